@@ -0,0 +1,1248 @@
+/*
+SDLBlocks
+
+Description:
+Placement AI used for autoplay, the attract mode and the blocksbot
+simulator.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "ai.h"
+
+#define AI_FULL_ROW ( (1<<TETRIS_WIDTH) - 1 )
+
+/* board column the tetrads spawn in */
+#define AI_SPAWN_COL ( ( (START_X) / TETRAD_WIDTH ) - 1 )
+
+/* every pattern in every column */
+#define AI_MAX_PLACEMENTS ( 4 * TETRIS_WIDTH )
+
+/* a tetrad pattern as row masks, bit 0 is the leftmost column of the pattern */
+
+struct AiPiece {
+	int w, h;
+	Uint16 rows[4];
+};
+
+struct AiPlacement {
+	int pattern;
+	int col;
+	int row;
+};
+
+/* weights from a genetic algorithm tuning of these four features, see README */
+struct AiWeights ai_default_weights = { -0.510066f, 0.760666f, -0.35663f, -0.184483f };
+
+static struct AiPiece ai_piece[MAX_TETRAD][4];
+
+static Uint64 ai_random( Uint64 *state );
+static int   ai_collide( const struct AiBoard *b, const struct AiPiece *p, int col, int row );
+static int   ai_placements( const struct AiBoard *b, int t, struct AiPlacement *list );
+static int   ai_place( struct AiBoard *dst, const struct AiBoard *src, int t, struct AiPlacement *pl );
+static Uint64 ai_hash( struct Ai *ai, const struct AiBoard *b );
+static float ai_evaluate( struct Ai *ai, const struct AiBoard *b );
+static float ai_search( struct Ai *ai, const struct AiBoard *b, const int *pieces, int n );
+static int   ai_over_budget( struct Ai *ai );
+static int   ai_beam_search( struct AiBeam *b, const struct AiBoard *board, const int *pieces, struct AiMove *move );
+static int   ai_beam_plan( void *data );
+static int   ai_beam_pass( struct AiBeam *b, const struct AiBoard *board, const int *pieces, int width, int abortable, double deadline, float *score );
+static void  ai_beam_level( struct AiBeam *b );
+static int   ai_beam_worker( void *data );
+static void  ai_beam_expand( struct AiBeam *b, struct AiWorker *w );
+static int   ai_beam_merge( struct AiBeam *b );
+static int   ai_better( const struct AiNode *a, const struct AiNode *b );
+static void  ai_select( struct AiNode *nodes, int *order, int lo, int hi, int k );
+static double ai_clock( void );
+
+/*
+ * ai_initialize
+ *
+ * build the row masks of every tetrad pattern, the Zobrist keys and
+ * the transposition table
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int ai_initialize( struct Ai *ai )
+{
+	struct TetradMask *m;
+	Uint64 cell[TETRIS_WIDTH];
+	Uint64 state;
+	int i, j, k, p;
+	int bits;
+
+	memset( ai, 0, sizeof(struct Ai) );
+
+	ai->table = malloc( AI_TABLE_SIZE * sizeof(struct AiEntry) );
+	if( ai->table == NULL )
+		return -1;
+
+	/* touch every page now rather than during the first searches */
+	memset( ai->table, 0, AI_TABLE_SIZE * sizeof(struct AiEntry) );
+
+	ai->weights = ai_default_weights;
+	ai->depth = AI_DEPTH;
+
+	for( i=0; i<MAX_TETRAD; i++ ) {
+		for( p=0; p<tetrad[i].num_patterns; p++ ) {
+			m = &tetrad[i].mask[p];
+			ai_piece[i][p].w = m->w;
+			ai_piece[i][p].h = m->h;
+			for( j=0; j<m->h; j++ ) {
+				ai_piece[i][p].rows[j] = 0;
+				for( k=0; k<m->w; k++ ) {
+					if( m->mask_arr[(j*m->w)+k] )
+						ai_piece[i][p].rows[j] |= 1 << k;
+				}
+			}
+		}
+	}
+
+	/* a fixed seed keeps the keys, and so any table statistics, reproducible */
+	state = 0x5344424c6f636b73ULL;
+
+	for( i=0; i<TETRIS_HEIGHT; i++ ) {
+		for( k=0; k<TETRIS_WIDTH; k++ )
+			cell[k] = ai_random( &state );
+
+		/* every row is the row with its lowest cell removed, plus that cell */
+		ai->row_key[i][0] = 0;
+		for( bits=1; bits<(1<<TETRIS_WIDTH); bits++ )
+			ai->row_key[i][bits] = ai->row_key[i][bits & (bits-1)] ^ cell[__builtin_ctz( bits )];
+	}
+
+	for( i=0; i<AI_MAX_DEPTH; i++ ) {
+		for( k=0; k<MAX_TETRAD; k++ )
+			ai->piece_key[i][k] = ai_random( &state );
+	}
+
+	for( i=0; i<=AI_MAX_DEPTH; i++ )
+		ai->depth_key[i] = ai_random( &state );
+
+	return 0;
+}
+
+/*
+ * ai_free
+ *
+ */
+void ai_free( struct Ai *ai )
+{
+	free( ai->table );
+	ai->table = NULL;
+}
+
+/*
+ * ai_board
+ *
+ * convert the game board to one bit per cell
+ *
+ */
+void ai_board( struct AiBoard *b, struct Tetris *t )
+{
+	int i, j;
+
+	for( i=0; i<TETRIS_HEIGHT; i++ ) {
+		b->rows[i] = 0;
+		for( j=0; j<TETRIS_WIDTH; j++ ) {
+			if( t->board[i][j] )
+				b->rows[i] |= 1 << j;
+		}
+	}
+}
+
+/*
+ * ai_choose
+ *
+ * find the best placement for the active tetrad, looking ahead at
+ * the upcoming tetrads up to the search depth. the depths are searched
+ * one after the other, a depth the budget runs out in is thrown away
+ * and the deepest one finished is played. depth 1 always finishes.
+ *
+ * returns 0 on success, -1 if the tetrad can't be placed anywhere
+ *
+ */
+int ai_choose( struct Ai *ai, struct Tetris *t, struct AiMove *move )
+{
+	struct AiPlacement list[AI_MAX_PLACEMENTS];
+	struct AiBoard board, next;
+	int pieces[AI_MAX_DEPTH];
+	int depth, d;
+	int lines;
+	int best, pass;
+	int n, i;
+	float score, pass_score;
+
+	depth = ai->depth;
+	if( depth < 1 )
+		depth = 1;
+	if( depth > AI_MAX_DEPTH )
+		depth = AI_MAX_DEPTH;
+
+	pieces[0] = t->cur_tetrad;
+	for( i=1; i<depth; i++ )
+		pieces[i] = t->next_tetrad[i-1];
+
+	ai_board( &board, t );
+
+	n = ai_placements( &board, pieces[0], list );
+	if( n == 0 )
+		return -1;
+
+	ai->start_nodes = ai->nodes;
+	ai->deadline = ( ai->budget_ms > 0 ) ? ai_clock() + ( ai->budget_ms / 1000.0 ) : 0.0;
+	ai->stop = 0;
+
+	best = -1;
+
+	for( d=1; d<=depth; d++ ) {
+		pass = -1;
+		pass_score = AI_LOSS;
+
+		for( i=0; i<n; i++ ) {
+			lines = ai_place( &next, &board, pieces[0], &list[i] );
+			score = ( lines * ai->weights.lines ) + ai_search( ai, &next, pieces+1, d-1 );
+
+			if( pass < 0 || score > pass_score ) {
+				pass = i;
+				pass_score = score;
+			}
+		}
+
+		if( ai->stop ) {
+			ai->cutoffs++;
+			break;
+		}
+
+		best = pass;
+		move->score = pass_score;
+	}
+
+	move->pattern = list[best].pattern;
+	move->tx = ( list[best].col + 1 ) * TETRAD_WIDTH;
+	move->ty = list[best].row * TETRAD_HEIGHT;
+
+	return 0;
+}
+
+/*
+ * ai_step
+ *
+ * take one action toward the chosen placement: rotate, then shift, then
+ * drop. a blocked action drops the tetrad where it is.
+ *
+ * returns 1 while there are actions left, 0 once the tetrad is dropped
+ *
+ */
+int ai_step( struct Tetris *t, struct AiMove *move )
+{
+	if( t->cur_pattern != move->pattern ) {
+		if( tetris_rotate( t ) )
+			return 1;
+	}
+	else if( t->tx > move->tx ) {
+		if( tetris_move_left( t ) )
+			return 1;
+	}
+	else if( t->tx < move->tx ) {
+		if( tetris_move_right( t ) )
+			return 1;
+	}
+
+	tetris_drop( t );
+
+	return 0;
+}
+
+/*
+ * ai_beam_initialize
+ *
+ * allocate the beams and the worker arenas and start the worker threads,
+ * threads < 1 uses one thread per online CPU
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int ai_beam_initialize( struct AiBeam *b, struct Ai *ai, int threads, int max_width )
+{
+	struct AiWorker *w;
+	int chunk;
+	int slots;
+	int i;
+
+	memset( b, 0, sizeof(struct AiBeam) );
+
+	if( threads < 1 )
+		threads = sysconf( _SC_NPROCESSORS_ONLN );
+	if( threads < 1 )
+		threads = 1;
+	if( threads > AI_BEAM_MAX_THREADS )
+		threads = AI_BEAM_MAX_THREADS;
+
+	if( max_width < 1 )
+		max_width = AI_BEAM_MAX_WIDTH;
+
+	b->ai = ai;
+	b->depth = AI_MAX_DEPTH;
+	b->width = ( max_width < AI_BEAM_WIDTH ) ? max_width : AI_BEAM_WIDTH;
+	b->max_width = max_width;
+	b->num_threads = threads;
+
+	b->beam = malloc( max_width * sizeof(struct AiNode) );
+	b->next = malloc( max_width * sizeof(struct AiNode) );
+	b->lock = SDL_CreateMutex();
+	b->start = SDL_CreateCond();
+	b->done = SDL_CreateCond();
+
+	if( b->beam == NULL || b->next == NULL || b->lock == NULL || b->start == NULL || b->done == NULL ) {
+		ai_beam_free( b );
+		return -1;
+	}
+
+	/* each worker expands at most its share of the widest beam */
+	chunk = ( max_width + threads - 1 ) / threads;
+
+	for( i=0; i<threads; i++ ) {
+		w = &b->workers[i];
+		w->beam = b;
+		w->index = i;
+		w->capacity = chunk * AI_MAX_PLACEMENTS;
+
+		for( slots=1; slots<2*w->capacity; slots<<=1 )
+			;
+
+		w->arena = malloc( w->capacity * sizeof(struct AiNode) );
+		w->order = malloc( w->capacity * sizeof(int) );
+		w->slots = calloc( slots, sizeof(struct AiSlot) );
+		w->slot_mask = slots - 1;
+
+		if( w->arena == NULL || w->order == NULL || w->slots == NULL ) {
+			ai_beam_free( b );
+			return -1;
+		}
+	}
+
+	/* the calling thread is worker 0 */
+	for( i=1; i<threads; i++ ) {
+		b->workers[i].thread = SDL_CreateThread( ai_beam_worker, &b->workers[i] );
+		if( b->workers[i].thread == NULL ) {
+			ai_beam_free( b );
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * ai_beam_free
+ *
+ * stop the worker threads and free the beams and arenas
+ *
+ */
+void ai_beam_free( struct AiBeam *b )
+{
+	int i;
+
+	/* the planner finishes its search on the workers before they stop */
+	if( b->planner != NULL ) {
+		SDL_mutexP( b->lock );
+		b->plan_quit = 1;
+		SDL_CondSignal( b->plan );
+		SDL_mutexV( b->lock );
+
+		SDL_WaitThread( b->planner, NULL );
+	}
+
+	if( b->lock != NULL ) {
+		SDL_mutexP( b->lock );
+		b->quit = 1;
+		SDL_CondBroadcast( b->start );
+		SDL_mutexV( b->lock );
+	}
+
+	for( i=0; i<b->num_threads; i++ ) {
+		if( b->workers[i].thread != NULL )
+			SDL_WaitThread( b->workers[i].thread, NULL );
+		free( b->workers[i].arena );
+		free( b->workers[i].order );
+		free( b->workers[i].slots );
+	}
+
+	if( b->plan != NULL )
+		SDL_DestroyCond( b->plan );
+	if( b->done != NULL )
+		SDL_DestroyCond( b->done );
+	if( b->start != NULL )
+		SDL_DestroyCond( b->start );
+	if( b->lock != NULL )
+		SDL_DestroyMutex( b->lock );
+
+	free( b->beam );
+	free( b->next );
+
+	memset( b, 0, sizeof(struct AiBeam) );
+}
+
+/*
+ * ai_beam_choose
+ *
+ * beam search over the active tetrad and the upcoming ones: every level
+ * expands all placements of the next tetrad on every board in the beam
+ * and keeps the best width boards. passes are repeated with twice the
+ * width while the budget lasts, a pass cut short by the budget is
+ * thrown away.
+ *
+ * returns 0 on success, -1 if the tetrad can't be placed anywhere
+ *
+ */
+int ai_beam_choose( struct AiBeam *b, struct Tetris *t, struct AiMove *move )
+{
+	struct AiBoard board;
+	int pieces[AI_MAX_DEPTH];
+	int i;
+
+	if( b->depth < 1 )
+		b->depth = 1;
+	if( b->depth > AI_MAX_DEPTH )
+		b->depth = AI_MAX_DEPTH;
+
+	pieces[0] = t->cur_tetrad;
+	for( i=1; i<b->depth; i++ )
+		pieces[i] = t->next_tetrad[i-1];
+
+	ai_board( &board, t );
+
+	return ai_beam_search( b, &board, pieces, move );
+}
+
+/*
+ * ai_beam_planner
+ *
+ * start the planner thread, after which the search can run next to the
+ * caller with ai_beam_start and ai_beam_poll
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int ai_beam_planner( struct AiBeam *b )
+{
+	b->plan = SDL_CreateCond();
+	if( b->plan == NULL )
+		return -1;
+
+	b->plan_state = AI_PLAN_IDLE;
+	b->planner = SDL_CreateThread( ai_beam_plan, b );
+
+	if( b->planner == NULL )
+		return -1;
+
+	return 0;
+}
+
+/*
+ * ai_beam_start
+ *
+ * hand the active tetrad of t to the planner thread, a result nobody
+ * picked up is thrown away. never waits for a search.
+ *
+ * returns 0 on success, -1 if the planner is still busy with the last
+ * search
+ *
+ */
+int ai_beam_start( struct AiBeam *b, struct Tetris *t )
+{
+	int i;
+
+	if( __atomic_load_n( &b->plan_state, __ATOMIC_ACQUIRE ) == AI_PLAN_BUSY )
+		return -1;
+
+	if( b->depth < 1 )
+		b->depth = 1;
+	if( b->depth > AI_MAX_DEPTH )
+		b->depth = AI_MAX_DEPTH;
+
+	b->plan_pieces[0] = t->cur_tetrad;
+	for( i=1; i<b->depth; i++ )
+		b->plan_pieces[i] = t->next_tetrad[i-1];
+
+	ai_board( &b->plan_board, t );
+
+	SDL_mutexP( b->lock );
+	__atomic_store_n( &b->plan_state, AI_PLAN_BUSY, __ATOMIC_RELEASE );
+	SDL_CondSignal( b->plan );
+	SDL_mutexV( b->lock );
+
+	return 0;
+}
+
+/*
+ * ai_beam_poll
+ *
+ * pick up the move of the search started with ai_beam_start
+ *
+ * returns 1 if the move is ready, 0 if the search is still running or
+ * none was started, -1 if the tetrad can't be placed anywhere
+ *
+ */
+int ai_beam_poll( struct AiBeam *b, struct AiMove *move )
+{
+	if( __atomic_load_n( &b->plan_state, __ATOMIC_ACQUIRE ) != AI_PLAN_DONE )
+		return 0;
+
+	*move = b->plan_move;
+	__atomic_store_n( &b->plan_state, AI_PLAN_IDLE, __ATOMIC_RELEASE );
+
+	return ( b->plan_result == 0 ) ? 1 : -1;
+}
+
+/*
+ * ai_beam_plan
+ *
+ * the planner thread
+ *
+ */
+static int ai_beam_plan( void *data )
+{
+	struct AiBeam *b = data;
+
+	SDL_mutexP( b->lock );
+
+	for( ;; ) {
+		while( !b->plan_quit && __atomic_load_n( &b->plan_state, __ATOMIC_ACQUIRE ) != AI_PLAN_BUSY )
+			SDL_CondWait( b->plan, b->lock );
+
+		if( b->plan_quit )
+			break;
+
+		SDL_mutexV( b->lock );
+
+		b->plan_result = ai_beam_search( b, &b->plan_board, b->plan_pieces, &b->plan_move );
+		__atomic_store_n( &b->plan_state, AI_PLAN_DONE, __ATOMIC_RELEASE );
+
+		SDL_mutexP( b->lock );
+	}
+
+	SDL_mutexV( b->lock );
+
+	return 0;
+}
+
+/*
+ * ai_beam_search
+ *
+ * the beam search of ai_beam_choose on board with the given tetrads
+ *
+ * returns 0 on success, -1 if the tetrad can't be placed anywhere
+ *
+ */
+static int ai_beam_search( struct AiBeam *b, const struct AiBoard *board, const int *pieces, struct AiMove *move )
+{
+	struct AiPlacement list[AI_MAX_PLACEMENTS];
+	double start, deadline;
+	float score, best_score;
+	int width;
+	int best;
+	int root;
+
+	start = ai_clock();
+	deadline = ( b->budget_ms > 0 ) ? start + ( b->budget_ms / 1000.0 ) : 0;
+
+	b->nodes = 0;
+	b->passes = 0;
+	b->reached = 0;
+
+	width = ( b->width < 1 ) ? 1 : b->width;
+	if( width > b->max_width )
+		width = b->max_width;
+
+	best = -1;
+	best_score = AI_LOSS;
+
+	for( ;; ) {
+		/* the first pass always runs to the end */
+		root = ai_beam_pass( b, board, pieces, width, ( best > -1 ), deadline, &score );
+
+		if( root == -2 )
+			break;
+		if( root == -1 )
+			return -1;
+
+		best = root;
+		best_score = score;
+		b->passes++;
+		b->reached = width;
+
+		if( b->budget_ms <= 0 && b->budget_nodes == 0 )
+			break;
+		if( width >= b->max_width )
+			break;
+		if( b->budget_nodes && b->nodes >= b->budget_nodes )
+			break;
+		if( b->budget_ms > 0 && ai_clock() >= deadline )
+			break;
+
+		width *= 2;
+		if( width > b->max_width )
+			width = b->max_width;
+	}
+
+	b->seconds = ai_clock() - start;
+
+	ai_placements( board, pieces[0], list );
+
+	move->pattern = list[best].pattern;
+	move->tx = ( list[best].col + 1 ) * TETRAD_WIDTH;
+	move->ty = list[best].row * TETRAD_HEIGHT;
+	move->score = best_score;
+
+	return 0;
+}
+
+/*
+ * ai_beam_pass
+ *
+ * one beam search of the given width
+ *
+ * returns the index of the best placement of the active tetrad in the
+ * order ai_placements lists them, -1 if there is none, -2 if the pass
+ * is abortable and the deadline or the node budget ran out first
+ *
+ */
+static int ai_beam_pass( struct AiBeam *b, const struct AiBoard *board, const int *pieces, int width, int abortable, double deadline, float *score )
+{
+	struct AiNode *tmp;
+	int root;
+	int level;
+	int n;
+
+	b->beam[0].board = *board;
+	b->beam[0].hash = ai_hash( b->ai, board );
+	b->beam[0].lines = 0;
+	b->beam[0].root = -1;
+	b->beam[0].score = 0;
+	b->beam_count = 1;
+	b->level_width = width;
+
+	root = -1;
+
+	for( level=0; level<b->depth; level++ ) {
+		b->piece = pieces[level];
+
+		ai_beam_level( b );
+		n = ai_beam_merge( b );
+
+		/* nothing survives this tetrad, go with the deepest level that had boards */
+		if( n == 0 )
+			break;
+
+		tmp = b->beam;
+		b->beam = b->next;
+		b->next = tmp;
+		b->beam_count = n;
+
+		root = b->beam[0].root;
+		*score = b->beam[0].score;
+
+		if( abortable && level+1 < b->depth ) {
+			if( deadline > 0 && ai_clock() >= deadline )
+				return -2;
+			if( b->budget_nodes && b->nodes >= b->budget_nodes )
+				return -2;
+		}
+	}
+
+	return root;
+}
+
+/*
+ * ai_beam_level
+ *
+ * expand the beam on every worker and wait for them all
+ *
+ */
+static void ai_beam_level( struct AiBeam *b )
+{
+	int i;
+
+	if( b->num_threads > 1 ) {
+		SDL_mutexP( b->lock );
+		b->pending = b->num_threads - 1;
+		b->generation++;
+		SDL_CondBroadcast( b->start );
+		SDL_mutexV( b->lock );
+	}
+
+	ai_beam_expand( b, &b->workers[0] );
+
+	if( b->num_threads > 1 ) {
+		SDL_mutexP( b->lock );
+		while( b->pending > 0 )
+			SDL_CondWait( b->done, b->lock );
+		SDL_mutexV( b->lock );
+	}
+
+	for( i=0; i<b->num_threads; i++ ) {
+		b->nodes += b->workers[i].nodes;
+		b->workers[i].nodes = 0;
+	}
+}
+
+/*
+ * ai_beam_worker
+ *
+ */
+static int ai_beam_worker( void *data )
+{
+	struct AiWorker *w = data;
+	struct AiBeam *b = w->beam;
+	Uint32 seen;
+
+	seen = 0;
+
+	SDL_mutexP( b->lock );
+
+	for( ;; ) {
+		while( !b->quit && b->generation == seen )
+			SDL_CondWait( b->start, b->lock );
+
+		if( b->quit )
+			break;
+
+		seen = b->generation;
+		SDL_mutexV( b->lock );
+
+		ai_beam_expand( b, w );
+
+		SDL_mutexP( b->lock );
+		if( --b->pending == 0 )
+			SDL_CondSignal( b->done );
+	}
+
+	SDL_mutexV( b->lock );
+
+	return 0;
+}
+
+/*
+ * ai_beam_expand
+ *
+ * expand this worker's share of the beam into its arena, drop boards
+ * it has already seen and sort out its best level_width boards
+ *
+ */
+static void ai_beam_expand( struct AiBeam *b, struct AiWorker *w )
+{
+	struct AiPlacement list[AI_MAX_PLACEMENTS];
+	struct AiNode *parent;
+	struct AiNode *child;
+	struct AiNode *dup;
+	struct AiSlot *slot;
+	int chunk, first, last;
+	int count;
+	int i, j, k;
+
+	w->count = 0;
+	w->kept = 0;
+	w->stamp++;
+
+	chunk = ( b->beam_count + b->num_threads - 1 ) / b->num_threads;
+	first = w->index * chunk;
+	last = first + chunk;
+	if( last > b->beam_count )
+		last = b->beam_count;
+
+	for( i=first; i<last; i++ ) {
+		parent = &b->beam[i];
+		count = ai_placements( &parent->board, b->piece, list );
+
+		for( j=0; j<count; j++ ) {
+			child = &w->arena[w->count];
+
+			child->lines = parent->lines + ai_place( &child->board, &parent->board, b->piece, &list[j] );
+			child->hash = ai_hash( b->ai, &child->board );
+			child->root = ( parent->root < 0 ) ? j : parent->root;
+
+			w->nodes++;
+
+			/* the same board reached another way: keep the lowest root so
+			 * the result doesn't depend on how the beam was split up */
+			k = child->hash & w->slot_mask;
+			for( slot=&w->slots[k]; slot->stamp==w->stamp; slot=&w->slots[k] ) {
+				if( slot->hash == child->hash )
+					break;
+				k = ( k + 1 ) & w->slot_mask;
+			}
+
+			if( slot->stamp == w->stamp ) {
+				dup = &w->arena[slot->node];
+				if( child->root < dup->root )
+					dup->root = child->root;
+				continue;
+			}
+
+			slot->hash = child->hash;
+			slot->node = w->count;
+			slot->stamp = w->stamp;
+
+			child->score = ( child->lines * b->ai->weights.lines ) + ai_evaluate( b->ai, &child->board );
+
+			w->order[w->count] = w->count;
+			w->count++;
+		}
+	}
+
+	w->kept = ( w->count < b->level_width ) ? w->count : b->level_width;
+	ai_select( w->arena, w->order, 0, w->count, w->kept );
+}
+
+/*
+ * ai_beam_merge
+ *
+ * merge the sorted survivors of every worker into the next beam,
+ * copies of one board come out next to each other and only the first
+ * one is kept
+ *
+ * returns the number of boards in the next beam
+ *
+ */
+static int ai_beam_merge( struct AiBeam *b )
+{
+	int head[AI_BEAM_MAX_THREADS];
+	struct AiWorker *w;
+	struct AiNode *node;
+	struct AiNode *best;
+	int from;
+	int n;
+	int i;
+
+	for( i=0; i<b->num_threads; i++ )
+		head[i] = 0;
+
+	n = 0;
+
+	while( n < b->level_width ) {
+		best = NULL;
+		from = -1;
+
+		for( i=0; i<b->num_threads; i++ ) {
+			w = &b->workers[i];
+			if( head[i] < w->kept ) {
+				node = &w->arena[w->order[head[i]]];
+				if( best == NULL || ai_better( node, best ) ) {
+					best = node;
+					from = i;
+				}
+			}
+		}
+
+		if( best == NULL )
+			break;
+
+		head[from]++;
+
+		if( n > 0 && best->hash == b->next[n-1].hash )
+			continue;
+
+		b->next[n++] = *best;
+	}
+
+	return n;
+}
+
+/*
+ * ai_better
+ *
+ * strict order of the boards in a beam: score, then hash and root to
+ * break ties the same way every time
+ *
+ */
+static int ai_better( const struct AiNode *a, const struct AiNode *b )
+{
+	if( a->score != b->score )
+		return a->score > b->score;
+	if( a->hash != b->hash )
+		return a->hash < b->hash;
+	return a->root < b->root;
+}
+
+/*
+ * ai_select
+ *
+ * partial quicksort: order[lo..hi) is rearranged so that its first k
+ * entries are the best k nodes, best first
+ *
+ */
+static void ai_select( struct AiNode *nodes, int *order, int lo, int hi, int k )
+{
+	int mid, store;
+	int pivot;
+	int tmp;
+	int i, j;
+
+	while( hi - lo > 16 ) {
+
+		/* median of three as the pivot, moved to the end */
+		mid = lo + ( ( hi - lo ) / 2 );
+		if( ai_better( &nodes[order[mid]], &nodes[order[lo]] ) ) {
+			tmp = order[mid]; order[mid] = order[lo]; order[lo] = tmp;
+		}
+		if( ai_better( &nodes[order[hi-1]], &nodes[order[lo]] ) ) {
+			tmp = order[hi-1]; order[hi-1] = order[lo]; order[lo] = tmp;
+		}
+		if( ai_better( &nodes[order[mid]], &nodes[order[hi-1]] ) ) {
+			tmp = order[mid]; order[mid] = order[hi-1]; order[hi-1] = tmp;
+		}
+
+		pivot = order[hi-1];
+		store = lo;
+
+		for( i=lo; i<hi-1; i++ ) {
+			if( ai_better( &nodes[order[i]], &nodes[pivot] ) ) {
+				tmp = order[i]; order[i] = order[store]; order[store] = tmp;
+				store++;
+			}
+		}
+
+		order[hi-1] = order[store];
+		order[store] = pivot;
+
+		/* the better side always matters, the worse side only if it
+		 * reaches into the first k */
+		if( store + 1 < k ) {
+			ai_select( nodes, order, lo, store, k );
+			lo = store + 1;
+		}
+		else {
+			hi = store;
+		}
+	}
+
+	/* insertion sort what's left */
+	for( i=lo+1; i<hi; i++ ) {
+		tmp = order[i];
+		for( j=i; j>lo && ai_better( &nodes[tmp], &nodes[order[j-1]] ); j-- )
+			order[j] = order[j-1];
+		order[j] = tmp;
+	}
+}
+
+/*
+ * ai_clock
+ *
+ * monotonic time in seconds
+ *
+ */
+static double ai_clock( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ( ts.tv_nsec / 1.0e9 );
+}
+
+/*
+ * ai_search
+ *
+ * score of the best sequence of placements of the n tetrads in pieces,
+ * memoized on the board and the tetrads left to place. once the budget
+ * runs out the scores are meaningless and aren't stored.
+ *
+ */
+static float ai_search( struct Ai *ai, const struct AiBoard *b, const int *pieces, int n )
+{
+	struct AiPlacement list[AI_MAX_PLACEMENTS];
+	struct AiBoard next;
+	struct AiEntry *e;
+	Uint64 key;
+	float best;
+	float score;
+	int lines;
+	int count;
+	int i;
+
+	ai->nodes++;
+
+	/* the budget is only checked above the leaves, so depth 1 finishes */
+	if( n > 0 && ai_over_budget( ai ) )
+		return AI_LOSS;
+
+	key = ai_hash( ai, b ) ^ ai->depth_key[n];
+	for( i=0; i<n; i++ )
+		key ^= ai->piece_key[i][pieces[i]];
+
+	e = &ai->table[ key & (AI_TABLE_SIZE-1) ];
+
+	ai->probes++;
+	if( e->key == key ) {
+		ai->hits++;
+		return e->score;
+	}
+
+	if( n == 0 ) {
+		best = ai_evaluate( ai, b );
+	}
+	else {
+		count = ai_placements( b, pieces[0], list );
+		best = AI_LOSS;
+
+		for( i=0; i<count; i++ ) {
+			lines = ai_place( &next, b, pieces[0], &list[i] );
+			score = ( lines * ai->weights.lines ) + ai_search( ai, &next, pieces+1, n-1 );
+			if( score > best )
+				best = score;
+		}
+
+		if( ai->stop )
+			return best;
+	}
+
+	e->key = key;
+	e->score = best;
+
+	return best;
+}
+
+/*
+ * ai_over_budget
+ *
+ * returns 1 once the search in progress has used up its nodes or time
+ *
+ */
+static int ai_over_budget( struct Ai *ai )
+{
+	if( ai->stop )
+		return 1;
+
+	if( ai->budget_nodes && ai->nodes - ai->start_nodes >= ai->budget_nodes )
+		ai->stop = 1;
+	else if( ai->deadline > 0 && ai_clock() > ai->deadline )
+		ai->stop = 1;
+
+	return ai->stop;
+}
+
+/*
+ * ai_evaluate
+ *
+ * weighted sum of the aggregate height, holes and bumpiness of a board
+ *
+ */
+static float ai_evaluate( struct Ai *ai, const struct AiBoard *b )
+{
+	int height[TETRIS_WIDTH];
+	Uint16 seen;
+	Uint16 fresh;
+	int total;
+	int holes;
+	int bump;
+	int i, d;
+
+	memset( height, 0, sizeof(height) );
+
+	seen = 0;
+	holes = 0;
+
+	/* top down: a column's height is set by its first filled cell, any
+	 * empty cell in a column already seen is a hole */
+	for( i=0; i<TETRIS_HEIGHT; i++ ) {
+		holes += __builtin_popcount( seen & ~b->rows[i] );
+
+		fresh = b->rows[i] & ~seen;
+		while( fresh ) {
+			height[__builtin_ctz( fresh )] = TETRIS_HEIGHT - i;
+			fresh &= fresh - 1;
+		}
+
+		seen |= b->rows[i];
+	}
+
+	total = height[0];
+	bump = 0;
+
+	for( i=1; i<TETRIS_WIDTH; i++ ) {
+		total += height[i];
+		d = height[i] - height[i-1];
+		bump += ( d < 0 ) ? -d : d;
+	}
+
+	return ( total * ai->weights.height ) + ( holes * ai->weights.holes ) + ( bump * ai->weights.bumpiness );
+}
+
+/*
+ * ai_placements
+ *
+ * list the placements reachable the way a player makes them: rotate at
+ * the spawn position, shift left or right, then drop. tucks and spins
+ * under an overhang (see perft) aren't listed: ai_step only rotates and
+ * shifts at the top, and in the game gravity pulls the tetrad down
+ * between its actions, so a move below the top isn't made reliably.
+ *
+ * returns the number of placements
+ *
+ */
+static int ai_placements( const struct AiBoard *b, int t, struct AiPlacement *list )
+{
+	struct AiPiece *p;
+	int pattern;
+	int col;
+	int row;
+	int n;
+	int dir;
+
+	n = 0;
+
+	for( pattern=0; pattern<tetrad[t].num_patterns; pattern++ ) {
+		p = &ai_piece[t][pattern];
+
+		/* a blocked rotation also blocks the ones after it */
+		if( ai_collide( b, p, AI_SPAWN_COL, 0 ) )
+			break;
+
+		for( dir=-1; dir<=1; dir+=2 ) {
+			col = ( dir < 0 ) ? AI_SPAWN_COL : AI_SPAWN_COL+1;
+
+			for( ; col>=0 && col+p->w<=TETRIS_WIDTH; col+=dir ) {
+				if( ai_collide( b, p, col, 0 ) )
+					break;
+
+				row = 0;
+				while( row+p->h < TETRIS_HEIGHT && !ai_collide( b, p, col, row+1 ) )
+					row++;
+
+				list[n].pattern = pattern;
+				list[n].col = col;
+				list[n].row = row;
+				n++;
+			}
+		}
+	}
+
+	return n;
+}
+
+/*
+ * ai_collide
+ *
+ */
+static int ai_collide( const struct AiBoard *b, const struct AiPiece *p, int col, int row )
+{
+	int i;
+
+	for( i=0; i<p->h; i++ ) {
+		if( b->rows[row+i] & ( p->rows[i] << col ) )
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * ai_place
+ *
+ * place a tetrad on a copy of the board and clear any filled rows,
+ * the same way tetris_update does
+ *
+ * returns the number of rows cleared
+ *
+ */
+static int ai_place( struct AiBoard *dst, const struct AiBoard *src, int t, struct AiPlacement *pl )
+{
+	struct AiPiece *p;
+	Uint16 top;
+	int lines;
+	int i, j;
+
+	p = &ai_piece[t][pl->pattern];
+
+	*dst = *src;
+	lines = 0;
+
+	for( i=0; i<p->h; i++ ) {
+		dst->rows[pl->row+i] |= p->rows[i] << pl->col;
+		if( dst->rows[pl->row+i] == AI_FULL_ROW )
+			lines++;
+	}
+
+	if( lines == 0 )
+		return 0;
+
+	/* the rows left over at the top repeat row 0 as in tetris_update,
+	 * they are only empty if row 0 was filled */
+	top = ( dst->rows[0] == AI_FULL_ROW ) ? 0 : dst->rows[0];
+
+	/* only rows under the tetrad can fill, everything above them moves down */
+	j = pl->row + p->h - 1;
+	for( i=j; i>-1; i-- ) {
+		if( dst->rows[i] != AI_FULL_ROW )
+			dst->rows[j--] = dst->rows[i];
+	}
+
+	while( j > -1 )
+		dst->rows[j--] = top;
+
+	return lines;
+}
+
+/*
+ * ai_hash
+ *
+ * Zobrist key of a board
+ *
+ */
+static Uint64 ai_hash( struct Ai *ai, const struct AiBoard *b )
+{
+	Uint64 key;
+	int i;
+
+	key = 0;
+
+	for( i=0; i<TETRIS_HEIGHT; i++ )
+		key ^= ai->row_key[i][b->rows[i]];
+
+	return key;
+}
+
+/*
+ * ai_random
+ *
+ * splitmix64
+ *
+ */
+static Uint64 ai_random( Uint64 *state )
+{
+	Uint64 z;
+
+	z = ( *state += 0x9e3779b97f4a7c15ULL );
+	z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+
+	return z ^ ( z >> 31 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,233 @@
+/*
+SDLBlocks
+
+Description:
+Placement AI used for autoplay, the attract mode and the blocksbot
+simulator.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef AI_H
+#define AI_H
+
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+
+/* the active tetrad plus every upcoming tetrad can be searched */
+#define AI_MAX_DEPTH (1+TETRIS_NUM_NEXT)
+
+/* default search depth: the active tetrad and the first preview */
+#define AI_DEPTH 2
+
+/* budget of a move in the game: nodes and time, past either the search
+ * plays the deepest depth it finished. AI_BUDGET_NODES takes about
+ * 0.5 ms at depth 2 and is never reached there. */
+#define AI_BUDGET_NODES 1500
+#define AI_BUDGET_MS 0.5
+
+/* transposition table entries, must be a power of two */
+#define AI_TABLE_BITS 16
+#define AI_TABLE_SIZE (1<<AI_TABLE_BITS)
+
+/* score of a position the game can't continue from */
+#define AI_LOSS -1.0e9f
+
+/* beam search: width of the first pass and the widest pass, the width
+ * doubles every pass while there is budget left */
+#define AI_BEAM_WIDTH 64
+#define AI_BEAM_MAX_WIDTH 1024
+#define AI_BEAM_MAX_THREADS 64
+
+/* search on the planner thread, see ai_beam_start */
+#define AI_PLAN_IDLE 0
+#define AI_PLAN_BUSY 1
+#define AI_PLAN_DONE 2
+
+/* weights of the board features */
+
+struct AiWeights {
+	float height;		/* sum of the column heights */
+	float lines;		/* rows cleared by the placement */
+	float holes;		/* empty cells with a filled cell above them */
+	float bumpiness;	/* sum of the height differences of neighbouring columns */
+};
+
+/* one row per bit, bit 0 is the leftmost column */
+
+struct AiBoard {
+	Uint16 rows[TETRIS_HEIGHT];
+};
+
+/* a placement of the active tetrad, in game board coordinates */
+
+struct AiMove {
+	int pattern;
+	int tx;
+	int ty;
+	float score;
+};
+
+struct AiEntry {
+	Uint64 key;
+	float score;
+};
+
+struct Ai {
+	struct AiWeights weights;
+
+	/* depth -- number of tetrads searched, 1..AI_MAX_DEPTH */
+	int depth;
+
+	/* Zobrist keys: row_key -- every possible row at every height,
+	 * piece_key -- a tetrad at a position in the search, depth_key -- remaining depth */
+	Uint64 row_key[TETRIS_HEIGHT][1<<TETRIS_WIDTH];
+	Uint64 piece_key[AI_MAX_DEPTH][MAX_TETRAD];
+	Uint64 depth_key[AI_MAX_DEPTH+1];
+
+	/* budget_nodes, budget_ms -- limit of one ai_choose, 0 for no limit */
+	Uint32 budget_nodes;
+	double budget_ms;
+
+	/* table -- always-replace transposition table of searched positions */
+	struct AiEntry *table;
+
+	/* the search in progress: stop -- its budget ran out */
+	Uint32 start_nodes;
+	double deadline;
+	int stop;
+
+	/* statistics since ai_initialize, cutoffs -- moves the budget cut short */
+	Uint32 nodes;
+	Uint32 probes;
+	Uint32 hits;
+	Uint32 cutoffs;
+};
+
+/* a board in the beam */
+
+struct AiNode {
+	struct AiBoard board;
+	Uint64 hash;
+	int lines;		/* rows cleared on the way to this board */
+	int root;		/* placement of the active tetrad this board descends from */
+	float score;
+};
+
+/* duplicate detection, slots from an older level have an older stamp */
+
+struct AiSlot {
+	Uint64 hash;
+	int node;
+	Uint32 stamp;
+};
+
+struct AiBeam;
+
+/* one thread of the beam search, everything it touches while
+ * expanding a level is allocated up front */
+
+struct AiWorker {
+	struct AiBeam *beam;
+	SDL_Thread *thread;
+	int index;
+
+	/* arena -- boards expanded this level, order -- the best of them, best first */
+	struct AiNode *arena;
+	int *order;
+	int capacity;
+	int count;
+	int kept;
+
+	struct AiSlot *slots;
+	int slot_mask;
+	Uint32 stamp;
+
+	Uint32 nodes;
+};
+
+struct AiBeam {
+	struct Ai *ai;
+
+	/* depth -- tetrads searched, width -- first pass, max_width -- last pass */
+	int depth;
+	int width;
+	int max_width;
+
+	/* budget_ms, budget_nodes -- stop widening once either is used up, 0 for no limit.
+	 * with neither set a single pass of width is made */
+	double budget_ms;
+	Uint32 budget_nodes;
+
+	int num_threads;
+	struct AiWorker workers[AI_BEAM_MAX_THREADS];
+
+	/* the pool: workers wait for generation to change, the last one done signals */
+	SDL_mutex *lock;
+	SDL_cond *start;
+	SDL_cond *done;
+	Uint32 generation;
+	int pending;
+	int quit;
+
+	/* planner -- thread that runs the searches asked for with
+	 * ai_beam_start, plan_state -- AI_PLAN_*, handed back and forth
+	 * with atomics. the plan_* fields belong to whichever side the
+	 * state says: the caller when IDLE or DONE, the planner when BUSY. */
+	SDL_Thread *planner;
+	SDL_cond *plan;
+	int plan_state;
+	int plan_quit;
+	struct AiBoard plan_board;
+	int plan_pieces[AI_MAX_DEPTH];
+	struct AiMove plan_move;
+	int plan_result;
+
+	/* the level being expanded: beam -- parents, next -- the survivors */
+	struct AiNode *beam;
+	struct AiNode *next;
+	int beam_count;
+	int level_width;
+	int piece;
+
+	/* statistics of the last search */
+	Uint32 nodes;
+	double seconds;
+	int passes;
+	int reached;
+};
+
+extern struct AiWeights ai_default_weights;
+
+int   ai_initialize( struct Ai *ai );
+void  ai_free( struct Ai *ai );
+void  ai_board( struct AiBoard *b, struct Tetris *t );
+int   ai_choose( struct Ai *ai, struct Tetris *t, struct AiMove *move );
+int   ai_step( struct Tetris *t, struct AiMove *move );
+
+int   ai_beam_initialize( struct AiBeam *b, struct Ai *ai, int threads, int max_width );
+void  ai_beam_free( struct AiBeam *b );
+int   ai_beam_choose( struct AiBeam *b, struct Tetris *t, struct AiMove *move );
+int   ai_beam_planner( struct AiBeam *b );
+int   ai_beam_start( struct AiBeam *b, struct Tetris *t );
+int   ai_beam_poll( struct AiBeam *b, struct AiMove *move );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
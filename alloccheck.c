@@ -0,0 +1,291 @@
+/*
+SDLBlocks
+
+Description:
+Test build only: counts heap allocations made while the game runs
+and drives the game from a replay's keys without a player.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dlfcn.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "replay.h"
+#include "game.h"
+#include "alloccheck.h"
+
+/* the allocator behind the one defined here */
+extern void *__libc_malloc( size_t size );
+extern void *__libc_calloc( size_t num, size_t size );
+extern void *__libc_realloc( void *ptr, size_t size );
+extern void *__libc_memalign( size_t align, size_t size );
+extern void  __libc_free( void *ptr );
+
+static void alloc_check_count( void *caller );
+static void alloc_script_press( struct Game *g, SDLKey key );
+
+/* armed -- count the calls, from any thread */
+static int check_armed;
+static Uint32 check_allocs;
+static Uint32 check_frees;
+static void *check_callers[ALLOC_CHECK_CALLERS];
+
+/* key for each replay action */
+static const SDLKey script_keys[] = {
+	SDLK_UNKNOWN, SDLK_LEFT, SDLK_RIGHT, SDLK_UP, SDLK_DOWN, SDLK_SPACE, SDLK_p
+};
+
+/*
+ * malloc, calloc, realloc, free, posix_memalign, aligned_alloc, memalign
+ *
+ * replace the C library's, which SDL and its libraries call as well
+ *
+ */
+void *malloc( size_t size )
+{
+	alloc_check_count( __builtin_return_address( 0 ) );
+	return __libc_malloc( size );
+}
+
+void *calloc( size_t num, size_t size )
+{
+	alloc_check_count( __builtin_return_address( 0 ) );
+	return __libc_calloc( num, size );
+}
+
+void *realloc( void *ptr, size_t size )
+{
+	alloc_check_count( __builtin_return_address( 0 ) );
+	return __libc_realloc( ptr, size );
+}
+
+void free( void *ptr )
+{
+	if( ptr != NULL && __atomic_load_n( &check_armed, __ATOMIC_RELAXED ) )
+		__atomic_fetch_add( &check_frees, 1, __ATOMIC_RELAXED );
+
+	__libc_free( ptr );
+}
+
+int posix_memalign( void **ptr, size_t align, size_t size )
+{
+	alloc_check_count( __builtin_return_address( 0 ) );
+
+	if( align < sizeof(void *) || ( align & ( align - 1 ) ) )
+		return EINVAL;
+
+	*ptr = __libc_memalign( align, size );
+
+	return ( *ptr != NULL ) ? 0 : ENOMEM;
+}
+
+void *aligned_alloc( size_t align, size_t size )
+{
+	alloc_check_count( __builtin_return_address( 0 ) );
+	return __libc_memalign( align, size );
+}
+
+void *memalign( size_t align, size_t size )
+{
+	alloc_check_count( __builtin_return_address( 0 ) );
+	return __libc_memalign( align, size );
+}
+
+/*
+ * alloc_check_arm
+ *
+ * start counting, everything allocated so far was startup
+ *
+ */
+void alloc_check_arm( void )
+{
+	__atomic_store_n( &check_allocs, 0, __ATOMIC_RELAXED );
+	__atomic_store_n( &check_frees, 0, __ATOMIC_RELAXED );
+	__atomic_store_n( &check_armed, 1, __ATOMIC_SEQ_CST );
+}
+
+/*
+ * alloc_check_disarm
+ *
+ */
+void alloc_check_disarm( void )
+{
+	__atomic_store_n( &check_armed, 0, __ATOMIC_SEQ_CST );
+}
+
+/*
+ * alloc_check_report
+ *
+ * print the counts and where the first allocations came from
+ *
+ * returns the number of allocations while armed
+ *
+ */
+int alloc_check_report( FILE *fp )
+{
+	Dl_info info;
+	Uint32 allocs;
+	Uint32 i;
+
+	allocs = __atomic_load_n( &check_allocs, __ATOMIC_SEQ_CST );
+
+	fprintf( fp, "%u allocations, %u frees\n", allocs, __atomic_load_n( &check_frees, __ATOMIC_SEQ_CST ) );
+
+	for( i=0; i<allocs && i<ALLOC_CHECK_CALLERS; i++ ) {
+		if( dladdr( check_callers[i], &info ) && info.dli_sname != NULL )
+			fprintf( fp, "  %p %s+0x%lx (%s)\n", check_callers[i], info.dli_sname,
+					(unsigned long)( (char *)check_callers[i] - (char *)info.dli_saddr ), info.dli_fname );
+		else if( dladdr( check_callers[i], &info ) )
+			fprintf( fp, "  %p (%s)\n", check_callers[i], info.dli_fname );
+		else
+			fprintf( fp, "  %p\n", check_callers[i] );
+	}
+
+	return (int)allocs;
+}
+
+/*
+ * alloc_check_count
+ *
+ */
+static void alloc_check_count( void *caller )
+{
+	Uint32 n;
+
+	if( !__atomic_load_n( &check_armed, __ATOMIC_RELAXED ) )
+		return;
+
+	n = __atomic_fetch_add( &check_allocs, 1, __ATOMIC_RELAXED );
+	if( n < ALLOC_CHECK_CALLERS )
+		check_callers[n] = caller;
+}
+
+/*
+ * alloc_script_load
+ *
+ * read the key presses of a replay, the script for every game played
+ * during the check
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int alloc_script_load( struct AllocScript *s, const char *path, Uint32 ticks )
+{
+	static struct Replay replay;
+	Uint8 actions[REPLAY_MAX_ACTIONS];
+	Uint32 time;
+	int num_actions;
+	int status;
+	int i;
+
+	memset( s, 0, sizeof(struct AllocScript) );
+	s->ticks = ticks;
+
+	if( replay_open( &replay, path ) != 0 )
+		return -1;
+
+	while( ( status = replay_read( &replay, &time, actions, &num_actions ) ) == 1 ) {
+		for( i=0; i<num_actions && s->num_keys<ALLOC_SCRIPT_KEYS; i++ ) {
+			if( actions[i] < sizeof(script_keys) / sizeof(script_keys[0]) &&
+					script_keys[actions[i]] != SDLK_UNKNOWN ) {
+				s->keys[s->num_keys].time = time;
+				s->keys[s->num_keys].key = script_keys[actions[i]];
+				s->num_keys++;
+			}
+		}
+	}
+
+	replay_close( &replay );
+
+	if( status != 0 || s->num_keys == 0 ) {
+		fprintf( stderr, "Unable to read a key script from the replay: %s\n", path );
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * alloc_script_step
+ *
+ * play the script on the game, called once per loop of the event loop
+ * with its latest snapshot. SPACE starts every game, the check is armed
+ * when the first one is running and the script starts over on each
+ * game and whenever a game outlasts it.
+ *
+ * returns 0 when the check has run for its time
+ *
+ */
+int alloc_script_step( struct AllocScript *s, struct Game *g, struct GameSnapshot *snap, Uint32 now )
+{
+	struct Tetris *t = &snap->tetris;
+
+	if( s->armed && now - s->start >= s->ticks )
+		return 0;
+
+	if( snap->attract || t->state == TETRIS_STATE_START || t->state == TETRIS_STATE_OVER ) {
+		s->playing = 0;
+		if( (Sint32)( now - s->space ) >= 0 ) {
+			alloc_script_press( g, SDLK_SPACE );
+			s->space = now + ALLOC_SCRIPT_SPACE_TICKS;
+		}
+		return 1;
+	}
+
+	if( !s->playing ) {
+		s->playing = 1;
+		s->base = now;
+		s->next = 0;
+
+		if( !s->armed ) {
+			alloc_check_arm();
+			s->armed = 1;
+			s->start = now;
+		}
+	}
+
+	while( s->next < s->num_keys && now - s->base >= s->keys[s->next].time )
+		alloc_script_press( g, s->keys[s->next++].key );
+
+	if( s->next == s->num_keys ) {
+		s->base = now;
+		s->next = 0;
+	}
+
+	return 1;
+}
+
+/*
+ * alloc_script_press
+ *
+ */
+static void alloc_script_press( struct Game *g, SDLKey key )
+{
+	game_key( g, key, 1 );
+	game_key( g, key, 0 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,79 @@
+/*
+SDLBlocks
+
+Description:
+Test build only: counts heap allocations made while the game runs
+and drives the game from a replay's keys without a player.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef ALLOCCHECK_H
+#define ALLOCCHECK_H
+
+#include <stdio.h>
+#include <SDL/SDL.h>
+
+#include "game.h"
+
+/* how long the scripted games run by default (s) */
+#define ALLOC_CHECK_SECONDS 600
+
+/* allocating call sites remembered for the report */
+#define ALLOC_CHECK_CALLERS 16
+
+/* key presses read from the replay, the rest are dropped */
+#define ALLOC_SCRIPT_KEYS 65536
+
+/* time between presses of SPACE on the start and game over screens (ms) */
+#define ALLOC_SCRIPT_SPACE_TICKS 500
+
+struct AllocKey {
+	/* time -- ms since the start of the game */
+	Uint32 time;
+	SDLKey key;
+};
+
+struct AllocScript {
+	struct AllocKey keys[ALLOC_SCRIPT_KEYS];
+	int num_keys;
+
+	/* next -- next key to press, playing -- a game is running,
+	 * base -- when the script was started on it */
+	int next;
+	int playing;
+	Uint32 base;
+
+	/* armed -- counting since start, for ticks ms,
+	 * space -- next press of SPACE */
+	int armed;
+	Uint32 start;
+	Uint32 ticks;
+	Uint32 space;
+};
+
+void alloc_check_arm( void );
+void alloc_check_disarm( void );
+int  alloc_check_report( FILE *fp );
+
+int  alloc_script_load( struct AllocScript *s, const char *path, Uint32 ticks );
+int  alloc_script_step( struct AllocScript *s, struct Game *g, struct GameSnapshot *snap, Uint32 now );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
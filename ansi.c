@@ -0,0 +1,412 @@
+/*
+SDLBlocks
+
+Description:
+Text renderer: draws the game with ANSI escape codes, sending only
+the cells that changed since the last frame.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "ansi.h"
+
+/* a run of unchanged cells up to this long is sent again rather than
+ * moved over, when no attribute change is needed it is never longer
+ * than the cursor movement */
+#define ANSI_MAX_GAP 3
+
+/* reset the attributes, hide the cursor, clear the screen */
+#define ANSI_START "\033[0m\033[?25l\033[2J\033[H"
+
+static void ansi_move( struct Ansi *a, int row, int col );
+static void ansi_attr( struct Ansi *a, int attr );
+static void ansi_put( struct Ansi *a, const char *s, int n );
+static void ansi_write( struct Ansi *a );
+static int  ansi_color( Uint32 color );
+
+/*
+ * ansi_initialize
+ *
+ * frames are written to fd, the first flush clears the terminal
+ *
+ */
+void ansi_initialize( struct Ansi *a, int fd )
+{
+	memset( a, 0, sizeof(struct Ansi) );
+
+	a->fd = fd;
+	a->full = 1;
+
+	ansi_clear( a );
+}
+
+/*
+ * ansi_clear
+ *
+ * start a new frame
+ *
+ */
+void ansi_clear( struct Ansi *a )
+{
+	int i, j;
+
+	for( i=0; i<ANSI_ROWS; i++ ) {
+		for( j=0; j<ANSI_COLS; j++ ) {
+			a->frame[i][j].ch = ' ';
+			a->frame[i][j].attr = ANSI_PLAIN;
+		}
+	}
+}
+
+/*
+ * ansi_text
+ *
+ * put plain text into the frame at row,col, clipped to the frame
+ *
+ */
+void ansi_text( struct Ansi *a, int row, int col, const char *text )
+{
+	if( row < 0 || row >= ANSI_ROWS )
+		return;
+
+	for( ; *text && col < ANSI_COLS; text++, col++ ) {
+		if( col < 0 )
+			continue;
+		a->frame[row][col].ch = *text;
+		a->frame[row][col].attr = ANSI_PLAIN;
+	}
+}
+
+/*
+ * ansi_block
+ *
+ * put a block, two cells wide, into the frame at row,col. it shows as
+ * [] so it can be told apart without colors.
+ *
+ */
+void ansi_block( struct Ansi *a, int row, int col, Uint32 color )
+{
+	int attr;
+
+	if( row < 0 || row >= ANSI_ROWS || col < 0 || col+1 >= ANSI_COLS )
+		return;
+
+	attr = ANSI_BLOCK( ansi_color( color ) );
+
+	a->frame[row][col].ch = '[';
+	a->frame[row][col].attr = attr;
+	a->frame[row][col+1].ch = ']';
+	a->frame[row][col+1].attr = attr;
+}
+
+/*
+ * ansi_draw_game
+ *
+ * draw the board, the active tetrad and the game text into a cleared
+ * frame, laid out like render_game()
+ *
+ */
+void ansi_draw_game( struct Ansi *a, struct Tetris *t )
+{
+	struct TetradMask *mask;
+	char text[64];
+	int i, j;
+	int bx, by;
+
+	/* walls and floor */
+	for( i=0; i<TETRIS_HEIGHT; i++ ) {
+		ansi_text( a, i, 0, "<!" );
+		ansi_text( a, i, 2 + (TETRIS_WIDTH*2), "!>" );
+	}
+
+	ansi_text( a, TETRIS_HEIGHT, 0, "<!" );
+	for( j=0; j<TETRIS_WIDTH; j++ ) {
+		ansi_text( a, TETRIS_HEIGHT, 2 + (j*2), "==" );
+		ansi_text( a, TETRIS_HEIGHT+1, 2 + (j*2), "\\/" );
+	}
+	ansi_text( a, TETRIS_HEIGHT, 2 + (TETRIS_WIDTH*2), "!>" );
+
+	/* the tetrominoes already on the matrix, filled rows are drawn
+	 * white until they are removed */
+	for( i=0; i<TETRIS_HEIGHT; i++ ) {
+		for( j=0; j<TETRIS_WIDTH; j++ ) {
+			if( t->state == TETRIS_STATE_CLEAR && ( t->clear_rows & ( 1 << i ) ) )
+				ansi_block( a, i, 2 + (j*2), 0xffffff );
+			else if( t->board[i][j] )
+				ansi_block( a, i, 2 + (j*2), t->board[i][j] );
+			else
+				ansi_text( a, i, 3 + (j*2), "." );
+		}
+	}
+
+	/* the active tetrad */
+	if( TETRIS_SHOWN( t ) ) {
+		mask = &t->t->mask[t->cur_pattern];
+		bx = ( t->tx / TETRAD_WIDTH ) - 1;
+		by = t->ty / TETRAD_HEIGHT;
+
+		for( i=0; i<mask->h; i++ ) {
+			for( j=0; j<mask->w; j++ ) {
+				if( mask->mask_arr[(i*mask->w)+j] && by+i > -1 )
+					ansi_block( a, by+i, 2 + ((bx+j)*2), t->t->color );
+			}
+		}
+	}
+
+	/* game text */
+	ansi_text( a, 0, ANSI_TEXT_COL, "SDLBlocks" );
+	sprintf( &text[0], "level: %d", t->game_level );
+	ansi_text( a, 2, ANSI_TEXT_COL, &text[0] );
+	sprintf( &text[0], "lines: %d", t->game_total_num_lines_cleared );
+	ansi_text( a, 3, ANSI_TEXT_COL, &text[0] );
+	sprintf( &text[0], "score: %d", t->game_score );
+	ansi_text( a, 4, ANSI_TEXT_COL, &text[0] );
+
+	/* preview of the next tetrad */
+	if( t->state != TETRIS_STATE_START && t->state != TETRIS_STATE_OVER ) {
+		mask = &tetrad[t->next_tetrad[0]].mask[0];
+
+		for( i=0; i<mask->h; i++ ) {
+			for( j=0; j<mask->w; j++ ) {
+				if( mask->mask_arr[(i*mask->w)+j] )
+					ansi_block( a, 2+i, ANSI_TEXT_COL + 14 + (j*2), tetrad[t->next_tetrad[0]].color );
+			}
+		}
+	}
+}
+
+/*
+ * ansi_flush
+ *
+ * bring the terminal up to date with the frame, sending only the cells
+ * that differ from the shadow copy
+ *
+ * returns the number of bytes sent
+ *
+ */
+int ansi_flush( struct Ansi *a )
+{
+	struct AnsiCell *cell;
+	Uint64 bytes;
+	int i, j;
+
+	bytes = a->bytes;
+
+	if( a->full ) {
+		/* the cleared terminal matches an all blank shadow */
+		ansi_put( a, ANSI_START, sizeof(ANSI_START) - 1 );
+
+		for( i=0; i<ANSI_ROWS; i++ ) {
+			for( j=0; j<ANSI_COLS; j++ ) {
+				a->shadow[i][j].ch = ' ';
+				a->shadow[i][j].attr = ANSI_PLAIN;
+			}
+		}
+
+		a->row = 0;
+		a->col = 0;
+		a->attr = ANSI_PLAIN;
+		a->full = 0;
+	}
+
+	for( i=0; i<ANSI_ROWS; i++ ) {
+		for( j=0; j<ANSI_COLS; j++ ) {
+			cell = &a->frame[i][j];
+
+			if( cell->ch == a->shadow[i][j].ch && cell->attr == a->shadow[i][j].attr )
+				continue;
+
+			ansi_move( a, i, j );
+			ansi_attr( a, cell->attr );
+			ansi_put( a, (char *)&cell->ch, 1 );
+
+			a->shadow[i][j] = *cell;
+			a->col++;
+		}
+	}
+
+	ansi_write( a );
+	a->frames++;
+
+	return (int)( a->bytes - bytes );
+}
+
+/*
+ * ansi_restore
+ *
+ * leave the terminal as it was, with the cursor below the frame
+ *
+ */
+void ansi_restore( struct Ansi *a )
+{
+	char seq[32];
+
+	sprintf( &seq[0], "\033[0m\033[%dH\033[?25h", ANSI_ROWS + 1 );
+	ansi_put( a, &seq[0], strlen( &seq[0] ) );
+	ansi_write( a );
+
+	a->full = 1;
+}
+
+/*
+ * ansi_move
+ *
+ * move the cursor to row,col the cheapest way: write over a short run
+ * of cells that are already right, or move forward on the same row, or
+ * jump there
+ *
+ */
+static void ansi_move( struct Ansi *a, int row, int col )
+{
+	char seq[32];
+	int gap;
+	int j;
+
+	if( a->row == row && a->col == col )
+		return;
+
+	if( a->row == row && col > a->col ) {
+		gap = col - a->col;
+
+		if( gap <= ANSI_MAX_GAP ) {
+			for( j=a->col; j<col; j++ ) {
+				if( a->shadow[row][j].attr != a->attr )
+					break;
+			}
+
+			if( j == col ) {
+				for( j=a->col; j<col; j++ )
+					ansi_put( a, (char *)&a->shadow[row][j].ch, 1 );
+				a->col = col;
+				return;
+			}
+		}
+
+		if( gap == 1 )
+			sprintf( &seq[0], "\033[C" );
+		else
+			sprintf( &seq[0], "\033[%dC", gap );
+	}
+	else if( col == 0 ) {
+		sprintf( &seq[0], "\033[%dH", row + 1 );
+	}
+	else {
+		sprintf( &seq[0], "\033[%d;%dH", row + 1, col + 1 );
+	}
+
+	ansi_put( a, &seq[0], strlen( &seq[0] ) );
+
+	a->row = row;
+	a->col = col;
+}
+
+/*
+ * ansi_attr
+ *
+ */
+static void ansi_attr( struct Ansi *a, int attr )
+{
+	char seq[16];
+
+	if( attr == a->attr )
+		return;
+
+	/* black blocks on a black terminal are drawn in reverse video */
+	if( attr == ANSI_PLAIN )
+		sprintf( &seq[0], "\033[0m" );
+	else if( attr == ANSI_BLOCK( 0 ) )
+		sprintf( &seq[0], "\033[0;7m" );
+	else
+		sprintf( &seq[0], "\033[0;30;%dm", 40 + ( attr - 1 ) );
+
+	ansi_put( a, &seq[0], strlen( &seq[0] ) );
+
+	a->attr = attr;
+}
+
+/*
+ * ansi_put
+ *
+ */
+static void ansi_put( struct Ansi *a, const char *s, int n )
+{
+	if( a->len + n > ANSI_OUT_SIZE )
+		ansi_write( a );
+
+	memcpy( &a->out[a->len], s, n );
+	a->len += n;
+}
+
+/*
+ * ansi_write
+ *
+ * write out the buffer, a terminal that went away is ignored
+ *
+ */
+static void ansi_write( struct Ansi *a )
+{
+	ssize_t n;
+	int done;
+
+	done = 0;
+
+	while( done < a->len ) {
+		n = write( a->fd, &a->out[done], a->len - done );
+		if( n < 0 ) {
+			if( errno == EINTR || errno == EAGAIN )
+				continue;
+			break;
+		}
+		done += n;
+	}
+
+	a->bytes += a->len;
+	a->len = 0;
+}
+
+/*
+ * ansi_color
+ *
+ * nearest ANSI palette color of a 0xRRGGBB tetrad color
+ *
+ */
+static int ansi_color( Uint32 color )
+{
+	int c;
+
+	c = 0;
+
+	if( ( color >> 16 ) & 0x80 )
+		c |= 1;
+	if( ( color >> 8 ) & 0x80 )
+		c |= 2;
+	if( color & 0x80 )
+		c |= 4;
+
+	return c;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,88 @@
+/*
+SDLBlocks
+
+Description:
+Text renderer: draws the game with ANSI escape codes, sending only
+the cells that changed since the last frame.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef ANSI_H
+#define ANSI_H
+
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+
+/* size of the text frame: the board with its walls and floor, then the
+ * game text to the right of it */
+#define ANSI_ROWS 22
+#define ANSI_COLS 48
+
+/* column of the game text */
+#define ANSI_TEXT_COL 26
+
+/* output buffer, written out whenever it fills up */
+#define ANSI_OUT_SIZE 4096
+
+/* cell attributes: plain text, or a block with a background color
+ * from the ANSI palette, whose bits are red 1, green 2, blue 4 */
+#define ANSI_PLAIN 0
+#define ANSI_BLOCK( color ) ( 1 + (color) )
+
+struct AnsiCell {
+	Uint8 ch;
+	Uint8 attr;
+};
+
+struct Ansi {
+	int fd;
+
+	/* frame -- the next frame, shadow -- what the terminal shows */
+	struct AnsiCell frame[ANSI_ROWS][ANSI_COLS];
+	struct AnsiCell shadow[ANSI_ROWS][ANSI_COLS];
+
+	/* full -- the terminal contents are unknown, clear it and send
+	 * every cell on the next flush */
+	int full;
+
+	/* row, col -- terminal cursor, attr -- current attribute */
+	int row;
+	int col;
+	int attr;
+
+	int len;
+	char out[ANSI_OUT_SIZE];
+
+	/* frames, bytes -- flushes and bytes written */
+	Uint64 frames;
+	Uint64 bytes;
+};
+
+void ansi_initialize( struct Ansi *a, int fd );
+void ansi_clear( struct Ansi *a );
+void ansi_text( struct Ansi *a, int row, int col, const char *text );
+void ansi_block( struct Ansi *a, int row, int col, Uint32 color );
+void ansi_draw_game( struct Ansi *a, struct Tetris *t );
+int  ansi_flush( struct Ansi *a );
+void ansi_restore( struct Ansi *a );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
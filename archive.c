@@ -0,0 +1,709 @@
+/*
+SDLBlocks
+
+Description:
+Replay archives: many games in one column oriented file with an index,
+read in place through mmap.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "replay.h"
+#include "archive.h"
+
+static int  archive_put_block( struct ArchiveWriter *w );
+static Uint64 archive_put_column( struct ArchiveWriter *w, const void *data, size_t size );
+static Uint64 archive_put_spool( struct ArchiveWriter *w, FILE *spool );
+static int  archive_put_varint( FILE *fp, Uint32 v );
+static int  archive_get_varint( const struct Archive *a, Uint64 *off, Uint32 *v );
+static int  archive_column( const struct Archive *a, Uint64 off, Uint64 size );
+static void archive_free( struct ArchiveWriter *w );
+
+/*
+ * archive_create
+ *
+ * start writing an archive to path
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int archive_create( struct ArchiveWriter *w, const char *path )
+{
+	struct ArchiveHeader hdr;
+
+	memset( w, 0, sizeof(struct ArchiveWriter) );
+
+	w->fp = fopen( path, "wb" );
+	if( w->fp == NULL ) {
+		fprintf( stderr, "Unable to open archive file: %s\n", path );
+		return -1;
+	}
+
+	w->times = tmpfile();
+	w->counts = tmpfile();
+	w->actions = tmpfile();
+
+	if( w->times == NULL || w->counts == NULL || w->actions == NULL ) {
+		fprintf( stderr, "Unable to create temporary files for %s\n", path );
+		archive_free( w );
+		return -1;
+	}
+
+	/* rewritten once the column offsets are known */
+	memset( &hdr, 0, sizeof(hdr) );
+	fwrite( &hdr, sizeof(hdr), 1, w->fp );
+
+	return 0;
+}
+
+/*
+ * archive_begin
+ *
+ * start the next game
+ *
+ */
+void archive_begin( struct ArchiveWriter *w, Uint32 seed )
+{
+	memset( &w->game, 0, sizeof(struct ArchiveGame) );
+	w->game.seed = seed;
+
+	w->first = w->num_frames;
+	w->last = 0;
+
+	w->mark_times = w->size_times;
+	w->mark_actions = w->size_actions;
+	w->mark_blocks = w->num_blocks;
+}
+
+/*
+ * archive_frame
+ *
+ * add a frame to the game, time is relative to the start of the game
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int archive_frame( struct ArchiveWriter *w, Uint32 time, const Uint8 *actions, int num_actions )
+{
+	Uint32 v;
+
+	if( ( w->num_frames % ARCHIVE_BLOCK ) == 0 ) {
+		if( archive_put_block( w ) != 0 )
+			return -1;
+		v = time;
+	}
+	else if( w->num_frames == w->first ) {
+		v = time;
+	}
+	else {
+		v = time - w->last;
+	}
+
+	w->size_times += archive_put_varint( w->times, v );
+	fputc( num_actions, w->counts );
+	fwrite( actions, 1, num_actions, w->actions );
+
+	w->size_actions += num_actions;
+	w->num_frames++;
+	w->last = time;
+
+	return 0;
+}
+
+/*
+ * archive_end
+ *
+ * add the game's row to the metadata columns, the seed and duration
+ * come from the writer
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int archive_end( struct ArchiveWriter *w, const struct ArchiveGame *game )
+{
+	struct ArchiveGame *games;
+	Uint64 *firsts;
+	Uint32 max;
+
+	if( w->num_games == w->max_games ) {
+		max = w->max_games ? w->max_games * 2 : 1024;
+		games = realloc( w->games, max * sizeof(struct ArchiveGame) );
+		firsts = realloc( w->firsts, ( max + 1 ) * sizeof(Uint64) );
+
+		if( games != NULL )
+			w->games = games;
+		if( firsts != NULL )
+			w->firsts = firsts;
+
+		if( games == NULL || firsts == NULL ) {
+			fprintf( stderr, "Unable to grow the archive game table\n" );
+			return -1;
+		}
+
+		w->max_games = max;
+	}
+
+	w->games[w->num_games] = *game;
+	w->games[w->num_games].seed = w->game.seed;
+	w->games[w->num_games].duration = w->last;
+	w->firsts[w->num_games] = w->first;
+	w->num_games++;
+	w->ended = w->num_frames;
+
+	return 0;
+}
+
+/*
+ * archive_cancel
+ *
+ * drop the frames of the game being written, for a replay that turns
+ * out to be corrupt halfway through
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int archive_cancel( struct ArchiveWriter *w )
+{
+	if( fflush( w->times ) != 0 || fflush( w->counts ) != 0 || fflush( w->actions ) != 0 ||
+			ftruncate( fileno( w->times ), w->mark_times ) != 0 ||
+			ftruncate( fileno( w->counts ), w->first ) != 0 ||
+			ftruncate( fileno( w->actions ), w->mark_actions ) != 0 ||
+			fseek( w->times, w->mark_times, SEEK_SET ) != 0 ||
+			fseek( w->counts, w->first, SEEK_SET ) != 0 ||
+			fseek( w->actions, w->mark_actions, SEEK_SET ) != 0 ) {
+		fprintf( stderr, "Unable to cut the archive back\n" );
+		return -1;
+	}
+
+	w->size_times = w->mark_times;
+	w->size_actions = w->mark_actions;
+	w->num_blocks = w->mark_blocks;
+	w->num_frames = w->first;
+	w->last = 0;
+
+	return 0;
+}
+
+/*
+ * archive_finish
+ *
+ * write the columns and the header and close the archive, a game that
+ * wasn't ended is left out
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int archive_finish( struct ArchiveWriter *w )
+{
+	struct ArchiveHeader hdr;
+	Uint32 *column;
+	Uint32 i, k;
+	int ret;
+
+	ret = 0;
+
+	if( w->num_frames != w->ended && archive_cancel( w ) != 0 )
+		ret = -1;
+
+	memset( &hdr, 0, sizeof(hdr) );
+	hdr.magic = ARCHIVE_MAGIC;
+	hdr.version = ARCHIVE_VERSION;
+	hdr.num_games = w->num_games;
+	hdr.block = ARCHIVE_BLOCK;
+	hdr.num_frames = w->num_frames;
+
+	/* the entry for the end of the frames */
+	if( ( w->num_frames % ARCHIVE_BLOCK ) == 0 && archive_put_block( w ) != 0 )
+		ret = -1;
+
+	if( w->firsts == NULL )
+		w->firsts = malloc( sizeof(Uint64) );
+
+	column = malloc( ( w->num_games ? w->num_games : 1 ) * MAX_TETRAD * sizeof(Uint32) );
+
+	if( column == NULL || w->firsts == NULL ) {
+		fprintf( stderr, "Unable to allocate the archive columns\n" );
+		free( column );
+		archive_free( w );
+		return -1;
+	}
+
+	w->firsts[w->num_games] = w->num_frames;
+
+	/* transpose the rows into columns, one column at a time */
+	for( i=0; i<w->num_games; i++ ) column[i] = w->games[i].seed;
+	hdr.off_seed = archive_put_column( w, column, w->num_games * sizeof(Uint32) );
+	for( i=0; i<w->num_games; i++ ) column[i] = w->games[i].score;
+	hdr.off_score = archive_put_column( w, column, w->num_games * sizeof(Uint32) );
+	for( i=0; i<w->num_games; i++ ) column[i] = w->games[i].lines;
+	hdr.off_lines = archive_put_column( w, column, w->num_games * sizeof(Uint32) );
+	for( i=0; i<w->num_games; i++ ) column[i] = w->games[i].level;
+	hdr.off_level = archive_put_column( w, column, w->num_games * sizeof(Uint32) );
+	for( i=0; i<w->num_games; i++ ) column[i] = w->games[i].pieces;
+	hdr.off_pieces = archive_put_column( w, column, w->num_games * sizeof(Uint32) );
+	for( i=0; i<w->num_games; i++ ) column[i] = w->games[i].duration;
+	hdr.off_duration = archive_put_column( w, column, w->num_games * sizeof(Uint32) );
+
+	for( i=0; i<w->num_games; i++ ) {
+		for( k=0; k<MAX_TETRAD; k++ )
+			column[(i*MAX_TETRAD)+k] = w->games[i].tetrads[k];
+	}
+	hdr.off_tetrads = archive_put_column( w, column, w->num_games * MAX_TETRAD * sizeof(Uint32) );
+
+	for( i=0; i<w->num_games; i++ ) {
+		for( k=0; k<ARCHIVE_CLEARS; k++ )
+			column[(i*ARCHIVE_CLEARS)+k] = w->games[i].clears[k];
+	}
+	hdr.off_clears = archive_put_column( w, column, w->num_games * ARCHIVE_CLEARS * sizeof(Uint32) );
+
+	free( column );
+
+	hdr.off_first = archive_put_column( w, w->firsts, ( w->num_games + 1 ) * sizeof(Uint64) );
+	hdr.off_index = archive_put_column( w, w->index, w->num_blocks * sizeof(struct ArchiveBlock) );
+
+	hdr.off_times = archive_put_spool( w, w->times );
+	hdr.size_times = w->size_times;
+	hdr.off_counts = archive_put_spool( w, w->counts );
+	hdr.off_actions = archive_put_spool( w, w->actions );
+	hdr.size_actions = w->size_actions;
+
+	hdr.size = ftell( w->fp );
+
+	if( fseek( w->fp, 0, SEEK_SET ) != 0 || fwrite( &hdr, sizeof(hdr), 1, w->fp ) != 1 )
+		ret = -1;
+
+	if( ferror( w->fp ) || ferror( w->times ) || ferror( w->counts ) || ferror( w->actions ) )
+		ret = -1;
+
+	if( fclose( w->fp ) != 0 )
+		ret = -1;
+	w->fp = NULL;
+
+	if( ret != 0 )
+		fprintf( stderr, "Unable to write the archive\n" );
+
+	archive_free( w );
+
+	return ret;
+}
+
+/*
+ * archive_open
+ *
+ * map an archive for reading
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int archive_open( struct Archive *a, const char *path )
+{
+	const struct ArchiveHeader *hdr;
+	struct stat st;
+	Uint64 n;
+	int fd;
+
+	memset( a, 0, sizeof(struct Archive) );
+
+	fd = open( path, O_RDONLY );
+	if( fd < 0 || fstat( fd, &st ) != 0 ) {
+		fprintf( stderr, "Unable to open archive file: %s\n", path );
+		if( fd >= 0 )
+			close( fd );
+		return -1;
+	}
+
+	if( (size_t)st.st_size < sizeof(struct ArchiveHeader) ) {
+		fprintf( stderr, "Not an archive file: %s\n", path );
+		close( fd );
+		return -1;
+	}
+
+	a->size = st.st_size;
+	a->map = mmap( NULL, a->size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+
+	if( a->map == MAP_FAILED ) {
+		fprintf( stderr, "Unable to map archive file: %s\n", path );
+		a->map = NULL;
+		return -1;
+	}
+
+	hdr = (const struct ArchiveHeader *)a->map;
+	a->hdr = hdr;
+
+	if( hdr->magic != ARCHIVE_MAGIC || hdr->version != ARCHIVE_VERSION || hdr->block == 0 ) {
+		fprintf( stderr, "Not an archive file: %s\n", path );
+		archive_close( a );
+		return -1;
+	}
+
+	n = hdr->num_games;
+
+	if( hdr->size != a->size ||
+			archive_column( a, hdr->off_seed, n * sizeof(Uint32) ) ||
+			archive_column( a, hdr->off_score, n * sizeof(Uint32) ) ||
+			archive_column( a, hdr->off_lines, n * sizeof(Uint32) ) ||
+			archive_column( a, hdr->off_level, n * sizeof(Uint32) ) ||
+			archive_column( a, hdr->off_pieces, n * sizeof(Uint32) ) ||
+			archive_column( a, hdr->off_duration, n * sizeof(Uint32) ) ||
+			archive_column( a, hdr->off_tetrads, n * MAX_TETRAD * sizeof(Uint32) ) ||
+			archive_column( a, hdr->off_clears, n * ARCHIVE_CLEARS * sizeof(Uint32) ) ||
+			archive_column( a, hdr->off_first, ( n + 1 ) * sizeof(Uint64) ) ||
+			archive_column( a, hdr->off_index, ( ( hdr->num_frames / hdr->block ) + 1 ) * sizeof(struct ArchiveBlock) ) ||
+			archive_column( a, hdr->off_times, hdr->size_times ) ||
+			archive_column( a, hdr->off_counts, hdr->num_frames ) ||
+			archive_column( a, hdr->off_actions, hdr->size_actions ) ) {
+		fprintf( stderr, "Archive is truncated or corrupt: %s\n", path );
+		archive_close( a );
+		return -1;
+	}
+
+	a->seed = (const Uint32 *)( a->map + hdr->off_seed );
+	a->score = (const Uint32 *)( a->map + hdr->off_score );
+	a->lines = (const Uint32 *)( a->map + hdr->off_lines );
+	a->level = (const Uint32 *)( a->map + hdr->off_level );
+	a->pieces = (const Uint32 *)( a->map + hdr->off_pieces );
+	a->duration = (const Uint32 *)( a->map + hdr->off_duration );
+	a->tetrads = (const Uint32 *)( a->map + hdr->off_tetrads );
+	a->clears = (const Uint32 *)( a->map + hdr->off_clears );
+	a->first = (const Uint64 *)( a->map + hdr->off_first );
+	a->index = (const struct ArchiveBlock *)( a->map + hdr->off_index );
+	a->times = a->map + hdr->off_times;
+	a->counts = a->map + hdr->off_counts;
+	a->actions = a->map + hdr->off_actions;
+
+	if( a->first[n] != hdr->num_frames ) {
+		fprintf( stderr, "Archive is truncated or corrupt: %s\n", path );
+		archive_close( a );
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * archive_close
+ *
+ */
+void archive_close( struct Archive *a )
+{
+	if( a->map != NULL )
+		munmap( a->map, a->size );
+
+	memset( a, 0, sizeof(struct Archive) );
+}
+
+/*
+ * archive_seek
+ *
+ * set c to read the frames of game from frame onwards. only the frames
+ * from the index entry before it are decoded.
+ *
+ * returns 0 on success, -1 if there is no such frame or the archive is
+ * corrupt
+ *
+ */
+int archive_seek( struct ArchiveCursor *c, const struct Archive *a, Uint32 game, Uint64 frame )
+{
+	Uint64 k;
+	Uint32 v;
+
+	if( game >= a->hdr->num_games )
+		return -1;
+
+	c->a = a;
+	c->first = a->first[game];
+	c->end = a->first[game+1];
+
+	if( c->first > c->end || c->end > a->hdr->num_frames || frame > c->end - c->first )
+		return -1;
+
+	c->frame = c->first + frame;
+
+	k = ( c->frame / a->hdr->block ) * a->hdr->block;
+	c->time_off = a->index[k / a->hdr->block].time_off;
+	c->action_off = a->index[k / a->hdr->block].action_off;
+	c->time = 0;
+
+	/* frames of the game before this one only need to be stepped over */
+	for( ; k<c->frame; k++ ) {
+		if( archive_get_varint( a, &c->time_off, &v ) != 0 )
+			return -1;
+
+		c->time = ( k == c->first || ( k % a->hdr->block ) == 0 ) ? v : c->time + v;
+		c->action_off += a->counts[k];
+	}
+
+	if( c->action_off > a->hdr->size_actions )
+		return -1;
+
+	return 0;
+}
+
+/*
+ * archive_next
+ *
+ * read the next frame of the game, time is relative to the start of
+ * the game and actions must hold REPLAY_MAX_ACTIONS
+ *
+ * returns 1 for a frame, 0 at the end of the game, -1 if the archive
+ * is corrupt
+ *
+ */
+int archive_next( struct ArchiveCursor *c, Uint32 *time, Uint8 *actions, int *num_actions )
+{
+	const struct Archive *a;
+	Uint32 v;
+	int n;
+
+	a = c->a;
+
+	if( c->frame >= c->end )
+		return 0;
+
+	if( archive_get_varint( a, &c->time_off, &v ) != 0 )
+		return -1;
+
+	c->time = ( c->frame == c->first || ( c->frame % a->hdr->block ) == 0 ) ? v : c->time + v;
+
+	n = a->counts[c->frame];
+	if( n > REPLAY_MAX_ACTIONS || c->action_off + n > a->hdr->size_actions )
+		return -1;
+
+	memcpy( actions, a->actions + c->action_off, n );
+
+	c->action_off += n;
+	c->frame++;
+
+	*time = c->time;
+	*num_actions = n;
+
+	return 1;
+}
+
+/*
+ * archive_locate
+ *
+ * offsets of frame in the times and actions columns, frame may be
+ * num_frames for the end of the columns
+ *
+ * returns 0 on success, -1 if there is no such frame or the archive is
+ * corrupt
+ *
+ */
+int archive_locate( const struct Archive *a, Uint64 frame, Uint64 *time_off, Uint64 *action_off )
+{
+	Uint64 k;
+	Uint32 v;
+
+	if( frame > a->hdr->num_frames )
+		return -1;
+
+	k = ( frame / a->hdr->block ) * a->hdr->block;
+	*time_off = a->index[k / a->hdr->block].time_off;
+	*action_off = a->index[k / a->hdr->block].action_off;
+
+	for( ; k<frame; k++ ) {
+		if( archive_get_varint( a, time_off, &v ) != 0 )
+			return -1;
+		*action_off += a->counts[k];
+	}
+
+	return ( *action_off > a->hdr->size_actions ) ? -1 : 0;
+}
+
+/*
+ * archive_put_block
+ *
+ * add the index entry for the next frame
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+static int archive_put_block( struct ArchiveWriter *w )
+{
+	struct ArchiveBlock *index;
+	Uint64 max;
+
+	if( w->num_blocks == w->max_blocks ) {
+		max = w->max_blocks ? w->max_blocks * 2 : 1024;
+		index = realloc( w->index, max * sizeof(struct ArchiveBlock) );
+
+		if( index == NULL ) {
+			fprintf( stderr, "Unable to grow the archive index\n" );
+			return -1;
+		}
+
+		w->index = index;
+		w->max_blocks = max;
+	}
+
+	w->index[w->num_blocks].time_off = w->size_times;
+	w->index[w->num_blocks].action_off = w->size_actions;
+	w->num_blocks++;
+
+	return 0;
+}
+
+/*
+ * archive_put_column
+ *
+ * write a column on an 8 byte boundary
+ *
+ * returns the offset of the column
+ *
+ */
+static Uint64 archive_put_column( struct ArchiveWriter *w, const void *data, size_t size )
+{
+	Uint64 off;
+
+	off = ftell( w->fp );
+
+	while( off & 7 ) {
+		fputc( 0, w->fp );
+		off++;
+	}
+
+	if( size )
+		fwrite( data, 1, size, w->fp );
+
+	return off;
+}
+
+/*
+ * archive_put_spool
+ *
+ * copy a spooled frame column into the archive
+ *
+ * returns the offset of the column
+ *
+ */
+static Uint64 archive_put_spool( struct ArchiveWriter *w, FILE *spool )
+{
+	Uint8 buf[65536];
+	Uint64 off;
+	size_t n;
+
+	off = archive_put_column( w, NULL, 0 );
+
+	rewind( spool );
+
+	while( ( n = fread( buf, 1, sizeof(buf), spool ) ) > 0 )
+		fwrite( buf, 1, n, w->fp );
+
+	return off;
+}
+
+/*
+ * archive_put_varint
+ *
+ * little-endian base 128 as in replay files
+ *
+ * returns the number of bytes written
+ *
+ */
+static int archive_put_varint( FILE *fp, Uint32 v )
+{
+	int n;
+
+	for( n=1; v >= 0x80; n++ ) {
+		fputc( ( v & 0x7f ) | 0x80, fp );
+		v >>= 7;
+	}
+
+	fputc( v, fp );
+
+	return n;
+}
+
+/*
+ * archive_get_varint
+ *
+ * read a varint at *off in the times column and move past it
+ *
+ * returns 0 on success, -1 at the end of the column or on a bad varint
+ *
+ */
+static int archive_get_varint( const struct Archive *a, Uint64 *off, Uint32 *v )
+{
+	int shift;
+	Uint8 c;
+
+	*v = 0;
+
+	for( shift=0; shift<35; shift+=7 ) {
+		if( *off >= a->hdr->size_times )
+			return -1;
+
+		c = a->times[(*off)++];
+		*v |= (Uint32)( c & 0x7f ) << shift;
+
+		if( !( c & 0x80 ) )
+			return 0;
+	}
+
+	return -1;
+}
+
+/*
+ * archive_column
+ *
+ * returns 0 if a column of size bytes at off lies within the archive
+ *
+ */
+static int archive_column( const struct Archive *a, Uint64 off, Uint64 size )
+{
+	if( off < sizeof(struct ArchiveHeader) || ( off & 7 ) || off > a->size || size > a->size - off )
+		return -1;
+
+	return 0;
+}
+
+/*
+ * archive_free
+ *
+ */
+static void archive_free( struct ArchiveWriter *w )
+{
+	if( w->fp != NULL )
+		fclose( w->fp );
+	if( w->times != NULL )
+		fclose( w->times );
+	if( w->counts != NULL )
+		fclose( w->counts );
+	if( w->actions != NULL )
+		fclose( w->actions );
+
+	free( w->games );
+	free( w->firsts );
+	free( w->index );
+
+	memset( w, 0, sizeof(struct ArchiveWriter) );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,198 @@
+/*
+SDLBlocks
+
+Description:
+Replay archives: many games in one column oriented file with an index,
+read in place through mmap.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdio.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "replay.h"
+
+#define ARCHIVE_MAGIC 0x52414253	/* "SBAR" */
+#define ARCHIVE_VERSION 1
+
+/* frames between two index entries */
+#define ARCHIVE_BLOCK 256
+
+/* line clears are counted by tetris_score() category, 1 to 4 rows */
+#define ARCHIVE_CLEARS 4
+
+/*
+ * an archive is a header followed by columns, each starting on an
+ * 8 byte boundary at the offset given in the header:
+ *
+ *   Uint32 seed[num_games], score, lines, level, pieces, duration
+ *   Uint32 tetrads[num_games][MAX_TETRAD]  -- tetrads locked, by type
+ *   Uint32 clears[num_games][ARCHIVE_CLEARS] -- line clears, by rows
+ *   Uint64 first[num_games+1]  -- first frame of each game
+ *   struct ArchiveBlock index[num_frames/ARCHIVE_BLOCK + 1]
+ *   Uint8 times[]    -- varint time of each frame
+ *   Uint8 counts[num_frames] -- number of actions of each frame
+ *   Uint8 actions[]  -- the actions of all the frames
+ *
+ * a frame is one replay record, frames are numbered across the whole
+ * archive. the time of a frame is the ms since the previous frame,
+ * except for the first frame of a game and of an index block which
+ * hold the ms since the start of the game, so decoding can start at
+ * any index entry.
+ *
+ */
+
+struct ArchiveHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 num_games;
+	Uint32 block;
+	Uint64 num_frames;
+	Uint64 size;
+
+	Uint64 off_seed;
+	Uint64 off_score;
+	Uint64 off_lines;
+	Uint64 off_level;
+	Uint64 off_pieces;
+	Uint64 off_duration;
+	Uint64 off_tetrads;
+	Uint64 off_clears;
+	Uint64 off_first;
+	Uint64 off_index;
+	Uint64 off_times;
+	Uint64 off_counts;
+	Uint64 off_actions;
+
+	Uint64 size_times;
+	Uint64 size_actions;
+};
+
+/* where frame i*ARCHIVE_BLOCK starts in times and actions */
+struct ArchiveBlock {
+	Uint64 time_off;
+	Uint64 action_off;
+};
+
+/* one game's row of the metadata columns */
+struct ArchiveGame {
+	Uint32 seed;
+	Uint32 score;
+	Uint32 lines;
+	Uint32 level;
+	Uint32 pieces;
+
+	/* duration -- time of the last frame */
+	Uint32 duration;
+
+	Uint32 tetrads[MAX_TETRAD];
+	Uint32 clears[ARCHIVE_CLEARS];
+};
+
+struct ArchiveWriter {
+	FILE *fp;
+
+	/* the frame columns are spooled to temporary files until the end */
+	FILE *times;
+	FILE *counts;
+	FILE *actions;
+
+	Uint64 num_frames;
+	Uint64 size_times;
+	Uint64 size_actions;
+
+	/* game -- row of the game being written, first -- its first frame,
+	 * the mark_* sizes are where a cancelled game is cut off */
+	struct ArchiveGame game;
+	Uint64 first;
+	Uint32 last;
+	Uint64 mark_times;
+	Uint64 mark_actions;
+	Uint64 mark_blocks;
+
+	/* ended -- frames of the games that were ended */
+	Uint64 ended;
+
+	Uint32 num_games;
+	Uint32 max_games;
+	struct ArchiveGame *games;
+	Uint64 *firsts;
+
+	Uint64 num_blocks;
+	Uint64 max_blocks;
+	struct ArchiveBlock *index;
+};
+
+struct Archive {
+	Uint8 *map;
+	size_t size;
+
+	const struct ArchiveHeader *hdr;
+
+	const Uint32 *seed;
+	const Uint32 *score;
+	const Uint32 *lines;
+	const Uint32 *level;
+	const Uint32 *pieces;
+	const Uint32 *duration;
+	const Uint32 *tetrads;
+	const Uint32 *clears;
+	const Uint64 *first;
+	const struct ArchiveBlock *index;
+	const Uint8 *times;
+	const Uint8 *counts;
+	const Uint8 *actions;
+};
+
+/* reads the frames of one game */
+struct ArchiveCursor {
+	const struct Archive *a;
+
+	/* frame -- next frame, first,end -- frames of the game */
+	Uint64 frame;
+	Uint64 first;
+	Uint64 end;
+
+	Uint64 time_off;
+	Uint64 action_off;
+	Uint32 time;
+};
+
+#define ARCHIVE_NUM_FRAMES( a, game ) ( (a)->first[(game)+1] - (a)->first[game] )
+
+int  archive_create( struct ArchiveWriter *w, const char *path );
+void archive_begin( struct ArchiveWriter *w, Uint32 seed );
+int  archive_frame( struct ArchiveWriter *w, Uint32 time, const Uint8 *actions, int num_actions );
+int  archive_end( struct ArchiveWriter *w, const struct ArchiveGame *game );
+int  archive_cancel( struct ArchiveWriter *w );
+int  archive_finish( struct ArchiveWriter *w );
+
+int  archive_open( struct Archive *a, const char *path );
+void archive_close( struct Archive *a );
+int  archive_seek( struct ArchiveCursor *c, const struct Archive *a, Uint32 game, Uint64 frame );
+int  archive_next( struct ArchiveCursor *c, Uint32 *time, Uint8 *actions, int *num_actions );
+int  archive_locate( const struct Archive *a, Uint64 frame, Uint64 *time_off, Uint64 *action_off );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,306 @@
+/*
+SDLBlocks
+
+Description:
+Headless simulator that plays seeded games with the placement AI.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "ai.h"
+
+/* move times are kept in 0.01 ms buckets up to 10 ms, for the
+ * percentile, the last bucket holds the longer ones */
+#define BOT_BUCKETS 1000
+
+static double bot_clock( clockid_t id );
+
+/*
+ * blocksbot
+ *
+ * usage: blocksbot [-games n] [-seed n] [-depth n] [-pieces n]
+ *                  [-beam width] [-threads n] [-budget ms] [-nodes n]
+ *                  [-limit ms] [-weights height,lines,holes,bumpiness]
+ *
+ * plays games with the placement AI driving the same game logic as
+ * sdlblocks, game i uses seed+i so runs are reproducible. each game
+ * ends at game over or after the piece limit.
+ *
+ * -beam switches to the beam search, widening passes up to the given
+ * width while the -budget (per move) or -nodes budget lasts. results
+ * don't depend on the number of threads unless a time budget is set.
+ *
+ * without -beam a move may search AI_BUDGET_NODES nodes, or -nodes (0
+ * for no limit), and -budget adds the time limit the game sets. a move
+ * over budget plays the deepest depth it finished.
+ *
+ * the time per move is reported as the mean, the 99.9th percentile and
+ * the worst move, with the most CPU time and nodes any move took. on a
+ * loaded machine the worst move is mostly time the process wasn't
+ * scheduled. blocksbot fails if a move of the AI took more than -limit
+ * ms of CPU (1 ms by default, 0 to not check).
+ *
+ * -weights plays with other weights than the default ones, such as
+ * those found by blockstune.
+ *
+ */
+
+int main( int argc, char *argv[] )
+{
+	static struct Ai ai;
+	static struct AiBeam beam;
+	static Uint32 spread[BOT_BUCKETS+1];
+	struct Tetris t;
+	struct AiMove move;
+	struct AiWeights weights;
+	Uint32 games, seed, max_pieces;
+	Uint32 lines, pieces, moves;
+	Uint64 score;
+	double start, elapsed, total, worst;
+	double cpu_start, cpu, worst_cpu;
+	double budget;
+	Uint64 nodes, last_nodes, most_nodes;
+	Uint32 budget_nodes;
+	Uint32 count, bucket;
+	double limit;
+	int nodes_set;
+	int width;
+	int threads;
+	int events;
+	int depth;
+	int ret;
+	Uint32 i;
+
+	games = 10;
+	seed = 1;
+	depth = 0;
+	max_pieces = 10000;
+	width = 0;
+	threads = 0;
+	budget = 0;
+	budget_nodes = 0;
+	nodes_set = 0;
+	limit = 1.0;
+	weights = ai_default_weights;
+
+	for( i=1; i<(Uint32)argc; i++ ) {
+		if( !strcmp( argv[i], "-games" ) && ( i+1 < (Uint32)argc ) )
+			games = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-seed" ) && ( i+1 < (Uint32)argc ) )
+			seed = strtoul( argv[++i], NULL, 0 );
+		else if( !strcmp( argv[i], "-depth" ) && ( i+1 < (Uint32)argc ) )
+			depth = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-pieces" ) && ( i+1 < (Uint32)argc ) )
+			max_pieces = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-beam" ) && ( i+1 < (Uint32)argc ) )
+			width = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-threads" ) && ( i+1 < (Uint32)argc ) )
+			threads = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-budget" ) && ( i+1 < (Uint32)argc ) )
+			budget = atof( argv[++i] );
+		else if( !strcmp( argv[i], "-nodes" ) && ( i+1 < (Uint32)argc ) ) {
+			budget_nodes = strtoul( argv[++i], NULL, 0 );
+			nodes_set = 1;
+		}
+		else if( !strcmp( argv[i], "-limit" ) && ( i+1 < (Uint32)argc ) )
+			limit = atof( argv[++i] );
+		else if( !strcmp( argv[i], "-weights" ) && ( i+1 < (Uint32)argc ) &&
+				sscanf( argv[i+1], "%f,%f,%f,%f", &weights.height, &weights.lines, &weights.holes, &weights.bumpiness ) == 4 )
+			i++;
+		else {
+			fprintf( stderr, "usage: %s [-games n] [-seed n] [-depth 1..%d] [-pieces n]\n"
+					"       [-beam width] [-threads n] [-budget ms] [-nodes n]\n"
+					"       [-limit ms] [-weights height,lines,holes,bumpiness]\n", argv[0], AI_MAX_DEPTH );
+			exit( 1 );
+		}
+	}
+
+	/* the beam search looks at every known tetrad by default */
+	if( depth == 0 )
+		depth = width ? AI_MAX_DEPTH : AI_DEPTH;
+
+	if( depth < 1 || depth > AI_MAX_DEPTH ) {
+		fprintf( stderr, "Depth must be between 1 and %d\n", AI_MAX_DEPTH );
+		exit( 1 );
+	}
+
+	if( ai_initialize( &ai ) != 0 ) {
+		fprintf( stderr, "Unable to allocate the transposition table\n" );
+		exit( 1 );
+	}
+
+	ai.depth = depth;
+	ai.weights = weights;
+	ai.budget_nodes = nodes_set ? budget_nodes : AI_BUDGET_NODES;
+	ai.budget_ms = budget;
+
+	if( width ) {
+		if( ai_beam_initialize( &beam, &ai, threads, width ) != 0 ) {
+			fprintf( stderr, "Unable to start the beam search\n" );
+			exit( 1 );
+		}
+
+		beam.depth = depth;
+		beam.budget_ms = budget;
+		beam.budget_nodes = budget_nodes;
+
+		/* without a budget there is one pass at full width */
+		if( budget <= 0 && budget_nodes == 0 )
+			beam.width = width;
+
+		printf( "beam search: width %d, %d threads, depth %d\n", width, beam.num_threads, depth );
+	}
+
+	score = 0;
+	lines = 0;
+	pieces = 0;
+	moves = 0;
+	nodes = 0;
+	last_nodes = 0;
+	most_nodes = 0;
+	total = 0.0;
+	worst = 0.0;
+	worst_cpu = 0.0;
+
+	for( i=0; i<games; i++ ) {
+
+		tetris_initialize( &t );
+		tetris_seed( &t, seed + i );
+		tetris_start( &t );
+
+		/* without a clock the filled rows would flash forever */
+		t.clear_delay = 0;
+
+		/* no clock: tetrads only fall when the AI drops them */
+		while( t.state != TETRIS_STATE_OVER && t.game_num_pieces <= max_pieces ) {
+
+			events = tetris_tick( &t, 0 );
+
+			if( events & TETRIS_EVENT_SPAWN ) {
+				start = bot_clock( CLOCK_MONOTONIC );
+				cpu_start = bot_clock( CLOCK_PROCESS_CPUTIME_ID );
+				if( width ) {
+					ret = ai_beam_choose( &beam, &t, &move );
+					nodes += beam.nodes;
+				}
+				else {
+					ret = ai_choose( &ai, &t, &move );
+				}
+				elapsed = bot_clock( CLOCK_MONOTONIC ) - start;
+				cpu = bot_clock( CLOCK_PROCESS_CPUTIME_ID ) - cpu_start;
+
+				if( ret != 0 )
+					break;
+
+				total += elapsed;
+				if( elapsed > worst )
+					worst = elapsed;
+				if( cpu > worst_cpu )
+					worst_cpu = cpu;
+				moves++;
+
+				bucket = elapsed * 100000.0;
+				spread[ bucket < BOT_BUCKETS ? bucket : BOT_BUCKETS ]++;
+
+				if( width ) {
+					if( beam.nodes > most_nodes )
+						most_nodes = beam.nodes;
+				}
+				else {
+					if( ai.nodes - last_nodes > most_nodes )
+						most_nodes = ai.nodes - last_nodes;
+					last_nodes = ai.nodes;
+				}
+
+				while( ai_step( &t, &move ) )
+					;
+			}
+		}
+
+		printf( "game %u seed %u: score %u lines %u pieces %u%s\n", i, seed + i,
+				t.game_score, t.game_total_num_lines_cleared, t.game_num_pieces,
+				( t.state == TETRIS_STATE_OVER ) ? "" : " (limit)" );
+
+		score += t.game_score;
+		lines += t.game_total_num_lines_cleared;
+		pieces += t.game_num_pieces;
+	}
+
+	if( games > 0 && moves > 0 ) {
+		printf( "average: score %.0f lines %.1f pieces %.1f\n",
+				(double)score / games, (double)lines / games, (double)pieces / games );
+		/* first bucket by which 99.9% of the moves were done */
+		count = 0;
+		for( bucket=0; bucket<BOT_BUCKETS; bucket++ ) {
+			count += spread[bucket];
+			if( count >= moves - moves / 1000 )
+				break;
+		}
+
+		printf( "%u moves, %.3f ms per move, 99.9%% under %.2f ms%s, %.3f ms worst\n",
+				moves, ( total * 1000.0 ) / moves, ( bucket + 1 ) / 100.0,
+				( bucket < BOT_BUCKETS ) ? "" : "+", worst * 1000.0 );
+		printf( "slowest move %.3f ms of CPU, at most %llu nodes in a move\n",
+				worst_cpu * 1000.0, (unsigned long long)most_nodes );
+
+		if( width )
+			printf( "%.0f nodes per move, %.0f nodes/s\n", (double)nodes / moves, nodes / total );
+		else
+			printf( "%.0f nodes per move, %.0f nodes/s, %.1f%% table hits, %u moves over budget\n",
+					(double)ai.nodes / moves, ai.nodes / total,
+					ai.probes ? ( 100.0 * ai.hits ) / ai.probes : 0.0, ai.cutoffs );
+	}
+
+	if( width )
+		ai_beam_free( &beam );
+
+	ai_free( &ai );
+
+	/* the beam search is meant to take its whole budget */
+	if( !width && limit > 0 && worst_cpu * 1000.0 > limit ) {
+		fprintf( stderr, "Slowest move took %.3f ms of CPU, over the %.3f ms limit\n", worst_cpu * 1000.0, limit );
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * bot_clock
+ *
+ * time in seconds on the given clock, monotonic or the process CPU
+ * time
+ *
+ */
+static double bot_clock( clockid_t id )
+{
+	struct timespec ts;
+
+	clock_gettime( id, &ts );
+
+	return ts.tv_sec + ( ts.tv_nsec / 1.0e9 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
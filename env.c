@@ -0,0 +1,370 @@
+/*
+SDLBlocks
+
+Description:
+Vector of games for training agents, kept in a shared memory region
+that a trainer process maps to read the observations in place.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "replay.h"
+#include "env.h"
+
+static void env_start( struct EnvSlot *s, Uint32 seed );
+
+/*
+ * env_region_size
+ *
+ * bytes needed for a region of num_envs games
+ *
+ */
+size_t env_region_size( Uint32 num_envs )
+{
+	size_t size;
+
+	size = sizeof(struct EnvHeader) + ( num_envs * sizeof(struct EnvSlot) ) + num_envs;
+
+	/* whole cache lines */
+	return ( size + 63 ) & ~(size_t)63;
+}
+
+/*
+ * env_region_init
+ *
+ * lay out a region of env_region_size() bytes and reset its games
+ * with seed 1. the magic is written last, a trainer that attaches
+ * before that is turned away.
+ *
+ * returns 0 on success, -1 if the semaphores can't be made
+ *
+ */
+int env_region_init( struct EnvHeader *h, Uint32 num_envs )
+{
+	size_t slot;
+
+	memset( h, 0, env_region_size( num_envs ) );
+
+	h->version = ENV_VERSION;
+	h->num_envs = num_envs;
+	h->region_size = env_region_size( num_envs );
+	h->header_size = sizeof(struct EnvHeader);
+	h->slot_size = sizeof(struct EnvSlot);
+	h->actions_offset = h->header_size + ( num_envs * h->slot_size );
+
+	slot = offsetof( struct EnvSlot, tetris );
+
+	h->off_board = slot + offsetof( struct Tetris, board );
+	h->off_cur_tetrad = slot + offsetof( struct Tetris, cur_tetrad );
+	h->off_cur_pattern = slot + offsetof( struct Tetris, cur_pattern );
+	h->off_tx = slot + offsetof( struct Tetris, tx );
+	h->off_ty = slot + offsetof( struct Tetris, ty );
+	h->off_next_tetrad = slot + offsetof( struct Tetris, next_tetrad );
+	h->off_score = slot + offsetof( struct Tetris, game_score );
+	h->off_lines = slot + offsetof( struct Tetris, game_total_num_lines_cleared );
+	h->off_level = slot + offsetof( struct Tetris, game_level );
+	h->off_pieces = slot + offsetof( struct Tetris, game_num_pieces );
+	h->off_reward = offsetof( struct EnvSlot, reward );
+	h->off_done = offsetof( struct EnvSlot, done );
+	h->off_episode = offsetof( struct EnvSlot, episode );
+
+	if( sem_init( &h->request, 1, 0 ) != 0 || sem_init( &h->reply, 1, 0 ) != 0 )
+		return -1;
+
+	env_reset( h, 1 );
+
+	__atomic_store_n( &h->magic, ENV_MAGIC, __ATOMIC_RELEASE );
+
+	return 0;
+}
+
+/*
+ * env_reset
+ *
+ * start a new episode in every game, game i with seed+i
+ *
+ */
+void env_reset( struct EnvHeader *h, Uint32 seed )
+{
+	struct EnvSlot *s;
+	Uint32 i;
+
+	for( i=0; i<h->num_envs; i++ ) {
+		s = ENV_SLOT( h, i );
+		s->seed = seed + i;
+		s->episode = 0;
+		s->reward = 0;
+		s->done = 0;
+		env_start( s, s->seed );
+	}
+}
+
+/*
+ * env_step
+ *
+ * play one action in every game and let ENV_STEP_MS of game time
+ * pass. a drop lands within its step. a game that ends starts its next
+ * episode right away, with a seed no other game in the region uses.
+ *
+ */
+void env_step( struct EnvHeader *h, const Uint8 *actions )
+{
+	struct EnvSlot *s;
+	struct Tetris *t;
+	Uint32 score;
+	Uint32 i;
+	int events;
+
+	for( i=0; i<h->num_envs; i++ ) {
+		s = ENV_SLOT( h, i );
+		t = &s->tetris;
+
+		score = t->game_score;
+
+		if( actions[i] < ENV_NUM_ACTIONS )
+			replay_apply( t, actions[i] );
+
+		s->now += ENV_STEP_MS;
+		events = tetris_tick( t, s->now );
+
+		if( actions[i] == REPLAY_DROP ) {
+			while( !( events & ( TETRIS_EVENT_SPAWN | TETRIS_EVENT_OVER ) ) )
+				events |= tetris_tick( t, s->now );
+		}
+
+		s->reward = (Sint32)( t->game_score - score );
+		s->done = ( t->state == TETRIS_STATE_OVER );
+
+		if( s->done ) {
+			s->episode++;
+			env_start( s, s->seed + ( s->episode * h->num_envs ) );
+		}
+	}
+
+	h->steps += h->num_envs;
+}
+
+/*
+ * env_create
+ *
+ * make the shared memory region name for num_envs games, replacing
+ * one left behind by a server that didn't exit cleanly
+ *
+ * returns NULL on failure, with errno set
+ *
+ */
+struct EnvHeader *env_create( const char *name, Uint32 num_envs )
+{
+	struct EnvHeader *h;
+	size_t size;
+	int fd;
+
+	if( num_envs == 0 || num_envs > ENV_MAX_ENVS ) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	size = env_region_size( num_envs );
+
+	fd = shm_open( name, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+	if( fd < 0 )
+		return NULL;
+
+	if( ftruncate( fd, size ) != 0 ) {
+		close( fd );
+		shm_unlink( name );
+		return NULL;
+	}
+
+	h = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	close( fd );
+
+	if( h == MAP_FAILED ) {
+		shm_unlink( name );
+		return NULL;
+	}
+
+	if( env_region_init( h, num_envs ) != 0 ) {
+		munmap( h, size );
+		shm_unlink( name );
+		return NULL;
+	}
+
+	return h;
+}
+
+/*
+ * env_serve
+ *
+ * carry out the trainer's commands until it closes the region
+ *
+ * returns 0 when closed, -1 if waiting for a command failed
+ *
+ */
+int env_serve( struct EnvHeader *h )
+{
+	int running;
+
+	running = 1;
+
+	while( running ) {
+
+		if( sem_wait( &h->request ) != 0 ) {
+			if( errno == EINTR )
+				continue;
+			return -1;
+		}
+
+		switch( h->command ) {
+			case ENV_CMD_RESET:
+				env_reset( h, h->seed );
+				break;
+			case ENV_CMD_STEP:
+				env_step( h, ENV_ACTIONS( h ) );
+				break;
+			case ENV_CMD_CLOSE:
+				running = 0;
+				break;
+		}
+
+		sem_post( &h->reply );
+	}
+
+	return 0;
+}
+
+/*
+ * env_destroy
+ *
+ */
+void env_destroy( struct EnvHeader *h, const char *name )
+{
+	sem_destroy( &h->request );
+	sem_destroy( &h->reply );
+
+	munmap( h, h->region_size );
+	shm_unlink( name );
+}
+
+/*
+ * env_attach
+ *
+ * map a server's region
+ *
+ * returns NULL if there is none or it isn't ready yet, with errno set
+ *
+ */
+struct EnvHeader *env_attach( const char *name )
+{
+	struct EnvHeader *h;
+	Uint32 size;
+	int fd;
+
+	fd = shm_open( name, O_RDWR, 0 );
+	if( fd < 0 )
+		return NULL;
+
+	/* the header tells how large the region is */
+	h = mmap( NULL, sizeof(struct EnvHeader), PROT_READ, MAP_SHARED, fd, 0 );
+
+	if( h == MAP_FAILED ) {
+		close( fd );
+		return NULL;
+	}
+
+	if( __atomic_load_n( &h->magic, __ATOMIC_ACQUIRE ) != ENV_MAGIC || h->version != ENV_VERSION ) {
+		munmap( h, sizeof(struct EnvHeader) );
+		close( fd );
+		errno = EAGAIN;
+		return NULL;
+	}
+
+	size = h->region_size;
+	munmap( h, sizeof(struct EnvHeader) );
+
+	h = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	close( fd );
+
+	if( h == MAP_FAILED )
+		return NULL;
+
+	return h;
+}
+
+/*
+ * env_call
+ *
+ * have the server carry out a command and wait until it is done
+ *
+ */
+void env_call( struct EnvHeader *h, Uint32 command, Uint32 seed )
+{
+	h->command = command;
+	h->seed = seed;
+
+	sem_post( &h->request );
+
+	while( sem_wait( &h->reply ) != 0 && errno == EINTR )
+		;
+}
+
+/*
+ * env_detach
+ *
+ */
+void env_detach( struct EnvHeader *h )
+{
+	munmap( h, h->region_size );
+}
+
+/*
+ * env_start
+ *
+ * start an episode and spawn its first tetrad
+ *
+ */
+static void env_start( struct EnvSlot *s, Uint32 seed )
+{
+	struct Tetris *t = &s->tetris;
+
+	tetris_initialize( t );
+	tetris_seed( t, seed );
+	tetris_start( t );
+
+	s->now = 0;
+	t->now = 0;
+	t->next_time = 0;
+
+	/* the line clear animation is only there to be watched */
+	t->clear_delay = 0;
+
+	tetris_tick( t, s->now );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,138 @@
+/*
+SDLBlocks
+
+Description:
+Vector of games for training agents, kept in a shared memory region
+that a trainer process maps to read the observations in place.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef ENV_H
+#define ENV_H
+
+#include <semaphore.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+
+#define ENV_MAGIC 0x4d594753	/* "SGYM" */
+#define ENV_VERSION 1
+
+#define ENV_SHM_NAME "/sdlblocks-gym"
+#define ENV_MAX_ENVS 65536
+
+/* game time that passes in one step (ms), gravity runs on it */
+#define ENV_STEP_MS 16
+
+/* actions are the replay actions, 0 does nothing */
+#define ENV_NOOP 0
+#define ENV_NUM_ACTIONS 6
+
+/* commands from the trainer */
+#define ENV_CMD_RESET 1
+#define ENV_CMD_STEP  2
+#define ENV_CMD_CLOSE 3
+
+/*
+ * the region is laid out as
+ *
+ *   struct EnvHeader
+ *   struct EnvSlot slot[num_envs]   -- at header_size, slot_size apart
+ *   Uint8 action[num_envs]          -- at actions_offset
+ *
+ * each slot holds the game itself, the observation is read straight
+ * out of struct Tetris: the offsets of its fields are in the header so
+ * trainers that aren't written in C can find them. board cells are 0
+ * when empty, the tetrad's color otherwise. tx,ty are in pixels, the
+ * cell is ( tx / TETRAD_WIDTH - 1, ty / TETRAD_HEIGHT ).
+ *
+ * the trainer writes the actions, sets command (and seed for a reset),
+ * posts request and waits for reply. the step is done in place.
+ *
+ */
+
+struct EnvHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 num_envs;
+	Uint32 region_size;
+	Uint32 header_size;
+	Uint32 slot_size;
+	Uint32 actions_offset;
+
+	/* offsets in a slot */
+	Uint32 off_board;
+	Uint32 off_cur_tetrad;
+	Uint32 off_cur_pattern;
+	Uint32 off_tx;
+	Uint32 off_ty;
+	Uint32 off_next_tetrad;
+	Uint32 off_score;
+	Uint32 off_lines;
+	Uint32 off_level;
+	Uint32 off_pieces;
+	Uint32 off_reward;
+	Uint32 off_done;
+	Uint32 off_episode;
+
+	Uint32 command;
+	Uint32 seed;
+
+	/* steps -- steps taken by all the games since the region was made */
+	Uint64 steps;
+
+	sem_t request;
+	sem_t reply;
+} __attribute__(( aligned(64) ));
+
+struct EnvSlot {
+	struct Tetris tetris;
+
+	/* reward -- score gained by the last step, done -- the last step
+	 * ended the episode and tetris already holds the next one */
+	Sint32 reward;
+	Uint32 done;
+	Uint32 episode;
+
+	/* seed -- of the first episode, now -- game time */
+	Uint32 seed;
+	Uint32 now;
+} __attribute__(( aligned(64) ));
+
+#define ENV_SLOT( h, i ) ( (struct EnvSlot *)( (Uint8 *)(h) + (h)->header_size + ( (size_t)(i) * (h)->slot_size ) ) )
+#define ENV_ACTIONS( h ) ( (Uint8 *)(h) + (h)->actions_offset )
+
+size_t env_region_size( Uint32 num_envs );
+int  env_region_init( struct EnvHeader *h, Uint32 num_envs );
+void env_reset( struct EnvHeader *h, Uint32 seed );
+void env_step( struct EnvHeader *h, const Uint8 *actions );
+
+/* shared memory, for the server */
+struct EnvHeader *env_create( const char *name, Uint32 num_envs );
+int  env_serve( struct EnvHeader *h );
+void env_destroy( struct EnvHeader *h, const char *name );
+
+/* shared memory, for the trainer */
+struct EnvHeader *env_attach( const char *name );
+void env_call( struct EnvHeader *h, Uint32 command, Uint32 seed );
+void env_detach( struct EnvHeader *h );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,591 @@
+/*
+SDLBlocks
+
+Description:
+Headless replay exporter, renders a replay into a Y4M or raw RGB
+video stream.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+
+#include "tetris.h"
+#include "render.h"
+#include "replay.h"
+
+#define EXPORT_MAX_THREADS 16
+
+/* seconds of frames rendered after the end of the game */
+#define EXPORT_TAIL_SECONDS 2
+
+#define EXPORT_Y4M 0
+#define EXPORT_RGB 1
+
+/*
+ * frames pass through a ring of slots: the main thread renders frame k
+ * into slot k % num_slots, converter k % num_threads converts it and the
+ * writer writes the slots out in frame order. each slot has its own
+ * semaphores so nothing is shared between frames in flight.
+ *
+ */
+
+struct ExportSlot {
+	SDL_Surface *frame;
+	Uint8 *out;
+
+	/* end -- no more frames, set instead of rendering a frame */
+	int end;
+
+	SDL_sem *free;
+	SDL_sem *rendered;
+	SDL_sem *converted;
+};
+
+struct Export {
+	FILE *fp;
+	int format;
+	int frame_size;
+
+	int num_threads;
+	int num_slots;
+	struct ExportSlot *slots;
+
+	/* error -- the writer couldn't write a frame */
+	int error;
+};
+
+struct ExportConverter {
+	struct Export *e;
+	int index;
+};
+
+static SDL_Surface *export_surface( void );
+static void export_render( SDL_Surface *frame, TTF_Font *font, struct Tetris *t, int ended );
+static void export_y4m( SDL_Surface *frame, Uint8 *out );
+static void export_rgb( SDL_Surface *frame, Uint8 *out );
+static int  export_converter_thread( void *data );
+static int  export_writer_thread( void *data );
+
+/*
+ * blocksexport
+ *
+ * usage: blocksexport [-o file|-] [-rgb] [-fps n] [-threads n]
+ *                     [-bmp frame file] replay
+ *
+ * plays a replay recorded with sdlblocks -record back without a window
+ * and renders it through the same drawing code as the game into an
+ * offscreen frame, fps frames per second of game time.
+ *
+ * frames are streamed as Y4M (4:2:0, full range BT.601) or as raw 24 bit
+ * RGB to the -o file or stdout. -bmp saves one frame as a BMP, without
+ * -o nothing else is written and the export stops at that frame.
+ *
+ * rendering stays on the main thread as SDL_ttf isn't thread safe, the
+ * color conversion runs on -threads converter threads and a writer
+ * thread keeps the output in frame order.
+ *
+ */
+
+int main( int argc, char *argv[] )
+{
+	static struct Replay replay;
+	static struct ExportConverter conv[EXPORT_MAX_THREADS];
+	SDL_Thread *threads[EXPORT_MAX_THREADS];
+	SDL_Thread *writer;
+	struct Export e;
+	struct ExportSlot *slot;
+	struct Tetris t;
+	SDL_Surface *frame;
+	TTF_Font *font;
+	char *out_path;
+	char *bmp_path;
+	char *replay_path;
+	Uint8 actions[REPLAY_MAX_ACTIONS];
+	Uint32 rec_time, frame_time;
+	int num_actions;
+	int fps;
+	int bmp_frame;
+	int stream;
+	int status;
+	int ended;
+	int end_frame;
+	int k;
+	int i;
+
+	/*
+	 * Parse the command line
+	 *
+	 */
+
+	memset( &e, 0, sizeof(e) );
+	e.format = EXPORT_Y4M;
+	e.num_threads = 0;
+	out_path = NULL;
+	bmp_path = NULL;
+	replay_path = NULL;
+	bmp_frame = -1;
+	fps = 60;
+
+	for( i=1; i<argc; i++ ) {
+		if( !strcmp( argv[i], "-o" ) && ( i+1 < argc ) )
+			out_path = argv[++i];
+		else if( !strcmp( argv[i], "-rgb" ) )
+			e.format = EXPORT_RGB;
+		else if( !strcmp( argv[i], "-fps" ) && ( i+1 < argc ) )
+			fps = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-threads" ) && ( i+1 < argc ) )
+			e.num_threads = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-bmp" ) && ( i+2 < argc ) ) {
+			bmp_frame = atoi( argv[++i] );
+			bmp_path = argv[++i];
+		}
+		else if( argv[i][0] != '-' && replay_path == NULL )
+			replay_path = argv[i];
+		else
+			break;
+	}
+
+	if( i < argc || replay_path == NULL || fps < 1 || fps > 1000 ) {
+		fprintf( stderr, "usage: %s [-o file|-] [-rgb] [-fps n] [-threads n] [-bmp frame file] replay\n", argv[0] );
+		exit( 1 );
+	}
+
+	/* stream unless only a BMP was asked for */
+	stream = ( out_path != NULL || bmp_path == NULL );
+
+	if( e.num_threads < 1 )
+		e.num_threads = sysconf( _SC_NPROCESSORS_ONLN );
+	if( e.num_threads < 1 )
+		e.num_threads = 1;
+	if( e.num_threads > EXPORT_MAX_THREADS )
+		e.num_threads = EXPORT_MAX_THREADS;
+
+	if( replay_open( &replay, replay_path ) != 0 )
+		exit( 1 );
+
+	/*
+	 * Initialize the font engine, there is no video to initialize
+	 *
+	 */
+
+	if( TTF_Init() == -1 ) {
+		fprintf( stderr, "Unable to initialize SDL_ttf: %s\n", TTF_GetError() );
+		exit( 1 );
+	}
+
+	font = TTF_OpenFont( "Bitstream-Vera-Sans-Mono.ttf", 18 );
+
+	if( font == NULL ) {
+		fprintf( stderr, "Unable to load font file: Bitstream-Vera-Sans-Mono.ttf %s\n", TTF_GetError() );
+		exit( 1 );
+	}
+
+	/*
+	 * Set up the output and the pipeline
+	 *
+	 */
+
+	frame = NULL;
+	writer = NULL;
+
+	if( stream ) {
+		if( out_path == NULL || !strcmp( out_path, "-" ) )
+			e.fp = stdout;
+		else
+			e.fp = fopen( out_path, "wb" );
+
+		if( e.fp == NULL ) {
+			fprintf( stderr, "Unable to open output file: %s\n", out_path );
+			exit( 1 );
+		}
+
+		if( e.format == EXPORT_Y4M ) {
+			e.frame_size = ( SCREEN_WIDTH * SCREEN_HEIGHT * 3 ) / 2;
+			fprintf( e.fp, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", SCREEN_WIDTH, SCREEN_HEIGHT, fps );
+		}
+		else
+			e.frame_size = SCREEN_WIDTH * SCREEN_HEIGHT * 3;
+
+		/* two frames in flight per converter */
+		e.num_slots = e.num_threads * 2;
+		e.slots = calloc( e.num_slots, sizeof(struct ExportSlot) );
+		if( e.slots == NULL ) {
+			fprintf( stderr, "Out of memory\n" );
+			exit( 1 );
+		}
+
+		for( i=0; i<e.num_slots; i++ ) {
+			slot = &e.slots[i];
+			slot->frame = export_surface();
+			slot->out = malloc( e.frame_size );
+			slot->free = SDL_CreateSemaphore( 1 );
+			slot->rendered = SDL_CreateSemaphore( 0 );
+			slot->converted = SDL_CreateSemaphore( 0 );
+
+			if( slot->frame == NULL || slot->out == NULL || slot->free == NULL ||
+					slot->rendered == NULL || slot->converted == NULL ) {
+				fprintf( stderr, "Unable to set up frame %d: %s\n", i, SDL_GetError() );
+				exit( 1 );
+			}
+		}
+
+		for( i=0; i<e.num_threads; i++ ) {
+			conv[i].e = &e;
+			conv[i].index = i;
+			threads[i] = SDL_CreateThread( export_converter_thread, &conv[i] );
+			if( threads[i] == NULL ) {
+				fprintf( stderr, "Unable to start a converter thread: %s\n", SDL_GetError() );
+				exit( 1 );
+			}
+		}
+
+		writer = SDL_CreateThread( export_writer_thread, &e );
+		if( writer == NULL ) {
+			fprintf( stderr, "Unable to start the writer thread: %s\n", SDL_GetError() );
+			exit( 1 );
+		}
+	}
+	else {
+		frame = export_surface();
+		if( frame == NULL ) {
+			fprintf( stderr, "Unable to create frame surface: %s\n", SDL_GetError() );
+			exit( 1 );
+		}
+	}
+
+	/* all frames share one pixel format, render the glyphs in it once */
+	if( render_text_cache( font, stream ? e.slots[0].frame->format : frame->format ) != 0 )
+		fprintf( stderr, "Unable to cache the font glyphs, rendering text per string\n" );
+
+	/*
+	 * Play the replay back, the game runs on replay time
+	 *
+	 */
+
+	tetris_initialize( &t );
+	tetris_seed( &t, replay.hdr.seed );
+	tetris_start( &t );
+	t.next_time = replay.hdr.next_time;
+
+	status = replay_read( &replay, &rec_time, actions, &num_actions );
+	ended = 0;
+	end_frame = 0;
+
+	for( k=0; ; k++ ) {
+
+		frame_time = (Uint32)( ( (Uint64)k * 1000 ) / fps );
+
+		/* play every record up to this frame */
+		while( !ended && rec_time <= frame_time ) {
+			if( status != 1 ) {
+				if( status < 0 )
+					fprintf( stderr, "Replay is truncated, stopping at %u ms\n", rec_time );
+				else if( replay.end.score != t.game_score ||
+						replay.end.lines != t.game_total_num_lines_cleared ||
+						replay.end.pieces != t.game_num_pieces )
+					fprintf( stderr, "Replay out of sync: score %u lines %u pieces %u, recorded %u %u %u\n",
+							t.game_score, t.game_total_num_lines_cleared, t.game_num_pieces,
+							replay.end.score, replay.end.lines, replay.end.pieces );
+
+				ended = 1;
+				end_frame = k + ( EXPORT_TAIL_SECONDS * fps );
+				break;
+			}
+
+			for( i=0; i<num_actions; i++ )
+				replay_apply( &t, actions[i] );
+
+			tetris_tick( &t, rec_time );
+
+			status = replay_read( &replay, &rec_time, actions, &num_actions );
+		}
+
+		if( ended && k >= end_frame )
+			break;
+
+		if( !stream ) {
+			if( k == bmp_frame ) {
+				export_render( frame, font, &t, ended );
+				break;
+			}
+			continue;
+		}
+
+		slot = &e.slots[k % e.num_slots];
+
+		SDL_SemWait( slot->free );
+		export_render( slot->frame, font, &t, ended );
+
+		if( k == bmp_frame && SDL_SaveBMP( slot->frame, bmp_path ) != 0 )
+			fprintf( stderr, "Unable to save %s: %s\n", bmp_path, SDL_GetError() );
+
+		SDL_SemPost( slot->rendered );
+	}
+
+	if( bmp_frame >= 0 && k < bmp_frame )
+		fprintf( stderr, "The replay is only %d frames long\n", k );
+
+	/*
+	 * Shut down, each converter and the writer see one end slot
+	 *
+	 */
+
+	if( stream ) {
+		for( i=0; i<e.num_threads; i++ ) {
+			slot = &e.slots[(k+i) % e.num_slots];
+			SDL_SemWait( slot->free );
+			slot->end = 1;
+			SDL_SemPost( slot->rendered );
+		}
+
+		for( i=0; i<e.num_threads; i++ )
+			SDL_WaitThread( threads[i], NULL );
+		SDL_WaitThread( writer, NULL );
+
+		if( e.fp != stdout )
+			fclose( e.fp );
+		else
+			fflush( e.fp );
+
+		for( i=0; i<e.num_slots; i++ ) {
+			slot = &e.slots[i];
+			SDL_FreeSurface( slot->frame );
+			free( slot->out );
+			SDL_DestroySemaphore( slot->free );
+			SDL_DestroySemaphore( slot->rendered );
+			SDL_DestroySemaphore( slot->converted );
+		}
+		free( e.slots );
+	}
+	else {
+		if( k == bmp_frame && SDL_SaveBMP( frame, bmp_path ) != 0 )
+			fprintf( stderr, "Unable to save %s: %s\n", bmp_path, SDL_GetError() );
+		SDL_FreeSurface( frame );
+	}
+
+	fprintf( stderr, "%d frames, score %u, lines %u, pieces %u\n", k,
+			t.game_score, t.game_total_num_lines_cleared, t.game_num_pieces );
+
+	replay_close( &replay );
+	render_text_free();
+	TTF_CloseFont( font );
+	TTF_Quit();
+
+	return e.error ? 1 : 0;
+}
+
+/*
+ * export_surface
+ *
+ * a native resolution 32bpp 0xRRGGBB frame, the layout the tetrad
+ * colors are defined in so they need no mapping
+ *
+ */
+static SDL_Surface *export_surface( void )
+{
+	return SDL_CreateRGBSurface( SDL_SWSURFACE, SCREEN_WIDTH, SCREEN_HEIGHT, 32,
+			0x00ff0000, 0x0000ff00, 0x000000ff, 0 );
+}
+
+/*
+ * export_render
+ *
+ * draw one frame of the replay
+ *
+ */
+static void export_render( SDL_Surface *frame, TTF_Font *font, struct Tetris *t, int ended )
+{
+	render_game( frame, font, t );
+
+	if( t->state == TETRIS_STATE_OVER )
+		tetris_draw_text( font, frame, 260, 192, "GAME OVER" );
+	else if( !ended )
+		tetris_draw_text( font, frame, 260, 192, "REPLAY" );
+}
+
+/*
+ * export_y4m
+ *
+ * convert a frame to planar 4:2:0 YCbCr, full range BT.601 in 8.8
+ * fixed point, chroma from the average of each 2x2 block
+ *
+ */
+static void export_y4m( SDL_Surface *frame, Uint8 *out )
+{
+	Uint32 *src;
+	Uint32 p, q;
+	Uint8 *y_plane, *u_plane, *v_plane;
+	int pitch;
+	int r, g, b;
+	int u, v;
+	int x, y;
+
+	pitch = frame->pitch / sizeof(Uint32);
+
+	y_plane = out;
+	u_plane = out + ( frame->w * frame->h );
+	v_plane = u_plane + ( ( frame->w / 2 ) * ( frame->h / 2 ) );
+
+	for( y=0; y<frame->h; y++ ) {
+		src = (Uint32 *)frame->pixels + ( y * pitch );
+		for( x=0; x<frame->w; x++ ) {
+			p = src[x];
+			r = ( p >> 16 ) & 0xff;
+			g = ( p >> 8 ) & 0xff;
+			b = p & 0xff;
+			*y_plane++ = ( ( 77 * r ) + ( 150 * g ) + ( 29 * b ) + 128 ) >> 8;
+		}
+	}
+
+	for( y=0; y<frame->h; y+=2 ) {
+		src = (Uint32 *)frame->pixels + ( y * pitch );
+		for( x=0; x<frame->w; x+=2 ) {
+			p = src[x];
+			q = src[x+1];
+			r = ( ( p >> 16 ) & 0xff ) + ( ( q >> 16 ) & 0xff );
+			g = ( ( p >> 8 ) & 0xff ) + ( ( q >> 8 ) & 0xff );
+			b = ( p & 0xff ) + ( q & 0xff );
+
+			p = src[x+pitch];
+			q = src[x+pitch+1];
+			r += ( ( p >> 16 ) & 0xff ) + ( ( q >> 16 ) & 0xff );
+			g += ( ( p >> 8 ) & 0xff ) + ( ( q >> 8 ) & 0xff );
+			b += ( p & 0xff ) + ( q & 0xff );
+
+			r = ( r + 2 ) >> 2;
+			g = ( g + 2 ) >> 2;
+			b = ( b + 2 ) >> 2;
+
+			/* offset by 128.5 so the shifts never see a negative value */
+			u = ( ( -43 * r ) - ( 85 * g ) + ( 128 * b ) + 32896 ) >> 8;
+			v = ( ( 128 * r ) - ( 107 * g ) - ( 21 * b ) + 32896 ) >> 8;
+
+			*u_plane++ = ( u > 255 ) ? 255 : u;
+			*v_plane++ = ( v > 255 ) ? 255 : v;
+		}
+	}
+}
+
+/*
+ * export_rgb
+ *
+ * convert a frame to packed 24 bit RGB
+ *
+ */
+static void export_rgb( SDL_Surface *frame, Uint8 *out )
+{
+	Uint32 *src;
+	Uint32 p;
+	int pitch;
+	int x, y;
+
+	pitch = frame->pitch / sizeof(Uint32);
+
+	for( y=0; y<frame->h; y++ ) {
+		src = (Uint32 *)frame->pixels + ( y * pitch );
+		for( x=0; x<frame->w; x++ ) {
+			p = src[x];
+			*out++ = ( p >> 16 ) & 0xff;
+			*out++ = ( p >> 8 ) & 0xff;
+			*out++ = p & 0xff;
+		}
+	}
+}
+
+/*
+ * export_converter_thread
+ *
+ * converts frames index, index + num_threads, ... until an end slot
+ *
+ */
+static int export_converter_thread( void *data )
+{
+	struct ExportConverter *c = data;
+	struct Export *e = c->e;
+	struct ExportSlot *slot;
+	int end;
+	int k;
+
+	for( k=c->index; ; k+=e->num_threads ) {
+		slot = &e->slots[k % e->num_slots];
+
+		SDL_SemWait( slot->rendered );
+
+		/* once posted the slot can be reused, don't look at it again */
+		end = slot->end;
+
+		if( !end ) {
+			if( e->format == EXPORT_Y4M )
+				export_y4m( slot->frame, slot->out );
+			else
+				export_rgb( slot->frame, slot->out );
+		}
+
+		SDL_SemPost( slot->converted );
+
+		if( end )
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ * export_writer_thread
+ *
+ * writes the converted frames in order until the first end slot
+ *
+ */
+static int export_writer_thread( void *data )
+{
+	struct Export *e = data;
+	struct ExportSlot *slot;
+	int k;
+
+	for( k=0; ; k++ ) {
+		slot = &e->slots[k % e->num_slots];
+
+		SDL_SemWait( slot->converted );
+
+		if( slot->end )
+			break;
+
+		/* after an error keep draining the frames so nothing blocks */
+		if( !e->error ) {
+			if( e->format == EXPORT_Y4M )
+				fputs( "FRAME\n", e->fp );
+
+			if( fwrite( slot->out, e->frame_size, 1, e->fp ) != 1 ) {
+				fprintf( stderr, "Unable to write frame %d\n", k );
+				e->error = 1;
+			}
+		}
+
+		SDL_SemPost( slot->free );
+	}
+
+	return 0;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,667 @@
+/*
+SDLBlocks
+
+Description:
+blocksfarm: plays seeded games with the placement AI in a pool of
+worker processes and collects the results in shared memory.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "ai.h"
+
+#define FARM_MAGIC 0x4d524146	/* "FARM" */
+#define FARM_VERSION 1
+
+#define FARM_MAX_WORKERS 256
+
+/* a worker that dies while playing a game is started again after that
+ * game, one that dies between games is only started again this many
+ * times in a row */
+#define FARM_MAX_RESTARTS 3
+
+/* seconds between progress lines, the checkpoint is synced with them */
+#define FARM_REPORT_SECONDS 5
+
+/* result states, a result is only read once its state is OVER or
+ * LIMIT. PLAYING marks the game a worker is on, a game a worker died
+ * playing is FAILED and isn't played again. */
+#define FARM_PENDING 0
+#define FARM_OVER    1
+#define FARM_LIMIT   2
+#define FARM_PLAYING 3
+#define FARM_FAILED  4
+
+/*
+ * the table is laid out as
+ *
+ *   struct FarmHeader
+ *   struct FarmResult result[games]
+ *
+ * in a file mapped by every process when there is a checkpoint, in an
+ * anonymous shared mapping otherwise. each game has its own result and
+ * is only played by one worker, which fills in the result and then
+ * stores its state, so nothing is locked.
+ *
+ */
+
+struct FarmHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 games;
+	Uint32 seed;
+	Uint32 max_pieces;
+	Uint32 depth;
+} __attribute__(( aligned(64) ));
+
+struct FarmResult {
+	Uint32 seed;
+	Uint32 score;
+	Uint32 lines;
+	Uint32 level;
+	Uint32 pieces;
+	Uint32 state;
+};
+
+/* one per worker, updated by the worker as it finishes each game */
+struct FarmWorker {
+	Uint32 first;
+	Uint32 last;
+
+	Uint32 games;
+	Uint64 pieces;
+	Uint64 usec;
+
+	/* restarts -- times started again, failures -- of them in a row
+	 * without a game started */
+	pid_t pid;
+	int restarts;
+	int failures;
+} __attribute__(( aligned(64) ));
+
+#define FARM_RESULT( h, i ) ( (struct FarmResult *)( (h) + 1 ) + (i) )
+
+static struct FarmHeader *farm_map( const char *path, Uint32 games, Uint32 seed, Uint32 max_pieces, int depth, size_t *size );
+static pid_t farm_spawn( struct FarmHeader *h, struct FarmWorker *w );
+static void farm_work( struct FarmHeader *h, struct FarmWorker *w );
+static Uint32 farm_count( struct FarmHeader *h );
+static int farm_crashed( struct FarmHeader *h, struct FarmWorker *w );
+static double farm_clock( void );
+
+/*
+ * blocksfarm
+ *
+ * usage: blocksfarm [-games n] [-seed n] [-depth n] [-pieces n]
+ *                   [-workers n] [-checkpoint file] [-list]
+ *
+ * plays games like blocksbot, game i with seed+i, in -workers forked
+ * processes (one per CPU by default). each worker plays its own range
+ * of the games, so a worker that crashes only loses the game it was
+ * playing, which is marked failed, and is started again on the rest.
+ *
+ * with -checkpoint the results table is the file itself. a run that
+ * was killed is resumed by running it again with the same file, games
+ * with a result are not played again.
+ *
+ */
+
+int main( int argc, char *argv[] )
+{
+	struct FarmWorker *workers;
+	struct FarmHeader *h;
+	struct FarmResult *r;
+	struct FarmWorker *w;
+	Uint32 games, seed, max_pieces;
+	Uint32 resumed, played, limited, crashed, total_games;
+	Uint64 score, lines, level, pieces;
+	double start, seconds, next_report;
+	struct timespec nap;
+	size_t size;
+	char *path;
+	pid_t pid;
+	int num_workers;
+	int running;
+	int failed;
+	int status;
+	int depth;
+	int list;
+	int i;
+
+	games = 100;
+	seed = 1;
+	depth = AI_DEPTH;
+	max_pieces = 10000;
+	num_workers = sysconf( _SC_NPROCESSORS_ONLN );
+	path = NULL;
+	list = 0;
+
+	for( i=1; i<argc; i++ ) {
+		if( !strcmp( argv[i], "-games" ) && ( i+1 < argc ) )
+			games = strtoul( argv[++i], NULL, 0 );
+		else if( !strcmp( argv[i], "-seed" ) && ( i+1 < argc ) )
+			seed = strtoul( argv[++i], NULL, 0 );
+		else if( !strcmp( argv[i], "-depth" ) && ( i+1 < argc ) )
+			depth = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-pieces" ) && ( i+1 < argc ) )
+			max_pieces = strtoul( argv[++i], NULL, 0 );
+		else if( !strcmp( argv[i], "-workers" ) && ( i+1 < argc ) )
+			num_workers = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-checkpoint" ) && ( i+1 < argc ) )
+			path = argv[++i];
+		else if( !strcmp( argv[i], "-list" ) )
+			list = 1;
+		else {
+			fprintf( stderr, "usage: %s [-games n] [-seed n] [-depth 1..%d] [-pieces n]\n"
+					"       [-workers n] [-checkpoint file] [-list]\n", argv[0], AI_MAX_DEPTH );
+			exit( 1 );
+		}
+	}
+
+	if( depth < 1 || depth > AI_MAX_DEPTH ) {
+		fprintf( stderr, "Depth must be between 1 and %d\n", AI_MAX_DEPTH );
+		exit( 1 );
+	}
+
+	if( games < 1 ) {
+		fprintf( stderr, "Number of games must be at least 1\n" );
+		exit( 1 );
+	}
+
+	if( num_workers < 1 )
+		num_workers = 1;
+	if( num_workers > FARM_MAX_WORKERS )
+		num_workers = FARM_MAX_WORKERS;
+	if( (Uint32)num_workers > games )
+		num_workers = games;
+
+	h = farm_map( path, games, seed, max_pieces, depth, &size );
+
+	if( h == NULL )
+		exit( 1 );
+
+	workers = mmap( NULL, num_workers * sizeof(struct FarmWorker), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+
+	if( workers == MAP_FAILED ) {
+		fprintf( stderr, "Unable to map the worker table: %s\n", strerror( errno ) );
+		exit( 1 );
+	}
+
+	memset( workers, 0, num_workers * sizeof(struct FarmWorker) );
+
+	resumed = farm_count( h );
+
+	if( resumed )
+		printf( "resuming %s: %u of %u games already played\n", path, resumed, games );
+
+	printf( "%u games from seed %u, depth %d, %d workers\n", games, seed, depth, num_workers );
+	fflush( stdout );
+
+	start = farm_clock();
+	next_report = start + FARM_REPORT_SECONDS;
+	running = 0;
+	failed = 0;
+
+	for( i=0; i<num_workers; i++ ) {
+		w = &workers[i];
+		w->first = (Uint32)( ( (Uint64)games * i ) / num_workers );
+		w->last = (Uint32)( ( (Uint64)games * ( i + 1 ) ) / num_workers );
+
+		if( farm_spawn( h, w ) < 0 ) {
+			failed = 1;
+			break;
+		}
+
+		running++;
+	}
+
+	nap.tv_sec = 0;
+	nap.tv_nsec = 50000000;
+
+	while( running > 0 ) {
+
+		pid = waitpid( -1, &status, WNOHANG );
+
+		if( pid < 0 ) {
+			if( errno == EINTR )
+				continue;
+			break;
+		}
+
+		if( pid == 0 ) {
+			nanosleep( &nap, NULL );
+
+			if( farm_clock() >= next_report ) {
+				played = farm_count( h ) - resumed;
+				seconds = farm_clock() - start;
+
+				printf( "%u of %u games, %.2f games/s\n", played + resumed, games, played / seconds );
+				fflush( stdout );
+
+				if( path != NULL )
+					msync( h, size, MS_ASYNC );
+
+				next_report += FARM_REPORT_SECONDS;
+			}
+			continue;
+		}
+
+		for( i=0; i<num_workers; i++ ) {
+			if( workers[i].pid == pid )
+				break;
+		}
+
+		if( i == num_workers )
+			continue;
+
+		w = &workers[i];
+		w->pid = 0;
+		running--;
+
+		if( WIFEXITED( status ) && WEXITSTATUS( status ) == 0 )
+			continue;
+
+		if( WIFSIGNALED( status ) )
+			fprintf( stderr, "Worker %d killed by signal %d\n", i, WTERMSIG( status ) );
+		else
+			fprintf( stderr, "Worker %d exited with status %d\n", i, WEXITSTATUS( status ) );
+
+		/* the game it died on won't be played again, a worker that
+		 * keeps dying without starting a game is given up on */
+		if( farm_crashed( h, w ) ) {
+			w->failures = 0;
+		}
+		else if( w->failures >= FARM_MAX_RESTARTS ) {
+			fprintf( stderr, "Worker %d failed %d times in a row, giving up on its games\n", i, w->failures + 1 );
+			failed = 1;
+			continue;
+		}
+		else {
+			w->failures++;
+		}
+
+		w->restarts++;
+
+		if( farm_spawn( h, w ) < 0 ) {
+			failed = 1;
+			continue;
+		}
+
+		running++;
+	}
+
+	seconds = farm_clock() - start;
+
+	if( path != NULL && msync( h, size, MS_SYNC ) != 0 )
+		fprintf( stderr, "Unable to sync %s: %s\n", path, strerror( errno ) );
+
+	printf( "\n" );
+
+	total_games = 0;
+	for( i=0; i<num_workers; i++ ) {
+		w = &workers[i];
+		total_games += w->games;
+
+		printf( "worker %d: seeds %u-%u, %u games, %llu pieces in %.2f s, %.2f games/s, %.0f pieces/s",
+				i, seed + w->first, seed + w->last - 1, w->games, (unsigned long long)w->pieces,
+				w->usec / 1.0e6, w->usec ? ( w->games * 1.0e6 ) / w->usec : 0.0,
+				w->usec ? ( w->pieces * 1.0e6 ) / w->usec : 0.0 );
+
+		if( w->restarts )
+			printf( ", %d restarts", w->restarts );
+
+		printf( "\n" );
+	}
+
+	printf( "%u games in %.2f s, %.2f games/s\n", total_games, seconds,
+			seconds > 0.0 ? total_games / seconds : 0.0 );
+
+	score = 0;
+	lines = 0;
+	level = 0;
+	pieces = 0;
+	played = 0;
+	limited = 0;
+	crashed = 0;
+
+	for( i=0; (Uint32)i<games; i++ ) {
+		r = FARM_RESULT( h, i );
+
+		if( r->state == FARM_FAILED ) {
+			if( list )
+				printf( "game %d seed %u: failed\n", i, r->seed );
+			crashed++;
+			continue;
+		}
+
+		if( r->state != FARM_OVER && r->state != FARM_LIMIT )
+			continue;
+
+		if( list ) {
+			printf( "game %d seed %u: score %u lines %u level %u pieces %u%s\n", i, r->seed,
+					r->score, r->lines, r->level, r->pieces, ( r->state == FARM_LIMIT ) ? " (limit)" : "" );
+		}
+
+		score += r->score;
+		lines += r->lines;
+		level += r->level;
+		pieces += r->pieces;
+		played++;
+		limited += ( r->state == FARM_LIMIT );
+	}
+
+	if( played > 0 ) {
+		printf( "average of %u games: score %.0f lines %.1f level %.1f pieces %.1f, %u reached the piece limit\n",
+				played, (double)score / played, (double)lines / played, (double)level / played,
+				(double)pieces / played, limited );
+	}
+
+	if( crashed > 0 )
+		printf( "%u games failed\n", crashed );
+
+	if( played + crashed < games )
+		printf( "%u games not played\n", games - played - crashed );
+
+	munmap( h, size );
+	munmap( workers, num_workers * sizeof(struct FarmWorker) );
+
+	return ( failed || crashed > 0 || played < games ) ? 1 : 0;
+}
+
+/*
+ * farm_map
+ *
+ * map the results table, from the checkpoint at path if there is one.
+ * a checkpoint left by an earlier run is only resumed if it was made
+ * for the same games.
+ *
+ * returns NULL on failure
+ *
+ */
+static struct FarmHeader *farm_map( const char *path, Uint32 games, Uint32 seed, Uint32 max_pieces, int depth, size_t *size )
+{
+	struct FarmHeader *h;
+	struct stat st;
+	Uint32 i;
+	int fd;
+
+	*size = sizeof(struct FarmHeader) + ( (size_t)games * sizeof(struct FarmResult) );
+
+	if( path == NULL ) {
+		h = mmap( NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+		if( h == MAP_FAILED ) {
+			fprintf( stderr, "Unable to map the results table: %s\n", strerror( errno ) );
+			return NULL;
+		}
+		memset( h, 0, *size );
+	}
+	else {
+		fd = open( path, O_RDWR | O_CREAT, 0644 );
+		if( fd < 0 || fstat( fd, &st ) != 0 ) {
+			fprintf( stderr, "Unable to open %s: %s\n", path, strerror( errno ) );
+			if( fd >= 0 )
+				close( fd );
+			return NULL;
+		}
+
+		if( st.st_size != 0 && (size_t)st.st_size != *size ) {
+			fprintf( stderr, "%s is not a checkpoint of %u games\n", path, games );
+			close( fd );
+			return NULL;
+		}
+
+		if( st.st_size == 0 && ftruncate( fd, *size ) != 0 ) {
+			fprintf( stderr, "Unable to size %s: %s\n", path, strerror( errno ) );
+			close( fd );
+			return NULL;
+		}
+
+		h = mmap( NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		close( fd );
+
+		if( h == MAP_FAILED ) {
+			fprintf( stderr, "Unable to map %s: %s\n", path, strerror( errno ) );
+			return NULL;
+		}
+
+		if( st.st_size != 0 ) {
+			if( h->magic != FARM_MAGIC || h->version != FARM_VERSION ) {
+				fprintf( stderr, "%s is not a checkpoint\n", path );
+				munmap( h, *size );
+				return NULL;
+			}
+
+			if( h->games != games || h->seed != seed || h->max_pieces != max_pieces || h->depth != (Uint32)depth ) {
+				fprintf( stderr, "%s was made for %u games from seed %u, depth %u, %u pieces\n",
+						path, h->games, h->seed, h->depth, h->max_pieces );
+				munmap( h, *size );
+				return NULL;
+			}
+
+			/* games still being played when the run was killed start over */
+			for( i=0; i<games; i++ ) {
+				if( FARM_RESULT( h, i )->state == FARM_PLAYING )
+					FARM_RESULT( h, i )->state = FARM_PENDING;
+			}
+
+			return h;
+		}
+	}
+
+	h->version = FARM_VERSION;
+	h->games = games;
+	h->seed = seed;
+	h->max_pieces = max_pieces;
+	h->depth = depth;
+
+	for( i=0; i<games; i++ )
+		FARM_RESULT( h, i )->seed = seed + i;
+
+	/* written last, a checkpoint torn while it was being made isn't resumed */
+	h->magic = FARM_MAGIC;
+
+	return h;
+}
+
+/*
+ * farm_spawn
+ *
+ * fork a worker for the games of w that have no result yet
+ *
+ * returns the worker's pid, -1 on failure
+ *
+ */
+static pid_t farm_spawn( struct FarmHeader *h, struct FarmWorker *w )
+{
+	pid_t pid;
+
+	/* don't hand buffered output down to the worker */
+	fflush( stdout );
+
+	pid = fork();
+
+	if( pid < 0 ) {
+		fprintf( stderr, "Unable to start a worker: %s\n", strerror( errno ) );
+		return -1;
+	}
+
+	if( pid == 0 ) {
+
+		/* don't keep playing if the coordinator is killed, a resumed
+		 * run would play the same games */
+		prctl( PR_SET_PDEATHSIG, SIGKILL );
+		if( getppid() == 1 )
+			_exit( 1 );
+
+		farm_work( h, w );
+		_exit( 0 );
+	}
+
+	w->pid = pid;
+
+	return pid;
+}
+
+/*
+ * farm_work
+ *
+ * play the games of w that have no result yet, in the worker
+ *
+ */
+static void farm_work( struct FarmHeader *h, struct FarmWorker *w )
+{
+	static struct Ai ai;
+	struct Tetris t;
+	struct AiMove move;
+	struct FarmResult *r;
+	double start;
+	Uint32 i;
+	int events;
+
+	if( ai_initialize( &ai ) != 0 ) {
+		fprintf( stderr, "Unable to allocate the transposition table\n" );
+		_exit( 1 );
+	}
+
+	ai.depth = h->depth;
+
+	for( i=w->first; i<w->last; i++ ) {
+
+		r = FARM_RESULT( h, i );
+
+		if( __atomic_load_n( &r->state, __ATOMIC_ACQUIRE ) != FARM_PENDING )
+			continue;
+
+		/* if the worker dies now the coordinator knows on which game */
+		__atomic_store_n( &r->state, FARM_PLAYING, __ATOMIC_RELEASE );
+
+		start = farm_clock();
+
+		tetris_initialize( &t );
+		tetris_seed( &t, r->seed );
+		tetris_start( &t );
+		t.clear_delay = 0;
+
+		/* as in blocksbot, tetrads only fall when the AI drops them */
+		while( t.state != TETRIS_STATE_OVER && t.game_num_pieces <= h->max_pieces ) {
+
+			events = tetris_tick( &t, 0 );
+
+			if( events & TETRIS_EVENT_SPAWN ) {
+				if( ai_choose( &ai, &t, &move ) != 0 )
+					break;
+
+				while( ai_step( &t, &move ) )
+					;
+			}
+		}
+
+		r->score = t.game_score;
+		r->lines = t.game_total_num_lines_cleared;
+		r->level = t.game_level;
+		r->pieces = t.game_num_pieces;
+
+		__atomic_store_n( &r->state, ( t.state == TETRIS_STATE_OVER ) ? FARM_OVER : FARM_LIMIT, __ATOMIC_RELEASE );
+
+		__atomic_store_n( &w->usec, w->usec + (Uint64)( ( farm_clock() - start ) * 1.0e6 ), __ATOMIC_RELAXED );
+		__atomic_store_n( &w->pieces, w->pieces + t.game_num_pieces, __ATOMIC_RELAXED );
+		__atomic_store_n( &w->games, w->games + 1, __ATOMIC_RELAXED );
+	}
+
+	ai_free( &ai );
+}
+
+/*
+ * farm_count
+ *
+ * number of games with a result or failed
+ *
+ */
+static Uint32 farm_count( struct FarmHeader *h )
+{
+	Uint32 count;
+	Uint32 state;
+	Uint32 i;
+
+	count = 0;
+	for( i=0; i<h->games; i++ ) {
+		state = __atomic_load_n( &FARM_RESULT( h, i )->state, __ATOMIC_ACQUIRE );
+		if( state != FARM_PENDING && state != FARM_PLAYING )
+			count++;
+	}
+
+	return count;
+}
+
+/*
+ * farm_crashed
+ *
+ * mark the game a dead worker was playing as failed, in the coordinator
+ *
+ * returns 1 if it was playing one
+ *
+ */
+static int farm_crashed( struct FarmHeader *h, struct FarmWorker *w )
+{
+	struct FarmResult *r;
+	Uint32 i;
+
+	for( i=w->first; i<w->last; i++ ) {
+		r = FARM_RESULT( h, i );
+
+		if( r->state == FARM_PLAYING ) {
+			fprintf( stderr, "Game %u seed %u failed\n", i, r->seed );
+			r->state = FARM_FAILED;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * farm_clock
+ *
+ * monotonic time in seconds
+ *
+ */
+static double farm_clock( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ( ts.tv_nsec / 1.0e9 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,790 @@
+/*
+SDLBlocks
+
+Description:
+The game simulation: input, game logic, rewind, AI and scores on a
+thread of its own, published to the renderer as snapshots.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include <SDL/SDL_mixer.h>
+
+#include "tetris.h"
+#include "rewind.h"
+#include "hiscore.h"
+#include "trace.h"
+#include "ai.h"
+#include "replay.h"
+#include "repeat.h"
+#include "sfx.h"
+#include "game.h"
+
+static int  game_thread( void *data );
+static void game_step( struct Game *g, Uint32 now );
+static void game_handle_key( struct Game *g, struct GameInput *in, Uint32 now );
+static void game_begin( struct Game *g, int attract, Uint32 now );
+static void game_repeat( struct Game *g, Uint32 now );
+static void game_sound( struct Game *g, int effect );
+static int  game_can_move( struct Tetris *t, int dx, int dy );
+static void game_publish( struct Game *g );
+static void game_trace_board( struct Tetris *t );
+static void game_fill( struct Game *g, struct GameSnapshot *s );
+
+/*
+ * game_initialize
+ *
+ * set up the game, the scores and the AI, music and sfx are NULL
+ * without audio, das and arr set the key repeat
+ *
+ */
+void game_initialize( struct Game *g, int practice, int autoplay, int use_beam, const char *record_path, Mix_Music *music, struct Sfx *sfx, Uint32 das, Uint32 arr )
+{
+	memset( g, 0, sizeof(struct Game) );
+
+	tetris_initialize( &g->tetris );
+	g->tetris.game_audio = ( music != NULL );
+	g->music = music;
+	g->sfx = sfx;
+
+	g->practice = practice;
+	g->autoplay = autoplay;
+	g->use_beam = use_beam;
+	g->record_path = record_path;
+
+	rewind_reset( &g->history );
+	repeat_initialize( &g->repeat, das, arr );
+
+	/* load the high-score table */
+	g->scores_ok = ( hiscore_open( &g->scores, HISCORE_FILE ) == 0 );
+
+	/* without the AI there is no autoplay or attract mode */
+	g->ai_ok = ( ai_initialize( &g->ai ) == 0 );
+	if( !g->ai_ok ) {
+		fprintf( stderr, "Unable to initialize the AI, autoplay disabled\n" );
+		g->autoplay = 0;
+	}
+
+	/* the AI plans on the simulation thread, well inside a step */
+	g->ai.budget_nodes = AI_BUDGET_NODES;
+	g->ai.budget_ms = AI_BUDGET_MS;
+
+	/* the beam search runs on its planner thread, the simulation only
+	 * polls it for the move */
+	if( g->ai_ok && g->use_beam ) {
+		if( ai_beam_initialize( &g->beam, &g->ai, 0, AI_BEAM_MAX_WIDTH ) == 0 ) {
+			g->beam.budget_ms = AI_BEAM_TICKS;
+			if( ai_beam_planner( &g->beam ) != 0 ) {
+				ai_beam_free( &g->beam );
+				g->use_beam = 0;
+			}
+		}
+		else {
+			g->use_beam = 0;
+		}
+
+		if( !g->use_beam )
+			fprintf( stderr, "Unable to start the beam search\n" );
+	}
+
+	g->bot_state = BOT_PLAN;
+	g->idle_time = SDL_GetTicks();
+	g->tetris.next_time = SDL_GetTicks();
+
+	/* the renderer starts out with a valid snapshot */
+	g->snap_back = 0;
+	g->snap_middle = 1;
+	g->snap_front = 2;
+	game_fill( g, &g->snap[g->snap_front] );
+}
+
+/*
+ * game_thread_start
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int game_thread_start( struct Game *g )
+{
+	g->quit = 0;
+	g->thread = SDL_CreateThread( game_thread, g );
+
+	return ( g->thread != NULL ) ? 0 : -1;
+}
+
+/*
+ * game_thread_stop
+ *
+ */
+void game_thread_stop( struct Game *g )
+{
+	if( g->thread == NULL )
+		return;
+
+	__atomic_store_n( &g->quit, 1, __ATOMIC_RELEASE );
+	SDL_WaitThread( g->thread, NULL );
+	g->thread = NULL;
+}
+
+/*
+ * game_free
+ *
+ * finish the replay and shut down the scores and the AI, the thread
+ * must be stopped
+ *
+ */
+void game_free( struct Game *g )
+{
+	replay_finish( &g->replay, &g->tetris );
+	replay_close( &g->replay );
+
+	if( g->scores_ok )
+		hiscore_close( &g->scores );
+
+	if( g->use_beam )
+		ai_beam_free( &g->beam );
+
+	if( g->ai_ok )
+		ai_free( &g->ai );
+}
+
+/*
+ * game_key
+ *
+ * queue a key press or release for the simulation, called from the
+ * event loop only. keys are dropped if the simulation falls
+ * GAME_INPUT_SIZE events behind.
+ *
+ * returns 0 if the key was queued at g->input_head - 1, -1 if dropped
+ *
+ */
+int game_key( struct Game *g, SDLKey key, int down )
+{
+	struct GameInput *in;
+	Uint32 head;
+
+	head = g->input_head;
+
+	if( head - __atomic_load_n( &g->input_tail, __ATOMIC_ACQUIRE ) >= GAME_INPUT_SIZE )
+		return -1;
+
+	in = &g->input[head & (GAME_INPUT_SIZE-1)];
+	in->time = SDL_GetTicks();
+	in->key = key;
+	in->down = down;
+
+	__atomic_store_n( &g->input_head, head + 1, __ATOMIC_RELEASE );
+
+	return 0;
+}
+
+/*
+ * game_snapshot
+ *
+ * the newest snapshot published by the simulation, called from the
+ * renderer only. the snapshot stays valid until the next call.
+ *
+ * returns 1 if it is newer than the one from the last call
+ *
+ */
+int game_snapshot( struct Game *g, struct GameSnapshot **snap )
+{
+	int fresh;
+
+	fresh = 0;
+
+	if( __atomic_load_n( &g->snap_middle, __ATOMIC_ACQUIRE ) & GAME_SNAP_FRESH ) {
+		g->snap_front = __atomic_exchange_n( &g->snap_middle, g->snap_front, __ATOMIC_ACQ_REL ) & 3;
+		fresh = 1;
+	}
+
+	*snap = &g->snap[g->snap_front];
+
+	return fresh;
+}
+
+/*
+ * game_latch
+ *
+ * late latch for the renderer: copy the game of a snapshot into view
+ * and apply the moves and rotations queued since the snapshot was
+ * taken, with the same functions the simulation will call on them.
+ * a gravity step in between can make the guess a row off, the next
+ * snapshot puts it right.
+ *
+ * returns the input position view is up to date with, the first key
+ * it couldn't apply
+ *
+ */
+Uint32 game_latch( struct Game *g, struct GameSnapshot *snap, struct Tetris *view )
+{
+	struct GameInput *in;
+	Uint32 pos, head;
+
+	*view = snap->tetris;
+
+	/* no tetrad of the player to move: the start screen or game over,
+	 * between tetrads, a demo game or a rewind */
+	if( snap->attract || snap->rewinding || !TETRIS_ACTIVE( &snap->tetris ) )
+		return snap->input;
+
+	head = g->input_head;
+
+	for( pos=snap->input; pos!=head; pos++ ) {
+		in = &g->input[pos & (GAME_INPUT_SIZE-1)];
+
+		/* keys after a drop, a pause or a rewind can't be guessed,
+		 * they are only shown once the simulation has had them */
+		if( in->key != SDLK_LEFT && in->key != SDLK_RIGHT &&
+				in->key != SDLK_UP && in->key != SDLK_DOWN )
+			break;
+
+		if( !in->down )
+			continue;
+
+		switch( in->key ) {
+			case SDLK_LEFT:
+				tetris_move_left( view );
+				break;
+			case SDLK_RIGHT:
+				tetris_move_right( view );
+				break;
+			case SDLK_UP:
+				tetris_rotate( view );
+				break;
+			case SDLK_DOWN:
+				tetris_move_down( view );
+				break;
+		}
+	}
+
+	return pos;
+}
+
+/*
+ * game_thread
+ *
+ * run the simulation every GAME_TICKS on its own clock, however long
+ * the renderer takes to draw and present a frame
+ *
+ */
+static int game_thread( void *data )
+{
+	struct Game *g = data;
+	Uint32 now, next;
+
+	next = SDL_GetTicks();
+
+	while( !__atomic_load_n( &g->quit, __ATOMIC_ACQUIRE ) ) {
+		now = SDL_GetTicks();
+
+		if( (Sint32)( next - now ) > 0 ) {
+			SDL_Delay( next - now );
+			continue;
+		}
+
+		if( now - next > GAME_MAX_LAG )
+			next = now;
+
+		game_step( g, next );
+		game_publish( g );
+
+		next += GAME_TICKS;
+	}
+
+	return 0;
+}
+
+/*
+ * game_step
+ *
+ * one simulation step at game time now
+ *
+ */
+static void game_step( struct Game *g, Uint32 now )
+{
+	struct Tetris *t = &g->tetris;
+	Uint32 tail;
+	int prev_pattern, prev_tx;
+	int events;
+	int ret;
+
+	/*
+	 * Input Section
+	 *
+	 */
+
+	tail = g->input_tail;
+
+	while( tail != __atomic_load_n( &g->input_head, __ATOMIC_ACQUIRE ) ) {
+		game_handle_key( g, &g->input[tail & (GAME_INPUT_SIZE-1)], now );
+		tail++;
+		__atomic_store_n( &g->input_tail, tail, __ATOMIC_RELEASE );
+	}
+
+	if( TETRIS_ACTIVE( t ) && !g->history.active && !g->attract )
+		game_repeat( g, now );
+
+	/*
+	 * Rewind Section
+	 *
+	 * while the rewind key is held the game is restored from the
+	 * rewind buffer every step, stepping back one recorded frame
+	 * every REWIND_TICKS. the restored game isn't ticked, it stays
+	 * frozen until the key is released.
+	 *
+	 */
+
+	if( g->rewind_key && t->state != TETRIS_STATE_START && t->state != TETRIS_STATE_PAUSE ) {
+		if( !g->history.active ) {
+			rewind_step( &g->history, t, 0 );
+			g->rewind_time = now + REWIND_TICKS;
+		}
+		else if( now >= g->rewind_time ) {
+			rewind_step( &g->history, t, 1 );
+			g->rewind_time = now + REWIND_TICKS;
+		}
+		else {
+			rewind_restore( &g->history, t, g->history.cursor );
+		}
+	}
+	else if( g->history.active ) {
+		TRACE_TETRAD( TRACE_REWIND, t, g->history.cursor );
+		game_trace_board( t );
+		rewind_resume( &g->history, t, now );
+		g->bot_state = BOT_PLAN;
+
+		/* rewinding out of a game over restarts the music */
+		if( t->game_audio && !Mix_PlayingMusic() )
+			Mix_PlayMusic( g->music, -1 );
+	}
+
+	/*
+	 * Game Logic Section
+	 *
+	 */
+
+	events = g->history.active ? 0 : tetris_tick( t, now );
+	replay_step( &g->replay, t, now, events );
+
+	if( events & TETRIS_EVENT_MOVE )
+		TRACE_TETRAD( TRACE_MOVE, t, 1 );
+
+	if( events & TETRIS_EVENT_LOCK ) {
+		if( g->practice )
+			rewind_lock( &g->history, t );
+		TRACE_LOCKED( t );
+		if( !( events & TETRIS_EVENT_CLEAR ) )
+			game_sound( g, SFX_LOCK );
+	}
+
+	if( events & TETRIS_EVENT_SPAWN ) {
+		TRACE_TETRAD( TRACE_SPAWN, t, 0 );
+		g->bot_state = BOT_PLAN;
+	}
+
+	if( events & TETRIS_EVENT_OVER ) {
+		TRACE_TETRAD( TRACE_OVER, t, 0 );
+		replay_finish( &g->replay, t );
+		if( t->game_audio )
+			Mix_HaltMusic();
+		game_sound( g, SFX_OVER );
+		g->idle_time = now;
+	}
+
+	if( events & TETRIS_EVENT_CLEAR ) {
+		TRACE( TRACE_CLEAR, 0, 0, 0, 0, t->last_lines );
+		game_sound( g, SFX_CLEAR );
+	}
+	if( events & TETRIS_EVENT_LEVEL ) {
+		TRACE( TRACE_LEVEL, 0, 0, 0, 0, t->game_level );
+		game_sound( g, SFX_LEVEL );
+	}
+
+	/* let the AI play the active tetrad, one action every AI_MOVE_TICKS */
+
+	if( ( g->autoplay || g->attract ) && !g->history.active && TETRIS_ACTIVE( t ) ) {
+		g->game_assisted = 1;
+
+		if( g->bot_state == BOT_PLAN ) {
+			/* a beam search for an earlier tetrad has to finish first */
+			if( g->use_beam ) {
+				if( ai_beam_start( &g->beam, t ) == 0 )
+					g->bot_state = BOT_WAIT;
+			}
+			else {
+				g->bot_state = ( ai_choose( &g->ai, t, &g->bot_move ) == 0 ) ? BOT_MOVE : BOT_DONE;
+			}
+			g->bot_time = now + AI_MOVE_TICKS;
+		}
+		else if( g->bot_state == BOT_WAIT ) {
+			ret = ai_beam_poll( &g->beam, &g->bot_move );
+			if( ret != 0 )
+				g->bot_state = ( ret > 0 ) ? BOT_MOVE : BOT_DONE;
+		}
+		else if( g->bot_state == BOT_MOVE && now >= g->bot_time ) {
+			prev_pattern = t->cur_pattern;
+			prev_tx = t->tx;
+
+			if( !ai_step( t, &g->bot_move ) ) {
+				replay_action( &g->replay, REPLAY_DROP );
+				g->bot_state = BOT_DONE;
+			}
+
+			/* a rotation or shift that fails before the drop leaves
+			 * nothing behind that the drop doesn't reset, so only the
+			 * moves that happened are recorded */
+			if( t->cur_pattern != prev_pattern ) {
+				replay_action( &g->replay, REPLAY_ROTATE );
+				TRACE_TETRAD( TRACE_ROTATE, t, 0 );
+				game_sound( g, SFX_ROTATE );
+			}
+			else if( t->tx != prev_tx ) {
+				replay_action( &g->replay, ( t->tx < prev_tx ) ? REPLAY_LEFT : REPLAY_RIGHT );
+				TRACE_TETRAD( TRACE_MOVE, t, 0 );
+				game_sound( g, SFX_MOVE );
+			}
+
+			g->bot_time = now + AI_MOVE_TICKS;
+		}
+	}
+
+	/* the attract mode starts a bot game after a while on the start
+	 * screen and goes back to it when the game is over */
+
+	if( g->attract && t->state == TETRIS_STATE_OVER && now >= g->idle_time + ATTRACT_OVER_TICKS ) {
+		tetris_initialize( t );
+		g->attract = 0;
+		g->idle_time = now;
+	}
+	else if( g->ai_ok && !g->attract && t->state == TETRIS_STATE_START && now >= g->idle_time + ATTRACT_TICKS ) {
+		game_begin( g, 1, now );
+	}
+
+	if( !g->attract && t->state != TETRIS_STATE_START )
+		g->idle_time = now;
+
+	/* enter finished games into the high-score table, rewinding makes
+	 * practice games ineligible and so does any help from the AI */
+
+	if( t->state == TETRIS_STATE_OVER && !g->game_recorded && !g->history.active ) {
+		if( g->scores_ok && !g->practice && !g->game_assisted )
+			hiscore_add_game( &g->scores, t, now - g->game_time );
+		g->game_recorded = 1;
+	}
+
+	/* record this step for rewind */
+
+	if( g->practice && !g->history.active && TETRIS_ACTIVE( t ) ) {
+		if( now >= g->rewind_time ) {
+			rewind_record( &g->history, t );
+			g->rewind_time = now + REWIND_TICKS;
+		}
+	}
+
+	g->seq++;
+}
+
+/*
+ * game_handle_key
+ *
+ */
+static void game_handle_key( struct Game *g, struct GameInput *in, Uint32 now )
+{
+	struct Tetris *t = &g->tetris;
+
+	if( !in->down ) {
+		if( in->key == SDLK_BACKSPACE )
+			g->rewind_key = 0;
+		else if( in->key == SDLK_LEFT )
+			repeat_release( &g->repeat, REPEAT_LEFT, in->time );
+		else if( in->key == SDLK_RIGHT )
+			repeat_release( &g->repeat, REPEAT_RIGHT, in->time );
+		else if( in->key == SDLK_DOWN )
+			repeat_release( &g->repeat, REPEAT_DOWN, in->time );
+		return;
+	}
+
+	/* any key ends the attract mode */
+	if( g->attract ) {
+		replay_finish( &g->replay, t );
+		tetris_initialize( t );
+		g->attract = 0;
+		g->idle_time = now;
+		return;
+	}
+
+	switch( in->key ) {
+
+		case SDLK_LEFT:
+			replay_action( &g->replay, REPLAY_LEFT );
+			if( tetris_move_left( t ) ) {
+				TRACE_TETRAD( TRACE_MOVE, t, 0 );
+				game_sound( g, SFX_MOVE );
+			}
+			repeat_press( &g->repeat, REPEAT_LEFT, in->time );
+			break;
+
+		case SDLK_RIGHT:
+			replay_action( &g->replay, REPLAY_RIGHT );
+			if( tetris_move_right( t ) ) {
+				TRACE_TETRAD( TRACE_MOVE, t, 0 );
+				game_sound( g, SFX_MOVE );
+			}
+			repeat_press( &g->repeat, REPEAT_RIGHT, in->time );
+			break;
+
+		case SDLK_UP:
+			replay_action( &g->replay, REPLAY_ROTATE );
+			if( tetris_rotate( t ) ) {
+				TRACE_TETRAD( TRACE_ROTATE, t, 0 );
+				game_sound( g, SFX_ROTATE );
+			}
+			break;
+
+		case SDLK_DOWN:
+			replay_action( &g->replay, REPLAY_DOWN );
+			if( tetris_move_down( t ) )
+				TRACE_TETRAD( TRACE_MOVE, t, 0 );
+			repeat_press( &g->repeat, REPEAT_DOWN, in->time );
+			break;
+
+		case SDLK_SPACE:
+			if( t->state == TETRIS_STATE_OVER ) {
+				tetris_initialize( t );
+			}
+			else if( t->state == TETRIS_STATE_START ) {
+				game_begin( g, 0, now );
+			}
+			else {
+				replay_action( &g->replay, REPLAY_DROP );
+				tetris_drop( t );
+			}
+			break;
+
+		case SDLK_p:
+			if( TETRIS_PLAYING( t ) || t->state == TETRIS_STATE_PAUSE ) {
+				replay_action( &g->replay, REPLAY_PAUSE );
+				if( tetris_pause( t ) ) {
+					if( t->game_audio )
+						Mix_PauseMusic();
+				}
+				else if( t->game_audio ) {
+					Mix_ResumeMusic();
+				}
+			}
+			break;
+
+		case SDLK_a:
+			if( g->ai_ok ) {
+				g->autoplay = !g->autoplay;
+				g->bot_state = BOT_PLAN;
+			}
+			break;
+
+		case SDLK_BACKSPACE:
+			if( g->practice )
+				g->rewind_key = 1;
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+ * game_repeat
+ *
+ * shift the active tetrad for the held keys, as many times as repeats
+ * fell due since the last step. a shift is only tried when it can
+ * succeed, a key held against a wall doesn't fill the replay with
+ * moves that fail.
+ *
+ */
+static void game_repeat( struct Game *g, Uint32 now )
+{
+	struct Tetris *t = &g->tetris;
+	int prev_tx;
+	int n;
+
+	prev_tx = t->tx;
+
+	for( n=repeat_due( &g->repeat, REPEAT_LEFT, now ); n>0 && game_can_move( t, -TETRAD_WIDTH, 0 ); n-- ) {
+		replay_action( &g->replay, REPLAY_LEFT );
+		tetris_move_left( t );
+		TRACE_TETRAD( TRACE_MOVE, t, 0 );
+	}
+
+	for( n=repeat_due( &g->repeat, REPEAT_RIGHT, now ); n>0 && game_can_move( t, TETRAD_WIDTH, 0 ); n-- ) {
+		replay_action( &g->replay, REPLAY_RIGHT );
+		tetris_move_right( t );
+		TRACE_TETRAD( TRACE_MOVE, t, 0 );
+	}
+
+	/* one click for all the shifts of a step */
+	if( t->tx != prev_tx )
+		game_sound( g, SFX_MOVE );
+
+	for( n=repeat_due( &g->repeat, REPEAT_DOWN, now ); n>0 && game_can_move( t, 0, TETRAD_HEIGHT ); n-- ) {
+		replay_action( &g->replay, REPLAY_DOWN );
+		tetris_move_down( t );
+		TRACE_TETRAD( TRACE_MOVE, t, 0 );
+	}
+}
+
+/*
+ * game_sound
+ *
+ * the demo game plays without sound, like without music
+ *
+ */
+static void game_sound( struct Game *g, int effect )
+{
+	if( !g->attract )
+		sfx_play( g->sfx, effect );
+}
+
+/*
+ * game_can_move
+ *
+ * whether the active tetrad fits dx,dy pixels away
+ *
+ */
+static int game_can_move( struct Tetris *t, int dx, int dy )
+{
+	int x, y;
+
+	x = t->tx + dx;
+	y = t->ty + dy;
+
+	if( x < (TETRIS_MIN_X+1) || x > t->max_x || y > t->max_y )
+		return 0;
+
+	return tetrad_move( &(t->board[0][0]), t->t, t->cur_pattern, x, y );
+}
+
+/*
+ * game_begin
+ *
+ * start a new game from the start screen, a demo game if attract is set
+ *
+ */
+static void game_begin( struct Game *g, int attract, Uint32 now )
+{
+	struct Tetris *t = &g->tetris;
+	Uint32 seed;
+
+	seed = rand();
+	tetris_seed( t, seed );
+	tetris_start( t );
+
+	if( g->record_path != NULL )
+		replay_create( &g->replay, g->record_path, t, seed, now );
+
+	rewind_reset( &g->history );
+	g->game_recorded = 0;
+	g->game_assisted = attract || g->autoplay;
+	g->attract = attract;
+	g->bot_state = BOT_PLAN;
+	g->game_time = now;
+
+	if( !attract ) {
+		TRACE( TRACE_START, 0, 0, 0, 0, 0 );
+		if( t->game_audio )
+			Mix_PlayMusic( g->music, -1 );
+	}
+}
+
+/*
+ * game_trace_board
+ *
+ * trace the board, score and lines of a rewound game so that a decoder
+ * can go on rebuilding the board from the tetrads placed after it
+ *
+ */
+static void game_trace_board( struct Tetris *t )
+{
+	int cells;
+	int i, j, k, n;
+
+	if( !trace_enabled )
+		return;
+
+	for( i=0; i<TETRIS_HEIGHT; i++ ) {
+		for( j=0; j<TETRIS_WIDTH; j+=4 ) {
+			cells = 0;
+
+			for( k=j; k<j+4; k++ ) {
+				cells <<= 4;
+				if( k >= TETRIS_WIDTH || t->board[i][k] == 0 )
+					continue;
+
+				for( n=0; n<MAX_TETRAD; n++ ) {
+					if( tetrad[n].color == t->board[i][k] )
+						break;
+				}
+				cells |= ( n < MAX_TETRAD ) ? n+1 : TRACE_CELL_OTHER;
+			}
+
+			TRACE( TRACE_ROW, 0, 0, j, i, cells );
+		}
+	}
+
+	TRACE( TRACE_SCORE, t->game_score >> 16, 0, 0, 0, t->game_score & 0xffff );
+	TRACE( TRACE_LINES, ( t->game_level < 255 ) ? t->game_level : 255, 0, 0,
+			t->game_cur_num_lines_cleared, t->game_total_num_lines_cleared );
+}
+
+/*
+ * game_publish
+ *
+ * hand the state after this step to the renderer
+ *
+ */
+static void game_publish( struct Game *g )
+{
+	game_fill( g, &g->snap[g->snap_back] );
+	g->snap_back = __atomic_exchange_n( &g->snap_middle, g->snap_back | GAME_SNAP_FRESH, __ATOMIC_ACQ_REL ) & 3;
+}
+
+/*
+ * game_fill
+ *
+ */
+static void game_fill( struct Game *g, struct GameSnapshot *s )
+{
+	int i;
+
+	s->seq = g->seq;
+	s->input = g->input_tail;
+	s->tetris = g->tetris;
+	s->rewinding = g->history.active;
+	s->attract = g->attract;
+	s->autoplay = g->autoplay;
+
+	s->scores_ok = g->scores_ok;
+	s->num_top = g->scores_ok ? g->scores.num_top : 0;
+	for( i=0; i<s->num_top; i++ )
+		s->top[i] = g->scores.top[i].score;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,172 @@
+/*
+SDLBlocks
+
+Description:
+The game simulation: input, game logic, rewind, AI and scores on a
+thread of its own, published to the renderer as snapshots.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef GAME_H
+#define GAME_H
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_mixer.h>
+
+#include "tetris.h"
+#include "rewind.h"
+#include "hiscore.h"
+#include "ai.h"
+#include "replay.h"
+#include "repeat.h"
+#include "sfx.h"
+
+/* simulation step (ms) */
+#define GAME_TICKS 4
+
+/* a simulation stalled for longer than this skips the missed steps
+ * instead of running them back to back (ms) */
+#define GAME_MAX_LAG 100
+
+/* key events queued for the simulation, must be a power of two */
+#define GAME_INPUT_SIZE 256
+
+/* time between AI actions (ms) */
+#define AI_MOVE_TICKS 40
+
+/* time the beam search may spend on a tetrad (ms), it runs next to
+ * the simulation */
+#define AI_BEAM_TICKS 20
+
+/* idle time on the start screen before the attract mode starts, and
+ * how long its game over stays on screen (ms) */
+#define ATTRACT_TICKS 20000
+#define ATTRACT_OVER_TICKS 3000
+
+/* AI progress on the active tetrad */
+#define BOT_PLAN 0
+#define BOT_MOVE 1
+#define BOT_DONE 2
+#define BOT_WAIT 3	/* the beam search is planning the move */
+
+/* everything the renderer needs, copied out after every step */
+
+struct GameSnapshot {
+
+	/* seq -- simulation step that produced this snapshot,
+	 * input -- position in the input queue up to which keys were handled */
+	Uint32 seq;
+	Uint32 input;
+
+	struct Tetris tetris;
+
+	int rewinding;
+	int attract;
+	int autoplay;
+
+	int scores_ok;
+	int num_top;
+	Uint32 top[HISCORE_TOP];
+};
+
+struct GameInput {
+	Uint32 time;
+	SDLKey key;
+	int down;
+};
+
+struct Game {
+
+	struct Tetris tetris;
+	Uint32 seq;
+
+	/* music -- played while a game runs if tetris.game_audio is set,
+	 * sfx -- sound effects, NULL without audio */
+	Mix_Music *music;
+	struct Sfx *sfx;
+
+	/* history -- practice mode rewind buffer, rewind_key -- rewind key held down */
+	struct Rewind history;
+	int practice;
+	int rewind_key;
+	Uint32 rewind_time;
+
+	/* scores -- high-score table and log, game_time -- when the game started */
+	struct Hiscore scores;
+	int scores_ok;
+	int game_recorded;
+	Uint32 game_time;
+
+	/* ai -- placement AI, autoplay -- AI plays the player's game,
+	 * attract -- AI plays a demo game, game_assisted -- AI moved in this game */
+	struct Ai ai;
+	struct AiBeam beam;
+	struct AiMove bot_move;
+	int ai_ok;
+	int use_beam;
+	int autoplay;
+	int attract;
+	int bot_state;
+	int game_assisted;
+	Uint32 bot_time;
+	Uint32 idle_time;
+
+	/* repeat -- auto repeat of the held movement keys */
+	struct Repeat repeat;
+
+	/* replay -- input recording of the game in progress */
+	struct Replay replay;
+	const char *record_path;
+
+	/* input -- key events from the event loop, a single producer single
+	 * consumer ring: only the event loop advances head, only the
+	 * simulation advances tail */
+	struct GameInput input[GAME_INPUT_SIZE];
+	Uint32 input_head __attribute__(( aligned(64) ));
+	Uint32 input_tail __attribute__(( aligned(64) ));
+
+	/*
+	 * snap -- triple buffer of snapshots. the simulation fills snap_back
+	 * and swaps it with snap_middle, the renderer swaps snap_front with
+	 * snap_middle when GAME_SNAP_FRESH is set in it. neither side ever
+	 * waits for the other.
+	 *
+	 */
+	struct GameSnapshot snap[3];
+	int snap_back;
+	int snap_front;
+	int snap_middle __attribute__(( aligned(64) ));
+
+	SDL_Thread *thread;
+	int quit;
+};
+
+#define GAME_SNAP_FRESH 4
+
+void game_initialize( struct Game *g, int practice, int autoplay, int use_beam, const char *record_path, Mix_Music *music, struct Sfx *sfx, Uint32 das, Uint32 arr );
+int  game_thread_start( struct Game *g );
+void game_thread_stop( struct Game *g );
+void game_free( struct Game *g );
+int  game_key( struct Game *g, SDLKey key, int down );
+int  game_snapshot( struct Game *g, struct GameSnapshot **snap );
+Uint32 game_latch( struct Game *g, struct GameSnapshot *snap, struct Tetris *view );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,242 @@
+/*
+SDLBlocks
+
+Description:
+blocksgym: serves a vector of games to a trainer process through
+shared memory.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "env.h"
+
+/* results of a benchmark run */
+struct GymTotals {
+	Uint64 steps;
+	Uint64 episodes;
+	Sint64 reward;
+	double seconds;
+};
+
+static void gym_play( struct EnvHeader *h, Uint8 *actions, int remote, Uint32 seed, Uint64 steps, struct GymTotals *r );
+static double gym_clock( void );
+
+/*
+ * blocksgym
+ *
+ * usage: blocksgym [-envs n] [-name shm] [-seed n] [-bench steps]
+ *
+ * serves -envs games (64 by default) in the shared memory region
+ * -name until the trainer sends ENV_CMD_CLOSE, see env.h.
+ *
+ * -bench plays random actions for the given number of steps, first
+ * calling env_step() in this process and then from a forked trainer
+ * through the server, and checks that both give the same results.
+ *
+ */
+
+int main( int argc, char *argv[] )
+{
+	struct EnvHeader *h;
+	struct GymTotals local, remote;
+	Uint64 bench;
+	Uint32 envs;
+	Uint32 seed;
+	char *name;
+	pid_t pid;
+	int status;
+	int i;
+
+	envs = 64;
+	seed = 1;
+	bench = 0;
+	name = ENV_SHM_NAME;
+
+	for( i=1; i<argc; i++ ) {
+		if( !strcmp( argv[i], "-envs" ) && ( i+1 < argc ) )
+			envs = strtoul( argv[++i], NULL, 0 );
+		else if( !strcmp( argv[i], "-name" ) && ( i+1 < argc ) )
+			name = argv[++i];
+		else if( !strcmp( argv[i], "-seed" ) && ( i+1 < argc ) )
+			seed = strtoul( argv[++i], NULL, 0 );
+		else if( !strcmp( argv[i], "-bench" ) && ( i+1 < argc ) )
+			bench = strtoull( argv[++i], NULL, 0 );
+		else {
+			fprintf( stderr, "usage: %s [-envs n] [-name shm] [-seed n] [-bench steps]\n", argv[0] );
+			exit( 1 );
+		}
+	}
+
+	if( envs < 1 || envs > ENV_MAX_ENVS ) {
+		fprintf( stderr, "Number of games must be between 1 and %d\n", ENV_MAX_ENVS );
+		exit( 1 );
+	}
+
+	h = env_create( name, envs );
+
+	if( h == NULL ) {
+		fprintf( stderr, "Unable to create shared memory %s: %s\n", name, strerror( errno ) );
+		exit( 1 );
+	}
+
+	if( bench == 0 ) {
+		printf( "serving %u games at %s (%u bytes, %u per game)\n", envs, name, h->region_size, h->slot_size );
+		fflush( stdout );
+
+		if( env_serve( h ) != 0 )
+			fprintf( stderr, "Unable to wait for the trainer: %s\n", strerror( errno ) );
+
+		env_destroy( h, name );
+		return 0;
+	}
+
+	/* in this process, on the shared region but without the server */
+	gym_play( h, ENV_ACTIONS( h ), 0, seed, bench, &local );
+
+	printf( "local:  %llu steps in %.3f s, %.2f M steps/s, %llu episodes, reward %lld\n",
+			(unsigned long long)local.steps, local.seconds, local.steps / local.seconds / 1.0e6,
+			(unsigned long long)local.episodes, (long long)local.reward );
+	fflush( stdout );
+
+	pid = fork();
+
+	if( pid < 0 ) {
+		fprintf( stderr, "Unable to start the trainer: %s\n", strerror( errno ) );
+		env_destroy( h, name );
+		exit( 1 );
+	}
+
+	if( pid == 0 ) {
+
+		/* the trainer maps the region on its own, like any other would */
+		h = env_attach( name );
+
+		if( h == NULL ) {
+			fprintf( stderr, "Unable to attach to %s: %s\n", name, strerror( errno ) );
+			_exit( 1 );
+		}
+
+		gym_play( h, ENV_ACTIONS( h ), 1, seed, bench, &remote );
+		env_call( h, ENV_CMD_CLOSE, 0 );
+
+		printf( "server: %llu steps in %.3f s, %.2f M steps/s, %llu episodes, reward %lld\n",
+				(unsigned long long)remote.steps, remote.seconds, remote.steps / remote.seconds / 1.0e6,
+				(unsigned long long)remote.episodes, (long long)remote.reward );
+
+		env_detach( h );
+
+		if( remote.steps != local.steps || remote.episodes != local.episodes || remote.reward != local.reward ) {
+			printf( "results differ\n" );
+			fflush( stdout );
+			_exit( 1 );
+		}
+
+		fflush( stdout );
+		_exit( 0 );
+	}
+
+	if( env_serve( h ) != 0 )
+		fprintf( stderr, "Unable to wait for the trainer: %s\n", strerror( errno ) );
+
+	env_destroy( h, name );
+
+	if( waitpid( pid, &status, 0 ) != pid || !WIFEXITED( status ) )
+		return 1;
+
+	return WEXITSTATUS( status );
+}
+
+/*
+ * gym_play
+ *
+ * reset with seed and step all the games with random actions until
+ * steps have been taken, through the server if remote is set. the
+ * rewards and episode ends are read from the slots after every step.
+ *
+ */
+static void gym_play( struct EnvHeader *h, Uint8 *actions, int remote, Uint32 seed, Uint64 steps, struct GymTotals *r )
+{
+	struct EnvSlot *s;
+	Uint32 x;
+	Uint32 i;
+	double start;
+
+	memset( r, 0, sizeof(struct GymTotals) );
+
+	/* xorshift gets stuck at zero */
+	x = seed ? seed : 0x9e3779b9;
+
+	start = gym_clock();
+
+	if( remote )
+		env_call( h, ENV_CMD_RESET, seed );
+	else
+		env_reset( h, seed );
+
+	while( r->steps < steps ) {
+
+		for( i=0; i<h->num_envs; i++ ) {
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			actions[i] = ( x >> 8 ) % ENV_NUM_ACTIONS;
+		}
+
+		if( remote )
+			env_call( h, ENV_CMD_STEP, 0 );
+		else
+			env_step( h, actions );
+
+		for( i=0; i<h->num_envs; i++ ) {
+			s = ENV_SLOT( h, i );
+			r->reward += s->reward;
+			r->episodes += s->done;
+		}
+
+		r->steps += h->num_envs;
+	}
+
+	r->seconds = gym_clock() - start;
+}
+
+/*
+ * gym_clock
+ *
+ * monotonic time in seconds
+ *
+ */
+static double gym_clock( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ( ts.tv_nsec / 1.0e9 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,504 @@
+/*
+SDLBlocks
+ 
+Description:
+High-score table and session statistics kept in an append-only log.
+ 
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "hiscore.h"
+
+static Uint32 hiscore_crc( const void *data, size_t len );
+static void hiscore_apply( struct Hiscore *h, const struct HiscoreRecord *r );
+static void hiscore_insert( struct Hiscore *h, const struct HiscoreEntry *e );
+static off_t hiscore_scan( struct Hiscore *h, off_t from, off_t size );
+static int hiscore_load_index( struct Hiscore *h, off_t size );
+static void hiscore_save_index( struct Hiscore *h );
+static void hiscore_queue( struct Hiscore *h, struct HiscoreRecord *r );
+static int hiscore_write( int fd, const void *data, size_t len );
+static int hiscore_writer( void *data );
+
+/*
+ * hiscore_open
+ *
+ * load the high-score table and totals from the index and whatever was
+ * appended to the log after it, drop a torn record left at the end of
+ * the log by a crash and start the writer thread
+ *
+ * returns 0 on success, -1 if the log can't be used
+ *
+ */
+int hiscore_open( struct Hiscore *h, const char *path )
+{
+	struct stat st;
+	off_t start;
+
+	memset( h, 0, sizeof(struct Hiscore) );
+	h->fd = -1;
+
+	if( strlen( path ) + strlen( HISCORE_INDEX_SUFFIX ) + 5 > sizeof(h->path) )
+		return -1;
+	strcpy( h->path, path );
+
+	h->fd = open( path, O_RDWR | O_CREAT | O_APPEND, 0644 );
+	if( h->fd < 0 ) {
+		fprintf( stderr, "Unable to open score file %s: %s\n", path, strerror( errno ) );
+		return -1;
+	}
+
+	if( fstat( h->fd, &st ) != 0 ) {
+		close( h->fd );
+		h->fd = -1;
+		return -1;
+	}
+
+	start = 0;
+	if( hiscore_load_index( h, st.st_size ) == 0 )
+		start = h->offset;
+
+	h->offset = hiscore_scan( h, start, st.st_size );
+
+	if( h->offset < st.st_size ) {
+		fprintf( stderr, "Dropping %ld damaged bytes at the end of %s\n",
+				(long)( st.st_size - h->offset ), path );
+		if( ftruncate( h->fd, h->offset ) != 0 ) {
+			close( h->fd );
+			h->fd = -1;
+			return -1;
+		}
+	}
+
+	h->session.magic = HISCORE_MAGIC;
+	h->session.type = HISCORE_SESSION;
+	h->session.time = (Uint32)time( NULL );
+
+	h->lock = SDL_CreateMutex();
+	h->wake = SDL_CreateCond();
+
+	if( h->lock != NULL && h->wake != NULL )
+		h->writer = SDL_CreateThread( hiscore_writer, h );
+
+	if( h->writer == NULL ) {
+		fprintf( stderr, "Unable to start the score writer: %s\n", SDL_GetError() );
+		if( h->wake != NULL )
+			SDL_DestroyCond( h->wake );
+		if( h->lock != NULL )
+			SDL_DestroyMutex( h->lock );
+		h->wake = NULL;
+		h->lock = NULL;
+		close( h->fd );
+		h->fd = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * hiscore_add_game
+ *
+ * enter a finished game into the table and hand its record to the
+ * writer thread, never waits on the disk
+ *
+ */
+void hiscore_add_game( struct Hiscore *h, struct Tetris *t, Uint32 play_time )
+{
+	struct HiscoreRecord r;
+
+	if( h->fd < 0 )
+		return;
+
+	r.magic = HISCORE_MAGIC;
+	r.type = HISCORE_GAME;
+	r.time = (Uint32)time( NULL );
+	r.a = t->game_score;
+	r.b = t->game_level;
+	r.c = t->game_total_num_lines_cleared;
+	r.d = t->game_num_pieces;
+	r.e = play_time;
+
+	hiscore_apply( h, &r );
+
+	if( r.a > h->session.a )
+		h->session.a = r.a;
+	h->session.b++;
+	h->session.c += r.c;
+	h->session.d += r.d;
+	h->session.e += r.e;
+
+	hiscore_queue( h, &r );
+}
+
+/*
+ * hiscore_close
+ *
+ * append the session record, wait for the writer to flush everything
+ * and rewrite the index
+ *
+ */
+void hiscore_close( struct Hiscore *h )
+{
+	int failed;
+
+	if( h->fd < 0 )
+		return;
+
+	if( h->session.b > 0 ) {
+		hiscore_apply( h, &h->session );
+		hiscore_queue( h, &h->session );
+	}
+
+	SDL_mutexP( h->lock );
+	h->quit = 1;
+	SDL_CondSignal( h->wake );
+	SDL_mutexV( h->lock );
+
+	SDL_WaitThread( h->writer, &failed );
+
+	/* the table in memory is ahead of the log if a write failed */
+	if( !failed )
+		hiscore_save_index( h );
+
+	close( h->fd );
+	h->fd = -1;
+
+	SDL_DestroyCond( h->wake );
+	SDL_DestroyMutex( h->lock );
+}
+
+/*
+ * hiscore_queue
+ *
+ */
+static void hiscore_queue( struct Hiscore *h, struct HiscoreRecord *r )
+{
+	r->crc = hiscore_crc( r, offsetof(struct HiscoreRecord, crc) );
+
+	SDL_mutexP( h->lock );
+
+	if( h->queue_len < HISCORE_QUEUE ) {
+		h->queue[h->queue_len++] = *r;
+		SDL_CondSignal( h->wake );
+	}
+	else {
+		fprintf( stderr, "Score log queue full, record dropped\n" );
+	}
+
+	SDL_mutexV( h->lock );
+}
+
+/*
+ * hiscore_writer
+ *
+ * writer thread: wait for records, give the game a moment to queue more
+ * so they share one write, then append the batch and sync it
+ *
+ * returns non-zero if any write failed
+ *
+ */
+static int hiscore_writer( void *data )
+{
+	struct Hiscore *h = data;
+	struct HiscoreRecord batch[HISCORE_QUEUE];
+	size_t len;
+	int failed;
+	int quit;
+	int n;
+
+	failed = 0;
+
+	SDL_mutexP( h->lock );
+
+	for( ;; ) {
+		while( !h->quit && h->queue_len == 0 )
+			SDL_CondWait( h->wake, h->lock );
+
+		if( !h->quit )
+			SDL_CondWaitTimeout( h->wake, h->lock, HISCORE_FLUSH_TICKS );
+
+		n = h->queue_len;
+		memcpy( batch, h->queue, n * sizeof(struct HiscoreRecord) );
+		h->queue_len = 0;
+		quit = h->quit;
+
+		SDL_mutexV( h->lock );
+
+		if( n > 0 ) {
+			len = n * sizeof(struct HiscoreRecord);
+			if( hiscore_write( h->fd, batch, len ) == 0 && fdatasync( h->fd ) == 0 ) {
+				h->offset += len;
+			}
+			else {
+				fprintf( stderr, "Unable to write score file %s: %s\n", h->path, strerror( errno ) );
+				failed = 1;
+			}
+		}
+
+		if( quit )
+			break;
+
+		SDL_mutexP( h->lock );
+	}
+
+	return failed;
+}
+
+/*
+ * hiscore_scan
+ *
+ * map the log and apply every valid record from offset from onwards,
+ * damaged records followed by good ones are skipped
+ *
+ * returns the offset just past the last valid record
+ *
+ */
+static off_t hiscore_scan( struct Hiscore *h, off_t from, off_t size )
+{
+	const struct HiscoreRecord *r;
+	Uint8 *map;
+	off_t base;
+	off_t end;
+	off_t pos;
+	size_t len;
+
+	if( from >= size )
+		return from;
+
+	/* mmap offsets must be page aligned */
+	base = from & ~( (off_t)sysconf( _SC_PAGESIZE ) - 1 );
+	len = size - base;
+
+	map = mmap( NULL, len, PROT_READ, MAP_PRIVATE, h->fd, base );
+	if( map == MAP_FAILED )
+		return from;
+
+	madvise( map, len, MADV_SEQUENTIAL );
+
+	end = from;
+
+	for( pos=from; pos+(off_t)sizeof(struct HiscoreRecord)<=size; pos+=sizeof(struct HiscoreRecord) ) {
+		r = (const struct HiscoreRecord *)( map + ( pos - base ) );
+		if( r->magic != HISCORE_MAGIC )
+			continue;
+		if( r->crc != hiscore_crc( r, offsetof(struct HiscoreRecord, crc) ) )
+			continue;
+
+		hiscore_apply( h, r );
+		end = pos + sizeof(struct HiscoreRecord);
+	}
+
+	munmap( map, len );
+
+	return end;
+}
+
+/*
+ * hiscore_apply
+ *
+ */
+static void hiscore_apply( struct Hiscore *h, const struct HiscoreRecord *r )
+{
+	struct HiscoreEntry e;
+
+	if( r->type == HISCORE_GAME ) {
+		e.score = r->a;
+		e.level = r->b;
+		e.lines = r->c;
+		e.time = r->time;
+		hiscore_insert( h, &e );
+
+		h->totals.games++;
+		h->totals.lines += r->c;
+		h->totals.pieces += r->d;
+		h->totals.play_time += r->e;
+	}
+	else if( r->type == HISCORE_SESSION ) {
+		h->totals.sessions++;
+	}
+}
+
+/*
+ * hiscore_insert
+ *
+ * insert into the table, sorted by score, earlier games first on ties
+ *
+ */
+static void hiscore_insert( struct Hiscore *h, const struct HiscoreEntry *e )
+{
+	int i;
+
+	if( h->num_top == HISCORE_TOP && e->score <= h->top[HISCORE_TOP-1].score )
+		return;
+
+	i = ( h->num_top < HISCORE_TOP ) ? h->num_top++ : HISCORE_TOP-1;
+
+	while( i > 0 && h->top[i-1].score < e->score ) {
+		h->top[i] = h->top[i-1];
+		i--;
+	}
+
+	h->top[i] = *e;
+}
+
+/*
+ * hiscore_load_index
+ *
+ * returns 0 if a valid index matching the log was loaded
+ *
+ */
+static int hiscore_load_index( struct Hiscore *h, off_t size )
+{
+	struct HiscoreIndex idx;
+	char path[sizeof(h->path)+8];
+	FILE *fp;
+	size_t n;
+
+	sprintf( path, "%s%s", h->path, HISCORE_INDEX_SUFFIX );
+
+	fp = fopen( path, "rb" );
+	if( fp == NULL )
+		return -1;
+
+	n = fread( &idx, sizeof(idx), 1, fp );
+	fclose( fp );
+
+	if( n != 1 || idx.magic != HISCORE_INDEX_MAGIC )
+		return -1;
+	if( idx.crc != hiscore_crc( &idx, offsetof(struct HiscoreIndex, crc) ) )
+		return -1;
+	if( idx.num_top > HISCORE_TOP || (off_t)idx.offset > size )
+		return -1;
+	if( idx.offset % sizeof(struct HiscoreRecord) )
+		return -1;
+
+	h->offset = idx.offset;
+	h->num_top = idx.num_top;
+	h->totals = idx.totals;
+	memcpy( h->top, idx.top, sizeof(h->top) );
+
+	return 0;
+}
+
+/*
+ * hiscore_save_index
+ *
+ * write the index next to the log and rename it into place
+ *
+ */
+static void hiscore_save_index( struct Hiscore *h )
+{
+	struct HiscoreIndex idx;
+	char path[sizeof(h->path)+8];
+	char tmp[sizeof(h->path)+16];
+	int fd;
+
+	memset( &idx, 0, sizeof(idx) );
+	idx.magic = HISCORE_INDEX_MAGIC;
+	idx.num_top = h->num_top;
+	idx.offset = h->offset;
+	idx.totals = h->totals;
+	memcpy( idx.top, h->top, sizeof(idx.top) );
+	idx.crc = hiscore_crc( &idx, offsetof(struct HiscoreIndex, crc) );
+
+	sprintf( path, "%s%s", h->path, HISCORE_INDEX_SUFFIX );
+	sprintf( tmp, "%s.tmp", path );
+
+	fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( fd < 0 )
+		return;
+
+	if( hiscore_write( fd, &idx, sizeof(idx) ) != 0 || fsync( fd ) != 0 ) {
+		close( fd );
+		unlink( tmp );
+		return;
+	}
+
+	close( fd );
+	rename( tmp, path );
+}
+
+/*
+ * hiscore_write
+ *
+ */
+static int hiscore_write( int fd, const void *data, size_t len )
+{
+	const Uint8 *p = data;
+	ssize_t n;
+
+	while( len > 0 ) {
+		n = write( fd, p, len );
+		if( n < 0 ) {
+			if( errno == EINTR )
+				continue;
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * hiscore_crc
+ *
+ * CRC-32 (IEEE 802.3)
+ *
+ */
+static Uint32 hiscore_crc( const void *data, size_t len )
+{
+	static Uint32 table[256];
+	static int ready = 0;
+	const Uint8 *p = data;
+	Uint32 crc;
+	int i, j;
+
+	if( !ready ) {
+		for( i=0; i<256; i++ ) {
+			crc = i;
+			for( j=0; j<8; j++ )
+				crc = ( crc & 1 ) ? ( crc >> 1 ) ^ 0xedb88320 : ( crc >> 1 );
+			table[i] = crc;
+		}
+		ready = 1;
+	}
+
+	crc = 0xffffffff;
+	while( len-- )
+		crc = table[ ( crc ^ *p++ ) & 0xff ] ^ ( crc >> 8 );
+
+	return crc ^ 0xffffffff;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
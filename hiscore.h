@@ -0,0 +1,130 @@
+/*
+SDLBlocks
+ 
+Description:
+High-score table and session statistics kept in an append-only log.
+ 
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+
+#ifndef HISCORE_H
+#define HISCORE_H
+
+#include <sys/types.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+
+#define HISCORE_FILE "sdlblocks.scores"
+#define HISCORE_INDEX_SUFFIX ".idx"
+
+#define HISCORE_MAGIC 0x47534253	/* "SBSG" */
+#define HISCORE_INDEX_MAGIC 0x58534253	/* "SBSX" */
+
+/* number of scores kept in the high-score table */
+#define HISCORE_TOP 10
+
+/* records waiting for the writer thread */
+#define HISCORE_QUEUE 64
+
+/* the writer flushes at least this often (ms) while records are queued */
+#define HISCORE_FLUSH_TICKS 1000
+
+/* record types */
+#define HISCORE_GAME    1
+#define HISCORE_SESSION 2
+
+/*
+ * log record, fixed size so that the log can be scanned in place
+ *
+ * HISCORE_GAME: a = score, b = level, c = lines, d = pieces, e = play time (ms)
+ * HISCORE_SESSION: a = best score, b = games, c = lines, d = pieces, e = play time (ms)
+ *
+ */
+
+struct HiscoreRecord {
+	Uint32 magic;
+	Uint32 type;
+	Uint32 time;
+	Uint32 a, b, c, d, e;
+	Uint32 crc;
+};
+
+struct HiscoreEntry {
+	Uint32 score;
+	Uint32 level;
+	Uint32 lines;
+	Uint32 time;
+};
+
+/* totals over every game in the log */
+
+struct HiscoreTotals {
+	Uint32 games;
+	Uint32 sessions;
+	Uint64 lines;
+	Uint64 pieces;
+	Uint64 play_time;
+};
+
+/*
+ * index file, rewritten on exit: the high-score table and totals as of
+ * some offset in the log, so only records appended after it are scanned
+ *
+ */
+
+struct HiscoreIndex {
+	Uint32 magic;
+	Uint32 num_top;
+	Uint64 offset;
+	struct HiscoreTotals totals;
+	struct HiscoreEntry top[HISCORE_TOP];
+	Uint32 crc;
+};
+
+struct Hiscore {
+	int fd;
+	char path[256];
+
+	/* offset -- end of the valid part of the log */
+	off_t offset;
+
+	int num_top;
+	struct HiscoreEntry top[HISCORE_TOP];
+	struct HiscoreTotals totals;
+
+	/* this session */
+	struct HiscoreRecord session;
+
+	/* queue -- records handed to the writer thread, guarded by lock */
+	struct HiscoreRecord queue[HISCORE_QUEUE];
+	int queue_len;
+	int quit;
+	SDL_mutex *lock;
+	SDL_cond *wake;
+	SDL_Thread *writer;
+};
+
+int  hiscore_open( struct Hiscore *h, const char *path );
+void hiscore_add_game( struct Hiscore *h, struct Tetris *t, Uint32 play_time );
+void hiscore_close( struct Hiscore *h );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
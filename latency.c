@@ -0,0 +1,190 @@
+/*
+SDLBlocks
+
+Description:
+Input to present latency histogram.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL/SDL.h>
+
+#include "latency.h"
+
+static Uint64 latency_clock( void );
+static double latency_percentile( struct Latency *l, double p );
+
+/*
+ * latency_reset
+ *
+ */
+void latency_reset( struct Latency *l )
+{
+	memset( l, 0, sizeof(struct Latency) );
+}
+
+/*
+ * latency_key
+ *
+ * a key press was received, input is where it went in the game input
+ * queue
+ *
+ */
+void latency_key( struct Latency *l, Uint32 input )
+{
+	struct LatencyKey *k;
+
+	if( l->head - l->tail >= LATENCY_PENDING )
+		return;
+
+	k = &l->pending[l->head & (LATENCY_PENDING-1)];
+	k->input = input;
+	k->time = latency_clock();
+	l->head++;
+}
+
+/*
+ * latency_present
+ *
+ * a frame was presented that shows the effect of every input before
+ * position shown in the game input queue
+ *
+ */
+void latency_present( struct Latency *l, Uint32 shown )
+{
+	struct LatencyKey *k;
+	Uint64 now, us;
+	int bucket;
+
+	now = latency_clock();
+
+	while( l->tail != l->head ) {
+		k = &l->pending[l->tail & (LATENCY_PENDING-1)];
+
+		if( (Sint32)( shown - k->input ) <= 0 )
+			break;
+
+		us = now - k->time;
+
+		bucket = us / LATENCY_BUCKET_US;
+		if( bucket >= LATENCY_BUCKETS )
+			bucket = LATENCY_BUCKETS - 1;
+
+		l->hist[bucket]++;
+		l->count++;
+		l->total_us += us;
+		if( us > l->max_us )
+			l->max_us = us;
+
+		l->tail++;
+	}
+}
+
+/*
+ * latency_report
+ *
+ * print the summary and the histogram
+ *
+ */
+void latency_report( struct Latency *l, FILE *fp )
+{
+	Uint32 most;
+	int bar;
+	int i;
+
+	if( l->count == 0 ) {
+		fprintf( fp, "input to present latency: no keys\n" );
+		return;
+	}
+
+	fprintf( fp, "input to present latency: %u keys, mean %.2f ms, p50 %.0f p90 %.0f p99 %.0f ms, max %.2f ms\n",
+			l->count, ( l->total_us / (double)l->count ) / 1000.0,
+			latency_percentile( l, 0.50 ), latency_percentile( l, 0.90 ),
+			latency_percentile( l, 0.99 ), l->max_us / 1000.0 );
+
+	most = 0;
+	for( i=0; i<LATENCY_BUCKETS; i++ ) {
+		if( l->hist[i] > most )
+			most = l->hist[i];
+	}
+
+	for( i=0; i<LATENCY_BUCKETS; i++ ) {
+		if( l->hist[i] == 0 )
+			continue;
+
+		bar = ( l->hist[i] * 50 + most - 1 ) / most;
+
+		if( i == LATENCY_BUCKETS - 1 )
+			fprintf( fp, "  >=%3d ms %6u ", i * LATENCY_BUCKET_US / 1000, l->hist[i] );
+		else
+			fprintf( fp, "  %5d ms %6u ", ( i + 1 ) * LATENCY_BUCKET_US / 1000, l->hist[i] );
+
+		while( bar-- > 0 )
+			fputc( '#', fp );
+		fputc( '\n', fp );
+	}
+}
+
+/*
+ * latency_percentile
+ *
+ * upper edge of the bucket holding the p quantile (ms)
+ *
+ */
+static double latency_percentile( struct Latency *l, double p )
+{
+	Uint32 want, sum;
+	int i;
+
+	want = (Uint32)( p * l->count );
+	if( want < 1 )
+		want = 1;
+
+	sum = 0;
+	for( i=0; i<LATENCY_BUCKETS; i++ ) {
+		sum += l->hist[i];
+		if( sum >= want )
+			break;
+	}
+
+	if( i >= LATENCY_BUCKETS - 1 )
+		return l->max_us / 1000.0;
+
+	return ( ( i + 1 ) * LATENCY_BUCKET_US ) / 1000.0;
+}
+
+/*
+ * latency_clock
+ *
+ * monotonic time in microseconds
+ *
+ */
+static Uint64 latency_clock( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ( (Uint64)ts.tv_sec * 1000000 ) + ( ts.tv_nsec / 1000 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
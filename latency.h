@@ -0,0 +1,63 @@
+/*
+SDLBlocks
+
+Description:
+Input to present latency histogram.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <SDL/SDL.h>
+
+/* histogram buckets of LATENCY_BUCKET_US, the last one collects
+ * everything slower */
+#define LATENCY_BUCKET_US 1000
+#define LATENCY_BUCKETS 100
+
+/* key presses waiting to be presented, must be a power of two */
+#define LATENCY_PENDING 256
+
+struct LatencyKey {
+	/* input -- position of the key in the game input queue */
+	Uint32 input;
+	Uint64 time;
+};
+
+struct Latency {
+	struct LatencyKey pending[LATENCY_PENDING];
+	Uint32 head;
+	Uint32 tail;
+
+	Uint32 count;
+	Uint64 total_us;
+	Uint64 max_us;
+	Uint32 hist[LATENCY_BUCKETS];
+};
+
+void latency_reset( struct Latency *l );
+void latency_key( struct Latency *l, Uint32 input );
+void latency_present( struct Latency *l, Uint32 shown );
+void latency_report( struct Latency *l, FILE *fp );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
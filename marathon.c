@@ -0,0 +1,777 @@
+/*
+SDLBlocks
+
+Description:
+Marathon mode: the game on a giant board stored in chunks, seen
+through a scrolling viewport.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+
+#include "tetris.h"
+#include "render.h"
+#include "marathon.h"
+
+static int  marathon_state_idle( struct Marathon *m, Uint32 now );
+static int  marathon_state_spawn( struct Marathon *m, Uint32 now );
+static int  marathon_state_fall( struct Marathon *m, Uint32 now );
+static int  marathon_state_drop( struct Marathon *m, Uint32 now );
+static int  marathon_state_lock( struct Marathon *m, Uint32 now );
+static int  marathon_state_clear( struct Marathon *m, Uint32 now );
+static int  marathon_state_pause( struct Marathon *m, Uint32 now );
+static void marathon_enter( struct Marathon *m, int state, Uint32 now );
+static Uint8 *marathon_row( struct Marathon *m, int row, int create, Uint16 **fill );
+static int  marathon_fits( struct Marathon *m, int pattern, int x, int y );
+static int  marathon_spawn( struct Marathon *m );
+static int  marathon_lock( struct Marathon *m, Uint32 now );
+static void marathon_clear_row( struct Marathon *m, int row );
+static Uint32 marathon_random( struct Marathon *m );
+
+/* state handlers, indexed by TETRIS_STATE_*, the rules of the ones in
+ * tetris.c on the chunked board */
+static int (* const marathon_state[TETRIS_NUM_STATES])( struct Marathon *m, Uint32 now ) = {
+	marathon_state_idle,	/* TETRIS_STATE_START */
+	marathon_state_spawn,
+	marathon_state_fall,
+	marathon_state_drop,
+	marathon_state_lock,
+	marathon_state_clear,
+	marathon_state_pause,
+	marathon_state_idle	/* TETRIS_STATE_OVER */
+};
+
+/*
+ * marathon_initialize
+ *
+ * set up an empty rows x cols board, the first tick spawns the first
+ * tetrad. only the chunk pointer table is allocated here, chunks are
+ * allocated as the stack grows into them.
+ *
+ * returns 0 on success, -1 if the size is out of range or out of memory
+ *
+ */
+int marathon_initialize( struct Marathon *m, int rows, int cols, Uint32 seed, Uint32 now )
+{
+	memset( m, 0, sizeof(struct Marathon) );
+
+	if( rows < TETRIS_HEIGHT || rows > MARATHON_MAX_ROWS ||
+			cols < MARATHON_MIN_COLS || cols > MARATHON_MAX_COLS )
+		return -1;
+
+	m->rows = rows;
+	m->cols = cols;
+	m->num_chunks = ( rows + MARATHON_CHUNK_ROWS - 1 ) / MARATHON_CHUNK_ROWS;
+	m->chunks = calloc( m->num_chunks, sizeof(struct MarathonChunk *) );
+
+	if( m->chunks == NULL )
+		return -1;
+
+	m->top = rows;
+
+	/* xorshift gets stuck at zero */
+	m->rng = seed ? seed : 0x9e3779b9;
+	m->next_tetrad = marathon_random( m ) % MAX_TETRAD;
+
+	m->drop_rate = 500;
+	m->lock_delay = TETRIS_LOCK_DELAY;
+	m->clear_delay = TETRIS_CLEAR_DELAY;
+	m->now = now;
+
+	marathon_enter( m, TETRIS_STATE_SPAWN, now );
+
+	return 0;
+}
+
+/*
+ * marathon_free
+ *
+ */
+void marathon_free( struct Marathon *m )
+{
+	int i;
+
+	if( m->chunks != NULL ) {
+		for( i=0; i<m->num_chunks; i++ )
+			free( m->chunks[i] );
+		free( m->chunks );
+	}
+
+	m->chunks = NULL;
+	m->num_chunks = 0;
+}
+
+/*
+ * marathon_cell
+ *
+ * returns 0 if the cell is empty, its tetrad + 1 otherwise
+ *
+ */
+int marathon_cell( struct Marathon *m, int row, int col )
+{
+	Uint8 *cells;
+	Uint16 *fill;
+
+	cells = marathon_row( m, row, 0, &fill );
+
+	if( cells == NULL )
+		return 0;
+
+	return cells[col];
+}
+
+/*
+ * marathon_move
+ *
+ * shift the active tetrad by dx,dy cells
+ *
+ * returns 1 if the active tetrad moved
+ *
+ */
+int marathon_move( struct Marathon *m, int dx, int dy )
+{
+	if( !TETRIS_ACTIVE( m ) || !marathon_fits( m, m->cur_pattern, m->x + dx, m->y + dy ) )
+		return 0;
+
+	m->x += dx;
+	m->y += dy;
+
+	return 1;
+}
+
+/*
+ * marathon_rotate
+ *
+ * returns 1 if the active tetrad rotated
+ *
+ */
+int marathon_rotate( struct Marathon *m )
+{
+	int pattern;
+
+	if( !TETRIS_ACTIVE( m ) )
+		return 0;
+
+	pattern = ( m->cur_pattern + 1 ) % tetrad[m->cur_tetrad].num_patterns;
+
+	if( pattern == m->cur_pattern || !marathon_fits( m, pattern, m->x, m->y ) )
+		return 0;
+
+	m->cur_pattern = pattern;
+
+	return 1;
+}
+
+/*
+ * marathon_drop
+ *
+ * drop the active tetrad, it falls one row per tick until it lands
+ *
+ */
+void marathon_drop( struct Marathon *m )
+{
+	if( TETRIS_ACTIVE( m ) )
+		m->state = TETRIS_STATE_DROP;
+}
+
+/*
+ * marathon_pause
+ *
+ * flip the pause switch of a game in progress, as tetris_pause
+ *
+ * returns 1 if the game is paused now
+ *
+ */
+int marathon_pause( struct Marathon *m )
+{
+	if( TETRIS_PLAYING( m ) || m->state == TETRIS_STATE_PAUSE )
+		m->game_pause = !m->game_pause;
+
+	return m->game_pause;
+}
+
+/*
+ * marathon_tick
+ *
+ * run the handler of the current state, as tetris_tick
+ *
+ * returns a mask of TETRIS_EVENT_* describing what happened
+ *
+ */
+int marathon_tick( struct Marathon *m, Uint32 now )
+{
+	m->now = now;
+
+	if( m->game_pause && TETRIS_PLAYING( m ) ) {
+		m->resume_state = m->state;
+		m->resume_time = m->state_time;
+		marathon_enter( m, TETRIS_STATE_PAUSE, now );
+		return 0;
+	}
+
+	return marathon_state[m->state]( m, now );
+}
+
+/*
+ * marathon_state_idle
+ *
+ */
+static int marathon_state_idle( struct Marathon *m, Uint32 now )
+{
+	return 0;
+}
+
+/*
+ * marathon_state_spawn
+ *
+ */
+static int marathon_state_spawn( struct Marathon *m, Uint32 now )
+{
+	if( !marathon_spawn( m ) ) {
+		marathon_enter( m, TETRIS_STATE_OVER, now );
+		return TETRIS_EVENT_OVER;
+	}
+
+	/* every tetrad gets a full drop interval before it first falls */
+	m->next_time = now;
+	marathon_enter( m, TETRIS_STATE_FALL, now );
+
+	return TETRIS_EVENT_SPAWN;
+}
+
+/*
+ * marathon_state_fall
+ *
+ * move the active tetrad down one row every drop_rate ms, the lock
+ * delay starts as soon as it lands
+ *
+ */
+static int marathon_state_fall( struct Marathon *m, Uint32 now )
+{
+	int events;
+
+	events = 0;
+
+	if( ( now - m->next_time ) >= m->drop_rate ) {
+		m->next_time = now;
+		if( marathon_move( m, 0, 1 ) )
+			events |= TETRIS_EVENT_MOVE;
+	}
+
+	if( !marathon_fits( m, m->cur_pattern, m->x, m->y + 1 ) )
+		marathon_enter( m, TETRIS_STATE_LOCK, now );
+
+	return events;
+}
+
+/*
+ * marathon_state_drop
+ *
+ * a dropped tetrad falls one row per tick and locks without a delay
+ *
+ */
+static int marathon_state_drop( struct Marathon *m, Uint32 now )
+{
+	if( marathon_move( m, 0, 1 ) )
+		return TETRIS_EVENT_MOVE;
+
+	return marathon_lock( m, now );
+}
+
+/*
+ * marathon_state_lock
+ *
+ * the tetrad locks when it still rests on the stack after lock_delay,
+ * moved off a ledge it falls again
+ *
+ */
+static int marathon_state_lock( struct Marathon *m, Uint32 now )
+{
+	if( marathon_fits( m, m->cur_pattern, m->x, m->y + 1 ) ) {
+		marathon_enter( m, TETRIS_STATE_FALL, now );
+		return 0;
+	}
+
+	if( ( now - m->state_time ) >= m->lock_delay )
+		return marathon_lock( m, now );
+
+	return 0;
+}
+
+/*
+ * marathon_state_clear
+ *
+ * remove the filled rows once they have flashed for clear_delay and
+ * update the score and level
+ *
+ */
+static int marathon_state_clear( struct Marathon *m, Uint32 now )
+{
+	Uint32 lines;
+	int events;
+	int i;
+
+	if( ( now - m->state_time ) < m->clear_delay )
+		return 0;
+
+	/* clearing a row moves only the rows above it, top to bottom keeps
+	 * the flagged rows below it where they are */
+	lines = 0;
+
+	for( i=0; ( m->clear_rows >> i ) != 0; i++ ) {
+		if( ( m->clear_rows >> i ) & 1 ) {
+			marathon_clear_row( m, m->clear_y + i );
+			lines++;
+		}
+	}
+
+	m->clear_rows = 0;
+	events = 0;
+
+	m->score += tetris_score( m->level, lines );
+	m->lines += lines;
+	m->level_lines += lines;
+
+	/* same levels as the normal game */
+	while( m->level_lines >= 10 ) {
+		if( m->level < 20 )
+			m->drop_rate -= 20;
+		m->level++;
+		m->level_lines -= 10;
+		events |= TETRIS_EVENT_LEVEL;
+	}
+
+	marathon_enter( m, TETRIS_STATE_SPAWN, now );
+
+	return events;
+}
+
+/*
+ * marathon_state_pause
+ *
+ * wait for the pause switch, then go back to the interrupted state
+ * with its timers moved on by the length of the pause
+ *
+ */
+static int marathon_state_pause( struct Marathon *m, Uint32 now )
+{
+	Uint32 paused;
+
+	if( m->game_pause )
+		return 0;
+
+	paused = now - m->state_time;
+
+	m->next_time += paused;
+	m->state = m->resume_state;
+	m->state_time = m->resume_time + paused;
+
+	return 0;
+}
+
+/*
+ * marathon_enter
+ *
+ */
+static void marathon_enter( struct Marathon *m, int state, Uint32 now )
+{
+	m->state = state;
+	m->state_time = now;
+}
+
+/*
+ * marathon_draw
+ *
+ * draw the part of the board inside the viewport, which follows the
+ * active tetrad. only the viewport rows are visited and chunks above
+ * the stack are skipped whole, so the cost of a frame does not depend
+ * on the size of the board.
+ *
+ */
+void marathon_draw( struct Marathon *m, SDL_Surface *frame, TTF_Font *font )
+{
+	struct MarathonChunk *chunk;
+	struct TetradMask *mask;
+	SDL_Rect rect;
+	Uint8 *cells;
+	Uint16 *fill;
+	char text[256];
+	int flash;
+	int vc, vr;
+	int ox, oy;
+	int row, end;
+	int i, j;
+
+	SDL_FillRect( frame, NULL, 0x000000 );
+
+	vc = ( m->cols < MARATHON_VIEW_COLS ) ? m->cols : MARATHON_VIEW_COLS;
+	vr = ( m->rows < MARATHON_VIEW_ROWS ) ? m->rows : MARATHON_VIEW_ROWS;
+
+	mask = &tetrad[m->cur_tetrad].mask[m->cur_pattern];
+
+	/* keep the active tetrad in the upper third of the viewport so the
+	 * stack it falls towards is in view */
+	m->cam_x = m->x + ( mask->w / 2 ) - ( vc / 2 );
+	m->cam_y = m->y - ( vr / 3 );
+
+	if( m->cam_x > m->cols - vc )
+		m->cam_x = m->cols - vc;
+	if( m->cam_x < 0 )
+		m->cam_x = 0;
+	if( m->cam_y > m->rows - vr )
+		m->cam_y = m->rows - vr;
+	if( m->cam_y < 0 )
+		m->cam_y = 0;
+
+	/* center a narrow board, stand a short one on the floor */
+	ox = 1 + ( ( MARATHON_VIEW_COLS - vc ) * MARATHON_CELL ) / 2;
+	oy = ( MARATHON_VIEW_ROWS - vr ) * MARATHON_CELL;
+
+	/* walls and floor, where they are in view */
+	if( m->cam_x == 0 )
+		vline( frame, ox - 1, oy, vr * MARATHON_CELL, 0xffffff );
+	if( m->cam_x + vc == m->cols )
+		vline( frame, ox + ( vc * MARATHON_CELL ), oy, vr * MARATHON_CELL, 0xffffff );
+	if( m->cam_y + vr == m->rows )
+		hline( frame, ox - 1, oy + ( vr * MARATHON_CELL ), ( vc * MARATHON_CELL ) + 2, 0xffffff );
+
+	rect.w = MARATHON_CELL - 1;
+	rect.h = MARATHON_CELL - 1;
+
+	/* filled rows flash until they are removed */
+	flash = ( m->state == TETRIS_STATE_CLEAR && ( ( m->now - m->state_time ) / RENDER_FLASH_TICKS ) % 2 == 0 );
+
+	for( row=m->cam_y; row<m->cam_y+vr; ) {
+
+		chunk = m->chunks[row / MARATHON_CHUNK_ROWS];
+		end = ( ( row / MARATHON_CHUNK_ROWS ) + 1 ) * MARATHON_CHUNK_ROWS;
+		if( end > m->cam_y + vr )
+			end = m->cam_y + vr;
+
+		if( chunk == NULL ) {
+			row = end;
+			continue;
+		}
+
+		for( ; row<end; row++ ) {
+			fill = &chunk->fill[row % MARATHON_CHUNK_ROWS];
+			if( *fill == 0 )
+				continue;
+
+			cells = chunk->cells + ( ( row % MARATHON_CHUNK_ROWS ) * m->cols );
+			rect.y = oy + ( ( row - m->cam_y ) * MARATHON_CELL );
+
+			if( flash && row >= m->clear_y && ( ( m->clear_rows >> ( row - m->clear_y ) ) & 1 ) ) {
+				rect.x = ox;
+				rect.w = ( vc * MARATHON_CELL ) - 1;
+				SDL_FillRect( frame, &rect, 0xffffff );
+				rect.w = MARATHON_CELL - 1;
+				continue;
+			}
+
+			for( j=0; j<vc; j++ ) {
+				if( cells[m->cam_x + j] ) {
+					rect.x = ox + ( j * MARATHON_CELL );
+					SDL_FillRect( frame, &rect, tetrad[cells[m->cam_x + j] - 1].color );
+				}
+			}
+		}
+	}
+
+	/* the active tetrad */
+	if( TETRIS_SHOWN( m ) ) {
+		for( i=0; i<mask->h; i++ ) {
+			for( j=0; j<mask->w; j++ ) {
+				if( mask->mask_arr[(i*mask->w)+j] && m->x + j >= m->cam_x && m->x + j < m->cam_x + vc &&
+						m->y + i >= m->cam_y && m->y + i < m->cam_y + vr ) {
+					rect.x = ox + ( ( m->x + j - m->cam_x ) * MARATHON_CELL );
+					rect.y = oy + ( ( m->y + i - m->cam_y ) * MARATHON_CELL );
+					SDL_FillRect( frame, &rect, tetrad[m->cur_tetrad].color );
+				}
+			}
+		}
+	}
+
+	/* depth gauge: the whole board, the viewport and the stack */
+	vline( frame, SCREEN_WIDTH - 8, 0, SCREEN_HEIGHT, 0x404040 );
+	rect.x = SCREEN_WIDTH - 10;
+	rect.w = 5;
+	rect.y = (Sint16)( ( (double)m->cam_y / m->rows ) * SCREEN_HEIGHT );
+	rect.h = (Uint16)( ( (double)vr / m->rows ) * SCREEN_HEIGHT ) + 1;
+	SDL_FillRect( frame, &rect, 0xffffff );
+	rect.x = SCREEN_WIDTH - 8;
+	rect.w = 1;
+	rect.y = (Sint16)( ( (double)m->top / m->rows ) * SCREEN_HEIGHT );
+	rect.h = SCREEN_HEIGHT - rect.y;
+	SDL_FillRect( frame, &rect, 0x00ff00 );
+
+	/* game text */
+	ox = ( MARATHON_VIEW_COLS * MARATHON_CELL ) + 12;
+
+	sprintf( &text[0], "Marathon" );
+	tetris_draw_text( font, frame, ox, 32, &text[0] );
+	sprintf( &text[0], "%dx%d", m->rows, m->cols );
+	tetris_draw_text( font, frame, ox, 56, &text[0] );
+	sprintf( &text[0], "level: %d", m->level );
+	tetris_draw_text( font, frame, ox, 96, &text[0] );
+	sprintf( &text[0], "lines: %d", m->lines );
+	tetris_draw_text( font, frame, ox, 128, &text[0] );
+	sprintf( &text[0], "score: %d", m->score );
+	tetris_draw_text( font, frame, ox, 160, &text[0] );
+	sprintf( &text[0], "stack: %d", m->rows - m->top );
+	tetris_draw_text( font, frame, ox, 192, &text[0] );
+
+	if( m->state == TETRIS_STATE_OVER ) {
+		sprintf( &text[0], "GAME OVER" );
+		tetris_draw_text( font, frame, ox, 240, &text[0] );
+	}
+	else if( m->state == TETRIS_STATE_PAUSE ) {
+		sprintf( &text[0], "PAUSE" );
+		tetris_draw_text( font, frame, ox, 240, &text[0] );
+	}
+	else {
+		tetrad_draw( frame, ox, 240, &tetrad[m->next_tetrad], 0 );
+	}
+}
+
+/*
+ * marathon_row
+ *
+ * find a row of the board, allocating its chunk if create is set
+ *
+ * returns the row's cells and sets fill to its block count, NULL if
+ * the row's chunk is empty and create isn't set or out of memory
+ *
+ */
+static Uint8 *marathon_row( struct Marathon *m, int row, int create, Uint16 **fill )
+{
+	struct MarathonChunk **chunk;
+
+	chunk = &m->chunks[row / MARATHON_CHUNK_ROWS];
+
+	if( *chunk == NULL ) {
+		if( !create )
+			return NULL;
+
+		*chunk = calloc( 1, sizeof(struct MarathonChunk) + ( MARATHON_CHUNK_ROWS * m->cols ) );
+		if( *chunk == NULL ) {
+			fprintf( stderr, "Unable to allocate a marathon board chunk\n" );
+			return NULL;
+		}
+	}
+
+	*fill = &(*chunk)->fill[row % MARATHON_CHUNK_ROWS];
+
+	return (*chunk)->cells + ( ( row % MARATHON_CHUNK_ROWS ) * m->cols );
+}
+
+/*
+ * marathon_fits
+ *
+ * returns 1 if the active tetrad in pattern can be at x,y
+ *
+ */
+static int marathon_fits( struct Marathon *m, int pattern, int x, int y )
+{
+	struct TetradMask *mask;
+	Uint8 *cells;
+	Uint16 *fill;
+	int i, j;
+
+	mask = &tetrad[m->cur_tetrad].mask[pattern];
+
+	if( x < 0 || y < 0 || x + mask->w > m->cols || y + mask->h > m->rows )
+		return 0;
+
+	/* nothing to hit above the stack */
+	if( y + mask->h <= m->top )
+		return 1;
+
+	for( i=0; i<mask->h; i++ ) {
+		cells = marathon_row( m, y + i, 0, &fill );
+		if( cells == NULL || *fill == 0 )
+			continue;
+		for( j=0; j<mask->w; j++ ) {
+			if( mask->mask_arr[(i*mask->w)+j] && cells[x + j] )
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * marathon_spawn
+ *
+ * make the next tetrad the active one, MARATHON_SPAWN_GAP rows above
+ * the stack
+ *
+ * returns 0 if there is no room for it, the game is over
+ *
+ */
+static int marathon_spawn( struct Marathon *m )
+{
+	struct TetradMask *mask;
+
+	m->cur_tetrad = m->next_tetrad;
+	m->cur_pattern = 0;
+	m->next_tetrad = marathon_random( m ) % MAX_TETRAD;
+
+	mask = &tetrad[m->cur_tetrad].mask[0];
+
+	m->x = ( m->cols - mask->w ) / 2;
+	m->y = m->top - MARATHON_SPAWN_GAP - mask->h;
+	if( m->y < 0 )
+		m->y = 0;
+
+	if( !marathon_fits( m, 0, m->x, m->y ) )
+		return 0;
+
+	return 1;
+}
+
+/*
+ * marathon_lock
+ *
+ * place the active tetrad on the board and flash the rows it filled,
+ * if any, before the next tetrad. only the rows it covers can have
+ * become full.
+ *
+ * returns a mask of TETRIS_EVENT_*
+ *
+ */
+static int marathon_lock( struct Marathon *m, Uint32 now )
+{
+	struct TetradMask *mask;
+	Uint8 *cells;
+	Uint16 *fill;
+	int i, j;
+
+	mask = &tetrad[m->cur_tetrad].mask[m->cur_pattern];
+
+	for( i=0; i<mask->h; i++ ) {
+		cells = marathon_row( m, m->y + i, 1, &fill );
+		if( cells == NULL ) {
+			marathon_enter( m, TETRIS_STATE_OVER, now );
+			return TETRIS_EVENT_LOCK | TETRIS_EVENT_OVER;
+		}
+		for( j=0; j<mask->w; j++ ) {
+			if( mask->mask_arr[(i*mask->w)+j] ) {
+				cells[m->x + j] = m->cur_tetrad + 1;
+				(*fill)++;
+			}
+		}
+	}
+
+	if( m->y < m->top )
+		m->top = m->y;
+
+	m->pieces++;
+
+	m->clear_y = m->y;
+	m->clear_rows = 0;
+	m->last_lines = 0;
+
+	for( i=0; i<mask->h; i++ ) {
+		cells = marathon_row( m, m->y + i, 0, &fill );
+		if( cells != NULL && *fill == m->cols ) {
+			m->clear_rows |= 1 << i;
+			m->last_lines++;
+		}
+	}
+
+	if( m->clear_rows ) {
+		marathon_enter( m, TETRIS_STATE_CLEAR, now );
+		return TETRIS_EVENT_LOCK | TETRIS_EVENT_CLEAR;
+	}
+
+	marathon_enter( m, TETRIS_STATE_SPAWN, now );
+
+	return TETRIS_EVENT_LOCK;
+}
+
+/*
+ * marathon_clear_row
+ *
+ * remove a full row and move the stack above it down one row, chunks
+ * left above the stack are freed
+ *
+ */
+static void marathon_clear_row( struct Marathon *m, int row )
+{
+	Uint8 *src, *dst;
+	Uint16 *src_fill, *dst_fill;
+	int i;
+
+	for( i=row; i>m->top; i-- ) {
+		src = marathon_row( m, i - 1, 0, &src_fill );
+		dst = marathon_row( m, i, src != NULL, &dst_fill );
+
+		if( dst == NULL )
+			continue;
+
+		if( src != NULL ) {
+			memcpy( dst, src, m->cols );
+			*dst_fill = *src_fill;
+		}
+		else {
+			memset( dst, 0, m->cols );
+			*dst_fill = 0;
+		}
+	}
+
+	dst = marathon_row( m, m->top, 0, &dst_fill );
+	if( dst != NULL ) {
+		memset( dst, 0, m->cols );
+		*dst_fill = 0;
+	}
+
+	m->top++;
+
+	if( m->top == m->rows || ( m->top % MARATHON_CHUNK_ROWS ) == 0 ) {
+		i = ( m->top - 1 ) / MARATHON_CHUNK_ROWS;
+		free( m->chunks[i] );
+		m->chunks[i] = NULL;
+	}
+}
+
+/*
+ * marathon_random
+ *
+ * xorshift32, as tetris_random
+ *
+ */
+static Uint32 marathon_random( struct Marathon *m )
+{
+	Uint32 x = m->rng;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	m->rng = x;
+
+	return x;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,123 @@
+/*
+SDLBlocks
+
+Description:
+Marathon mode: the game on a giant board stored in chunks, seen
+through a scrolling viewport.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef MARATHON_H
+#define MARATHON_H
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+
+#include "tetris.h"
+
+/* the board is stored in chunks of MARATHON_CHUNK_ROWS rows, only
+ * chunks that hold blocks are allocated */
+#define MARATHON_CHUNK_ROWS 64
+
+#define MARATHON_MIN_COLS 4
+#define MARATHON_MAX_COLS 1024
+#define MARATHON_MAX_ROWS 1000000
+
+/* new tetrads appear this many rows above the top of the stack */
+#define MARATHON_SPAWN_GAP 16
+
+/* cell size and viewport (cells), the HUD goes to the right of it */
+#define MARATHON_CELL 12
+#define MARATHON_VIEW_COLS 26
+#define MARATHON_VIEW_ROWS 40
+
+struct MarathonChunk {
+	/* fill -- blocks in each row, cells -- 0 if empty, tetrad + 1 */
+	Uint16 fill[MARATHON_CHUNK_ROWS];
+	Uint8 cells[1];
+};
+
+/* marathon games run the same states and delays as tetris_tick(),
+ * TETRIS_STATE_*, so the TETRIS_ACTIVE/PLAYING/SHOWN tests apply */
+struct Marathon {
+
+	/* state -- TETRIS_STATE_*, state_time -- game time it was entered */
+	int state;
+	Uint32 state_time;
+
+	int rows;
+	int cols;
+
+	/* chunks -- rows / MARATHON_CHUNK_ROWS chunk pointers, NULL above
+	 * the stack, top -- highest row holding a block, rows if none */
+	int num_chunks;
+	struct MarathonChunk **chunks;
+	int top;
+
+	/* the active tetrad, x,y -- its upper-left cell */
+	int cur_tetrad;
+	int cur_pattern;
+	int x;
+	int y;
+	int next_tetrad;
+	Uint32 rng;
+
+	Uint32 score;
+	Uint32 level;
+	Uint32 lines;
+	Uint32 level_lines;
+	Uint32 pieces;
+	Uint32 last_lines;
+
+	/* now -- time of the last tick, next_time -- time of the last fall,
+	 * drop_rate -- ms per row */
+	Uint32 now, next_time;
+	Uint32 drop_rate;
+
+	/* lock_delay, clear_delay -- how long the LOCK and CLEAR states
+	 * last (ms), clear_rows -- a bit per row from clear_y being cleared */
+	Uint32 lock_delay;
+	Uint32 clear_delay;
+	Uint32 clear_rows;
+	int clear_y;
+
+	/* game_pause -- pause switch, the next tick stops or resumes the
+	 * game, resume_* -- the state the pause interrupted */
+	int game_pause;
+	int resume_state;
+	Uint32 resume_time;
+
+	/* cam_x, cam_y -- upper-left cell of the viewport */
+	int cam_x;
+	int cam_y;
+};
+
+int  marathon_initialize( struct Marathon *m, int rows, int cols, Uint32 seed, Uint32 now );
+void marathon_free( struct Marathon *m );
+int  marathon_cell( struct Marathon *m, int row, int col );
+int  marathon_move( struct Marathon *m, int dx, int dy );
+int  marathon_rotate( struct Marathon *m );
+void marathon_drop( struct Marathon *m );
+int  marathon_pause( struct Marathon *m );
+int  marathon_tick( struct Marathon *m, Uint32 now );
+void marathon_draw( struct Marathon *m, SDL_Surface *frame, TTF_Font *font );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
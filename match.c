@@ -0,0 +1,213 @@
+/*
+SDLBlocks
+
+Description:
+Headless versus matches between AI players.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "ai.h"
+#include "versus.h"
+
+static double match_clock( void );
+
+/*
+ * blocksmatch
+ *
+ * usage: blocksmatch [-players n] [-games n] [-seed n] [-depth d1,d2,..]
+ *                    [-seconds n]
+ *
+ * plays versus matches between AI players, each board on a thread of
+ * its own as in sdlblocks -versus but on game time rather than the
+ * clock. match i uses seed+i and plays out the same on every run.
+ * -depth gives each player its search depth, the last one given
+ * applies to the rest. a match still going after -seconds of game
+ * time is a draw.
+ *
+ */
+
+int main( int argc, char *argv[] )
+{
+	static struct Versus v;
+	static struct Ai ai[VERSUS_MAX_PLAYERS];
+	struct Ai *players[VERSUS_MAX_PLAYERS];
+	struct VersusBoard *b;
+	int depth[VERSUS_MAX_PLAYERS];
+	Uint32 won[VERSUS_MAX_PLAYERS];
+	Uint64 sent[VERSUS_MAX_PLAYERS];
+	Uint64 lines[VERSUS_MAX_PLAYERS];
+	Uint32 games, seed, seconds, draws;
+	Uint64 game_time;
+	double start, elapsed;
+	int num_players;
+	int winner;
+	char *p;
+	int i, n;
+	Uint32 g;
+
+	num_players = 2;
+	games = 10;
+	seed = 1;
+	seconds = 600;
+
+	n = 0;
+	depth[0] = AI_DEPTH;
+
+	for( i=1; i<argc; i++ ) {
+		if( !strcmp( argv[i], "-players" ) && ( i+1 < argc ) )
+			num_players = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-games" ) && ( i+1 < argc ) )
+			games = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-seed" ) && ( i+1 < argc ) )
+			seed = strtoul( argv[++i], NULL, 0 );
+		else if( !strcmp( argv[i], "-seconds" ) && ( i+1 < argc ) )
+			seconds = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-depth" ) && ( i+1 < argc ) ) {
+			p = argv[++i];
+			for( n=0; n<VERSUS_MAX_PLAYERS && *p; n++ ) {
+				depth[n] = strtol( p, &p, 10 );
+				if( *p == ',' )
+					p++;
+			}
+		}
+		else {
+			fprintf( stderr, "usage: %s [-players 2..%d] [-games n] [-seed n] [-depth d1,d2,..]\n"
+					"       [-seconds n]\n", argv[0], VERSUS_MAX_PLAYERS );
+			exit( 1 );
+		}
+	}
+
+	if( num_players < 2 || num_players > VERSUS_MAX_PLAYERS ) {
+		fprintf( stderr, "Players must be between 2 and %d\n", VERSUS_MAX_PLAYERS );
+		exit( 1 );
+	}
+
+	if( n == 0 )
+		n = 1;
+
+	for( i=n; i<num_players; i++ )
+		depth[i] = depth[n-1];
+
+	for( i=0; i<num_players; i++ ) {
+		if( depth[i] < 1 || depth[i] > AI_MAX_DEPTH ) {
+			fprintf( stderr, "Depth must be between 1 and %d\n", AI_MAX_DEPTH );
+			exit( 1 );
+		}
+
+		if( ai_initialize( &ai[i] ) != 0 ) {
+			fprintf( stderr, "Unable to allocate the transposition table\n" );
+			exit( 1 );
+		}
+
+		ai[i].depth = depth[i];
+		players[i] = &ai[i];
+
+		won[i] = 0;
+		sent[i] = 0;
+		lines[i] = 0;
+	}
+
+	draws = 0;
+	game_time = 0;
+	start = match_clock();
+
+	for( g=0; g<games; g++ ) {
+
+		versus_initialize( &v, num_players, seed + g, players, 1, seconds * 1000 );
+
+		if( versus_start( &v ) != 0 ) {
+			fprintf( stderr, "Unable to start the board threads\n" );
+			exit( 1 );
+		}
+
+		while( !versus_over( &v ) )
+			SDL_Delay( 1 );
+
+		versus_stop( &v );
+
+		winner = -1;
+		printf( "match %u seed %u:", g, seed + g );
+
+		for( i=0; i<num_players; i++ ) {
+			b = &v.board[i];
+
+			if( b->result == VERSUS_WON )
+				winner = i;
+
+			printf( " [%d] lines %u sent %u received %u%s", i,
+					b->tetris.game_total_num_lines_cleared, b->sent, b->received,
+					b->topped_out ? "" : " *" );
+
+			sent[i] += b->sent;
+			lines[i] += b->tetris.game_total_num_lines_cleared;
+		}
+
+		if( winner < 0 ) {
+			printf( ", draw at %.1f s\n", v.board[0].end_time / 1000.0 );
+			draws++;
+		}
+		else {
+			printf( ", player %d wins at %.1f s\n", winner, v.board[winner].end_time / 1000.0 );
+			won[winner]++;
+		}
+
+		game_time += v.board[winner < 0 ? 0 : winner].end_time;
+	}
+
+	elapsed = match_clock() - start;
+
+	if( games > 0 ) {
+		for( i=0; i<num_players; i++ ) {
+			printf( "player %d (depth %d): %u wins, %.1f lines %.1f rows sent per match\n", i, depth[i],
+					won[i], (double)lines[i] / games, (double)sent[i] / games );
+		}
+
+		printf( "%u draws, %.1f s of game time per match, %.1fx real time\n", draws,
+				game_time / 1000.0 / games, elapsed > 0 ? game_time / 1000.0 / elapsed : 0.0 );
+	}
+
+	for( i=0; i<num_players; i++ )
+		ai_free( &ai[i] );
+
+	return 0;
+}
+
+/*
+ * match_clock
+ *
+ * monotonic time in seconds
+ *
+ */
+static double match_clock( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ( ts.tv_nsec / 1.0e9 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,641 @@
+/*
+SDLBlocks
+
+Description:
+Reachable placement enumeration ("perft") and move generation benchmark.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+
+#define PERFT_MAX_DEPTH 16
+
+#define PERFT_FULL_ROW ( (1<<TETRIS_WIDTH) - 1 )
+
+/* board column the tetrads spawn in */
+#define PERFT_SPAWN_COL ( ( (START_X) / TETRAD_WIDTH ) - 1 )
+
+/* how a lock position can be reached */
+#define PERFT_DROP 0	/* rotate and shift at the spawn row, then drop */
+#define PERFT_TUCK 1	/* also shift below the spawn row */
+#define PERFT_SPIN 2	/* also rotate below the spawn row */
+
+/* one row per bit, bit 0 is the leftmost column */
+
+struct PerftBoard {
+	Uint16 rows[TETRIS_HEIGHT];
+};
+
+/* lock positions: bit col of lock[pattern][row] */
+
+struct PerftLocks {
+	Uint16 lock[4][TETRIS_HEIGHT];
+	int count;
+};
+
+struct PerftPiece {
+	int w, h;
+	Uint16 rows[4];
+};
+
+static struct PerftPiece perft_piece[MAX_TETRAD][4];
+
+static struct Tetris reference;
+
+static void   perft_fast( const struct PerftBoard *b, int t, int mode, struct PerftLocks *out );
+static void   perft_reference( const struct PerftBoard *b, int t, struct PerftLocks *out );
+static Uint64 perft_count( const struct PerftBoard *b, const int *pieces, int depth, int ref );
+static Uint64 perft_check( const struct PerftBoard *b, const int *pieces, int depth );
+static int    perft_place( struct PerftBoard *dst, const struct PerftBoard *src, int t, int pattern, int col, int row );
+static void   perft_list( const struct PerftBoard *b, int t );
+static int    perft_load( struct PerftBoard *b, const char *path );
+static double perft_clock( void );
+
+/*
+ * perft
+ *
+ * usage: perft [-board file] [-seed n | -pieces digits] [-depth n]
+ *              [-list] [-check] [-ref]
+ *
+ * counts the lock positions reachable with the game's movement rules
+ * for every sequence of depth tetrads, the way chess engines count
+ * move sequences. the tetrads come from the game's random number
+ * generator (-seed) or are given as tetrad numbers (-pieces 2506).
+ *
+ * -board reads the starting board: up to 20 lines of 10 characters,
+ * '.' is an empty cell, the last line is the bottom row
+ * -list prints every lock position of the first tetrad and whether it
+ * is a plain drop, a tuck or a spin
+ * -check runs the reference generator next to the fast one and stops
+ * at the first board where they disagree
+ * -ref also times the reference generator
+ *
+ */
+
+int main( int argc, char *argv[] )
+{
+	struct PerftBoard board;
+	struct PerftLocks drop, tuck, all;
+	struct TetradMask *m;
+	int pieces[PERFT_MAX_DEPTH];
+	const char *path;
+	const char *sequence;
+	Uint32 seed;
+	Uint64 n;
+	double start, elapsed;
+	int depth;
+	int list, check, ref;
+	int i, j, k, p, d;
+
+	path = NULL;
+	sequence = NULL;
+	seed = 1;
+	depth = 3;
+	list = 0;
+	check = 0;
+	ref = 0;
+
+	for( i=1; i<argc; i++ ) {
+		if( !strcmp( argv[i], "-board" ) && ( i+1 < argc ) )
+			path = argv[++i];
+		else if( !strcmp( argv[i], "-seed" ) && ( i+1 < argc ) )
+			seed = strtoul( argv[++i], NULL, 0 );
+		else if( !strcmp( argv[i], "-pieces" ) && ( i+1 < argc ) )
+			sequence = argv[++i];
+		else if( !strcmp( argv[i], "-depth" ) && ( i+1 < argc ) )
+			depth = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-list" ) )
+			list = 1;
+		else if( !strcmp( argv[i], "-check" ) )
+			check = 1;
+		else if( !strcmp( argv[i], "-ref" ) )
+			ref = 1;
+		else {
+			fprintf( stderr, "usage: %s [-board file] [-seed n | -pieces digits] [-depth n] [-list] [-check] [-ref]\n", argv[0] );
+			exit( 1 );
+		}
+	}
+
+	if( depth < 1 || depth > PERFT_MAX_DEPTH ) {
+		fprintf( stderr, "Depth must be between 1 and %d\n", PERFT_MAX_DEPTH );
+		exit( 1 );
+	}
+
+	/* tetrad patterns as row masks */
+	for( i=0; i<MAX_TETRAD; i++ ) {
+		for( p=0; p<tetrad[i].num_patterns; p++ ) {
+			m = &tetrad[i].mask[p];
+			perft_piece[i][p].w = m->w;
+			perft_piece[i][p].h = m->h;
+			for( j=0; j<m->h; j++ ) {
+				perft_piece[i][p].rows[j] = 0;
+				for( k=0; k<m->w; k++ ) {
+					if( m->mask_arr[(j*m->w)+k] )
+						perft_piece[i][p].rows[j] |= 1 << k;
+				}
+			}
+		}
+	}
+
+	/* the sequence of tetrads */
+	tetris_initialize( &reference );
+
+	if( sequence != NULL ) {
+		if( (int)strlen( sequence ) < depth ) {
+			fprintf( stderr, "Need %d tetrads, got %s\n", depth, sequence );
+			exit( 1 );
+		}
+		for( i=0; i<depth; i++ ) {
+			pieces[i] = sequence[i] - '0';
+			if( pieces[i] < 0 || pieces[i] >= MAX_TETRAD ) {
+				fprintf( stderr, "Tetrads are numbered 0 to %d\n", MAX_TETRAD-1 );
+				exit( 1 );
+			}
+		}
+	}
+	else {
+		tetris_seed( &reference, seed );
+		for( i=0; i<depth; i++ ) {
+			tetris_next_tetrad( &reference );
+			pieces[i] = reference.cur_tetrad;
+		}
+	}
+
+	memset( &board, 0, sizeof(board) );
+	if( path != NULL && perft_load( &board, path ) != 0 )
+		exit( 1 );
+
+	printf( "tetrads" );
+	for( i=0; i<depth; i++ )
+		printf( " %d", pieces[i] );
+	printf( "\n" );
+
+	perft_fast( &board, pieces[0], PERFT_DROP, &drop );
+	perft_fast( &board, pieces[0], PERFT_TUCK, &tuck );
+	perft_fast( &board, pieces[0], PERFT_SPIN, &all );
+
+	printf( "lock positions: %d (%d drop, %d tuck, %d spin)\n", all.count,
+			drop.count, tuck.count - drop.count, all.count - tuck.count );
+
+	if( list )
+		perft_list( &board, pieces[0] );
+
+	for( d=1; d<=depth; d++ ) {
+		start = perft_clock();
+		n = perft_count( &board, pieces, d, 0 );
+		elapsed = perft_clock() - start;
+
+		printf( "depth %2d: %12llu placements  %.3f s  %.0f placements/s", d,
+				(unsigned long long)n, elapsed, elapsed > 0 ? n / elapsed : 0.0 );
+
+		if( ref ) {
+			start = perft_clock();
+			n = perft_count( &board, pieces, d, 1 );
+			elapsed = perft_clock() - start;
+			printf( "  reference %.0f placements/s", elapsed > 0 ? n / elapsed : 0.0 );
+		}
+
+		printf( "\n" );
+	}
+
+	if( check ) {
+		n = perft_check( &board, pieces, depth );
+		printf( "check: %llu boards, fast and reference generators agree\n", (unsigned long long)n );
+	}
+
+	return 0;
+}
+
+/*
+ * perft_fast
+ *
+ * find the lock positions of tetrad t with a bit per column: a row at a
+ * time from the top, every pattern's reachable columns are grown left
+ * and right and across rotations until nothing changes, then carried
+ * one row down. tetrads never move up, so one pass is enough.
+ *
+ * mode limits the moves made below the spawn row, see PERFT_*
+ *
+ */
+static void perft_fast( const struct PerftBoard *b, int t, int mode, struct PerftLocks *out )
+{
+	Uint16 fit[4][TETRIS_HEIGHT+1];
+	Uint16 reach[4][TETRIS_HEIGHT];
+	struct PerftPiece *p;
+	Uint16 r, grown;
+	int patterns;
+	int changed;
+	int row, col;
+	int i, q, k;
+
+	patterns = tetrad[t].num_patterns;
+
+	/* columns each pattern fits in, row by row */
+	for( i=0; i<patterns; i++ ) {
+		p = &perft_piece[t][i];
+
+		for( row=0; row<=TETRIS_HEIGHT; row++ ) {
+			fit[i][row] = 0;
+			if( row + p->h > TETRIS_HEIGHT )
+				continue;
+
+			for( col=0; col+p->w<=TETRIS_WIDTH; col++ ) {
+				for( k=0; k<p->h; k++ ) {
+					if( b->rows[row+k] & ( p->rows[k] << col ) )
+						break;
+				}
+				if( k == p->h )
+					fit[i][row] |= 1 << col;
+			}
+		}
+	}
+
+	memset( reach, 0, sizeof(reach) );
+	memset( out, 0, sizeof(struct PerftLocks) );
+
+	reach[0][0] = fit[0][0] & ( 1 << PERFT_SPAWN_COL );
+
+	for( row=0; row<TETRIS_HEIGHT; row++ ) {
+
+		do {
+			changed = 0;
+
+			for( i=0; i<patterns; i++ ) {
+				r = reach[i][row];
+				if( r == 0 )
+					continue;
+
+				if( row == 0 || mode != PERFT_DROP ) {
+					do {
+						grown = r;
+						r |= ( ( r << 1 ) | ( r >> 1 ) ) & fit[i][row];
+					} while( r != grown );
+					reach[i][row] = r;
+				}
+
+				if( row == 0 || mode == PERFT_SPIN ) {
+					q = ( i + 1 ) % patterns;
+					r &= fit[q][row];
+					if( r & ~reach[q][row] ) {
+						reach[q][row] |= r;
+						changed = 1;
+					}
+				}
+			}
+		} while( changed );
+
+		for( i=0; i<patterns; i++ ) {
+			r = reach[i][row] & ~fit[i][row+1];
+			out->lock[i][row] = r;
+			out->count += __builtin_popcount( r );
+
+			if( row+1 < TETRIS_HEIGHT )
+				reach[i][row+1] = reach[i][row] & fit[i][row+1];
+		}
+	}
+}
+
+/*
+ * perft_reference
+ *
+ * find the lock positions of tetrad t with a breadth-first search that
+ * moves the tetrad with the same functions the key handlers call
+ *
+ */
+static void perft_reference( const struct PerftBoard *b, int t, struct PerftLocks *out )
+{
+	Uint8 seen[4][TETRIS_HEIGHT][TETRIS_WIDTH];
+	Uint8 queue[4*TETRIS_HEIGHT*TETRIS_WIDTH][3];
+	struct Tetris *g = &reference;
+	int head, tail;
+	int pattern, col, row;
+	int move;
+	int i, j;
+
+	for( i=0; i<TETRIS_HEIGHT; i++ ) {
+		for( j=0; j<TETRIS_WIDTH; j++ )
+			g->board[i][j] = ( b->rows[i] >> j ) & 1 ? tetrad[0].color : 0;
+	}
+
+	g->state = TETRIS_STATE_FALL;
+	g->cur_tetrad = t;
+	g->t = &tetrad[t];
+
+	memset( seen, 0, sizeof(seen) );
+	memset( out, 0, sizeof(struct PerftLocks) );
+
+	if( !tetrad_move( &(g->board[0][0]), g->t, 0, START_X, 0 ) )
+		return;
+
+	head = 0;
+	tail = 0;
+	queue[tail][0] = 0;
+	queue[tail][1] = PERFT_SPAWN_COL;
+	queue[tail][2] = 0;
+	tail++;
+	seen[0][0][PERFT_SPAWN_COL] = 1;
+
+	while( head < tail ) {
+		pattern = queue[head][0];
+		col = queue[head][1];
+		row = queue[head][2];
+		head++;
+
+		for( move=0; move<4; move++ ) {
+			g->cur_pattern = pattern;
+			g->tx = ( col + 1 ) * TETRAD_WIDTH;
+			g->ty = row * TETRAD_HEIGHT;
+			g->max_x = TETRIS_MAX_X - ( g->t->mask[pattern].w * TETRAD_WIDTH );
+			g->max_y = TETRIS_MAX_Y - ( g->t->mask[pattern].h * TETRAD_HEIGHT );
+
+			switch( move ) {
+				case 0:
+					/* where the tetrad can't move down it locks */
+					if( !tetris_move_down( g ) ) {
+						out->lock[pattern][row] |= 1 << col;
+						out->count++;
+						continue;
+					}
+					break;
+				case 1:
+					if( !tetris_move_left( g ) )
+						continue;
+					break;
+				case 2:
+					if( !tetris_move_right( g ) )
+						continue;
+					break;
+				case 3:
+					if( !tetris_rotate( g ) )
+						continue;
+					break;
+			}
+
+			i = ( g->tx / TETRAD_WIDTH ) - 1;
+			j = g->ty / TETRAD_HEIGHT;
+
+			if( !seen[g->cur_pattern][j][i] ) {
+				seen[g->cur_pattern][j][i] = 1;
+				queue[tail][0] = g->cur_pattern;
+				queue[tail][1] = i;
+				queue[tail][2] = j;
+				tail++;
+			}
+		}
+	}
+}
+
+/*
+ * perft_count
+ *
+ * number of placement sequences of the first depth tetrads
+ *
+ */
+static Uint64 perft_count( const struct PerftBoard *b, const int *pieces, int depth, int ref )
+{
+	struct PerftLocks locks;
+	struct PerftBoard next;
+	Uint16 r;
+	Uint64 n;
+	int pattern, row, col;
+
+	if( ref )
+		perft_reference( b, pieces[0], &locks );
+	else
+		perft_fast( b, pieces[0], PERFT_SPIN, &locks );
+
+	if( depth == 1 )
+		return locks.count;
+
+	n = 0;
+
+	for( pattern=0; pattern<4; pattern++ ) {
+		for( row=0; row<TETRIS_HEIGHT; row++ ) {
+			for( r=locks.lock[pattern][row]; r; r&=r-1 ) {
+				col = __builtin_ctz( r );
+				perft_place( &next, b, pieces[0], pattern, col, row );
+				n += perft_count( &next, pieces+1, depth-1, ref );
+			}
+		}
+	}
+
+	return n;
+}
+
+/*
+ * perft_check
+ *
+ * walk every placement sequence comparing the two generators
+ *
+ * returns the number of boards checked, exits on the first difference
+ *
+ */
+static Uint64 perft_check( const struct PerftBoard *b, const int *pieces, int depth )
+{
+	struct PerftLocks fast, slow;
+	struct PerftBoard next;
+	Uint16 r;
+	Uint64 n;
+	int pattern, row, col;
+	int i;
+
+	perft_fast( b, pieces[0], PERFT_SPIN, &fast );
+	perft_reference( b, pieces[0], &slow );
+
+	if( memcmp( fast.lock, slow.lock, sizeof(fast.lock) ) ) {
+		printf( "generators disagree on tetrad %d (fast %d, reference %d) on this board:\n",
+				pieces[0], fast.count, slow.count );
+		for( i=0; i<TETRIS_HEIGHT; i++ ) {
+			printf( "    |" );
+			for( col=0; col<TETRIS_WIDTH; col++ )
+				printf( " %c", ( b->rows[i] >> col ) & 1 ? '#' : '.' );
+			printf( " |\n" );
+		}
+		for( pattern=0; pattern<4; pattern++ ) {
+			for( row=0; row<TETRIS_HEIGHT; row++ ) {
+				for( col=0; col<TETRIS_WIDTH; col++ ) {
+					if( ( ( fast.lock[pattern][row] ^ slow.lock[pattern][row] ) >> col ) & 1 )
+						printf( "    pattern %d col %d row %d only in the %s generator\n", pattern, col, row,
+								( fast.lock[pattern][row] >> col ) & 1 ? "fast" : "reference" );
+				}
+			}
+		}
+		exit( 1 );
+	}
+
+	n = 1;
+
+	if( depth == 1 )
+		return n;
+
+	for( pattern=0; pattern<4; pattern++ ) {
+		for( row=0; row<TETRIS_HEIGHT; row++ ) {
+			for( r=fast.lock[pattern][row]; r; r&=r-1 ) {
+				col = __builtin_ctz( r );
+				perft_place( &next, b, pieces[0], pattern, col, row );
+				n += perft_check( &next, pieces+1, depth-1 );
+			}
+		}
+	}
+
+	return n;
+}
+
+/*
+ * perft_place
+ *
+ * place a tetrad on a copy of the board and clear any filled rows,
+ * the same way tetris_update does
+ *
+ * returns the number of rows cleared
+ *
+ */
+static int perft_place( struct PerftBoard *dst, const struct PerftBoard *src, int t, int pattern, int col, int row )
+{
+	struct PerftPiece *p;
+	Uint16 top;
+	int lines;
+	int i, j;
+
+	p = &perft_piece[t][pattern];
+
+	*dst = *src;
+	lines = 0;
+
+	for( i=0; i<p->h; i++ ) {
+		dst->rows[row+i] |= p->rows[i] << col;
+		if( dst->rows[row+i] == PERFT_FULL_ROW )
+			lines++;
+	}
+
+	if( lines == 0 )
+		return 0;
+
+	/* the rows left over at the top repeat row 0, unless it was filled */
+	top = ( dst->rows[0] == PERFT_FULL_ROW ) ? 0 : dst->rows[0];
+
+	j = row + p->h - 1;
+	for( i=j; i>-1; i-- ) {
+		if( dst->rows[i] != PERFT_FULL_ROW )
+			dst->rows[j--] = dst->rows[i];
+	}
+
+	while( j > -1 )
+		dst->rows[j--] = top;
+
+	return lines;
+}
+
+/*
+ * perft_list
+ *
+ * print every lock position of tetrad t and how it is reached
+ *
+ */
+static void perft_list( const struct PerftBoard *b, int t )
+{
+	static const char *kind[] = { "drop", "tuck", "spin" };
+	struct PerftLocks locks[3];
+	int pattern, row, col;
+	int mode;
+
+	for( mode=PERFT_DROP; mode<=PERFT_SPIN; mode++ )
+		perft_fast( b, t, mode, &locks[mode] );
+
+	for( pattern=0; pattern<4; pattern++ ) {
+		for( row=0; row<TETRIS_HEIGHT; row++ ) {
+			for( col=0; col<TETRIS_WIDTH; col++ ) {
+				if( !( ( locks[PERFT_SPIN].lock[pattern][row] >> col ) & 1 ) )
+					continue;
+
+				/* the most restricted mode that still reaches it */
+				for( mode=PERFT_DROP; mode<PERFT_SPIN; mode++ ) {
+					if( ( locks[mode].lock[pattern][row] >> col ) & 1 )
+						break;
+				}
+
+				printf( "    tetrad %d pattern %d col %d row %2d  %s\n", t, pattern, col, row, kind[mode] );
+			}
+		}
+	}
+}
+
+/*
+ * perft_load
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+static int perft_load( struct PerftBoard *b, const char *path )
+{
+	char line[TETRIS_HEIGHT+1][64];
+	FILE *fp;
+	int rows;
+	int i, j;
+
+	fp = fopen( path, "r" );
+	if( fp == NULL ) {
+		fprintf( stderr, "Unable to open board file: %s\n", path );
+		return -1;
+	}
+
+	rows = 0;
+	while( rows <= TETRIS_HEIGHT && fgets( line[rows], sizeof(line[rows]), fp ) != NULL )
+		rows++;
+
+	fclose( fp );
+
+	if( rows > TETRIS_HEIGHT ) {
+		fprintf( stderr, "%s: more than %d rows\n", path, TETRIS_HEIGHT );
+		return -1;
+	}
+
+	/* the last line is the bottom row */
+	for( i=0; i<rows; i++ ) {
+		for( j=0; j<TETRIS_WIDTH && line[i][j] != '\0' && line[i][j] != '\n'; j++ ) {
+			if( line[i][j] != '.' && line[i][j] != ' ' )
+				b->rows[TETRIS_HEIGHT-rows+i] |= 1 << j;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * perft_clock
+ *
+ * monotonic time in seconds
+ *
+ */
+static double perft_clock( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ( ts.tv_nsec / 1.0e9 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,322 @@
+/*
+SDLBlocks
+
+Description:
+Drawing of the game board, the tetrads and the game text.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+
+#include "tetris.h"
+#include "render.h"
+
+/* glyphs -- every cached character of font side by side, advance
+ * pixels apart, in the pixel format of the frames */
+static TTF_Font *text_font;
+static SDL_Surface *text_glyphs;
+static int text_advance;
+
+/*
+ * render_game
+ *
+ * draw the walls, the grid, the board, the active and next tetrads and
+ * the level, lines and score into a SCREEN_WIDTH x SCREEN_HEIGHT frame
+ *
+ */
+void render_game( SDL_Surface *frame, TTF_Font *font, struct Tetris *t )
+{
+	SDL_Rect rect;
+	char text[256];
+	int i, j;
+	int x, y;
+
+	/* clear the buffer */
+	SDL_FillRect( frame, NULL, 0x000000 );
+
+	/* draw the walls: left, right, bottom */
+	vline( frame, TETRIS_MIN_X-1, 0, 401, 0xffffff );
+	vline( frame, TETRIS_MAX_X+1, 0, 401, 0xffffff );
+	hline( frame, TETRIS_MIN_X-1, TETRIS_MAX_Y+1, 204, 0xffffff );
+
+	/* draw the grid */
+	for( i=0;i<TETRIS_HEIGHT;i++ ) {
+		y = (i * TETRAD_HEIGHT) + (TETRAD_HEIGHT/2);
+		for(j=0; j<TETRIS_WIDTH; j++ ) {
+			x = (TETRIS_MIN_X-1) + (j*TETRAD_WIDTH) + (TETRAD_WIDTH/2);
+			rect.x = x;
+			rect.y = y;
+			rect.h = 2;
+			rect.w = 2;
+			SDL_FillRect( frame, &rect, 0x0000ff );
+		}
+	}
+
+	/* draw the tetrominoes already on the matrix */
+	tetris_draw_board( frame, &(t->board[0][0]) );
+
+	/* filled rows flash until they are removed */
+	if( t->state == TETRIS_STATE_CLEAR && ( ( t->now - t->state_time ) / RENDER_FLASH_TICKS ) % 2 == 0 ) {
+		rect.x = TETRIS_MIN_X + 2;
+		rect.w = ( TETRIS_WIDTH * TETRAD_WIDTH ) - 1;
+		rect.h = TETRAD_HEIGHT - 1;
+		for( i=0; i<TETRIS_HEIGHT; i++ ) {
+			rect.y = (i * TETRAD_HEIGHT) + TETRIS_MIN_Y + 1;
+			if( t->clear_rows & ( 1 << i ) )
+				SDL_FillRect( frame, &rect, 0xffffff );
+		}
+	}
+
+	/* draw the currently active tetrominoe */
+	if( TETRIS_SHOWN( t ) )
+		tetrad_draw( frame, t->tx, t->ty, t->t, t->cur_pattern );
+
+	/* draw game text */
+	sprintf( &text[0], "SDLBlocks" );
+	tetris_draw_text( font, frame, 260, 32, &text[0] );
+	sprintf( &text[0], "level: %d", t->game_level );
+	tetris_draw_text( font, frame, 260, 64, &text[0] );
+	sprintf( &text[0], "lines: %d", t->game_total_num_lines_cleared );
+	tetris_draw_text( font, frame, 260, 96, &text[0] );
+	sprintf( &text[0], "score: %d", t->game_score );
+	tetris_draw_text( font, frame, 260, 128, &text[0] );
+
+	/* preview of the next tetrad */
+	if( t->state != TETRIS_STATE_START && t->state != TETRIS_STATE_OVER )
+		tetrad_draw( frame, 390, 64, &tetrad[t->next_tetrad[0]], 0 );
+}
+
+/*
+ * render_text_cache
+ *
+ * render the printable characters of a monospaced font once, after
+ * this tetris_draw_text() copies them out of the cache instead of
+ * rendering and freeing a surface for every string it draws
+ *
+ * returns 0 on success, -1 if the font isn't monospaced or out of memory
+ *
+ */
+int render_text_cache( TTF_Font *font, SDL_PixelFormat *format )
+{
+	SDL_Surface *src;
+	SDL_Color white = { 0xff, 0xff, 0xff, 0x00 };
+	char chars[RENDER_NUM_GLYPHS+1];
+	int advance;
+	int w, h;
+	int i;
+
+	render_text_free();
+
+	for( i=0; i<RENDER_NUM_GLYPHS; i++ )
+		chars[i] = RENDER_FIRST_GLYPH + i;
+	chars[RENDER_NUM_GLYPHS] = '\0';
+
+	/* a string is only the glyphs side by side if nothing is kerned */
+	if( TTF_GlyphMetrics( font, 'M', NULL, NULL, NULL, NULL, &advance ) != 0 ||
+			TTF_SizeText( font, chars, &w, &h ) != 0 || w != advance * RENDER_NUM_GLYPHS )
+		return -1;
+
+	src = TTF_RenderText_Solid( font, chars, white );
+	if( src == NULL )
+		return -1;
+
+	/* converted up front so blits into the frame need no conversion,
+	 * the background stays transparent */
+	text_glyphs = SDL_ConvertSurface( src, format, SDL_SWSURFACE | SDL_SRCCOLORKEY );
+	SDL_FreeSurface( src );
+
+	if( text_glyphs == NULL )
+		return -1;
+
+	text_font = font;
+	text_advance = advance;
+
+	return 0;
+}
+
+/*
+ * render_text_free
+ *
+ */
+void render_text_free( void )
+{
+	if( text_glyphs != NULL )
+		SDL_FreeSurface( text_glyphs );
+
+	text_glyphs = NULL;
+	text_font = NULL;
+}
+
+/*
+ * hline
+ *
+ * draw a horizontal line
+ *
+ */
+void hline(SDL_Surface *surface, int x, int y, int width, Uint32 pixel )
+{
+	SDL_Rect rect;
+
+	rect.x = x;
+	rect.y = y;
+	rect.h = 1;
+	rect.w = width;
+
+	SDL_FillRect( surface, &rect, pixel );
+}
+
+/*
+ * vline
+ *
+ * draw a vertical line
+ *
+ */
+void vline(SDL_Surface *surface, int x, int y, int height, Uint32 pixel )
+{
+	SDL_Rect rect;
+
+	rect.x = x;
+	rect.y = y;
+	rect.h = height;
+	rect.w = 1;
+	
+	SDL_FillRect( surface, &rect, pixel );
+}
+
+
+/*
+ * tetris_draw_text
+ *
+ * draw a text string to some surface at some (x,y), from the glyph
+ * cache if there is one for the font
+ *
+ */
+void tetris_draw_text( TTF_Font *font, SDL_Surface *dest, Uint32 x, Uint32 y, char *text )
+{
+	SDL_Surface *src;
+	SDL_Rect rect;
+	SDL_Rect glyph;
+	SDL_Color white = { 0xff, 0xff, 0xff, 0x00 };
+	int c;
+
+	/* copy the glyphs out of the cache, spaces and characters it
+	 * doesn't have are left blank */
+	if( text_glyphs != NULL && font == text_font ) {
+		glyph.y = 0;
+		glyph.w = text_advance;
+		glyph.h = text_glyphs->h;
+
+		for( ; *text; text++, x+=text_advance ) {
+			c = (unsigned char)*text - RENDER_FIRST_GLYPH;
+			if( c <= 0 || c >= RENDER_NUM_GLYPHS )
+				continue;
+
+			glyph.x = c * text_advance;
+			rect.x = x;
+			rect.y = y;
+
+			SDL_BlitSurface( text_glyphs, &glyph, dest, &rect );
+		}
+
+		return;
+	}
+
+	src = TTF_RenderText_Solid( font, text, white );
+
+	if( src != NULL ) {
+		rect.x = x;
+		rect.y = y;
+		rect.w = src->w;
+		rect.h = src->h;
+
+		SDL_BlitSurface( src, NULL, dest, &rect );
+		SDL_FreeSurface( src );
+	}
+}
+
+/*
+ * tetrad_draw
+ *
+ * draw a tetrad on the board
+ *
+ */
+void tetrad_draw( SDL_Surface *surface, int x, int y, struct Tetrad *t, int pattern )
+{
+	Uint32 *mask;
+	SDL_Rect rect;
+	int i, j;
+	int w, h;
+
+	if ( pattern < 0 )
+		return;
+	
+	rect.x = x;
+	rect.y = y;
+	rect.h = TETRAD_HEIGHT - 1;
+	rect.w = TETRAD_WIDTH - 1;
+
+	mask = t->mask[pattern].mask_arr;
+	w = t->mask[pattern].w;
+	h = t->mask[pattern].h;
+
+	for( i=0; i<h; i++ ) {
+
+		rect.y = y + (i*TETRAD_HEIGHT) + 1;
+
+		if ( y > -1 ) {
+			for( j=0; j<w; j++ ) {
+				rect.x = x + (j*TETRAD_WIDTH) + 1;
+				if ( *mask++ )
+					SDL_FillRect( surface, &rect, t->color );
+			}
+		}
+	}
+}
+
+/*
+ * tetris_draw_board
+ *
+ */
+void tetris_draw_board( SDL_Surface *surface, Uint32 *board ) 
+{
+	Uint32 *bptr = board;
+	SDL_Rect rect;
+	int i, j;
+
+	rect.h = TETRAD_HEIGHT - 1;
+	rect.w = TETRAD_WIDTH - 1;
+	
+	for( i=0; i<TETRIS_HEIGHT; i++ ) {
+		rect.y = (i * TETRAD_HEIGHT) + TETRIS_MIN_Y + 1;
+		rect.x = 1;
+		for( j=0; j<TETRIS_WIDTH; j++ ) {
+			rect.x += TETRAD_WIDTH;
+			if ( *bptr ) {
+				SDL_FillRect( surface, &rect, *bptr );
+			}
+			bptr++;
+		}
+	}
+}
+
+/* vim: set ci ai ts=4 sw=4: */
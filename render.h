@@ -0,0 +1,55 @@
+/*
+SDLBlocks
+
+Description:
+Drawing of the game board, the tetrads and the game text.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_ttf.h>
+
+#include "tetris.h"
+
+#define SCREEN_WIDTH  480
+#define SCREEN_HEIGHT 480
+
+/* filled rows blink at this period before they are removed (ms) */
+#define RENDER_FLASH_TICKS 50
+
+/* characters in the glyph cache, printable ASCII */
+#define RENDER_FIRST_GLYPH ' '
+#define RENDER_NUM_GLYPHS 95
+
+void render_game( SDL_Surface *frame, TTF_Font *font, struct Tetris *t );
+int  render_text_cache( TTF_Font *font, SDL_PixelFormat *format );
+void render_text_free( void );
+
+void hline(SDL_Surface *surface, int x, int y, int width, Uint32 pixel );
+void vline(SDL_Surface *surface, int x, int y, int height, Uint32 pixel );
+void tetris_draw_board( SDL_Surface *surface, Uint32 *board );
+void tetris_draw_text( TTF_Font *font, SDL_Surface *dest, Uint32 x, Uint32 y, char *text );
+void tetrad_draw(SDL_Surface *surface, int x, int y, struct Tetrad *t, int pattern );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,155 @@
+/*
+SDLBlocks
+
+Description:
+Key repeat: delayed auto shift and auto repeat rate for held keys.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+
+#include "repeat.h"
+
+/*
+ * repeat_initialize
+ *
+ */
+void repeat_initialize( struct Repeat *r, Uint32 das, Uint32 arr )
+{
+	memset( r, 0, sizeof(struct Repeat) );
+
+	r->das = das;
+	r->arr = arr;
+	r->shift = -1;
+}
+
+/*
+ * repeat_press
+ *
+ * a key went down at time, the press itself moves once and the repeats
+ * start after the DAS (or the soft drop rate for the down key)
+ *
+ */
+void repeat_press( struct Repeat *r, int key, Uint32 time )
+{
+	r->key[key].held = 1;
+	r->key[key].polled = time;
+
+	if( key == REPEAT_DOWN ) {
+		r->key[key].next = time + REPEAT_DOWN_RATE;
+		return;
+	}
+
+	r->key[key].next = time + r->das;
+	r->shift = key;
+}
+
+/*
+ * repeat_release
+ *
+ * a key went up at time. releasing the repeating horizontal key hands
+ * the repeat to the other one if it is still held, with a fresh DAS.
+ *
+ */
+void repeat_release( struct Repeat *r, int key, Uint32 time )
+{
+	int other;
+
+	r->key[key].held = 0;
+
+	if( key == REPEAT_DOWN || key != r->shift )
+		return;
+
+	other = ( key == REPEAT_LEFT ) ? REPEAT_RIGHT : REPEAT_LEFT;
+
+	if( r->key[other].held ) {
+		r->key[other].next = time + r->das;
+		r->shift = other;
+	}
+	else
+		r->shift = -1;
+}
+
+/*
+ * repeat_clear
+ *
+ * forget the held keys, they have to be pressed again
+ *
+ */
+void repeat_clear( struct Repeat *r )
+{
+	int i;
+
+	for( i=0; i<REPEAT_NUM_KEYS; i++ )
+		r->key[i].held = 0;
+
+	r->shift = -1;
+}
+
+/*
+ * repeat_due
+ *
+ * the number of repeats of key that fell due up to now, however many
+ * that is since the last call: the count comes from the timestamps, not
+ * from how often this is called. REPEAT_ALL for an ARR of 0.
+ *
+ * a key that went unpolled for more than REPEAT_STALL, while the game
+ * was paused or stalled, resumes with a single repeat instead of all
+ * the ones that fell due in the meantime.
+ *
+ */
+int repeat_due( struct Repeat *r, int key, Uint32 now )
+{
+	struct RepeatKey *k = &r->key[key];
+	Uint32 rate;
+	Uint32 polled;
+	Uint32 n;
+
+	if( !k->held )
+		return 0;
+
+	polled = k->polled;
+	k->polled = now;
+
+	if( key != REPEAT_DOWN && key != r->shift )
+		return 0;
+
+	if( (Sint32)( now - k->next ) < 0 )
+		return 0;
+
+	rate = ( key == REPEAT_DOWN ) ? REPEAT_DOWN_RATE : r->arr;
+
+	if( rate == 0 ) {
+		k->next = now + 1;
+		return REPEAT_ALL;
+	}
+
+	if( ( now - polled ) > REPEAT_STALL )
+		k->next = now;
+
+	n = ( ( now - k->next ) / rate ) + 1;
+	k->next += n * rate;
+
+	return ( n > REPEAT_ALL ) ? REPEAT_ALL : n;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,80 @@
+/*
+SDLBlocks
+
+Description:
+Key repeat: delayed auto shift and auto repeat rate for held keys.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef REPEAT_H
+#define REPEAT_H
+
+#include <SDL/SDL.h>
+
+/* default delayed auto shift, the time a key is held before it starts
+ * repeating, and auto repeat rate, the time between repeats (ms).
+ * an ARR of 0 shifts all the way at once. */
+#define REPEAT_DAS 170
+#define REPEAT_ARR 50
+
+/* soft drop repeats from the press on at its own rate (ms) */
+#define REPEAT_DOWN_RATE 40
+
+/* repeating keys */
+#define REPEAT_LEFT  0
+#define REPEAT_RIGHT 1
+#define REPEAT_DOWN  2
+#define REPEAT_NUM_KEYS 3
+
+/* repeats reported for an ARR of 0, more than any shift can take */
+#define REPEAT_ALL 64
+
+/* a held key not polled for this long (ms) had its repeat clock
+ * stopped, by a pause, a clear or a stall, and catches up with one
+ * repeat at most */
+#define REPEAT_STALL 100
+
+struct RepeatKey {
+	int held;
+
+	/* next -- when the next repeat is due, polled -- time of the
+	 * last repeat_due() while held */
+	Uint32 next;
+	Uint32 polled;
+};
+
+struct Repeat {
+	Uint32 das;
+	Uint32 arr;
+
+	struct RepeatKey key[REPEAT_NUM_KEYS];
+
+	/* shift -- the horizontal key that repeats, the last one pressed */
+	int shift;
+};
+
+void repeat_initialize( struct Repeat *r, Uint32 das, Uint32 arr );
+void repeat_press( struct Repeat *r, int key, Uint32 time );
+void repeat_release( struct Repeat *r, int key, Uint32 time );
+void repeat_clear( struct Repeat *r );
+int  repeat_due( struct Repeat *r, int key, Uint32 now );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
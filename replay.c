@@ -0,0 +1,325 @@
+/*
+SDLBlocks
+
+Description:
+Replay files: the seed and every input of a game, enough to play it
+back exactly.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "replay.h"
+
+static void replay_put_varint( FILE *fp, Uint32 v );
+static int  replay_get_varint( FILE *fp, Uint32 *v );
+
+/*
+ * replay_create
+ *
+ * start recording a game, called right after tetris_seed() and
+ * tetris_start() with the seed and the game time of the start. the
+ * file of the previous recording is reused, so one Replay always
+ * records to the same path
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int replay_create( struct Replay *r, const char *path, struct Tetris *t, Uint32 seed, Uint32 start )
+{
+	FILE *fp;
+
+	fp = ( r->fp != NULL ) ? r->fp : r->idle;
+
+	memset( r, 0, sizeof(struct Replay) );
+
+	/* rewrite the file of the last recording in place */
+	if( fp != NULL && ( fseek( fp, 0, SEEK_SET ) != 0 || ftruncate( fileno( fp ), 0 ) != 0 ) ) {
+		fclose( fp );
+		fp = NULL;
+	}
+
+	r->fp = ( fp != NULL ) ? fp : fopen( path, "wb" );
+	if( r->fp == NULL ) {
+		fprintf( stderr, "Unable to open replay file: %s\n", path );
+		return -1;
+	}
+
+	r->hdr.magic = REPLAY_MAGIC;
+	r->hdr.version = REPLAY_VERSION;
+	r->hdr.seed = seed;
+	r->hdr.next_time = t->next_time - start;
+
+	fwrite( &r->hdr, sizeof(r->hdr), 1, r->fp );
+
+	r->start = start;
+	r->last = start;
+	r->flags = replay_flags( t );
+
+	return 0;
+}
+
+/*
+ * replay_action
+ *
+ * queue an action for the next record
+ *
+ */
+void replay_action( struct Replay *r, int action )
+{
+	if( r->fp == NULL )
+		return;
+
+	/* far more than one game loop can produce */
+	if( r->num_actions == REPLAY_MAX_ACTIONS )
+		return;
+
+	r->actions[r->num_actions++] = action;
+}
+
+/*
+ * replay_step
+ *
+ * called once per game loop after tetris_tick(), writes a record if
+ * there were actions or if the tick changed the game
+ *
+ */
+void replay_step( struct Replay *r, struct Tetris *t, Uint32 now, int events )
+{
+	int flags;
+
+	if( r->fp == NULL )
+		return;
+
+	flags = replay_flags( t );
+
+	if( !r->num_actions && !events && flags == r->flags )
+		return;
+
+	replay_put_varint( r->fp, now - r->last );
+	fputc( r->num_actions, r->fp );
+	fwrite( r->actions, 1, r->num_actions, r->fp );
+
+	r->num_actions = 0;
+	r->last = now;
+	r->flags = flags;
+}
+
+/*
+ * replay_finish
+ *
+ * write the end record and flush the file
+ *
+ */
+void replay_finish( struct Replay *r, struct Tetris *t )
+{
+	struct ReplayEnd end;
+
+	if( r->fp == NULL )
+		return;
+
+	/* actions queued after the last tick were never played */
+	replay_put_varint( r->fp, 0 );
+	fputc( REPLAY_END, r->fp );
+
+	end.score = t->game_score;
+	end.lines = t->game_total_num_lines_cleared;
+	end.pieces = t->game_num_pieces;
+	fwrite( &end, sizeof(end), 1, r->fp );
+
+	/* kept open for the next game, replay_close() closes it */
+	fflush( r->fp );
+	r->idle = r->fp;
+	r->fp = NULL;
+}
+
+/*
+ * replay_open
+ *
+ * open a replay for reading
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int replay_open( struct Replay *r, const char *path )
+{
+	memset( r, 0, sizeof(struct Replay) );
+
+	r->fp = fopen( path, "rb" );
+	if( r->fp == NULL ) {
+		fprintf( stderr, "Unable to open replay file: %s\n", path );
+		return -1;
+	}
+
+	if( fread( &r->hdr, sizeof(r->hdr), 1, r->fp ) != 1 ||
+			r->hdr.magic != REPLAY_MAGIC || r->hdr.version != REPLAY_VERSION ) {
+		fprintf( stderr, "Not a replay file: %s\n", path );
+		replay_close( r );
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * replay_read
+ *
+ * read the next record, time is relative to the start of the game and
+ * actions must hold REPLAY_MAX_ACTIONS
+ *
+ * returns 1 for a record, 0 at the end record (r->end is filled in),
+ * -1 if the file is truncated or corrupt
+ *
+ */
+int replay_read( struct Replay *r, Uint32 *time, Uint8 *actions, int *num_actions )
+{
+	Uint32 dt;
+	int n;
+
+	if( replay_get_varint( r->fp, &dt ) != 0 )
+		return -1;
+
+	n = fgetc( r->fp );
+	if( n == EOF )
+		return -1;
+
+	r->last += dt;
+	*time = r->last;
+
+	if( n == REPLAY_END ) {
+		*num_actions = 0;
+		return ( fread( &r->end, sizeof(r->end), 1, r->fp ) == 1 ) ? 0 : -1;
+	}
+
+	if( n > REPLAY_MAX_ACTIONS || fread( actions, 1, n, r->fp ) != (size_t)n )
+		return -1;
+
+	*num_actions = n;
+
+	return 1;
+}
+
+/*
+ * replay_close
+ *
+ */
+void replay_close( struct Replay *r )
+{
+	if( r->fp != NULL )
+		fclose( r->fp );
+
+	if( r->idle != NULL )
+		fclose( r->idle );
+
+	r->fp = NULL;
+	r->idle = NULL;
+}
+
+/*
+ * replay_flags
+ *
+ * the game state tetris_tick() works from, a state change without any
+ * other event still has to be recorded
+ *
+ */
+int replay_flags( struct Tetris *t )
+{
+	return t->state;
+}
+
+/*
+ * replay_apply
+ *
+ * play back one action
+ *
+ */
+void replay_apply( struct Tetris *t, int action )
+{
+	switch( action ) {
+		case REPLAY_LEFT:
+			tetris_move_left( t );
+			break;
+		case REPLAY_RIGHT:
+			tetris_move_right( t );
+			break;
+		case REPLAY_ROTATE:
+			tetris_rotate( t );
+			break;
+		case REPLAY_DOWN:
+			tetris_move_down( t );
+			break;
+		case REPLAY_DROP:
+			tetris_drop( t );
+			break;
+		case REPLAY_PAUSE:
+			tetris_pause( t );
+			break;
+	}
+}
+
+/*
+ * replay_put_varint
+ *
+ * little-endian base 128, 7 bits per byte, high bit set on all but
+ * the last byte
+ *
+ */
+static void replay_put_varint( FILE *fp, Uint32 v )
+{
+	while( v >= 0x80 ) {
+		fputc( ( v & 0x7f ) | 0x80, fp );
+		v >>= 7;
+	}
+
+	fputc( v, fp );
+}
+
+/*
+ * replay_get_varint
+ *
+ * returns 0 on success, -1 at the end of the file or on a bad varint
+ *
+ */
+static int replay_get_varint( FILE *fp, Uint32 *v )
+{
+	int shift;
+	int c;
+
+	*v = 0;
+
+	for( shift=0; shift<35; shift+=7 ) {
+		c = fgetc( fp );
+		if( c == EOF )
+			return -1;
+
+		*v |= (Uint32)( c & 0x7f ) << shift;
+
+		if( !( c & 0x80 ) )
+			return 0;
+	}
+
+	return -1;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
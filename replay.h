@@ -0,0 +1,118 @@
+/*
+SDLBlocks
+
+Description:
+Replay files: the seed and every input of a game, enough to play it
+back exactly.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+
+#define REPLAY_MAGIC 0x50524253	/* "SBRP" */
+#define REPLAY_VERSION 2
+
+/* replay actions, one byte each */
+#define REPLAY_LEFT   1
+#define REPLAY_RIGHT  2
+#define REPLAY_ROTATE 3
+#define REPLAY_DOWN   4
+#define REPLAY_DROP   5
+#define REPLAY_PAUSE  6
+
+/* actions queued between two records */
+#define REPLAY_MAX_ACTIONS 64
+
+/* action count of the record that ends a replay */
+#define REPLAY_END 0xff
+
+/*
+ * a replay file is a header followed by records:
+ *
+ *   varint dt    -- ms since the previous record (since the start for the first)
+ *   Uint8 count  -- number of actions, REPLAY_END for the end record
+ *   Uint8 action[count]
+ *
+ * playing a record applies its actions with replay_apply() and then
+ * calls tetris_tick() once at the record time. a record is written for
+ * every game loop that had input or where tetris_tick() changed
+ * anything, the loops in between are no-ops for the game logic and are
+ * left out. the end record holds the final score for verification.
+ *
+ */
+
+struct ReplayHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 seed;
+
+	/* next_time -- tetris.next_time relative to the start of the game */
+	Uint32 next_time;
+};
+
+struct ReplayEnd {
+	Uint32 score;
+	Uint32 lines;
+	Uint32 pieces;
+};
+
+struct Replay {
+	FILE *fp;
+
+	/* idle -- file of the last finished recording, reused by the next
+	 * replay_create() so recording a game doesn't allocate a stream */
+	FILE *idle;
+
+	struct ReplayHeader hdr;
+
+	/* start -- game time of the start, last -- time of the last record */
+	Uint32 start;
+	Uint32 last;
+
+	/* flags -- replay_flags() after the last record */
+	int flags;
+
+	int num_actions;
+	Uint8 actions[REPLAY_MAX_ACTIONS];
+
+	/* end -- read from the end record */
+	struct ReplayEnd end;
+};
+
+int  replay_create( struct Replay *r, const char *path, struct Tetris *t, Uint32 seed, Uint32 start );
+void replay_action( struct Replay *r, int action );
+void replay_step( struct Replay *r, struct Tetris *t, Uint32 now, int events );
+void replay_finish( struct Replay *r, struct Tetris *t );
+
+int  replay_open( struct Replay *r, const char *path );
+int  replay_read( struct Replay *r, Uint32 *time, Uint8 *actions, int *num_actions );
+void replay_close( struct Replay *r );
+
+int  replay_flags( struct Tetris *t );
+void replay_apply( struct Tetris *t, int action );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,239 @@
+/*
+SDLBlocks
+ 
+Description:
+Rewind buffer: periodic keyframes plus per-lock deltas.
+ 
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "rewind.h"
+
+static struct RewindKeyframe * rewind_keyframe( struct Rewind *rw, Uint32 frame );
+
+/*
+ * rewind_reset
+ *
+ * forget everything recorded, called when a new game starts
+ *
+ */
+void rewind_reset( struct Rewind *rw )
+{
+	rw->num_frames = 0;
+	rw->num_locks = 0;
+	rw->active = 0;
+	rw->cursor = 0;
+}
+
+/*
+ * rewind_record
+ *
+ * record the active tetrad for one frame, and a full copy of the game
+ * every REWIND_KEYFRAME_INTERVAL frames
+ *
+ */
+void rewind_record( struct Rewind *rw, struct Tetris *t )
+{
+	struct RewindFrame *f;
+	struct RewindKeyframe *k;
+
+	if( ( rw->num_frames % REWIND_KEYFRAME_INTERVAL ) == 0 ) {
+		k = &rw->keyframes[ ( rw->num_frames / REWIND_KEYFRAME_INTERVAL ) % REWIND_KEYFRAMES ];
+		k->frame = rw->num_frames;
+		k->lock_seq = rw->num_locks;
+		memcpy( &k->state, t, sizeof(struct Tetris) );
+	}
+
+	f = &rw->frames[ rw->num_frames % REWIND_FRAMES ];
+	f->lock_seq = rw->num_locks;
+	f->tetrad = t->cur_tetrad;
+	f->pattern = t->cur_pattern;
+	f->col = ( t->tx / TETRAD_WIDTH ) - 1;
+	f->row = t->ty / TETRAD_HEIGHT;
+
+	rw->num_frames++;
+}
+
+/*
+ * rewind_lock
+ *
+ * record the tetrad tetris_tick just placed on the board
+ *
+ */
+void rewind_lock( struct Rewind *rw, struct Tetris *t )
+{
+	struct RewindLock *l;
+
+	if( t->lock_pattern < 0 || t->lock_ty < 0 )
+		return;
+
+	l = &rw->locks[ rw->num_locks & (REWIND_LOCKS-1) ];
+	l->tetrad = t->lock_tetrad;
+	l->pattern = t->lock_pattern;
+	l->col = ( t->lock_tx / TETRAD_WIDTH ) - 1;
+	l->row = t->lock_ty / TETRAD_HEIGHT;
+
+	rw->num_locks++;
+}
+
+/*
+ * rewind_restore
+ *
+ * rebuild the game as it was at some recorded frame: copy the keyframe
+ * preceding it, replay the placements made since then and put the
+ * active tetrad back where it was
+ *
+ * returns 0 on success, -1 if the frame is no longer in the buffer
+ *
+ */
+int rewind_restore( struct Rewind *rw, struct Tetris *t, Uint32 frame )
+{
+	struct RewindKeyframe *k;
+	struct RewindFrame *f;
+	struct RewindLock *l;
+	Uint32 seq;
+	int game_audio;
+
+	if( frame >= rw->num_frames )
+		return -1;
+	if( ( rw->num_frames - frame ) > REWIND_FRAMES )
+		return -1;
+
+	k = rewind_keyframe( rw, frame );
+	if( k == NULL )
+		return -1;
+
+	f = &rw->frames[ frame % REWIND_FRAMES ];
+	if( ( rw->num_locks - k->lock_seq ) > REWIND_LOCKS )
+		return -1;
+
+	/* this belongs to the session, not to the recorded game */
+	game_audio = t->game_audio;
+
+	memcpy( t, &k->state, sizeof(struct Tetris) );
+
+	t->game_audio = game_audio;
+
+	for( seq=k->lock_seq; seq!=f->lock_seq; seq++ ) {
+		l = &rw->locks[ seq & (REWIND_LOCKS-1) ];
+		tetrad_put( &(t->board[0][0]), &tetrad[l->tetrad], l->pattern,
+				(l->col+1) * TETRAD_WIDTH, l->row * TETRAD_HEIGHT );
+		tetris_update( t );
+		tetris_level_up( t );
+
+		/* deals from the recorded random number generator state */
+		tetris_next_tetrad( t );
+	}
+
+	t->cur_tetrad = f->tetrad;
+	t->cur_pattern = f->pattern;
+	t->t = &tetrad[t->cur_tetrad];
+	t->tx = ( f->col + 1 ) * TETRAD_WIDTH;
+	t->ty = f->row * TETRAD_HEIGHT;
+	t->max_x = TETRIS_MAX_X - ( t->t->mask[t->cur_pattern].w * TETRAD_WIDTH );
+	t->max_y = TETRIS_MAX_Y - ( t->t->mask[t->cur_pattern].h * TETRAD_HEIGHT );
+
+	/* frames are only recorded while the tetrad can move, the game
+	 * isn't ticked until rewind_resume */
+	t->state = TETRIS_STATE_FALL;
+	t->game_pause = 0;
+	t->clear_rows = 0;
+
+	return 0;
+}
+
+/*
+ * rewind_step
+ *
+ * step back some number of frames, entering rewind on the first call
+ *
+ * returns 0 while there is history left, -1 at the oldest frame
+ *
+ */
+int rewind_step( struct Rewind *rw, struct Tetris *t, int frames )
+{
+	if( rw->num_frames == 0 )
+		return -1;
+
+	if( !rw->active ) {
+		rw->active = 1;
+		rw->cursor = rw->num_frames - 1;
+	}
+
+	while( frames-- > 0 ) {
+		if( rw->cursor == 0 || rewind_keyframe( rw, rw->cursor-1 ) == NULL ||
+				( rw->num_frames - (rw->cursor-1) ) > REWIND_FRAMES ) {
+			rewind_restore( rw, t, rw->cursor );
+			return -1;
+		}
+		rw->cursor--;
+	}
+
+	return rewind_restore( rw, t, rw->cursor );
+}
+
+/*
+ * rewind_resume
+ *
+ * leave rewind and continue play from the restored frame, everything
+ * recorded after it is discarded
+ *
+ */
+void rewind_resume( struct Rewind *rw, struct Tetris *t, Uint32 now )
+{
+	if( !rw->active )
+		return;
+
+	rw->num_frames = rw->cursor + 1;
+	rw->num_locks = rw->frames[ rw->cursor % REWIND_FRAMES ].lock_seq;
+	rw->active = 0;
+
+	/* the restored timers are from the recorded game, restart them
+	 * on the game's clock */
+	t->next_time = now;
+	t->state_time = now;
+}
+
+/*
+ * rewind_keyframe
+ *
+ * find the keyframe preceding a frame, or NULL if it has been overwritten
+ *
+ */
+static struct RewindKeyframe * rewind_keyframe( struct Rewind *rw, Uint32 frame )
+{
+	struct RewindKeyframe *k;
+	Uint32 n;
+
+	n = frame / REWIND_KEYFRAME_INTERVAL;
+	k = &rw->keyframes[ n % REWIND_KEYFRAMES ];
+
+	if( k->frame != n * REWIND_KEYFRAME_INTERVAL )
+		return NULL;
+
+	return k;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,95 @@
+/*
+SDLBlocks
+ 
+Description:
+Rewind buffer: periodic keyframes plus per-lock deltas.
+ 
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+
+/* REWIND_SECONDS of play are kept, sampled REWIND_RATE times per second */
+#define REWIND_SECONDS 10
+#define REWIND_RATE 60
+#define REWIND_TICKS (1000/REWIND_RATE)
+#define REWIND_FRAMES (REWIND_SECONDS*REWIND_RATE)
+
+/* a full copy of the game is kept once every REWIND_KEYFRAME_INTERVAL frames */
+#define REWIND_KEYFRAME_INTERVAL REWIND_RATE
+#define REWIND_KEYFRAMES ((REWIND_FRAMES/REWIND_KEYFRAME_INTERVAL)+2)
+
+/* number of tetrad placements remembered, must be a power of two */
+#define REWIND_LOCKS 1024
+
+/* a tetrad placed on the board */
+
+struct RewindLock {
+	Uint8 tetrad;
+	Sint8 pattern;
+	Sint8 col;
+	Sint8 row;
+};
+
+/* the active tetrad at one recorded frame */
+
+struct RewindFrame {
+	Uint32 lock_seq;
+	Uint8 tetrad;
+	Sint8 pattern;
+	Sint8 col;
+	Sint8 row;
+};
+
+struct RewindKeyframe {
+	Uint32 frame;
+	Uint32 lock_seq;
+	struct Tetris state;
+};
+
+struct Rewind {
+
+	/* num_frames, num_locks -- totals recorded since the game started */
+	Uint32 num_frames;
+	Uint32 num_locks;
+
+	/* active -- rewinding, cursor -- frame currently restored */
+	int active;
+	Uint32 cursor;
+
+	struct RewindFrame frames[REWIND_FRAMES];
+	struct RewindLock locks[REWIND_LOCKS];
+	struct RewindKeyframe keyframes[REWIND_KEYFRAMES];
+};
+
+void rewind_reset( struct Rewind *rw );
+void rewind_record( struct Rewind *rw, struct Tetris *t );
+void rewind_lock( struct Rewind *rw, struct Tetris *t );
+int  rewind_restore( struct Rewind *rw, struct Tetris *t, Uint32 frame );
+int  rewind_step( struct Rewind *rw, struct Tetris *t, int frames );
+void rewind_resume( struct Rewind *rw, struct Tetris *t, Uint32 now );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
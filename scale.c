@@ -0,0 +1,346 @@
+/*
+SDLBlocks
+
+Description:
+Integer upscaler used to present the native resolution game frame
+in a larger, resizable window.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "scale.h"
+
+static void scale_row( Uint32 *dst, const Uint32 *src, int w, int factor );
+static void scale_block( struct Scaler *s, SDL_Surface *screen, int x, int y, int w, int h );
+
+/*
+ * scaler_initialize
+ *
+ * create the native resolution frame surface using the pixel layout of
+ * the window surface so that mapped colors are valid in both
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int scaler_initialize( struct Scaler *s, SDL_PixelFormat *format, int w, int h )
+{
+	memset( s, 0, sizeof(struct Scaler) );
+
+	s->frame = SDL_CreateRGBSurface( SDL_SWSURFACE, w, h, 32,
+			format->Rmask, format->Gmask, format->Bmask, format->Amask );
+
+	if( s->frame == NULL )
+		return -1;
+
+	s->tiles_x = ( w + SCALE_TILE - 1 ) / SCALE_TILE;
+	s->tiles_y = ( h + SCALE_TILE - 1 ) / SCALE_TILE;
+
+	/* worst case every other tile in a tile row is dirty */
+	s->max_rects = s->tiles_y * ( ( s->tiles_x + 1 ) / 2 );
+
+	s->prev = malloc( w * h * sizeof(Uint32) );
+	s->rects = malloc( s->max_rects * sizeof(SDL_Rect) );
+
+	if( s->prev == NULL || s->rects == NULL ) {
+		scaler_free( s );
+		return -1;
+	}
+
+	s->factor = SCALE_MIN;
+	s->full = 1;
+
+	return 0;
+}
+
+/*
+ * scaler_set_window
+ *
+ * pick the largest integer scale factor that fits the window and center
+ * the scaled frame in it
+ *
+ */
+void scaler_set_window( struct Scaler *s, int win_w, int win_h )
+{
+	int fx, fy;
+
+	fx = win_w / s->frame->w;
+	fy = win_h / s->frame->h;
+
+	s->factor = ( fx < fy ) ? fx : fy;
+
+	if( s->factor < SCALE_MIN )
+		s->factor = SCALE_MIN;
+	if( s->factor > SCALE_MAX )
+		s->factor = SCALE_MAX;
+
+	s->ox = ( win_w - ( s->frame->w * s->factor ) ) / 2;
+	s->oy = ( win_h - ( s->frame->h * s->factor ) ) / 2;
+
+	if( s->ox < 0 )
+		s->ox = 0;
+	if( s->oy < 0 )
+		s->oy = 0;
+
+	s->full = 1;
+}
+
+/*
+ * scaler_present
+ *
+ * compare the frame against the last presented frame tile by tile,
+ * upscale runs of changed tiles into the window surface and update
+ * only those parts of the window
+ *
+ * returns the number of window rectangles updated
+ *
+ */
+int scaler_present( struct Scaler *s, SDL_Surface *screen )
+{
+	Uint32 *src;
+	Uint32 *old;
+	int pitch;
+	int tx, ty;
+	int x, y, w, h;
+	int run;
+	int dirty;
+	int i;
+
+	pitch = s->frame->pitch / sizeof(Uint32);
+	s->num_rects = 0;
+
+	/* clear the borders around the scaled frame */
+	if( s->full )
+		SDL_FillRect( screen, NULL, 0x000000 );
+
+	if( SDL_MUSTLOCK( screen ) )
+		SDL_LockSurface( screen );
+
+	if( s->full ) {
+		for( y=0; y<s->frame->h; y++ ) {
+			memcpy( s->prev + ( y * s->frame->w ),
+					(Uint32 *)s->frame->pixels + ( y * pitch ),
+					s->frame->w * sizeof(Uint32) );
+		}
+
+		scale_block( s, screen, 0, 0, s->frame->w, s->frame->h );
+	}
+	else {
+		for( ty=0; ty<s->tiles_y; ty++ ) {
+
+			y = ty * SCALE_TILE;
+			h = s->frame->h - y;
+			if( h > SCALE_TILE )
+				h = SCALE_TILE;
+
+			run = -1;
+
+			/* one past the last tile closes any open run */
+			for( tx=0; tx<=s->tiles_x; tx++ ) {
+
+				dirty = 0;
+
+				if( tx < s->tiles_x ) {
+					x = tx * SCALE_TILE;
+					w = s->frame->w - x;
+					if( w > SCALE_TILE )
+						w = SCALE_TILE;
+
+					for( i=0; i<h; i++ ) {
+						src = (Uint32 *)s->frame->pixels + ( (y+i) * pitch ) + x;
+						old = s->prev + ( (y+i) * s->frame->w ) + x;
+						if( memcmp( src, old, w * sizeof(Uint32) ) ) {
+							dirty = 1;
+							break;
+						}
+					}
+
+					if( dirty ) {
+						for( ; i<h; i++ ) {
+							src = (Uint32 *)s->frame->pixels + ( (y+i) * pitch ) + x;
+							old = s->prev + ( (y+i) * s->frame->w ) + x;
+							memcpy( old, src, w * sizeof(Uint32) );
+						}
+					}
+				}
+
+				if( dirty && run < 0 ) {
+					run = tx;
+				}
+				else if( !dirty && run > -1 ) {
+					x = run * SCALE_TILE;
+					w = ( tx * SCALE_TILE ) - x;
+					if( x + w > s->frame->w )
+						w = s->frame->w - x;
+
+					scale_block( s, screen, x, y, w, h );
+					run = -1;
+				}
+			}
+		}
+	}
+
+	if( SDL_MUSTLOCK( screen ) )
+		SDL_UnlockSurface( screen );
+
+	if( s->full ) {
+		SDL_UpdateRect( screen, 0, 0, 0, 0 );
+		s->full = 0;
+	}
+	else if( s->num_rects ) {
+		SDL_UpdateRects( screen, s->num_rects, s->rects );
+	}
+
+	return s->num_rects;
+}
+
+/*
+ * scaler_free
+ *
+ */
+void scaler_free( struct Scaler *s )
+{
+	if( s->frame != NULL )
+		SDL_FreeSurface( s->frame );
+
+	free( s->prev );
+	free( s->rects );
+
+	s->frame = NULL;
+	s->prev = NULL;
+	s->rects = NULL;
+}
+
+/*
+ * scale_block
+ *
+ * upscale the frame rectangle (x,y,w,h) into the window and record the
+ * window rectangle it covers
+ *
+ */
+static void scale_block( struct Scaler *s, SDL_Surface *screen, int x, int y, int w, int h )
+{
+	Uint32 *src;
+	Uint8 *dst;
+	Uint8 *row;
+	SDL_Rect *rect;
+	int pitch;
+	int f;
+	int i, k;
+
+	f = s->factor;
+	pitch = s->frame->pitch / sizeof(Uint32);
+
+	/* clip against the window in case it is smaller than the frame */
+	if( ( s->ox + ( (x + w) * f ) ) > screen->w )
+		w = ( screen->w - s->ox ) / f - x;
+	if( ( s->oy + ( (y + h) * f ) ) > screen->h )
+		h = ( screen->h - s->oy ) / f - y;
+
+	if( w <= 0 || h <= 0 )
+		return;
+
+	src = (Uint32 *)s->frame->pixels + ( y * pitch ) + x;
+	dst = (Uint8 *)screen->pixels + ( ( s->oy + (y * f) ) * screen->pitch ) + ( ( s->ox + (x * f) ) * sizeof(Uint32) );
+
+	for( i=0; i<h; i++ ) {
+
+		/* expand one source row, then replicate it down */
+		scale_row( (Uint32 *)dst, src, w, f );
+
+		row = dst;
+		dst += screen->pitch;
+
+		for( k=1; k<f; k++ ) {
+			memcpy( dst, row, w * f * sizeof(Uint32) );
+			dst += screen->pitch;
+		}
+
+		src += pitch;
+	}
+
+	if( s->num_rects < s->max_rects ) {
+		rect = &s->rects[s->num_rects++];
+		rect->x = s->ox + ( x * f );
+		rect->y = s->oy + ( y * f );
+		rect->w = w * f;
+		rect->h = h * f;
+	}
+}
+
+/*
+ * scale_row
+ *
+ * nearest-neighbour expand w pixels of src into w*factor pixels of dst,
+ * four source pixels at a time with SSE2 where available
+ *
+ */
+static void scale_row( Uint32 *dst, const Uint32 *src, int w, int factor )
+{
+	int i, k;
+
+	i = 0;
+
+	if( factor == 1 ) {
+		memcpy( dst, src, w * sizeof(Uint32) );
+		return;
+	}
+
+#ifdef __SSE2__
+	if( factor == 2 ) {
+		for( ; i+4<=w; i+=4 ) {
+			__m128i v = _mm_loadu_si128( (const __m128i *)( src + i ) );
+			_mm_storeu_si128( (__m128i *)( dst + (i*2) ), _mm_unpacklo_epi32( v, v ) );
+			_mm_storeu_si128( (__m128i *)( dst + (i*2) + 4 ), _mm_unpackhi_epi32( v, v ) );
+		}
+	}
+	else if( factor == 3 ) {
+		for( ; i+4<=w; i+=4 ) {
+			__m128i v = _mm_loadu_si128( (const __m128i *)( src + i ) );
+			_mm_storeu_si128( (__m128i *)( dst + (i*3) ), _mm_shuffle_epi32( v, _MM_SHUFFLE(1,0,0,0) ) );
+			_mm_storeu_si128( (__m128i *)( dst + (i*3) + 4 ), _mm_shuffle_epi32( v, _MM_SHUFFLE(2,2,1,1) ) );
+			_mm_storeu_si128( (__m128i *)( dst + (i*3) + 8 ), _mm_shuffle_epi32( v, _MM_SHUFFLE(3,3,3,2) ) );
+		}
+	}
+	else if( factor == 4 ) {
+		for( ; i+4<=w; i+=4 ) {
+			__m128i v = _mm_loadu_si128( (const __m128i *)( src + i ) );
+			_mm_storeu_si128( (__m128i *)( dst + (i*4) ), _mm_shuffle_epi32( v, 0x00 ) );
+			_mm_storeu_si128( (__m128i *)( dst + (i*4) + 4 ), _mm_shuffle_epi32( v, 0x55 ) );
+			_mm_storeu_si128( (__m128i *)( dst + (i*4) + 8 ), _mm_shuffle_epi32( v, 0xaa ) );
+			_mm_storeu_si128( (__m128i *)( dst + (i*4) + 12 ), _mm_shuffle_epi32( v, 0xff ) );
+		}
+	}
+#endif
+
+	/* remaining pixels, or everything when SSE2 is not available */
+	for( ; i<w; i++ ) {
+		for( k=0; k<factor; k++ )
+			dst[(i*factor)+k] = src[i];
+	}
+}
+
+/* vim: set ci ai ts=4 sw=4: */
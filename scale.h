@@ -0,0 +1,70 @@
+/*
+SDLBlocks
+
+Description:
+Integer upscaler used to present the native resolution game frame
+in a larger, resizable window.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <SDL/SDL.h>
+
+#define SCALE_MIN 1
+#define SCALE_MAX 4
+
+/* the frame is compared against the last presented frame in tiles of
+ * SCALE_TILE x SCALE_TILE pixels, only changed tiles are rescaled */
+#define SCALE_TILE 16
+
+struct Scaler {
+
+	/* frame -- native resolution 32bpp surface the game renders into */
+	SDL_Surface *frame;
+
+	/* prev -- copy of the frame as it was last presented */
+	Uint32 *prev;
+
+	/* factor -- integer scale factor, ox,oy -- offset of the scaled frame in the window */
+	int factor;
+	int ox;
+	int oy;
+
+	/* full -- rescale and update the whole window on the next present */
+	int full;
+
+	int tiles_x;
+	int tiles_y;
+
+	/* rects -- window rectangles updated by the last present */
+	int num_rects;
+	int max_rects;
+	SDL_Rect *rects;
+};
+
+int  scaler_initialize( struct Scaler *s, SDL_PixelFormat *format, int w, int h );
+void scaler_set_window( struct Scaler *s, int win_w, int win_h );
+int  scaler_present( struct Scaler *s, SDL_Surface *screen );
+void scaler_free( struct Scaler *s );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,645 @@
+/*
+SDLBlocks
+
+Description:
+blocksscan: packs replays into an archive, reads games back from it
+and gathers statistics over the whole archive in parallel.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "replay.h"
+#include "archive.h"
+
+#define SCAN_MAX_THREADS 64
+
+/* score histogram buckets: 0, then [2^(b-1), 2^b) */
+#define SCAN_BUCKETS 33
+
+/* statistics of one range of games, gathered by one thread */
+struct ScanPart {
+	const struct Archive *a;
+	Uint32 lo;
+	Uint32 hi;
+	int verify;
+
+	Uint64 games;
+	Uint64 frames;
+	Uint64 bytes;
+	Uint64 score;
+	Uint64 lines;
+	Uint64 pieces;
+	Uint64 duration;
+	Uint32 min_score;
+	Uint32 max_score;
+
+	Uint64 hist[SCAN_BUCKETS];
+	Uint64 tetrads[MAX_TETRAD];
+	Uint64 clears[ARCHIVE_CLEARS];
+	Uint64 actions[256];
+
+	Uint32 bad;
+};
+
+static const char *scan_action_name[] = { "none", "left", "right", "rotate", "down", "drop", "pause" };
+static const char *scan_clear_name[ARCHIVE_CLEARS] = { "single", "double", "triple", "tetris" };
+
+static int  scan_pack( const char *path, char **replays, int num_replays );
+static int  scan_pack_one( struct ArchiveWriter *w, const char *path );
+static int  scan_stats( struct Archive *a, int threads, int verify );
+static int  scan_thread( void *data );
+static int  scan_play( const struct Archive *a, Uint32 game, struct Tetris *t );
+static int  scan_dump( struct Archive *a, Uint32 game, Uint64 frame, Uint64 count );
+static double scan_clock( void );
+
+/*
+ * blocksscan
+ *
+ * usage: blocksscan -o archive replay... | -
+ *        blocksscan [-threads n] [-verify] archive
+ *        blocksscan -game n [-frame n] [-count n] archive
+ *
+ * -o packs the replays into an archive, playing each one back to fill
+ * in its metadata. with - the replay paths are read from stdin, one
+ * per line. replays that don't play back are left out.
+ *
+ * without -o or -game it reports the score distribution, the tetrads
+ * locked, the line clears by tetris_score() category and the actions
+ * over the whole archive, each of -threads threads taking a range of
+ * the games. only the metadata columns and the actions are read,
+ * -verify also plays every game back from the archive.
+ *
+ * -game prints the frames of one game from -frame on, seeking through
+ * the index rather than decoding the games before it.
+ *
+ */
+
+int main( int argc, char *argv[] )
+{
+	struct Archive a;
+	char *out_path;
+	char *path;
+	Uint64 frame;
+	Uint64 count;
+	Uint32 game;
+	int dump;
+	int threads;
+	int verify;
+	int usage;
+	int ret;
+	int i;
+
+	out_path = NULL;
+	path = NULL;
+	dump = 0;
+	game = 0;
+	frame = 0;
+	count = 20;
+	threads = 0;
+	verify = 0;
+	usage = 0;
+
+	for( i=1; i<argc && !usage; i++ ) {
+		if( !strcmp( argv[i], "-o" ) && ( i+1 < argc ) )
+			out_path = argv[++i];
+		else if( !strcmp( argv[i], "-threads" ) && ( i+1 < argc ) )
+			threads = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-verify" ) )
+			verify = 1;
+		else if( !strcmp( argv[i], "-game" ) && ( i+1 < argc ) ) {
+			game = strtoul( argv[++i], NULL, 0 );
+			dump = 1;
+		}
+		else if( !strcmp( argv[i], "-frame" ) && ( i+1 < argc ) )
+			frame = strtoull( argv[++i], NULL, 0 );
+		else if( !strcmp( argv[i], "-count" ) && ( i+1 < argc ) )
+			count = strtoull( argv[++i], NULL, 0 );
+		else if( argv[i][0] != '-' || !strcmp( argv[i], "-" ) )
+			break;
+		else
+			usage = 1;
+	}
+
+	if( out_path != NULL && !usage ) {
+		if( i == argc ) {
+			fprintf( stderr, "No replays to pack\n" );
+			exit( 1 );
+		}
+		return scan_pack( out_path, argv + i, argc - i );
+	}
+
+	if( i == argc - 1 )
+		path = argv[i];
+
+	if( path == NULL || usage ) {
+		fprintf( stderr, "usage: %s -o archive replay... | -\n"
+				"       %s [-threads n] [-verify] archive\n"
+				"       %s -game n [-frame n] [-count n] archive\n", argv[0], argv[0], argv[0] );
+		exit( 1 );
+	}
+
+	if( archive_open( &a, path ) != 0 )
+		exit( 1 );
+
+	if( dump )
+		ret = scan_dump( &a, game, frame, count );
+	else
+		ret = scan_stats( &a, threads, verify );
+
+	archive_close( &a );
+
+	return ret;
+}
+
+/*
+ * scan_pack
+ *
+ * returns 0 on success, 1 on failure
+ *
+ */
+static int scan_pack( const char *path, char **replays, int num_replays )
+{
+	struct ArchiveWriter w;
+	char line[4096];
+	Uint32 packed, skipped;
+	size_t len;
+	int ret;
+	int i;
+
+	if( archive_create( &w, path ) != 0 )
+		return 1;
+
+	packed = 0;
+	skipped = 0;
+
+	for( i=0; i<num_replays; i++ ) {
+
+		if( strcmp( replays[i], "-" ) ) {
+			ret = scan_pack_one( &w, replays[i] );
+			packed += ( ret == 0 );
+			skipped += ( ret != 0 );
+			continue;
+		}
+
+		while( fgets( line, sizeof(line), stdin ) != NULL ) {
+			len = strlen( line );
+			while( len > 0 && ( line[len-1] == '\n' || line[len-1] == '\r' ) )
+				line[--len] = '\0';
+
+			if( len == 0 )
+				continue;
+
+			ret = scan_pack_one( &w, line );
+			packed += ( ret == 0 );
+			skipped += ( ret != 0 );
+		}
+	}
+
+	if( archive_finish( &w ) != 0 )
+		return 1;
+
+	printf( "%u games packed into %s", packed, path );
+	if( skipped )
+		printf( ", %u replays left out", skipped );
+	printf( "\n" );
+
+	return 0;
+}
+
+/*
+ * scan_pack_one
+ *
+ * play a replay back and add it to the archive
+ *
+ * returns 0 on success, -1 if the replay was left out
+ *
+ */
+static int scan_pack_one( struct ArchiveWriter *w, const char *path )
+{
+	static struct Replay replay;
+	struct ArchiveGame g;
+	struct Tetris t;
+	Uint8 actions[REPLAY_MAX_ACTIONS];
+	Uint32 time;
+	int num_actions;
+	int status;
+	int events;
+	int i;
+
+	if( replay_open( &replay, path ) != 0 )
+		return -1;
+
+	memset( &g, 0, sizeof(g) );
+
+	tetris_initialize( &t );
+	tetris_seed( &t, replay.hdr.seed );
+	tetris_start( &t );
+
+	archive_begin( w, replay.hdr.seed );
+
+	while( ( status = replay_read( &replay, &time, actions, &num_actions ) ) == 1 ) {
+
+		if( archive_frame( w, time, actions, num_actions ) != 0 )
+			break;
+
+		for( i=0; i<num_actions; i++ )
+			replay_apply( &t, actions[i] );
+
+		events = tetris_tick( &t, time );
+
+		if( events & TETRIS_EVENT_LOCK )
+			g.tetrads[t.lock_tetrad]++;
+
+		if( ( events & TETRIS_EVENT_CLEAR ) && t.last_lines > 0 )
+			g.clears[( t.last_lines > ARCHIVE_CLEARS ? ARCHIVE_CLEARS : t.last_lines ) - 1]++;
+	}
+
+	replay_close( &replay );
+
+	if( status < 0 ) {
+		fprintf( stderr, "Replay is truncated, leaving out %s\n", path );
+		archive_cancel( w );
+		return -1;
+	}
+
+	if( status != 0 ) {
+		archive_cancel( w );
+		return -1;
+	}
+
+	if( replay.end.score != t.game_score || replay.end.lines != t.game_total_num_lines_cleared ||
+			replay.end.pieces != t.game_num_pieces ) {
+		fprintf( stderr, "Replay out of sync, leaving out %s\n", path );
+		archive_cancel( w );
+		return -1;
+	}
+
+	g.score = t.game_score;
+	g.lines = t.game_total_num_lines_cleared;
+	g.level = t.game_level;
+	g.pieces = t.game_num_pieces;
+
+	if( archive_end( w, &g ) != 0 ) {
+		archive_cancel( w );
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * scan_stats
+ *
+ * returns 0 on success, 1 if a game failed to verify
+ *
+ */
+static int scan_stats( struct Archive *a, int threads, int verify )
+{
+	static struct ScanPart parts[SCAN_MAX_THREADS];
+	SDL_Thread *thread[SCAN_MAX_THREADS];
+	struct ScanPart total;
+	struct ScanPart *p;
+	Uint32 num_games;
+	Uint64 lo, hi, sum;
+	double start, seconds;
+	int i, k;
+
+	num_games = a->hdr->num_games;
+
+	if( threads < 1 )
+		threads = sysconf( _SC_NPROCESSORS_ONLN );
+	if( threads < 1 )
+		threads = 1;
+	if( threads > SCAN_MAX_THREADS )
+		threads = SCAN_MAX_THREADS;
+
+	start = scan_clock();
+
+	for( i=0; i<threads; i++ ) {
+		p = &parts[i];
+		memset( p, 0, sizeof(struct ScanPart) );
+		p->a = a;
+		p->lo = (Uint32)( ( (Uint64)num_games * i ) / threads );
+		p->hi = (Uint32)( ( (Uint64)num_games * ( i + 1 ) ) / threads );
+		p->verify = verify;
+
+		/* the first range is scanned here */
+		thread[i] = ( i > 0 ) ? SDL_CreateThread( scan_thread, p ) : NULL;
+	}
+
+	scan_thread( &parts[0] );
+
+	for( i=1; i<threads; i++ ) {
+		if( thread[i] != NULL )
+			SDL_WaitThread( thread[i], NULL );
+		else
+			scan_thread( &parts[i] );
+	}
+
+	seconds = scan_clock() - start;
+
+	memset( &total, 0, sizeof(total) );
+	total.min_score = 0xffffffff;
+
+	for( i=0; i<threads; i++ ) {
+		p = &parts[i];
+		total.games += p->games;
+		total.frames += p->frames;
+		total.bytes += p->bytes;
+		total.score += p->score;
+		total.lines += p->lines;
+		total.pieces += p->pieces;
+		total.duration += p->duration;
+		total.bad += p->bad;
+
+		if( p->games && p->min_score < total.min_score )
+			total.min_score = p->min_score;
+		if( p->games && p->max_score > total.max_score )
+			total.max_score = p->max_score;
+
+		for( k=0; k<SCAN_BUCKETS; k++ )
+			total.hist[k] += p->hist[k];
+		for( k=0; k<MAX_TETRAD; k++ )
+			total.tetrads[k] += p->tetrads[k];
+		for( k=0; k<ARCHIVE_CLEARS; k++ )
+			total.clears[k] += p->clears[k];
+		for( k=0; k<256; k++ )
+			total.actions[k] += p->actions[k];
+	}
+
+	printf( "%llu games, %llu frames, %.1f MB scanned in %.3f s with %d threads, %.0f MB/s\n",
+			(unsigned long long)total.games, (unsigned long long)total.frames, total.bytes / 1.0e6,
+			seconds, threads, seconds > 0.0 ? total.bytes / 1.0e6 / seconds : 0.0 );
+
+	if( total.games == 0 )
+		return 0;
+
+	printf( "\nscore: min %u average %.0f max %u\n", total.min_score,
+			(double)total.score / total.games, total.max_score );
+	printf( "lines %.1f pieces %.1f minutes %.1f per game\n", (double)total.lines / total.games,
+			(double)total.pieces / total.games, total.duration / 60000.0 / total.games );
+
+	printf( "\nscore distribution:\n" );
+	for( k=0; k<SCAN_BUCKETS; k++ ) {
+		if( total.hist[k] == 0 )
+			continue;
+
+		lo = k ? ( 1ULL << ( k - 1 ) ) : 0;
+		hi = k ? ( 1ULL << k ) - 1 : 0;
+		printf( "  %9llu - %9llu  %10llu  %5.1f%%\n", (unsigned long long)lo, (unsigned long long)hi,
+				(unsigned long long)total.hist[k], ( 100.0 * total.hist[k] ) / total.games );
+	}
+
+	sum = 0;
+	for( k=0; k<MAX_TETRAD; k++ )
+		sum += total.tetrads[k];
+
+	printf( "\ntetrads locked:\n" );
+	for( k=0; k<MAX_TETRAD; k++ ) {
+		printf( "  tetrad %d  %12llu  %5.1f%%\n", k, (unsigned long long)total.tetrads[k],
+				sum ? ( 100.0 * total.tetrads[k] ) / sum : 0.0 );
+	}
+
+	sum = 0;
+	for( k=0; k<ARCHIVE_CLEARS; k++ )
+		sum += total.clears[k];
+
+	printf( "\nline clears:\n" );
+	for( k=0; k<ARCHIVE_CLEARS; k++ ) {
+		printf( "  %-7s  %12llu  %5.1f%% of clears  %5.1f%% of lines\n", scan_clear_name[k],
+				(unsigned long long)total.clears[k], sum ? ( 100.0 * total.clears[k] ) / sum : 0.0,
+				total.lines ? ( 100.0 * total.clears[k] * ( k + 1 ) ) / total.lines : 0.0 );
+	}
+
+	sum = 0;
+	for( k=0; k<256; k++ )
+		sum += total.actions[k];
+
+	printf( "\nactions:\n" );
+	for( k=0; k<256; k++ ) {
+		if( total.actions[k] == 0 )
+			continue;
+
+		if( k < (int)( sizeof(scan_action_name) / sizeof(scan_action_name[0]) ) )
+			printf( "  %-7s", scan_action_name[k] );
+		else
+			printf( "  %-7d", k );
+
+		printf( "  %12llu  %5.1f%%\n", (unsigned long long)total.actions[k], ( 100.0 * total.actions[k] ) / sum );
+	}
+
+	if( verify ) {
+		printf( "\n%llu games played back, %u out of sync\n", (unsigned long long)total.games, total.bad );
+		return total.bad ? 1 : 0;
+	}
+
+	return 0;
+}
+
+/*
+ * scan_thread
+ *
+ * gather the statistics of the games lo..hi-1 from the metadata
+ * columns, and the action counts from the actions of their frames
+ *
+ */
+static int scan_thread( void *data )
+{
+	struct ScanPart *p;
+	const struct Archive *a;
+	struct Tetris t;
+	Uint64 time_lo, time_hi;
+	Uint64 action_lo, action_hi;
+	Uint64 j;
+	Uint32 score;
+	Uint32 g;
+	int b;
+	int k;
+
+	p = data;
+	a = p->a;
+	time_lo = 0;
+	time_hi = 0;
+
+	if( p->lo >= p->hi )
+		return 0;
+
+	p->min_score = 0xffffffff;
+
+	for( g=p->lo; g<p->hi; g++ ) {
+		score = a->score[g];
+
+		p->score += score;
+		p->lines += a->lines[g];
+		p->pieces += a->pieces[g];
+		p->duration += a->duration[g];
+
+		if( score < p->min_score )
+			p->min_score = score;
+		if( score > p->max_score )
+			p->max_score = score;
+
+		for( b=0; score; b++ )
+			score >>= 1;
+		p->hist[b]++;
+
+		for( k=0; k<MAX_TETRAD; k++ )
+			p->tetrads[k] += a->tetrads[(g*MAX_TETRAD)+k];
+		for( k=0; k<ARCHIVE_CLEARS; k++ )
+			p->clears[k] += a->clears[(g*ARCHIVE_CLEARS)+k];
+	}
+
+	p->games = p->hi - p->lo;
+	p->frames = a->first[p->hi] - a->first[p->lo];
+
+	if( archive_locate( a, a->first[p->lo], &time_lo, &action_lo ) == 0 &&
+			archive_locate( a, a->first[p->hi], &time_hi, &action_hi ) == 0 ) {
+		for( j=action_lo; j<action_hi; j++ )
+			p->actions[a->actions[j]]++;
+
+		p->bytes = action_hi - action_lo;
+	}
+
+	p->bytes += p->games * ( 6 + MAX_TETRAD + ARCHIVE_CLEARS ) * sizeof(Uint32);
+
+	if( !p->verify )
+		return 0;
+
+	for( g=p->lo; g<p->hi; g++ ) {
+		if( scan_play( a, g, &t ) != 0 || t.game_score != a->score[g] ||
+				t.game_total_num_lines_cleared != a->lines[g] || t.game_num_pieces != a->pieces[g] ) {
+			fprintf( stderr, "Game %u (seed %u) out of sync\n", g, a->seed[g] );
+			p->bad++;
+		}
+	}
+
+	p->bytes += ( time_hi - time_lo ) + p->frames;
+
+	return 0;
+}
+
+/*
+ * scan_play
+ *
+ * play a game back from the archive into t
+ *
+ * returns 0 on success, -1 if the archive is corrupt
+ *
+ */
+static int scan_play( const struct Archive *a, Uint32 game, struct Tetris *t )
+{
+	struct ArchiveCursor c;
+	Uint8 actions[REPLAY_MAX_ACTIONS];
+	Uint32 time;
+	int num_actions;
+	int status;
+	int i;
+
+	if( archive_seek( &c, a, game, 0 ) != 0 )
+		return -1;
+
+	tetris_initialize( t );
+	tetris_seed( t, a->seed[game] );
+	tetris_start( t );
+
+	while( ( status = archive_next( &c, &time, actions, &num_actions ) ) == 1 ) {
+		for( i=0; i<num_actions; i++ )
+			replay_apply( t, actions[i] );
+
+		tetris_tick( t, time );
+	}
+
+	return status;
+}
+
+/*
+ * scan_dump
+ *
+ * print count frames of a game from frame on
+ *
+ * returns 0 on success, 1 on failure
+ *
+ */
+static int scan_dump( struct Archive *a, Uint32 game, Uint64 frame, Uint64 count )
+{
+	struct ArchiveCursor c;
+	Uint8 actions[REPLAY_MAX_ACTIONS];
+	Uint32 time;
+	int num_actions;
+	int status;
+	int i;
+
+	if( archive_seek( &c, a, game, frame ) != 0 ) {
+		fprintf( stderr, "No frame %llu in game %u\n", (unsigned long long)frame, game );
+		return 1;
+	}
+
+	printf( "game %u seed %u: score %u lines %u level %u pieces %u, %llu frames, %u ms\n",
+			game, a->seed[game], a->score[game], a->lines[game], a->level[game], a->pieces[game],
+			(unsigned long long)ARCHIVE_NUM_FRAMES( a, game ), a->duration[game] );
+
+	for( ; count > 0; count-- ) {
+		status = archive_next( &c, &time, actions, &num_actions );
+
+		if( status < 0 ) {
+			fprintf( stderr, "Archive is corrupt at frame %llu\n", (unsigned long long)( frame + ( c.frame - c.first ) ) );
+			return 1;
+		}
+
+		if( status == 0 )
+			break;
+
+		printf( "frame %llu at %u ms:", (unsigned long long)( c.frame - c.first - 1 ), time );
+
+		for( i=0; i<num_actions; i++ ) {
+			if( actions[i] < sizeof(scan_action_name) / sizeof(scan_action_name[0]) )
+				printf( " %s", scan_action_name[actions[i]] );
+			else
+				printf( " %d", actions[i] );
+		}
+
+		printf( "\n" );
+	}
+
+	return 0;
+}
+
+/*
+ * scan_clock
+ *
+ * monotonic time in seconds
+ *
+ */
+static double scan_clock( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ( ts.tv_nsec / 1.0e9 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -30,265 +30,34 @@ USA
 #include <SDL/SDL_ttf.h>
 #include <SDL/SDL_mixer.h>
 
-#define SCREEN_WIDTH  480
-#define SCREEN_HEIGHT 480
-
-#define TETRIS_WIDTH  10
-#define TETRIS_HEIGHT 20
-
-#define TETRAD_WIDTH 20
-#define TETRAD_HEIGHT 20
-
-#define MAX_TETRAD 7
-
-#define TETRIS_MIN_X (TETRAD_WIDTH-1)
-#define TETRIS_MAX_X (TETRIS_MIN_X+(TETRIS_WIDTH*TETRAD_HEIGHT)+1)
-#define TETRIS_MIN_Y 0
-#define TETRIS_MAX_Y (TETRIS_MIN_Y+(TETRAD_HEIGHT*TETRIS_HEIGHT))
-
-#define START_X (TETRIS_MIN_X+1)+(TETRAD_WIDTH*4)
-#define START_Y TETRIS_MIN_Y
-
-/* tetrad patterns */
-
-struct TetradMask {
-	int w, h;
-	Uint32 mask_arr[6];
-};
-
-
-/* ### */
-/* #   */
-
-struct TetradMask tetrad_0_mask[4] = {
-	
-	{ 3, 2, { 
-			1, 1, 1, 
-			1, 0, 0, 
-			} },
-
-	{ 2, 3, { 
-			1, 1, 
-			0, 1, 
-			0, 1,
-			} },
-	
-	{ 3, 2, { 
-			0, 0, 1, 
-			1, 1, 1, 
-			} },
-	
-	{ 2, 3, { 
-			1, 0, 
-			1, 0, 
-			1, 1,
-			} }
-};
-
-/* ### */
-/*   # */
-
-struct TetradMask tetrad_1_mask[4] = {
-	
-	{ 3, 2, { 
-			1, 1, 1, 
-			0, 0, 1, 
-			} },
-
-	{ 2, 3, { 
-			0, 1, 
-			0, 1, 
-			1, 1,
-			} },
-	
-	{ 3, 2, { 
-			1, 0, 0, 
-			1, 1, 1, 
-			} },
-	
-	{ 2, 3, { 
-			1, 1,
-			1, 0,
-			1, 0,
-			} }
-};
-
-/* ### */
-/*  #  */
-
-struct TetradMask tetrad_2_mask[4] = {
-	
-	{ 3, 2, { 
-			1, 1, 1, 
-			0, 1, 0, 
-			} },
-
-	{ 2, 3, { 
-			0, 1,
-			1, 1,
-			0, 1,
-			} },
-	
-	{ 3, 2, { 
-			0, 1, 0, 
-			1, 1, 1, 
-			} },
-	
-	{ 2, 3, { 
-			1, 0,
-			1, 1,
-			1, 0,
-			} }
-};
-
-/*  ## */
-/* ##  */
-
-struct TetradMask tetrad_3_mask[2] = {
-	
-	{ 3, 2, { 
-			0, 1, 1, 
-			1, 1, 0, 
-			} },
-
-	{ 2, 3, { 
-			1, 0,
-			1, 1,
-			0, 1,
-			} }
-};
-
-/* ##  */
-/*  ## */
-
-struct TetradMask tetrad_4_mask[2] = {
-	
-	{ 3, 2, { 
-			1, 1, 0, 
-			0, 1, 1, 
-			} },
+#include "tetris.h"
+#include "scale.h"
+#include "trace.h"
+#include "render.h"
+#include "game.h"
+#include "latency.h"
+#include "sfx.h"
+#include "marathon.h"
+#include "versus.h"
+
+#ifdef ALLOC_CHECK
+#include "alloccheck.h"
+#endif
 
-	{ 2, 3, { 
-			0, 1, 
-			1, 1, 
-			1, 0,
-			} }
-};
+#define VIDEO_FLAGS ( SDL_SWSURFACE | SDL_RESIZABLE )
 
-/* #### */
-
-struct TetradMask tetrad_5_mask[2] = {
-	
-	{ 4, 1, { 
-			1, 1, 1, 1, 0, 0
-			} },
-	{ 1, 4, { 
-			1, 
-			1,
-			1,
-			1,
-			0, 0
-			} }
-};
-
-/* ## */
-/* ## */
-
-struct TetradMask tetrad_6_mask[1] = {
-	
-	{ 2, 2, { 
-			1, 1,
-			1, 1,
-			0, 0
-			} }
-};
-
-/* tetrad type */
-
-struct Tetrad {
-	int num_patterns;
-	Uint32 color;
-	struct TetradMask * mask; 
-};
-
-struct Tetrad tetrad[MAX_TETRAD] = {
-	{4, 0xff00ff, &tetrad_0_mask[0]},
-	{4, 0xffffff, &tetrad_1_mask[0]},
-	{4, 0xffff00, &tetrad_2_mask[0]},
-	{2, 0x00ff00, &tetrad_3_mask[0]},
-	{2, 0x00ffff, &tetrad_4_mask[0]},
-	{2, 0xff0000, &tetrad_5_mask[0]},
-	{1, 0x0000ff, &tetrad_6_mask[0]}
-};
-
-/* game super type - holds all of the game state variables */
-
-struct Tetris {
-	
-	/* game state flags */
-	int tetrad_drop;
-	int tetrad_move;
-	int tetrad_skip_move;
-	int tetrad_new;
-	int tetrad_wait;
-	int tetrad_check_fill;
-	Uint32 tetrad_drop_rate;
-
-	int cur_tetrad;
-	int cur_pattern;
-	int prev_pattern;
-	int game_over;
-	int game_run;
-	int game_pause;
-	int game_start;
-	int game_audio;
-
-	Uint32 game_score;
-	Uint32 game_level;
-	Uint32 game_total_num_lines_cleared;
-	Uint32 game_cur_num_lines_cleared;
-
-	/* tetrad_max_patterns - max patterns of the currently active tetrad */
-	int tetrad_max_patterns;
-
-	/* tx, ty -- upper-left position of currently active tetrad relative to the game board */
-	int tx;
-	int ty;
-	int prev_tx;
-	int prev_ty;
-
-	/* max_x,max_y -- maximum width and height of currently active tetrad relative to the game board */
-	int max_x;
-	int max_y;
-
-	/* game clock-tick time variables */
-	Uint32 now, next_time;
-	
-	/* abstract representation of the tetris game board */
-	Uint32 board[TETRIS_HEIGHT][TETRIS_WIDTH];
-	Uint32 score;
-
-	/* pointer to currently active tetrad */
-	struct Tetrad *t;
-};
-
-/* function prototypes */
-
-void hline(SDL_Surface *surface, int x, int y, int width, Uint32 pixel );
-void vline(SDL_Surface *surface, int x, int y, int height, Uint32 pixel );
-void tetris_initialize( struct Tetris * t );
-void tetris_draw_board( SDL_Surface *surface, Uint32 *board );
-void tetris_update( struct Tetris *t );
-Uint32 tetris_score( Uint32 level, Uint32 lines );
-void tetris_level_up( struct Tetris *t );
-void tetris_draw_text( TTF_Font *font, SDL_Surface *dest, Uint32 x, Uint32 y, char *text );
-void tetrad_draw(SDL_Surface *surface, int x, int y, struct Tetrad *t, int pattern );
-void tetrad_put( Uint32 *board, struct Tetrad *t, int pattern, int tx, int ty );
-int  tetrad_move( Uint32 *board, struct Tetrad *t, int pattern, int tx, int ty );
+static int  handle_events( struct Game *game, struct Scaler *scaler, SDL_Surface **screen, struct Latency *latency );
+static void handle_window( SDL_Event *event, struct Scaler *scaler, SDL_Surface **screen );
+static void marathon_run( struct Scaler *scaler, SDL_Surface **screen, TTF_Font *font, struct Sfx *sfx, int rows, int cols, int das, int arr );
+static void versus_run( struct Scaler *scaler, SDL_Surface **screen, TTF_Font *font, int players, int humans, int das, int arr );
+static int  versus_key( int key, int humans, int *player, int *action );
+static void versus_repeat( struct Versus *v, int player, int action, int n );
 
 /*
  * main
  *
+ * the event loop and the renderer, the game itself runs on the
+ * simulation thread in game.c
  *
  */
 
@@ -296,24 +65,200 @@ int main( int argc, char *argv[] )
 {
 	const SDL_VideoInfo *video;
 	SDL_Surface *screen;
-	SDL_Event event;
-	SDL_Rect rect;
+	SDL_Surface *frame;
+	struct Scaler scaler;
 	TTF_Font *font;
 	Mix_Music *music;
-
-	int i, j;
-	int x, y;
-
-	struct Tetris tetris;
+	static struct Sfx sfx;
+	struct Sfx *effects;
+
+	int i;
+	int scale;
+	int running;
+	char *trace_path;
+
+	/* game -- the simulation, snap -- its latest state */
+	static struct Game game;
+	struct GameSnapshot *snap;
+	int practice;
+	int autoplay;
+	int use_beam;
+	char *record_path;
+
+	/* latency -- input to present histogram, late_latch -- apply the keys
+	 * pressed since the last snapshot to the tetrad that is drawn */
+	static struct Latency latency;
+	struct Tetris view;
+	Uint32 shown, drawn;
+	int measure;
+	int late_latch;
+	int fresh;
+
+	/* das, arr -- key repeat delay and rate (ms) */
+	int das;
+	int arr;
+
+	/* marathon_rows, marathon_cols -- board size of the marathon mode */
+	int marathon_rows;
+	int marathon_cols;
+
+	/* versus_players -- boards side by side in versus mode, versus_humans
+	 * -- how many of them are played from the keyboard */
+	int versus_players;
+	int versus_humans;
+	int frame_w;
 
 	char text[256];
 
+#ifdef ALLOC_CHECK
+	/* alloc_path -- replay whose keys play the games of the check */
+	static struct AllocScript alloc_script;
+	char *alloc_path;
+	int alloc_seconds;
+#endif
+
 	/*
-	 * Initialize the game variables
+	 * Parse the command line
 	 *
 	 */
 
-	tetris_initialize( &tetris );
+	scale = SCALE_MIN;
+	practice = 0;
+	autoplay = 0;
+	use_beam = 0;
+	trace_path = NULL;
+	record_path = NULL;
+	measure = 0;
+	late_latch = 0;
+	das = REPEAT_DAS;
+	arr = REPEAT_ARR;
+	marathon_rows = 0;
+	marathon_cols = 0;
+	versus_players = 0;
+	versus_humans = 1;
+
+#ifdef DEBUG_TETRIS
+	practice = 1;
+	trace_path = TRACE_FILE;
+#endif
+
+#ifdef ALLOC_CHECK
+	alloc_path = NULL;
+	alloc_seconds = ALLOC_CHECK_SECONDS;
+#endif
+
+	for( i=1; i<argc; i++ ) {
+		if( !strcmp( argv[i], "-scale" ) && ( i+1 < argc ) ) {
+			scale = atoi( argv[++i] );
+			if( scale < SCALE_MIN || scale > SCALE_MAX ) {
+				fprintf( stderr, "Scale must be between %d and %d\n", SCALE_MIN, SCALE_MAX );
+				exit( 1 );
+			}
+		}
+		else if( !strcmp( argv[i], "-practice" ) ) {
+			practice = 1;
+		}
+		else if( !strcmp( argv[i], "-trace" ) && ( i+1 < argc ) ) {
+			trace_path = argv[++i];
+		}
+		else if( !strcmp( argv[i], "-autoplay" ) ) {
+			autoplay = 1;
+		}
+		else if( !strcmp( argv[i], "-beam" ) ) {
+			use_beam = 1;
+		}
+		else if( !strcmp( argv[i], "-record" ) && ( i+1 < argc ) ) {
+			record_path = argv[++i];
+		}
+		else if( !strcmp( argv[i], "-latency" ) ) {
+			measure = 1;
+		}
+		else if( !strcmp( argv[i], "-latelatch" ) ) {
+			late_latch = 1;
+		}
+		else if( !strcmp( argv[i], "-das" ) && ( i+1 < argc ) ) {
+			das = atoi( argv[++i] );
+		}
+		else if( !strcmp( argv[i], "-arr" ) && ( i+1 < argc ) ) {
+			arr = atoi( argv[++i] );
+		}
+		else if( !strcmp( argv[i], "-sfxtest" ) ) {
+			exit( sfx_test() );
+		}
+		else if( !strcmp( argv[i], "-marathon" ) && ( i+1 < argc ) ) {
+			if( sscanf( argv[++i], "%dx%d", &marathon_rows, &marathon_cols ) != 2 ||
+					marathon_rows < TETRIS_HEIGHT || marathon_rows > MARATHON_MAX_ROWS ||
+					marathon_cols < MARATHON_MIN_COLS || marathon_cols > MARATHON_MAX_COLS ) {
+				fprintf( stderr, "-marathon takes ROWSxCOLS, %d..%d rows by %d..%d columns\n",
+						TETRIS_HEIGHT, MARATHON_MAX_ROWS, MARATHON_MIN_COLS, MARATHON_MAX_COLS );
+				exit( 1 );
+			}
+		}
+		else if( !strcmp( argv[i], "-versus" ) && ( i+1 < argc ) ) {
+			versus_players = atoi( argv[++i] );
+			if( versus_players < 2 || versus_players > VERSUS_MAX_PLAYERS ) {
+				fprintf( stderr, "Versus takes 2 to %d players\n", VERSUS_MAX_PLAYERS );
+				exit( 1 );
+			}
+		}
+		else if( !strcmp( argv[i], "-humans" ) && ( i+1 < argc ) ) {
+			versus_humans = atoi( argv[++i] );
+		}
+#ifdef ALLOC_CHECK
+		else if( !strcmp( argv[i], "-alloccheck" ) && ( i+1 < argc ) ) {
+			alloc_path = argv[++i];
+		}
+		else if( !strcmp( argv[i], "-allocseconds" ) && ( i+1 < argc ) ) {
+			alloc_seconds = atoi( argv[++i] );
+		}
+#endif
+		else {
+			fprintf( stderr, "usage: %s [-scale %d..%d] [-practice] [-autoplay] [-beam] [-trace file] [-record file] [-latency] [-latelatch] [-das ms] [-arr ms] [-sfxtest] [-marathon ROWSxCOLS] [-versus n] [-humans 0..2]\n", argv[0], SCALE_MIN, SCALE_MAX );
+			exit( 1 );
+		}
+	}
+
+	if( das < 0 || arr < 0 ) {
+		fprintf( stderr, "-das and -arr can't be negative\n" );
+		exit( 1 );
+	}
+
+	/* only the normal game is recorded */
+	if( marathon_rows > 0 && ( record_path != NULL || practice ) ) {
+		fprintf( stderr, "-marathon can't be used with -record or -practice\n" );
+		exit( 1 );
+	}
+
+	if( versus_players > 0 && ( marathon_rows > 0 || record_path != NULL || practice ) ) {
+		fprintf( stderr, "-versus can't be used with -marathon, -record or -practice\n" );
+		exit( 1 );
+	}
+
+	if( versus_players > 0 && ( versus_humans < 0 || versus_humans > 2 || versus_humans > versus_players ) ) {
+		fprintf( stderr, "-humans takes 0 to 2 players, no more than -versus\n" );
+		exit( 1 );
+	}
+
+	/* a rewound game can't be replayed from its inputs */
+	if( practice && record_path != NULL ) {
+		fprintf( stderr, "-record can't be used in practice mode\n" );
+		exit( 1 );
+	}
+
+#ifdef ALLOC_CHECK
+	/* runs headless, a window and a sound card aren't needed */
+	if( alloc_path != NULL ) {
+		if( marathon_rows > 0 || practice || alloc_seconds <= 0 ) {
+			fprintf( stderr, "-alloccheck needs the normal game and -allocseconds above 0\n" );
+			exit( 1 );
+		}
+		if( alloc_script_load( &alloc_script, alloc_path, alloc_seconds * 1000 ) != 0 )
+			exit( 1 );
+		setenv( "SDL_VIDEODRIVER", "dummy", 0 );
+		setenv( "SDL_AUDIODRIVER", "dummy", 0 );
+	}
+#endif
+
 	srand( (unsigned int) time( (time_t *)NULL ) );
 	
 	/*
@@ -350,33 +295,60 @@ int main( int argc, char *argv[] )
 		exit( 1 );
 	}
 
-	screen = SDL_SetVideoMode ( SCREEN_WIDTH, SCREEN_HEIGHT, video->vfmt->BitsPerPixel, SDL_HWSURFACE | SDL_DOUBLEBUF );
+	/* versus boards are drawn side by side */
+	frame_w = ( versus_players > 0 ) ? versus_players * SCREEN_WIDTH : SCREEN_WIDTH;
+
+	/* don't open a window larger than the desktop */
+	while( ( scale > SCALE_MIN ) && ( video->current_w > 0 ) &&
+			( ( frame_w*scale > video->current_w ) || ( SCREEN_HEIGHT*scale > video->current_h ) ) )
+		scale--;
+
+	/* the game is drawn into a native resolution frame which is then
+	 * upscaled into a 32bpp window */
+	screen = SDL_SetVideoMode ( frame_w*scale, SCREEN_HEIGHT*scale, 32, VIDEO_FLAGS );
 
 	if( screen == NULL ) {
 		fprintf( stderr, "Unable to set up video: %s\n", SDL_GetError() );
 		exit( 1 );
 	}
 
+	if( scaler_initialize( &scaler, screen->format, frame_w, SCREEN_HEIGHT ) != 0 ) {
+		fprintf( stderr, "Unable to create frame surface: %s\n", SDL_GetError() );
+		exit( 1 );
+	}
+
+	scaler_set_window( &scaler, screen->w, screen->h );
+	frame = scaler.frame;
+
+	/* the text is drawn from glyphs rendered once */
+	if( render_text_cache( font, frame->format ) != 0 )
+		fprintf( stderr, "Unable to cache the font glyphs, rendering text per string\n" );
+
 	SDL_WM_SetCaption( "SDLBlocks", NULL );
 	SDL_WM_SetIcon( SDL_LoadBMP( "sdlblocks.bmp" ), NULL );
 
-	/* setup sound and load game music */
+	/* setup sound, load game music and make the sound effects */
 
-	if( Mix_OpenAudio( MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, 2, 1024 ) != 0 ) {
-		fprintf( stderr,  "Unable to initialize audio: %s\n", Mix_GetError() );
-		tetris.game_audio = 0;
-	}
-	else
-		tetris.game_audio = 1;
+	music = NULL;
+	effects = NULL;
 
-	if( tetris.game_audio ) {
+	if( Mix_OpenAudio( MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, 2, SFX_BUFFER ) != 0 )
+		fprintf( stderr,  "Unable to initialize audio: %s\n", Mix_GetError() );
+	else {
 		music = Mix_LoadMUS( "korobeiniki.mp3" );
 		if( music == NULL ) {
 			fprintf( stderr, "Unable to load Mp3 file: %s\n", Mix_GetError() );
 			exit( 1 );
 		}
+
+		if( sfx_initialize( &sfx ) == 0 )
+			effects = &sfx;
 	}
 
+	/* start the event trace */
+	if( trace_path != NULL )
+		trace_open( trace_path );
+
 	/* map tetrad RGB colors to actual colors */
 	tetrad[0].color = SDL_MapRGB( screen->format, 0xff, 0x00, 0xff );
 	tetrad[1].color = SDL_MapRGB( screen->format, 0xff, 0xff, 0xff );
@@ -391,766 +363,638 @@ int main( int argc, char *argv[] )
 	atexit( SDL_Quit );
 	atexit( Mix_CloseAudio );
 
+	/* the marathon mode runs on this thread, without the simulation */
+	if( marathon_rows > 0 ) {
+		marathon_run( &scaler, &screen, font, effects, marathon_rows, marathon_cols, das, arr );
+
+		trace_close();
+		if( music != NULL )
+			Mix_FreeMusic( music );
+		if( effects != NULL )
+			sfx_free( effects );
+		render_text_free();
+		scaler_free( &scaler );
+
+		return 0;
+	}
+
+	/* versus runs its boards on threads of their own, without sound */
+	if( versus_players > 0 ) {
+		versus_run( &scaler, &screen, font, versus_players, versus_humans, das, arr );
+
+		trace_close();
+		if( music != NULL )
+			Mix_FreeMusic( music );
+		if( effects != NULL )
+			sfx_free( effects );
+		render_text_free();
+		scaler_free( &scaler );
+
+		return 0;
+	}
+
+	/* set up the game, its scores and the AI */
+	game_initialize( &game, practice, autoplay, use_beam, record_path, music, effects, das, arr );
+
 	/*
 	 * Main Loop
 	 *
 	 */
 
-    tetris.next_time = SDL_GetTicks();
+	if( game_thread_start( &game ) != 0 ) {
+		fprintf( stderr, "Unable to start the game thread: %s\n", SDL_GetError() );
+		exit( 1 );
+	}
 
-	while ( tetris.game_run ) {
+	running = 1;
+	drawn = 0;
+	latency_reset( &latency );
+
+	while ( running ) {
 		/*
 		 * Event Handler Section
 		 *
 		 */
 
-		while ( SDL_PollEvent( &event ) ) {
-
-			switch ( event.type ) {
-				case SDL_QUIT:
-					tetris.game_run = 0;
-					break;
-
-				case SDL_KEYDOWN:
-					switch ( event.key.keysym.sym ) {
-
-						case SDLK_LEFT:
-							if ( tetris.game_start == 0 ) {
-								if( tetrad_move( &(tetris.board[0][0]), tetris.t, tetris.cur_pattern, tetris.tx, tetris.ty ) ) {
-									tetris.prev_tx = tetris.tx;
-									
-									tetris.tx -= TETRAD_WIDTH;
-									
-									if( tetris.tx < (TETRIS_MIN_X+1) )
-										tetris.tx = (TETRIS_MIN_X+1);
-
-									/* make sure we can move into this position */
-									if( !tetrad_move( &(tetris.board[0][0]), tetris.t, tetris.cur_pattern, tetris.tx, tetris.ty ) ) {
-										/* move the tetrad back */
-										tetris.tx = tetris.prev_tx;
-									}
-								}
-								tetris.tetrad_wait = 1;
-							}
-							break;
-
-						case SDLK_RIGHT:
-							if ( tetris.game_start == 0 ) {
-								if( tetrad_move( &(tetris.board[0][0]), tetris.t, tetris.cur_pattern, tetris.tx, tetris.ty ) ) {
-
-									tetris.prev_tx = tetris.tx;
-
-									tetris.tx += TETRAD_WIDTH;
-
-									if( tetris.tx > tetris.max_x )
-										tetris.tx = tetris.max_x;
-
-									/* make sure we can move into this position */
-									if( !tetrad_move( &(tetris.board[0][0]), tetris.t, tetris.cur_pattern, tetris.tx, tetris.ty ) ) {
-										/* move the tetrad back */
-										tetris.tx = tetris.prev_tx;
-									}
-								}
-								tetris.tetrad_wait = 1;
-							}
-							break;
-
-						case SDLK_UP:
-							if ( tetris.game_start == 0 ) {
-								tetris.prev_pattern = tetris.cur_pattern;
-								tetris.cur_pattern++;
-
-								if( tetris.cur_pattern == tetris.tetrad_max_patterns ) 
-									tetris.cur_pattern = 0;
-
-								tetris.max_x = TETRIS_MAX_X - ( tetris.t->mask[tetris.cur_pattern].w * TETRAD_WIDTH );
-								tetris.max_y = TETRIS_MAX_Y - ( tetris.t->mask[tetris.cur_pattern].h * TETRAD_HEIGHT );
-
-								/* 
-								 * check the position of the new tetrad
-								 * make sure that it can be placed along
-								 * the right edge of the game board
-								 */
-
-								if( tetris.tx > tetris.max_x ) {
-									tetris.cur_pattern = tetris.prev_pattern;
-									tetris.max_x = TETRIS_MAX_X - ( tetris.t->mask[tetris.cur_pattern].w * TETRAD_WIDTH );
-									tetris.max_y = TETRIS_MAX_Y - ( tetris.t->mask[tetris.cur_pattern].h * TETRAD_HEIGHT );
-								}
-
-								if( tetris.ty > tetris.max_y ) {
-									tetris.cur_pattern = tetris.prev_pattern;
-									tetris.max_x = TETRIS_MAX_X - ( tetris.t->mask[tetris.cur_pattern].w * TETRAD_WIDTH );
-									tetris.max_y = TETRIS_MAX_Y - ( tetris.t->mask[tetris.cur_pattern].h * TETRAD_HEIGHT );
-								}
-
-								if( !tetrad_move( &(tetris.board[0][0]), tetris.t, tetris.cur_pattern, tetris.tx, tetris.ty ) ) {
-									/* move the tetrad back */
-									tetris.cur_pattern = tetris.prev_pattern;
-									tetris.max_x = TETRIS_MAX_X - ( tetris.t->mask[tetris.cur_pattern].w * TETRAD_WIDTH );
-									tetris.max_y = TETRIS_MAX_Y - ( tetris.t->mask[tetris.cur_pattern].h * TETRAD_HEIGHT );
-								}
-							}
-							break;
-
-						case SDLK_DOWN:
-							if ( tetris.game_start == 0 ) {
-								tetris.prev_ty = tetris.ty;
-								tetris.ty += TETRAD_HEIGHT;
-								if( tetris.ty > tetris.max_y )
-									tetris.ty = tetris.prev_ty;
-								/* make sure we can move into this position */
-								if( !tetrad_move( &(tetris.board[0][0]), tetris.t, tetris.cur_pattern, tetris.tx, tetris.ty ) ) {
-									/* move the tetrad back */
-									tetris.ty = tetris.prev_ty;
-								}
-							}
-							break;
-
-						case SDLK_SPACE:
-							if( tetris.game_over ) {
-								tetris_initialize( &tetris );
-							}
-							else if( tetris.game_start ) {
-								tetris.game_start = 0;
-								tetris.tetrad_skip_move = 1;
-								tetris.tetrad_new = 1;
-								if( tetris.game_audio ) 
-									Mix_PlayMusic( music, -1 );
-							}
-							else {
-								tetris.tetrad_drop = 1;
-								tetris.tetrad_move = 0;
-							}
-#ifdef DEBUG_TETRIS
-							fprintf( stderr, "drop...\n");
-#endif
-							break;
-
-						case SDLK_ESCAPE:
-							tetris.game_run = 0;
-							break;
-					}
-					break;
-
-				case SDL_KEYUP:
-					switch ( event.key.keysym.sym )
-					{
-						case SDLK_LEFT:
-							break;
-						case SDLK_RIGHT:
-							break;
-						case SDLK_UP:
-							break;
-						case SDLK_DOWN:
-							break;
-					}
-					break;
-			}
-		}
+		running = handle_events( &game, &scaler, &screen, measure ? &latency : NULL );
 
 		/*
-		 * Game Logic Section
+		 * Rendering Section
+		 *
+		 * only redraw when the simulation has published a new step or,
+		 * with the late latch, when a key was pressed since the last
+		 * frame, unless the window needs a full update anyway
 		 *
 		 */
 
-		/* move the currently active tetrad down one row */
-
-		if ( tetris.tetrad_drop || tetris.tetrad_move ) { 
-
-			tetris.prev_ty = tetris.ty; 
+		fresh = game_snapshot( &game, &snap );
 
-			if ( tetris.tetrad_move ) {
-				tetris.now = SDL_GetTicks();
-
-				if ( tetris.tetrad_wait ) {
-					tetris.now = 0;
-					tetris.tetrad_wait = 0;
-				}
+#ifdef ALLOC_CHECK
+		if( alloc_path != NULL && !alloc_script_step( &alloc_script, &game, snap, SDL_GetTicks() ) )
+			running = 0;
+#endif
 
-				else if ( ( tetris.now - tetris.next_time ) >= tetris.tetrad_drop_rate ) {
-					tetris.next_time = SDL_GetTicks();
-					tetris.ty += TETRAD_HEIGHT;
-				}
-			}
-			else 
-				tetris.ty += TETRAD_HEIGHT; 
-
-			if( tetris.ty > tetris.max_y ) {
-				tetris.ty = tetris.prev_ty;
-				tetris.tetrad_drop = 0;
-				tetris.tetrad_move = 0;
-				tetris.tetrad_new = 1;
-				tetris.tetrad_check_fill = 1;
-			}
-			
-			/* make sure we can move into this position */
-			if( !tetrad_move( &(tetris.board[0][0]), tetris.t, tetris.cur_pattern, tetris.tx, tetris.ty ) ) {
-				if( tetris.ty < 0 ) {
-					tetris.game_over = 1;
-					tetris.tetrad_new = 0;
-					tetris.tetrad_drop = 0;
-					tetris.tetrad_move = 0;
-					tetris.tetrad_skip_move = 0;
-
-					if( tetris.game_audio )
-						Mix_HaltMusic();
-				}
-				else {
-					/* move the tetrad back */
-					tetris.ty = tetris.prev_ty;
-					tetris.tetrad_drop = 0;
-					tetris.tetrad_move = 0;
-					tetris.tetrad_new = 1;
-					tetris.tetrad_check_fill = 1;
-				}
-			}
+		if( !fresh && !scaler.full && !( late_latch && game.input_head != drawn ) ) {
+			SDL_Delay( 1 );
+			continue;
 		}
 
-		/* don't move the tetrad for 1 game-loop */
-
-		if ( tetris.tetrad_skip_move ) {
-			tetris.tetrad_skip_move = 0;
-			tetris.tetrad_move = 1;
-			tetris.tetrad_wait = 1;
+		/* sample the input once more right before drawing the tetrad */
+		if( late_latch ) {
+			running = handle_events( &game, &scaler, &screen, measure ? &latency : NULL ) && running;
+			shown = game_latch( &game, snap, &view );
 		}
-
-		/* spawn a new tetrad */
-
-		if( tetris.tetrad_new ) {
-		
-			/* place the current tetrad on the board */
-			tetrad_put( &(tetris.board[0][0]), tetris.t, tetris.cur_pattern, tetris.tx, tetris.ty );
-
-			/* generate a new tetrad */
-			tetris.cur_tetrad = rand() % MAX_TETRAD;
-			tetris.cur_tetrad = rand() % MAX_TETRAD;
-			tetris.cur_tetrad = rand() % MAX_TETRAD; 
-			tetris.cur_tetrad = rand() % MAX_TETRAD;
-			tetris.cur_tetrad = rand() % MAX_TETRAD;
-
-			tetris.cur_pattern = 0;
-
-			tetris.t = &tetrad[tetris.cur_tetrad];
-
-			tetris.tx = START_X;
-			tetris.ty = 0;
-
-			tetris.tetrad_max_patterns = tetris.t->num_patterns;
-			tetris.max_x = TETRIS_MAX_X - ( tetris.t->mask[tetris.cur_pattern].w * TETRAD_WIDTH );
-			tetris.max_y = TETRIS_MAX_Y - ( tetris.t->mask[tetris.cur_pattern].h * TETRAD_HEIGHT );
-			
-			/* check for game over */
-			if( !tetrad_move( &(tetris.board[0][0]), tetris.t, tetris.cur_pattern, tetris.tx, tetris.ty ) ) {
-#ifdef DEBUG_TETRIS
-				fprintf( stderr, "game over...\n" );
-#endif
-				tetris.game_over = 1;
-				tetris.tetrad_new = 0;
-				tetris.tetrad_drop = 0;
-				tetris.tetrad_move = 0;
-				tetris.tetrad_skip_move = 0;
-
-				if( tetris.game_audio )
-					Mix_HaltMusic();
-			}
-			else {
-				tetris.tetrad_new = 0;
-				tetris.tetrad_drop = 0;
-				tetris.tetrad_move = 0;
-				tetris.tetrad_skip_move = 1;
-			}
+		else {
+			view = snap->tetris;
+			shown = snap->input;
 		}
 
-		/* check for filled rows and update the score and level */
-
-		if ( tetris.tetrad_check_fill ) { 
-#ifdef DEBUG_TETRIS
-			fprintf( stderr, "checking board..\n" );
-#endif
-			tetris_update( &tetris );
-			tetris_level_up( &tetris );
-			tetris.tetrad_check_fill = 0;
+		drawn = game.input_head;
 
-#ifdef DEBUG_TETRIS
-	fprintf( stderr, "\n" );
-	fprintf( stderr, "cur level: %d\n", tetris.game_level );
-	fprintf( stderr, "cur score: %d\n", tetris.game_score );
-	fprintf( stderr, "total num lines cleared: %d\n", tetris.game_total_num_lines_cleared );
-	fprintf( stderr, "cur num lines cleared: %d\n", tetris.game_cur_num_lines_cleared );
-	fprintf( stderr, "\n" );
-#endif
+		render_game( frame, font, &view );
 
+		if( snap->num_top > 0 ) {
+			sprintf( &text[0], "best:  %d", snap->top[0] );
+			tetris_draw_text( font, frame, 260, 160, &text[0] );
 		}
 		
-		/*
-		 * Rendering Section
-		 *
-		 */
-
-		if( SDL_MUSTLOCK( screen ) )
-			SDL_LockSurface( screen );
-
-		/* clear the buffer */
-		SDL_FillRect( screen, NULL, 0x000000 );
-
-		/* draw the walls: left, right, bottom */
-		vline( screen, TETRIS_MIN_X-1, 0, 401, 0xffffff );
-		vline( screen, TETRIS_MAX_X+1, 0, 401, 0xffffff );
-		hline( screen, TETRIS_MIN_X-1, TETRIS_MAX_Y+1, 204, 0xffffff );
-
-		/* draw the grid */
-		for( i=0;i<TETRIS_HEIGHT;i++ ) {
-			y = (i * TETRAD_HEIGHT) + (TETRAD_HEIGHT/2);
-			for(j=0; j<TETRIS_WIDTH; j++ ) {
-				x = (TETRIS_MIN_X-1) + (j*TETRAD_WIDTH) + (TETRAD_WIDTH/2);
-				rect.x = x;
-				rect.y = y;
-				rect.h = 2;
-				rect.w = 2;
-				SDL_FillRect( screen, &rect, 0x0000ff );
-			}
+		if( snap->rewinding ) {
+			sprintf( &text[0], "REWIND" );
+			tetris_draw_text( font, frame, 260, 192, &text[0] );
 		}
-
-		/* draw the tetrominoes already on the matrix */
-		tetris_draw_board( screen, &(tetris.board[0][0]) );
-
-		/* draw the currently active tetrominoe */
-		tetrad_draw( screen, tetris.tx, tetris.ty, tetris.t, tetris.cur_pattern );
-
-		/* draw game text */
-		sprintf( &text[0], "SDLBlocks" );
-		tetris_draw_text( font, screen, 260, 32, &text[0] );
-		sprintf( &text[0], "level: %d", tetris.game_level );
-		tetris_draw_text( font, screen, 260, 64, &text[0] );
-		sprintf( &text[0], "lines: %d", tetris.game_total_num_lines_cleared );
-		tetris_draw_text( font, screen, 260, 96, &text[0] );
-		sprintf( &text[0], "score: %d", tetris.game_score );
-		tetris_draw_text( font, screen, 260, 128, &text[0] );
-		
-		if( tetris.game_pause ) {
+		else if( snap->attract ) {
+			sprintf( &text[0], "DEMO" );
+			tetris_draw_text( font, frame, 260, 192, &text[0] );
+		}
+		else if( snap->autoplay && TETRIS_PLAYING( &snap->tetris ) ) {
+			sprintf( &text[0], "AUTOPLAY" );
+			tetris_draw_text( font, frame, 260, 192, &text[0] );
+		}
+		else if( snap->tetris.state == TETRIS_STATE_PAUSE ) {
 			sprintf( &text[0], "PAUSE" );
-			tetris_draw_text( font, screen, 260, 192, &text[0] );
+			tetris_draw_text( font, frame, 260, 192, &text[0] );
 		}
-		else if( tetris.game_start ) {
+		else if( snap->tetris.state == TETRIS_STATE_START ) {
 			sprintf( &text[0], "PRESS SPACE..." );
-			tetris_draw_text( font, screen, 260, 192, &text[0] );
+			tetris_draw_text( font, frame, 260, 192, &text[0] );
 		}
-		else if( tetris.game_over ) {
+		else if( snap->tetris.state == TETRIS_STATE_OVER ) {
 			sprintf( &text[0], "GAME OVER" );
-			tetris_draw_text( font, screen, 260, 192, &text[0] );
+			tetris_draw_text( font, frame, 260, 192, &text[0] );
 		}
 
+		/* high-score table between games */
+		if( snap->scores_ok && ( snap->tetris.state == TETRIS_STATE_START || snap->tetris.state == TETRIS_STATE_OVER ) && !snap->rewinding ) {
+			sprintf( &text[0], "HIGH SCORES" );
+			tetris_draw_text( font, frame, 260, 240, &text[0] );
+			for( i=0; i<snap->num_top; i++ ) {
+				sprintf( &text[0], "%2d %9d", i+1, snap->top[i] );
+				tetris_draw_text( font, frame, 260, 264 + (i*20), &text[0] );
+			}
+		}
 
-		if( SDL_MUSTLOCK( screen ) )
-			SDL_UnlockSurface( screen );
+		/* upscale the changed parts of the frame into the window */
+		scaler_present( &scaler, screen );
 
-		SDL_Flip( screen );
+		if( measure )
+			latency_present( &latency, shown );
 	}
 
 	/* clean up */
 
-	if( tetris.game_audio)
+#ifdef ALLOC_CHECK
+	alloc_check_disarm();
+#endif
+
+	game_thread_stop( &game );
+	game_free( &game );
+
+	trace_close();
+
+	if( measure )
+		latency_report( &latency, stderr );
+
+	if( music != NULL )
 		Mix_FreeMusic( music );
 
+	if( effects != NULL )
+		sfx_free( effects );
+
+	render_text_free();
+	scaler_free( &scaler );
 	SDL_FreeSurface( screen );
 
+#ifdef ALLOC_CHECK
+	/* the check fails on any allocation after the first game started */
+	if( alloc_path != NULL && alloc_check_report( stderr ) != 0 )
+		return 1;
+#endif
+
 	return 0;
 }
 
-
 /*
- * tetris_initialize
- *
- * initialize tetris game variables
- *
- * input:
+ * handle_events
  *
- * struct Tetris * tetris - point to type struct Tetris
+ * pass key events on to the simulation and handle the window, key
+ * presses are timestamped for the latency histogram if latency is set
  *
- * output: none
+ * returns 0 when the game should quit
  *
  */
-
-void tetris_initialize( struct Tetris *tetris )
+static int handle_events( struct Game *game, struct Scaler *scaler, SDL_Surface **screen, struct Latency *latency )
 {
-	if( tetris != NULL ) {
+	SDL_Event event;
+	int running;
 
-		Uint32 *board = &(tetris->board[0][0]);
-		memset( board, 0, (TETRIS_HEIGHT*TETRIS_WIDTH)*sizeof(Uint32) );
-		
-		tetris->tetrad_drop = 0;
-		tetris->tetrad_new = 0;
-		tetris->tetrad_wait = 0;
-		tetris->tetrad_check_fill = 0;
-		tetris->cur_tetrad = 0;
-		/* set cur_pattern to -1 so that the tetrad isn't drawn while
-		 * the game hasn't started. */
-		tetris->cur_pattern = -1;
-		tetris->prev_pattern = 0;
-		tetris->tetrad_max_patterns = 0;
-		tetris->max_x = 0;
-		tetris->max_y = 0;
-		tetris->prev_tx = 0;
-		tetris->prev_ty = 0;
-		tetris->score = 0;
-		tetris->game_over = 0;
-		tetris->game_pause = 0;
-		tetris->game_score = 0;
-		tetris->game_level = 0;
-		tetris->game_total_num_lines_cleared = 0;
-		tetris->game_cur_num_lines_cleared = 0;
-		tetris->tetrad_move = 0;
-		tetris->tetrad_skip_move = 0;
-		tetris->game_run = 1;
-		tetris->tx = START_X;
-		tetris->ty = START_Y;
-
-		tetris->game_start = 1;
-		tetris->game_pause = 0;
-		tetris->game_over = 0;
-
-		/* set the first tetrad */
-		tetris->tetrad_drop_rate = 500;
-
-		tetris->t = &tetrad[tetris->cur_tetrad];
-		tetris->tetrad_max_patterns = tetris->t->num_patterns;
-		tetris->max_x = TETRIS_MAX_X - ( tetris->t->mask[tetris->cur_pattern].w * TETRAD_WIDTH );
-		tetris->max_y = TETRIS_MAX_Y - ( tetris->t->mask[tetris->cur_pattern].h * TETRAD_HEIGHT );
-	}
-}
+	running = 1;
 
-/*
- * hline
- *
- * draw a horizontal line
- *
- */
-void hline(SDL_Surface *surface, int x, int y, int width, Uint32 pixel )
-{
-	SDL_Rect rect;
+	while ( SDL_PollEvent( &event ) ) {
 
-	rect.x = x;
-	rect.y = y;
-	rect.h = 1;
-	rect.w = width;
+		switch ( event.type ) {
+			case SDL_QUIT:
+				running = 0;
+				break;
+
+			case SDL_VIDEORESIZE:
+			case SDL_VIDEOEXPOSE:
+				handle_window( &event, scaler, screen );
+				break;
+
+			case SDL_KEYDOWN:
+				if( event.key.keysym.sym == SDLK_ESCAPE )
+					running = 0;
+				else if( game_key( game, event.key.keysym.sym, 1 ) == 0 && latency != NULL )
+					latency_key( latency, game->input_head - 1 );
+				break;
+
+			case SDL_KEYUP:
+				game_key( game, event.key.keysym.sym, 0 );
+				break;
+		}
+	}
 
-	SDL_FillRect( surface, &rect, pixel );
+	return running;
 }
 
 /*
- * vline
+ * handle_window
  *
- * draw a vertical line
+ * follow the window size, redraw all of it after an expose
  *
  */
-void vline(SDL_Surface *surface, int x, int y, int height, Uint32 pixel )
+static void handle_window( SDL_Event *event, struct Scaler *scaler, SDL_Surface **screen )
 {
-	SDL_Rect rect;
-
-	rect.x = x;
-	rect.y = y;
-	rect.h = height;
-	rect.w = 1;
-	
-	SDL_FillRect( surface, &rect, pixel );
+	if( event->type == SDL_VIDEORESIZE ) {
+		*screen = SDL_SetVideoMode( event->resize.w, event->resize.h, 32, VIDEO_FLAGS );
+		if( *screen == NULL ) {
+			fprintf( stderr, "Unable to resize video: %s\n", SDL_GetError() );
+			exit( 1 );
+		}
+		scaler_set_window( scaler, (*screen)->w, (*screen)->h );
+	}
+	else {
+		scaler->full = 1;
+	}
 }
 
-
 /*
- * tetris_update
+ * marathon_run
  *
- * check the tetris game board for filled rows and remove them if they are found
- * and accumulate points.
+ * play marathon games on a rows x cols board until the window is
+ * closed, SPACE drops the tetrad or starts a new game after game over,
+ * P pauses. a frame is only drawn when something changed or filled
+ * rows flash.
  *
  */
-void tetris_update( struct Tetris *t )
+static void marathon_run( struct Scaler *scaler, SDL_Surface **screen, TTF_Font *font, struct Sfx *sfx, int rows, int cols, int das, int arr )
 {
-	Uint32 board_tmp[TETRIS_HEIGHT][TETRIS_WIDTH];
-	Uint32 *bptr;
-	Uint32 num_lines_cleared;
-	int i, j;
+	static struct Marathon m;
+	struct Repeat repeat;
+	SDL_Event event;
+	Uint32 now;
+	int running;
+	int changed;
+	int events;
+	int key;
 	int n;
-	int m;
 
-	memset( &board_tmp[0][0], 0, (TETRIS_HEIGHT*TETRIS_WIDTH)*sizeof(Uint32) );
+	if( marathon_initialize( &m, rows, cols, rand(), SDL_GetTicks() ) != 0 ) {
+		fprintf( stderr, "Unable to set up a %dx%d marathon board\n", rows, cols );
+		exit( 1 );
+	}
 
-	num_lines_cleared = 0;
+	repeat_initialize( &repeat, das, arr );
 
-	/* check the board for filled rows from the bottom-up */
-	i = TETRIS_HEIGHT - 1;
+	running = 1;
+	changed = 1;
 
-	for( i=TETRIS_HEIGHT-1; i>-1; i-- ) {
-		bptr = (i * TETRIS_WIDTH) + &(t->board[0][0]);
-		n = 0;
-		for ( j=0; j<TETRIS_WIDTH; j++ ) {
-				if ( *bptr++ )
-						n++;
-		}
+	while( running ) {
 
-#ifdef DEBUG_TETRIS
-		fprintf( stderr, "n: %d\n", n );
-#endif
+		now = SDL_GetTicks();
 
-		/* is there a fully filled row? */
-		if( n == TETRIS_WIDTH ) { 
+		while( SDL_PollEvent( &event ) ) {
 
-			/* yes, then shift the board down to the current level */
+			switch( event.type ) {
+				case SDL_QUIT:
+					running = 0;
+					break;
 
-			num_lines_cleared++;
+				case SDL_VIDEORESIZE:
+				case SDL_VIDEOEXPOSE:
+					handle_window( &event, scaler, screen );
+					changed = 1;
+					break;
 
-			bptr = &(t->board[0][0]);
+				case SDL_KEYDOWN:
+					key = event.key.keysym.sym;
+					changed = 1;
 
-			m = i * TETRIS_WIDTH;
-			memcpy( &board_tmp[0][0], bptr, m*sizeof(Uint32) );
-			memcpy( bptr+TETRIS_WIDTH, &board_tmp[0][0], m*sizeof(Uint32) );
+					if( key == SDLK_ESCAPE ) {
+						running = 0;
+					}
+					else if( key == SDLK_LEFT ) {
+						if( marathon_move( &m, -1, 0 ) )
+							sfx_play( sfx, SFX_MOVE );
+						repeat_press( &repeat, REPEAT_LEFT, now );
+					}
+					else if( key == SDLK_RIGHT ) {
+						if( marathon_move( &m, 1, 0 ) )
+							sfx_play( sfx, SFX_MOVE );
+						repeat_press( &repeat, REPEAT_RIGHT, now );
+					}
+					else if( key == SDLK_UP ) {
+						if( marathon_rotate( &m ) )
+							sfx_play( sfx, SFX_ROTATE );
+					}
+					else if( key == SDLK_DOWN ) {
+						marathon_move( &m, 0, 1 );
+						repeat_press( &repeat, REPEAT_DOWN, now );
+					}
+					else if( key == SDLK_SPACE ) {
+						if( m.state == TETRIS_STATE_OVER ) {
+							marathon_free( &m );
+							marathon_initialize( &m, rows, cols, rand(), now );
+							repeat_clear( &repeat );
+						}
+						else {
+							marathon_drop( &m );
+						}
+					}
+					else if( key == SDLK_p ) {
+						marathon_pause( &m );
+					}
+					break;
 
-			/* push the row counter back up to the previous line */
-			i++;
+				case SDL_KEYUP:
+					key = event.key.keysym.sym;
+
+					if( key == SDLK_LEFT )
+						repeat_release( &repeat, REPEAT_LEFT, now );
+					else if( key == SDLK_RIGHT )
+						repeat_release( &repeat, REPEAT_RIGHT, now );
+					else if( key == SDLK_DOWN )
+						repeat_release( &repeat, REPEAT_DOWN, now );
+					break;
+			}
 		}
-	}
 
-	/* update game score */
-	t->game_score += tetris_score( t->game_level, num_lines_cleared );
-	t->game_total_num_lines_cleared += num_lines_cleared;
-	t->game_cur_num_lines_cleared += num_lines_cleared;
+		/* held keys, marathon moves don't reset the gravity timer */
+		for( n=repeat_due( &repeat, REPEAT_LEFT, now ); n>0 && marathon_move( &m, -1, 0 ); n-- )
+			changed = 1;
+		for( n=repeat_due( &repeat, REPEAT_RIGHT, now ); n>0 && marathon_move( &m, 1, 0 ); n-- )
+			changed = 1;
+		for( n=repeat_due( &repeat, REPEAT_DOWN, now ); n>0 && marathon_move( &m, 0, 1 ); n-- )
+			changed = 1;
+
+		events = marathon_tick( &m, now );
+
+		if( events & TETRIS_EVENT_OVER )
+			sfx_play( sfx, SFX_OVER );
+		else if( events & TETRIS_EVENT_LEVEL )
+			sfx_play( sfx, SFX_LEVEL );
+		else if( events & TETRIS_EVENT_CLEAR )
+			sfx_play( sfx, SFX_CLEAR );
+		else if( events & TETRIS_EVENT_LOCK )
+			sfx_play( sfx, SFX_LOCK );
+
+		if( !events && !changed && !scaler->full && m.state != TETRIS_STATE_CLEAR ) {
+			SDL_Delay( 1 );
+			continue;
+		}
 
-	/* check for tilt, if so then reset the score */
-	if( t->game_score > 9999999 ) {
-		t->game_score = 0;
+		marathon_draw( &m, scaler->frame, font );
+		scaler_present( scaler, *screen );
+		changed = 0;
 	}
-}
 
-/*
- * tetris_score
- *
- * calculate game score based on NES scoring algorithm
- * see wikipedia.org entry for tetris for an explaination.
- *
- */
-Uint32 tetris_score( Uint32 level, Uint32 lines )
-{
-	if( lines == 0 )
-		return 0;
-	else if( lines == 1 ) {
-		return ( level + 1 ) * 40;
-	}
-	else if( lines == 2 ) {
-		return ( level + 1 ) * 100;
-	}
-	else if( lines == 3 ) {
-		return ( level + 1 ) * 300;
-	}
-	else {
-		return ( level + 1 ) * 1200;
-	}
+	marathon_free( &m );
 }
 
 /*
- * tetris_level_up
+ * versus_run
  *
- * increase the game level every 10 lines cleared
- * stop at level 20
- *
- * increase tetrad_drop_rate by 20ms per level
+ * play versus matches until the window is closed, the first humans
+ * boards are played from the keyboard and the AI plays the rest. the
+ * boards run on threads of their own, this one only turns keys into
+ * actions and draws the latest snapshot of every board next to the
+ * others. SPACE starts a new match once one is over.
  *
  */
-void tetris_level_up( struct Tetris *t )
+static void versus_run( struct Scaler *scaler, SDL_Surface **screen, TTF_Font *font, int players, int humans, int das, int arr )
 {
-	if( ( t->game_cur_num_lines_cleared > 9 ) && ( t->game_level < 20 ) ) {
-		t->game_level++;
-		t->tetrad_drop_rate -= 20;
-		t->game_cur_num_lines_cleared -= 10;
-	}
-	else if( ( t->game_cur_num_lines_cleared >= 10 ) && ( t->game_level >= 20 ) ) {
-		t->game_level++;
-		t->game_cur_num_lines_cleared -= 10;
+	static struct Versus v;
+	static struct Ai ai[VERSUS_MAX_PLAYERS];
+	struct Ai *bots[VERSUS_MAX_PLAYERS];
+	struct Repeat repeat[2];
+	struct VersusSnapshot *snap;
+	SDL_Surface *board;
+	SDL_Event event;
+	SDL_Rect rect;
+	char text[256];
+	Uint32 now;
+	int running;
+	int changed;
+	int over;
+	int player;
+	int action;
+	int key;
+	int i;
+
+	for( i=0; i<players; i++ ) {
+		bots[i] = NULL;
+
+		if( i < humans )
+			continue;
+
+		if( ai_initialize( &ai[i] ) != 0 ) {
+			fprintf( stderr, "Unable to allocate the transposition table\n" );
+			exit( 1 );
+		}
+		bots[i] = &ai[i];
 	}
-}
 
-/*
- * tetris_draw_text
- *
- * draw a text string to some surface at some (x,y)
- *
- */
-void tetris_draw_text( TTF_Font *font, SDL_Surface *dest, Uint32 x, Uint32 y, char *text )
-{
-	SDL_Surface *src;
-	SDL_Rect rect;
-	SDL_Color white = { 0xff, 0xff, 0xff, 0x00 };
+	/* each board is rendered on its own and copied into place */
+	board = SDL_CreateRGBSurface( SDL_SWSURFACE, SCREEN_WIDTH, SCREEN_HEIGHT, 32,
+			scaler->frame->format->Rmask, scaler->frame->format->Gmask,
+			scaler->frame->format->Bmask, scaler->frame->format->Amask );
 
-	src = TTF_RenderText_Solid( font, text, white );
+	if( board == NULL ) {
+		fprintf( stderr, "Unable to create board surface: %s\n", SDL_GetError() );
+		exit( 1 );
+	}
 
-	rect.x = x;
-	rect.y = y;
-	rect.w = src->w;
-	rect.h = src->h;
+	for( i=0; i<2; i++ )
+		repeat_initialize( &repeat[i], das, arr );
 
-	if( src != NULL ) {
-		SDL_BlitSurface( src, NULL, dest, &rect );
-		SDL_FreeSurface( src );
+	versus_initialize( &v, players, rand(), bots, 0, 0 );
+
+	if( versus_start( &v ) != 0 ) {
+		fprintf( stderr, "Unable to start the board threads: %s\n", SDL_GetError() );
+		exit( 1 );
 	}
-}
 
-/*
- * tetrad_draw
- *
- * draw a tetrad on the board
- *
- */
-void tetrad_draw( SDL_Surface *surface, int x, int y, struct Tetrad *t, int pattern )
-{
-	Uint32 *mask;
-	SDL_Rect rect;
-	int i, j;
-	int w, h;
+	running = 1;
+	over = 0;
 
-	if ( pattern < 0 )
-		return;
-	
-	rect.x = x;
-	rect.y = y;
-	rect.h = TETRAD_HEIGHT - 1;
-	rect.w = TETRAD_WIDTH - 1;
+	while( running ) {
+
+		now = SDL_GetTicks();
+
+		while( SDL_PollEvent( &event ) ) {
 
-	mask = t->mask[pattern].mask_arr;
-	w = t->mask[pattern].w;
-	h = t->mask[pattern].h;
+			switch( event.type ) {
+				case SDL_QUIT:
+					running = 0;
+					break;
 
-	for( i=0; i<h; i++ ) {
+				case SDL_VIDEORESIZE:
+				case SDL_VIDEOEXPOSE:
+					handle_window( &event, scaler, screen );
+					break;
 
-		rect.y = y + (i*TETRAD_HEIGHT) + 1;
+				case SDL_KEYDOWN:
+					key = event.key.keysym.sym;
 
-		if ( y > -1 ) {
-			for( j=0; j<w; j++ ) {
-				rect.x = x + (j*TETRAD_WIDTH) + 1;
-				if ( *mask++ )
-					SDL_FillRect( surface, &rect, t->color );
+					if( key == SDLK_ESCAPE ) {
+						running = 0;
+					}
+					else if( over && key == SDLK_SPACE ) {
+						versus_stop( &v );
+						versus_initialize( &v, players, rand(), bots, 0, 0 );
+						for( i=0; i<2; i++ )
+							repeat_clear( &repeat[i] );
+
+						if( versus_start( &v ) != 0 ) {
+							fprintf( stderr, "Unable to start the board threads: %s\n", SDL_GetError() );
+							exit( 1 );
+						}
+						over = 0;
+					}
+					else if( versus_key( key, humans, &player, &action ) ) {
+						versus_action( &v, player, action );
+
+						if( action == REPLAY_LEFT )
+							repeat_press( &repeat[player], REPEAT_LEFT, now );
+						else if( action == REPLAY_RIGHT )
+							repeat_press( &repeat[player], REPEAT_RIGHT, now );
+						else if( action == REPLAY_DOWN )
+							repeat_press( &repeat[player], REPEAT_DOWN, now );
+					}
+					break;
+
+				case SDL_KEYUP:
+					if( versus_key( event.key.keysym.sym, humans, &player, &action ) ) {
+						if( action == REPLAY_LEFT )
+							repeat_release( &repeat[player], REPEAT_LEFT, now );
+						else if( action == REPLAY_RIGHT )
+							repeat_release( &repeat[player], REPEAT_RIGHT, now );
+						else if( action == REPLAY_DOWN )
+							repeat_release( &repeat[player], REPEAT_DOWN, now );
+					}
+					break;
 			}
 		}
-	}
-}
 
-/*
- * tetrad_move
- *
- */
-int tetrad_move( Uint32 *board, struct Tetrad *t, int pattern, int tx, int ty )
-{
-	Uint32 *mask;
-	Uint32 *bptr;
-	int i, j;
-	int bx;
-	int by;
-	int w, h;
-
-	bx = (tx / TETRAD_WIDTH)-1;
-	by = ty / TETRAD_HEIGHT;
-	w = t->mask[pattern].w;
-	h = t->mask[pattern].h;
-
-	mask = t->mask[pattern].mask_arr;
-
-	for( i=0; i<h; i++ ) {
-		if ( by > -1 ) {
-			bptr = board + ( by * TETRIS_WIDTH ) + bx;
-			for( j=0; j<w; j++ ) {
-				if( *mask && *bptr ) {
-					return 0;
-				}
-				mask++;
-				bptr++;
+		/* held keys */
+		for( i=0; i<humans; i++ ) {
+			versus_repeat( &v, i, REPLAY_LEFT, repeat_due( &repeat[i], REPEAT_LEFT, now ) );
+			versus_repeat( &v, i, REPLAY_RIGHT, repeat_due( &repeat[i], REPEAT_RIGHT, now ) );
+			versus_repeat( &v, i, REPLAY_DOWN, repeat_due( &repeat[i], REPEAT_DOWN, now ) );
+		}
+
+		if( !over && versus_over( &v ) ) {
+			over = 1;
+			scaler->full = 1;
+		}
+
+		/*
+		 * Rendering Section
+		 *
+		 * redraw when any board has published a new step
+		 *
+		 */
+
+		changed = scaler->full;
+
+		for( i=0; i<players; i++ ) {
+			if( !versus_snapshot( &v, i, &snap ) && !changed )
+				continue;
+
+			changed = 1;
+
+			render_game( board, font, &snap->tetris );
+
+			sprintf( &text[0], ( i < humans ) ? "player %d" : "cpu %d", i + 1 );
+			tetris_draw_text( font, board, 260, 160, &text[0] );
+			sprintf( &text[0], "sent:  %u", snap->sent );
+			tetris_draw_text( font, board, 260, 192, &text[0] );
+			sprintf( &text[0], "incoming: %u", snap->incoming );
+			tetris_draw_text( font, board, 260, 224, &text[0] );
+
+			if( over ) {
+				if( v.board[i].result == VERSUS_WON )
+					sprintf( &text[0], "WINNER" );
+				else if( v.board[i].result == VERSUS_DRAW )
+					sprintf( &text[0], "DRAW" );
+				else
+					sprintf( &text[0], "GAME OVER" );
+				tetris_draw_text( font, board, 260, 272, &text[0] );
+
+				sprintf( &text[0], "PRESS SPACE..." );
+				tetris_draw_text( font, board, 260, 304, &text[0] );
+			}
+			else if( snap->tetris.state == TETRIS_STATE_OVER ) {
+				sprintf( &text[0], "GAME OVER" );
+				tetris_draw_text( font, board, 260, 272, &text[0] );
 			}
+
+			rect.x = i * SCREEN_WIDTH;
+			rect.y = 0;
+			SDL_BlitSurface( board, NULL, scaler->frame, &rect );
+		}
+
+		if( !changed ) {
+			SDL_Delay( 1 );
+			continue;
 		}
-		by++;
+
+		scaler_present( scaler, *screen );
 	}
-	
-	return 1;
+
+	versus_stop( &v );
+
+	for( i=humans; i<players; i++ )
+		ai_free( &ai[i] );
+
+	SDL_FreeSurface( board );
 }
 
 /*
- * tetrad_put
+ * versus_key
+ *
+ * the action of a key in versus mode and the player it is for, one
+ * human plays with the arrows and SPACE, two with WASD and SPACE for
+ * the first and the arrows and RETURN for the second
+ *
+ * returns 0 if the key does nothing
  *
  */
-void tetrad_put( Uint32 *board, struct Tetrad *t, int pattern, int tx, int ty )
+static int versus_key( int key, int humans, int *player, int *action )
 {
-	Uint32 *mask;
-	Uint32 *bptr = board;
-	int i, j;
-	int bx;
-	int by;
-	int w, h;
-
-	if ( ty < 0 )
-		return;
-
-	bx = (tx / TETRAD_WIDTH)-1;
-	by = ty / TETRAD_HEIGHT;
-	w = t->mask[pattern].w;
-	h = t->mask[pattern].h;
-
-	mask = t->mask[pattern].mask_arr;
-
-	for( i=0; i<h; i++ ) {
-		if ( by > -1 ) {
-			bptr = board + ( by * TETRIS_WIDTH ) + bx;
-			for( j=0; j<w; j++ ) {
-				if( *mask ) {
-					*bptr = t->color;
-				}
-				mask++;
-				bptr++;
-			}
-		}
-		by++;
-	}
+	if( humans == 0 )
+		return 0;
 
-#ifdef DEBUG_TETRIS
+	/* the arrows belong to the last human */
+	*player = humans - 1;
+
+	switch( key ) {
+		case SDLK_LEFT:  *action = REPLAY_LEFT;   return 1;
+		case SDLK_RIGHT: *action = REPLAY_RIGHT;  return 1;
+		case SDLK_UP:    *action = REPLAY_ROTATE; return 1;
+		case SDLK_DOWN:  *action = REPLAY_DOWN;   return 1;
+	}
 
-	bptr = board;
+	*player = 0;
 
-	fprintf( stderr, "\n\n");
+	if( key == SDLK_SPACE ) {
+		*action = REPLAY_DROP;
+		return 1;
+	}
 
-	for( i=0; i<TETRIS_HEIGHT; i++ ) {
+	if( humans < 2 )
+		return 0;
 
-		for( j=0; j<TETRIS_WIDTH; j++ ) {
+	switch( key ) {
+		case SDLK_a: *action = REPLAY_LEFT;   return 1;
+		case SDLK_d: *action = REPLAY_RIGHT;  return 1;
+		case SDLK_w: *action = REPLAY_ROTATE; return 1;
+		case SDLK_s: *action = REPLAY_DOWN;   return 1;
 
-			if ( *bptr++ ) {
-				fprintf( stderr, "1 " );
-			}
-			else
-				fprintf( stderr, "0 " );
-		}
-		fprintf( stderr, "\n");
+		case SDLK_RETURN:
+			*player = 1;
+			*action = REPLAY_DROP;
+			return 1;
 	}
 
-#endif 
+	return 0;
 }
 
 /*
- * tetris_draw_board
+ * versus_repeat
+ *
+ * queue the repeats of a held key, an ARR of 0 shifts no further than
+ * the board is wide
  *
  */
-void tetris_draw_board( SDL_Surface *surface, Uint32 *board ) 
+static void versus_repeat( struct Versus *v, int player, int action, int n )
 {
-	Uint32 *bptr = board;
-	SDL_Rect rect;
-	int i, j;
+	if( n > TETRIS_WIDTH )
+		n = TETRIS_WIDTH;
 
-	rect.h = TETRAD_HEIGHT - 1;
-	rect.w = TETRAD_WIDTH - 1;
-	
-	for( i=0; i<TETRIS_HEIGHT; i++ ) {
-		rect.y = (i * TETRAD_HEIGHT) + TETRIS_MIN_Y + 1;
-		rect.x = 1;
-		for( j=0; j<TETRIS_WIDTH; j++ ) {
-			rect.x += TETRAD_WIDTH;
-			if ( *bptr ) {
-				SDL_FillRect( surface, &rect, *bptr );
-			}
-			bptr++;
-		}
+	for( ; n>0; n-- ) {
+		if( versus_action( v, player, action ) != 0 )
+			break;
 	}
 }
 
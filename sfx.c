@@ -0,0 +1,306 @@
+/*
+SDLBlocks
+
+Description:
+Sound effects, synthesized into mixer chunks at startup and played
+from a fixed pool of channels.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <SDL/SDL.h>
+#include <SDL/SDL_mixer.h>
+
+#include "sfx.h"
+
+#define SFX_SQUARE 0
+#define SFX_SINE   1
+#define SFX_NOISE  2
+
+/* an effect is a tone sweeping from f0 to f1 Hz over ms milliseconds
+ * with a linear fade out */
+
+struct SfxTone {
+	int wave;
+	float f0;
+	float f1;
+	int ms;
+	float volume;
+};
+
+static const struct SfxTone sfx_tones[SFX_NUM] = {
+	{ SFX_SQUARE,  880.0f,  880.0f,  25, 0.15f },	/* move */
+	{ SFX_SQUARE,  660.0f,  990.0f,  40, 0.15f },	/* rotate */
+	{ SFX_NOISE,   120.0f,   60.0f,  70, 0.30f },	/* lock */
+	{ SFX_SINE,    440.0f, 1760.0f, 220, 0.35f },	/* line clear */
+	{ SFX_SINE,    523.0f, 1046.0f, 350, 0.35f },	/* level up */
+	{ SFX_SQUARE,  440.0f,  110.0f, 700, 0.30f },	/* game over */
+};
+
+static Uint8 *sfx_synth( const struct SfxTone *tone, int freq, int channels, Uint32 *len );
+static double sfx_clock( void );
+
+/*
+ * sfx_initialize
+ *
+ * synthesize every effect for the open mixer and set up the channel
+ * pool, nothing is allocated or loaded after this
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int sfx_initialize( struct Sfx *s )
+{
+	Uint16 format;
+	Uint32 len;
+	int i;
+
+	memset( s, 0, sizeof(struct Sfx) );
+
+	if( !Mix_QuerySpec( &s->freq, &format, &s->channels ) ) {
+		fprintf( stderr, "Unable to query the mixer: %s\n", Mix_GetError() );
+		return -1;
+	}
+
+	if( format != AUDIO_S16SYS ) {
+		fprintf( stderr, "Sound effects need 16 bit audio\n" );
+		return -1;
+	}
+
+	for( i=0; i<SFX_NUM; i++ ) {
+		s->pcm[i] = sfx_synth( &sfx_tones[i], s->freq, s->channels, &len );
+		if( s->pcm[i] == NULL ) {
+			sfx_free( s );
+			return -1;
+		}
+
+		s->chunk[i] = Mix_QuickLoad_RAW( s->pcm[i], len );
+		if( s->chunk[i] == NULL ) {
+			fprintf( stderr, "Unable to load a sound effect: %s\n", Mix_GetError() );
+			sfx_free( s );
+			return -1;
+		}
+	}
+
+	if( Mix_AllocateChannels( SFX_CHANNELS ) < SFX_CHANNELS ) {
+		fprintf( stderr, "Unable to allocate %d mixer channels\n", SFX_CHANNELS );
+		sfx_free( s );
+		return -1;
+	}
+
+	Mix_GroupChannels( 0, SFX_CHANNELS-1, SFX_GROUP );
+
+	s->ok = 1;
+
+	return 0;
+}
+
+/*
+ * sfx_play
+ *
+ * start an effect on a free channel of the pool, or on the one that
+ * has been playing the longest
+ *
+ * returns the channel or -1
+ *
+ */
+int sfx_play( struct Sfx *s, int effect )
+{
+	int channel;
+
+	if( s == NULL || !s->ok )
+		return -1;
+
+	channel = Mix_GroupAvailable( SFX_GROUP );
+	if( channel == -1 )
+		channel = Mix_GroupOldest( SFX_GROUP );
+	if( channel == -1 )
+		return -1;
+
+	return Mix_PlayChannel( channel, s->chunk[effect], 0 );
+}
+
+/*
+ * sfx_free
+ *
+ */
+void sfx_free( struct Sfx *s )
+{
+	int i;
+
+	/* a chunk can't be freed while it plays */
+	if( s->chunk[0] != NULL )
+		Mix_HaltGroup( SFX_GROUP );
+
+	for( i=0; i<SFX_NUM; i++ ) {
+		if( s->chunk[i] != NULL )
+			Mix_FreeChunk( s->chunk[i] );
+		free( s->pcm[i] );
+		s->chunk[i] = NULL;
+		s->pcm[i] = NULL;
+	}
+
+	s->ok = 0;
+}
+
+/*
+ * sfx_test
+ *
+ * play every effect through the dummy audio driver, then more effects
+ * at once than there are channels, and check each play got a channel
+ * and everything finished
+ *
+ * returns the exit status, 0 if the test passed
+ *
+ */
+int sfx_test( void )
+{
+	static struct Sfx sfx;
+	double start, elapsed, worst;
+	Uint32 deadline;
+	int failed;
+	int i;
+
+	putenv( "SDL_AUDIODRIVER=dummy" );
+
+	if( SDL_Init( SDL_INIT_AUDIO ) < 0 ) {
+		fprintf( stderr, "Unable to init SDL audio: %s\n", SDL_GetError() );
+		return 1;
+	}
+
+	if( Mix_OpenAudio( MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, 2, SFX_BUFFER ) != 0 ) {
+		fprintf( stderr, "Unable to initialize audio: %s\n", Mix_GetError() );
+		SDL_Quit();
+		return 1;
+	}
+
+	failed = ( sfx_initialize( &sfx ) != 0 );
+	worst = 0.0;
+
+	for( i=0; !failed && i<SFX_NUM+(SFX_CHANNELS*2); i++ ) {
+		start = sfx_clock();
+		if( sfx_play( &sfx, i % SFX_NUM ) < 0 ) {
+			fprintf( stderr, "effect %d got no channel: %s\n", i % SFX_NUM, Mix_GetError() );
+			failed = 1;
+		}
+		elapsed = sfx_clock() - start;
+		if( elapsed > worst )
+			worst = elapsed;
+	}
+
+	/* the longest effect plus a generous margin */
+	deadline = SDL_GetTicks() + 2000;
+	while( !failed && Mix_Playing( -1 ) > 0 ) {
+		if( SDL_GetTicks() > deadline ) {
+			fprintf( stderr, "effects still playing after 2 s\n" );
+			failed = 1;
+		}
+		SDL_Delay( 10 );
+	}
+
+	if( !failed )
+		printf( "sound effects ok: %d Hz, %d channels, %d sample buffer, slowest play %.1f us\n",
+				sfx.freq, sfx.channels, SFX_BUFFER, worst * 1.0e6 );
+
+	sfx_free( &sfx );
+	Mix_CloseAudio();
+	SDL_Quit();
+
+	return failed;
+}
+
+/*
+ * sfx_synth
+ *
+ * render a tone as signed 16 bit samples, len is set to its size in
+ * bytes
+ *
+ */
+static Uint8 *sfx_synth( const struct SfxTone *tone, int freq, int channels, Uint32 *len )
+{
+	Sint16 *pcm;
+	Uint32 noise;
+	double phase, f, amp;
+	int frames;
+	int value;
+	int i, c;
+
+	frames = ( freq * tone->ms ) / 1000;
+	*len = frames * channels * sizeof(Sint16);
+
+	pcm = malloc( *len );
+	if( pcm == NULL ) {
+		fprintf( stderr, "Out of memory\n" );
+		return NULL;
+	}
+
+	phase = 0.0;
+	noise = 0x12345678;
+
+	for( i=0; i<frames; i++ ) {
+		f = tone->f0 + ( ( tone->f1 - tone->f0 ) * i ) / frames;
+		amp = tone->volume * ( 1.0 - ( (double)i / frames ) );
+
+		phase += f / freq;
+		if( phase >= 1.0 )
+			phase -= 1.0;
+
+		switch( tone->wave ) {
+			case SFX_SQUARE:
+				value = ( phase < 0.5 ) ? 32767 : -32767;
+				break;
+			case SFX_SINE:
+				value = 32767 * sin( 2.0 * M_PI * phase );
+				break;
+			default:
+				/* noise through a square at f, a thump rather than a hiss */
+				noise ^= noise << 13;
+				noise ^= noise >> 17;
+				noise ^= noise << 5;
+				value = ( ( phase < 0.5 ) ? 24000 : -24000 ) + (Sint16)( noise & 0x1fff ) - 0x1000;
+				break;
+		}
+
+		for( c=0; c<channels; c++ )
+			pcm[(i*channels)+c] = value * amp;
+	}
+
+	return (Uint8 *)pcm;
+}
+
+/*
+ * sfx_clock
+ *
+ * monotonic time in seconds
+ *
+ */
+static double sfx_clock( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ( ts.tv_nsec / 1.0e9 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
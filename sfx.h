@@ -0,0 +1,67 @@
+/*
+SDLBlocks
+
+Description:
+Sound effects, synthesized into mixer chunks at startup and played
+from a fixed pool of channels.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef SFX_H
+#define SFX_H
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_mixer.h>
+
+/* mixer buffer in samples, half the old 1024 for half the latency */
+#define SFX_BUFFER 512
+
+/* mixer channels kept for the effects, the oldest effect is cut off
+ * when all of them are playing */
+#define SFX_CHANNELS 8
+#define SFX_GROUP 1
+
+/* effects */
+#define SFX_MOVE   0
+#define SFX_ROTATE 1
+#define SFX_LOCK   2
+#define SFX_CLEAR  3
+#define SFX_LEVEL  4
+#define SFX_OVER   5
+#define SFX_NUM    6
+
+struct Sfx {
+	int ok;
+
+	/* the mixer output format the effects were synthesized for */
+	int freq;
+	int channels;
+
+	Uint8 *pcm[SFX_NUM];
+	Mix_Chunk *chunk[SFX_NUM];
+};
+
+int  sfx_initialize( struct Sfx *s );
+int  sfx_play( struct Sfx *s, int effect );
+void sfx_free( struct Sfx *s );
+int  sfx_test( void );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,455 @@
+/*
+SDLBlocks
+
+Description:
+blocksterm: plays and watches games in a terminal, without a
+display.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "game.h"
+#include "replay.h"
+#include "ansi.h"
+
+/* keys read from the terminal in one go */
+#define TERM_MAX_KEYS 64
+
+/* how long the end of a replay stays on screen (ms) */
+#define TERM_REPLAY_TAIL 3000
+
+static volatile sig_atomic_t term_quit;
+static volatile sig_atomic_t term_resized;
+
+static struct termios term_saved;
+static int term_raw;
+
+/* term_input -- stdin is still open */
+static int term_input = 1;
+
+static void term_live( struct Ansi *ansi, int autoplay, int use_beam, Uint32 frame_ms );
+static int  term_replay( struct Ansi *ansi, const char *path, Uint32 frame_ms );
+static void term_draw_snapshot( struct Ansi *ansi, struct GameSnapshot *snap );
+static int  term_read_keys( SDLKey *keys );
+static void term_wait( Uint32 ms );
+static void term_signal( int sig );
+
+/*
+ * blocksterm
+ *
+ * usage: blocksterm [-autoplay] [-beam] [-fps n] [-stats] [-replay file]
+ *
+ * plays the game in a terminal with the same simulation as sdlblocks,
+ * or plays a replay back in real time. the arrow keys and space play,
+ * p pauses, a toggles the AI, q quits. terminals only report key presses, each
+ * one is passed on as a press and a release, held keys repeat at the
+ * terminal's rate.
+ *
+ * -stats prints the number of frames and bytes sent on exit.
+ *
+ */
+
+int main( int argc, char *argv[] )
+{
+	static struct Ansi ansi;
+	struct termios raw;
+	char *replay_path;
+	int autoplay;
+	int use_beam;
+	int stats;
+	int fps;
+	int ret;
+	int i;
+
+	autoplay = 0;
+	use_beam = 0;
+	stats = 0;
+	fps = 60;
+	replay_path = NULL;
+
+	for( i=1; i<argc; i++ ) {
+		if( !strcmp( argv[i], "-autoplay" ) )
+			autoplay = 1;
+		else if( !strcmp( argv[i], "-beam" ) )
+			use_beam = 1;
+		else if( !strcmp( argv[i], "-stats" ) )
+			stats = 1;
+		else if( !strcmp( argv[i], "-fps" ) && ( i+1 < argc ) )
+			fps = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-replay" ) && ( i+1 < argc ) )
+			replay_path = argv[++i];
+		else
+			break;
+	}
+
+	if( i < argc || fps < 1 || fps > 1000 ) {
+		fprintf( stderr, "usage: %s [-autoplay] [-beam] [-fps n] [-stats] [-replay file]\n", argv[0] );
+		exit( 1 );
+	}
+
+	/* the clock and the threads, there is no video */
+	if( SDL_Init( SDL_INIT_TIMER ) < 0 ) {
+		fprintf( stderr, "Unable to init SDL: %s\n", SDL_GetError() );
+		exit( 1 );
+	}
+
+	srand( (unsigned int) time( (time_t *)NULL ) );
+
+	signal( SIGINT, term_signal );
+	signal( SIGTERM, term_signal );
+	signal( SIGWINCH, term_signal );
+
+	/* read keys as they are pressed, without echo */
+	if( isatty( STDIN_FILENO ) && tcgetattr( STDIN_FILENO, &term_saved ) == 0 ) {
+		raw = term_saved;
+		raw.c_lflag &= ~( ICANON | ECHO );
+		raw.c_cc[VMIN] = 0;
+		raw.c_cc[VTIME] = 0;
+		term_raw = ( tcsetattr( STDIN_FILENO, TCSANOW, &raw ) == 0 );
+	}
+
+	ansi_initialize( &ansi, STDOUT_FILENO );
+
+	ret = 0;
+
+	if( replay_path != NULL )
+		ret = term_replay( &ansi, replay_path, 1000 / fps );
+	else
+		term_live( &ansi, autoplay, use_beam, 1000 / fps );
+
+	ansi_restore( &ansi );
+
+	if( term_raw )
+		tcsetattr( STDIN_FILENO, TCSANOW, &term_saved );
+
+	if( stats && ansi.frames > 0 )
+		fprintf( stderr, "%llu frames, %llu bytes, %.1f bytes per frame\n",
+				(unsigned long long)ansi.frames, (unsigned long long)ansi.bytes,
+				(double)ansi.bytes / ansi.frames );
+
+	SDL_Quit();
+
+	return ret;
+}
+
+/*
+ * term_live
+ *
+ * run the simulation thread and draw its snapshots, at most one frame
+ * every frame_ms and only when the snapshot changed
+ *
+ */
+static void term_live( struct Ansi *ansi, int autoplay, int use_beam, Uint32 frame_ms )
+{
+	static struct Game game;
+	struct GameSnapshot *snap;
+	SDLKey keys[TERM_MAX_KEYS];
+	Uint32 now, next;
+	int n;
+	int i;
+
+	game_initialize( &game, 0, autoplay, use_beam, NULL, NULL, NULL, REPEAT_DAS, REPEAT_ARR );
+
+	if( game_thread_start( &game ) != 0 ) {
+		fprintf( stderr, "Unable to start the game thread: %s\n", SDL_GetError() );
+		game_free( &game );
+		return;
+	}
+
+	next = SDL_GetTicks();
+
+	while( !term_quit ) {
+
+		n = term_read_keys( keys );
+		for( i=0; i<n; i++ ) {
+			game_key( &game, keys[i], 1 );
+			game_key( &game, keys[i], 0 );
+		}
+
+		now = SDL_GetTicks();
+
+		if( (Sint32)( next - now ) > 0 ) {
+			term_wait( next - now );
+			continue;
+		}
+
+		next += frame_ms;
+		if( (Sint32)( now - next ) > (Sint32)frame_ms )
+			next = now + frame_ms;
+
+		if( term_resized ) {
+			term_resized = 0;
+			ansi->full = 1;
+		}
+
+		if( !game_snapshot( &game, &snap ) && !ansi->full )
+			continue;
+
+		term_draw_snapshot( ansi, snap );
+		ansi_flush( ansi );
+	}
+
+	game_thread_stop( &game );
+	game_free( &game );
+}
+
+/*
+ * term_replay
+ *
+ * play a replay back in real time, as blocksexport does frame by frame
+ *
+ * returns 0 when the replay played to the end in sync, 1 otherwise
+ *
+ */
+static int term_replay( struct Ansi *ansi, const char *path, Uint32 frame_ms )
+{
+	static struct Replay replay;
+	struct Tetris t;
+	SDLKey keys[TERM_MAX_KEYS];
+	Uint8 actions[REPLAY_MAX_ACTIONS];
+	Uint32 rec_time, start, now, next;
+	Uint32 end_time;
+	int num_actions;
+	int status;
+	int ended;
+	int synced;
+	int changed;
+	int i;
+
+	if( replay_open( &replay, path ) != 0 )
+		return 1;
+
+	tetris_initialize( &t );
+	tetris_seed( &t, replay.hdr.seed );
+	tetris_start( &t );
+	t.next_time = replay.hdr.next_time;
+
+	status = replay_read( &replay, &rec_time, actions, &num_actions );
+	ended = 0;
+	synced = 0;
+	changed = 1;
+	end_time = 0;
+
+	start = SDL_GetTicks();
+	next = start;
+
+	while( !term_quit ) {
+
+		term_read_keys( keys );
+
+		now = SDL_GetTicks();
+
+		if( ended && (Sint32)( now - end_time ) >= 0 )
+			break;
+
+		if( (Sint32)( next - now ) > 0 ) {
+			term_wait( next - now );
+			continue;
+		}
+
+		next += frame_ms;
+		if( (Sint32)( now - next ) > (Sint32)frame_ms )
+			next = now + frame_ms;
+
+		/* play every record up to now */
+		while( !ended && rec_time <= now - start ) {
+			if( status != 1 ) {
+				synced = ( status == 0 && replay.end.score == t.game_score &&
+						replay.end.lines == t.game_total_num_lines_cleared &&
+						replay.end.pieces == t.game_num_pieces );
+				ended = 1;
+				end_time = now + TERM_REPLAY_TAIL;
+				changed = 1;
+				break;
+			}
+
+			for( i=0; i<num_actions; i++ )
+				replay_apply( &t, actions[i] );
+
+			tetris_tick( &t, rec_time );
+			changed = 1;
+
+			status = replay_read( &replay, &rec_time, actions, &num_actions );
+		}
+
+		if( term_resized ) {
+			term_resized = 0;
+			ansi->full = 1;
+		}
+
+		if( !changed && !ansi->full )
+			continue;
+
+		ansi_clear( ansi );
+		ansi_draw_game( ansi, &t );
+
+		if( t.state == TETRIS_STATE_OVER )
+			ansi_text( ansi, 7, ANSI_TEXT_COL, "GAME OVER" );
+		else if( !ended )
+			ansi_text( ansi, 7, ANSI_TEXT_COL, "REPLAY" );
+
+		ansi_flush( ansi );
+		changed = 0;
+	}
+
+	replay_close( &replay );
+
+	if( ended && !synced )
+		fprintf( stderr, "Replay out of sync or truncated\n" );
+
+	return !( ended && synced );
+}
+
+/*
+ * term_draw_snapshot
+ *
+ * the game and the same status text and high-score table as sdlblocks
+ *
+ */
+static void term_draw_snapshot( struct Ansi *ansi, struct GameSnapshot *snap )
+{
+	char text[64];
+	int i;
+
+	ansi_clear( ansi );
+	ansi_draw_game( ansi, &snap->tetris );
+
+	if( snap->num_top > 0 ) {
+		sprintf( &text[0], "best:  %d", snap->top[0] );
+		ansi_text( ansi, 5, ANSI_TEXT_COL, &text[0] );
+	}
+
+	if( snap->rewinding )
+		ansi_text( ansi, 7, ANSI_TEXT_COL, "REWIND" );
+	else if( snap->attract )
+		ansi_text( ansi, 7, ANSI_TEXT_COL, "DEMO" );
+	else if( snap->autoplay && TETRIS_PLAYING( &snap->tetris ) )
+		ansi_text( ansi, 7, ANSI_TEXT_COL, "AUTOPLAY" );
+	else if( snap->tetris.state == TETRIS_STATE_PAUSE )
+		ansi_text( ansi, 7, ANSI_TEXT_COL, "PAUSE" );
+	else if( snap->tetris.state == TETRIS_STATE_START )
+		ansi_text( ansi, 7, ANSI_TEXT_COL, "PRESS SPACE..." );
+	else if( snap->tetris.state == TETRIS_STATE_OVER )
+		ansi_text( ansi, 7, ANSI_TEXT_COL, "GAME OVER" );
+
+	/* high-score table between games */
+	if( snap->scores_ok && ( snap->tetris.state == TETRIS_STATE_START || snap->tetris.state == TETRIS_STATE_OVER ) && !snap->rewinding ) {
+		ansi_text( ansi, 9, ANSI_TEXT_COL, "HIGH SCORES" );
+		for( i=0; i<snap->num_top; i++ ) {
+			sprintf( &text[0], "%2d %9d", i+1, snap->top[i] );
+			ansi_text( ansi, 10 + i, ANSI_TEXT_COL, &text[0] );
+		}
+	}
+}
+
+/*
+ * term_read_keys
+ *
+ * read the keys pressed since the last call, the arrow keys come as
+ * escape sequences. q quits.
+ *
+ * returns the number of keys
+ *
+ */
+static int term_read_keys( SDLKey *keys )
+{
+	unsigned char buf[TERM_MAX_KEYS];
+	struct pollfd pfd;
+	ssize_t len;
+	int n;
+	int i;
+
+	pfd.fd = STDIN_FILENO;
+	pfd.events = POLLIN;
+
+	if( !term_input || poll( &pfd, 1, 0 ) < 1 )
+		return 0;
+
+	len = read( STDIN_FILENO, buf, sizeof(buf) );
+	n = 0;
+
+	/* keys can also be piped in, stop reading at the end */
+	if( len == 0 && !term_raw )
+		term_input = 0;
+
+	for( i=0; i<len; i++ ) {
+		if( buf[i] == 0x1b && i+2 < len && ( buf[i+1] == '[' || buf[i+1] == 'O' ) ) {
+			switch( buf[i+2] ) {
+				case 'A': keys[n++] = SDLK_UP; break;
+				case 'B': keys[n++] = SDLK_DOWN; break;
+				case 'C': keys[n++] = SDLK_RIGHT; break;
+				case 'D': keys[n++] = SDLK_LEFT; break;
+			}
+			i += 2;
+		}
+		else if( buf[i] == 'q' ) {
+			term_quit = 1;
+		}
+		else if( buf[i] == 0x7f || buf[i] == 0x08 ) {
+			keys[n++] = SDLK_BACKSPACE;
+		}
+		else if( buf[i] >= ' ' && buf[i] < 0x7f ) {
+			/* SDL keys of printable characters are the characters */
+			keys[n++] = (SDLKey)buf[i];
+		}
+	}
+
+	return n;
+}
+
+/*
+ * term_wait
+ *
+ * sleep for up to ms, or until a key is pressed
+ *
+ */
+static void term_wait( Uint32 ms )
+{
+	struct pollfd pfd;
+
+	/* poll ignores a negative fd, and just sleeps */
+	pfd.fd = term_input ? STDIN_FILENO : -1;
+	pfd.events = POLLIN;
+
+	poll( &pfd, 1, ms );
+}
+
+/*
+ * term_signal
+ *
+ */
+static void term_signal( int sig )
+{
+	if( sig == SIGWINCH )
+		term_resized = 1;
+	else
+		term_quit = 1;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
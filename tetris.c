@@ -0,0 +1,975 @@
+/*
+SDLBlocks
+ 
+Description:
+Game board, tetrad types and game rules.
+ 
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+
+static int  tetris_state_idle( struct Tetris *t, Uint32 now );
+static int  tetris_state_spawn( struct Tetris *t, Uint32 now );
+static int  tetris_state_fall( struct Tetris *t, Uint32 now );
+static int  tetris_state_drop( struct Tetris *t, Uint32 now );
+static int  tetris_state_lock( struct Tetris *t, Uint32 now );
+static int  tetris_state_clear( struct Tetris *t, Uint32 now );
+static int  tetris_state_pause( struct Tetris *t, Uint32 now );
+static void tetris_enter( struct Tetris *t, int state, Uint32 now );
+static int  tetris_lock( struct Tetris *t, Uint32 now );
+static int  tetris_fall( struct Tetris *t );
+static int  tetris_can_fall( struct Tetris *t );
+static void tetris_set_pattern( struct Tetris *t, int pattern );
+
+/* state handlers, indexed by TETRIS_STATE_* */
+static int (* const tetris_state[TETRIS_NUM_STATES])( struct Tetris *t, Uint32 now ) = {
+	tetris_state_idle,	/* TETRIS_STATE_START */
+	tetris_state_spawn,
+	tetris_state_fall,
+	tetris_state_drop,
+	tetris_state_lock,
+	tetris_state_clear,
+	tetris_state_pause,
+	tetris_state_idle	/* TETRIS_STATE_OVER */
+};
+
+/* versus mode: garbage rows sent for a clear of 0..4 rows */
+static const Uint32 tetris_attack[5] = { 0, 0, 1, 2, 4 };
+
+/* tetrad patterns */
+
+/* ### */
+/* #   */
+
+struct TetradMask tetrad_0_mask[4] = {
+	
+	{ 3, 2, { 
+			1, 1, 1, 
+			1, 0, 0, 
+			} },
+
+	{ 2, 3, { 
+			1, 1, 
+			0, 1, 
+			0, 1,
+			} },
+	
+	{ 3, 2, { 
+			0, 0, 1, 
+			1, 1, 1, 
+			} },
+	
+	{ 2, 3, { 
+			1, 0, 
+			1, 0, 
+			1, 1,
+			} }
+};
+
+/* ### */
+/*   # */
+
+struct TetradMask tetrad_1_mask[4] = {
+	
+	{ 3, 2, { 
+			1, 1, 1, 
+			0, 0, 1, 
+			} },
+
+	{ 2, 3, { 
+			0, 1, 
+			0, 1, 
+			1, 1,
+			} },
+	
+	{ 3, 2, { 
+			1, 0, 0, 
+			1, 1, 1, 
+			} },
+	
+	{ 2, 3, { 
+			1, 1,
+			1, 0,
+			1, 0,
+			} }
+};
+
+/* ### */
+/*  #  */
+
+struct TetradMask tetrad_2_mask[4] = {
+	
+	{ 3, 2, { 
+			1, 1, 1, 
+			0, 1, 0, 
+			} },
+
+	{ 2, 3, { 
+			0, 1,
+			1, 1,
+			0, 1,
+			} },
+	
+	{ 3, 2, { 
+			0, 1, 0, 
+			1, 1, 1, 
+			} },
+	
+	{ 2, 3, { 
+			1, 0,
+			1, 1,
+			1, 0,
+			} }
+};
+
+/*  ## */
+/* ##  */
+
+struct TetradMask tetrad_3_mask[2] = {
+	
+	{ 3, 2, { 
+			0, 1, 1, 
+			1, 1, 0, 
+			} },
+
+	{ 2, 3, { 
+			1, 0,
+			1, 1,
+			0, 1,
+			} }
+};
+
+/* ##  */
+/*  ## */
+
+struct TetradMask tetrad_4_mask[2] = {
+	
+	{ 3, 2, { 
+			1, 1, 0, 
+			0, 1, 1, 
+			} },
+
+	{ 2, 3, { 
+			0, 1, 
+			1, 1, 
+			1, 0,
+			} }
+};
+
+/* #### */
+
+struct TetradMask tetrad_5_mask[2] = {
+	
+	{ 4, 1, { 
+			1, 1, 1, 1, 0, 0
+			} },
+	{ 1, 4, { 
+			1, 
+			1,
+			1,
+			1,
+			0, 0
+			} }
+};
+
+/* ## */
+/* ## */
+
+struct TetradMask tetrad_6_mask[1] = {
+	
+	{ 2, 2, { 
+			1, 1,
+			1, 1,
+			0, 0
+			} }
+};
+
+struct Tetrad tetrad[MAX_TETRAD] = {
+	{4, 0xff00ff, &tetrad_0_mask[0]},
+	{4, 0xffffff, &tetrad_1_mask[0]},
+	{4, 0xffff00, &tetrad_2_mask[0]},
+	{2, 0x00ff00, &tetrad_3_mask[0]},
+	{2, 0x00ffff, &tetrad_4_mask[0]},
+	{2, 0xff0000, &tetrad_5_mask[0]},
+	{1, 0x0000ff, &tetrad_6_mask[0]}
+};
+
+/*
+ * tetris_initialize
+ *
+ * initialize tetris game variables
+ *
+ * input:
+ *
+ * struct Tetris * tetris - point to type struct Tetris
+ *
+ * output: none
+ *
+ */
+
+void tetris_initialize( struct Tetris *tetris )
+{
+	if( tetris != NULL ) {
+
+		Uint32 *board = &(tetris->board[0][0]);
+		memset( board, 0, (TETRIS_HEIGHT*TETRIS_WIDTH)*sizeof(Uint32) );
+
+		tetris->state = TETRIS_STATE_START;
+		tetris->state_time = 0;
+		tetris->game_pause = 0;
+		tetris->resume_state = TETRIS_STATE_START;
+		tetris->resume_time = 0;
+
+		tetris->cur_tetrad = 0;
+		tetris->cur_pattern = 0;
+		tetris->t = &tetrad[tetris->cur_tetrad];
+		tetris->tx = START_X;
+		tetris->ty = START_Y;
+		tetris_set_pattern( tetris, tetris->cur_pattern );
+
+		tetris->now = 0;
+		tetris->next_time = 0;
+		tetris->tetrad_drop_rate = 500;
+		tetris->lock_delay = TETRIS_LOCK_DELAY;
+		tetris->clear_delay = TETRIS_CLEAR_DELAY;
+		tetris->clear_rows = 0;
+
+		tetris->game_score = 0;
+		tetris->game_level = 0;
+		tetris->game_total_num_lines_cleared = 0;
+		tetris->game_cur_num_lines_cleared = 0;
+		tetris->game_num_pieces = 0;
+
+		tetris->lock_tetrad = 0;
+		tetris->lock_pattern = -1;
+		tetris->lock_tx = 0;
+		tetris->lock_ty = 0;
+		tetris->last_lines = 0;
+
+		tetris->garbage_in = 0;
+		tetris->garbage_hole = 0;
+		tetris->garbage_out = 0;
+
+		tetris_seed( tetris, 1 );
+	}
+}
+
+/*
+ * tetris_seed
+ *
+ * seed the random number generator and deal the upcoming tetrads,
+ * the same seed always produces the same sequence of tetrads
+ *
+ */
+void tetris_seed( struct Tetris *t, Uint32 seed )
+{
+	int i;
+
+	/* xorshift gets stuck at zero */
+	t->rng = seed ? seed : 0x9e3779b9;
+
+	for( i=0; i<TETRIS_NUM_NEXT; i++ )
+		t->next_tetrad[i] = tetris_random( t ) % MAX_TETRAD;
+}
+
+/*
+ * tetris_random
+ *
+ * xorshift32
+ *
+ */
+Uint32 tetris_random( struct Tetris *t )
+{
+	Uint32 x = t->rng;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	t->rng = x;
+
+	return x;
+}
+
+/*
+ * tetris_start
+ *
+ * leave the start screen, the next tick spawns the first tetrad
+ *
+ */
+void tetris_start( struct Tetris *t )
+{
+	t->state = TETRIS_STATE_SPAWN;
+}
+
+/*
+ * tetris_tick
+ *
+ * run the game logic for one pass of the game loop: the handler of the
+ * current state lets the active tetrad fall, locks it, clears filled
+ * rows and spawns the next one
+ *
+ * now - current time in ms, drives the drop rate and the delays
+ *
+ * returns a mask of TETRIS_EVENT_* describing what happened
+ *
+ */
+int tetris_tick( struct Tetris *t, Uint32 now )
+{
+	t->now = now;
+
+	/* the pause switch stops a game in progress in whatever state */
+	if( t->game_pause && TETRIS_PLAYING( t ) ) {
+		t->resume_state = t->state;
+		t->resume_time = t->state_time;
+		tetris_enter( t, TETRIS_STATE_PAUSE, now );
+		return 0;
+	}
+
+	return tetris_state[t->state]( t, now );
+}
+
+/*
+ * tetris_state_idle
+ *
+ * the start screen and game over, nothing happens until the game is
+ * started or initialized again
+ *
+ */
+static int tetris_state_idle( struct Tetris *t, Uint32 now )
+{
+	return 0;
+}
+
+/*
+ * tetris_state_spawn
+ *
+ */
+static int tetris_state_spawn( struct Tetris *t, Uint32 now )
+{
+	/* garbage rises before the next tetrad, a stack pushed out the top is lost */
+	if( t->garbage_in ) {
+		if( tetris_garbage( t, t->garbage_in, t->garbage_hole ) != 0 ) {
+			tetris_enter( t, TETRIS_STATE_OVER, now );
+			return TETRIS_EVENT_OVER;
+		}
+		t->garbage_in = 0;
+	}
+
+	tetris_next_tetrad( t );
+
+	/* check for game over */
+	if( !tetrad_move( &(t->board[0][0]), t->t, t->cur_pattern, t->tx, t->ty ) ) {
+		tetris_enter( t, TETRIS_STATE_OVER, now );
+		return TETRIS_EVENT_OVER;
+	}
+
+	/* every tetrad gets a full drop interval before it first falls */
+	t->next_time = now;
+	tetris_enter( t, TETRIS_STATE_FALL, now );
+
+	return TETRIS_EVENT_SPAWN;
+}
+
+/*
+ * tetris_state_fall
+ *
+ * move the active tetrad down one row every tetrad_drop_rate ms, the
+ * lock delay starts as soon as it lands
+ *
+ */
+static int tetris_state_fall( struct Tetris *t, Uint32 now )
+{
+	int events;
+
+	events = 0;
+
+	if( ( now - t->next_time ) >= t->tetrad_drop_rate ) {
+		t->next_time = now;
+		if( tetris_fall( t ) )
+			events |= TETRIS_EVENT_MOVE;
+	}
+
+	if( !tetris_can_fall( t ) )
+		tetris_enter( t, TETRIS_STATE_LOCK, now );
+
+	return events;
+}
+
+/*
+ * tetris_state_drop
+ *
+ * a dropped tetrad falls one row per tick and locks without a delay
+ *
+ */
+static int tetris_state_drop( struct Tetris *t, Uint32 now )
+{
+	if( tetris_fall( t ) )
+		return TETRIS_EVENT_MOVE;
+
+	return tetris_lock( t, now );
+}
+
+/*
+ * tetris_state_lock
+ *
+ * the tetrad locks when it still rests on the stack after lock_delay,
+ * moved off a ledge it falls again
+ *
+ */
+static int tetris_state_lock( struct Tetris *t, Uint32 now )
+{
+	if( tetris_can_fall( t ) ) {
+		tetris_enter( t, TETRIS_STATE_FALL, now );
+		return 0;
+	}
+
+	if( ( now - t->state_time ) >= t->lock_delay )
+		return tetris_lock( t, now );
+
+	return 0;
+}
+
+/*
+ * tetris_state_clear
+ *
+ * remove the filled rows once they have flashed for clear_delay and
+ * update the score and level
+ *
+ */
+static int tetris_state_clear( struct Tetris *t, Uint32 now )
+{
+	Uint32 level;
+
+	if( ( now - t->state_time ) < t->clear_delay )
+		return 0;
+
+	level = t->game_level;
+
+	tetris_update( t );
+	tetris_level_up( t );
+
+	t->clear_rows = 0;
+	tetris_enter( t, TETRIS_STATE_SPAWN, now );
+
+	return ( t->game_level != level ) ? TETRIS_EVENT_LEVEL : 0;
+}
+
+/*
+ * tetris_state_pause
+ *
+ * wait for the pause switch, then go back to the interrupted state
+ * with its timers moved on by the length of the pause
+ *
+ */
+static int tetris_state_pause( struct Tetris *t, Uint32 now )
+{
+	Uint32 paused;
+
+	if( t->game_pause )
+		return 0;
+
+	paused = now - t->state_time;
+
+	t->next_time += paused;
+	t->state = t->resume_state;
+	t->state_time = t->resume_time + paused;
+
+	return 0;
+}
+
+/*
+ * tetris_enter
+ *
+ */
+static void tetris_enter( struct Tetris *t, int state, Uint32 now )
+{
+	t->state = state;
+	t->state_time = now;
+}
+
+/*
+ * tetris_lock
+ *
+ * place the active tetrad on the board and flash the rows it filled,
+ * if any, before the next tetrad
+ *
+ */
+static int tetris_lock( struct Tetris *t, Uint32 now )
+{
+	Uint32 *bptr;
+	int i, j;
+
+	t->lock_tetrad = t->cur_tetrad;
+	t->lock_pattern = t->cur_pattern;
+	t->lock_tx = t->tx;
+	t->lock_ty = t->ty;
+
+	tetrad_put( &(t->board[0][0]), t->t, t->cur_pattern, t->tx, t->ty );
+
+	/* only the rows the tetrad covers can have been filled */
+	t->clear_rows = 0;
+	t->last_lines = 0;
+
+	for( i=t->ty/TETRAD_HEIGHT; i<TETRIS_HEIGHT && i<(t->ty/TETRAD_HEIGHT)+t->t->mask[t->cur_pattern].h; i++ ) {
+		bptr = &(t->board[i][0]);
+		for( j=0; j<TETRIS_WIDTH && bptr[j]; j++ )
+			;
+		if( j == TETRIS_WIDTH ) {
+			t->clear_rows |= 1 << i;
+			t->last_lines++;
+		}
+	}
+
+	if( t->clear_rows ) {
+		tetris_enter( t, TETRIS_STATE_CLEAR, now );
+		return TETRIS_EVENT_LOCK | TETRIS_EVENT_CLEAR;
+	}
+
+	tetris_enter( t, TETRIS_STATE_SPAWN, now );
+
+	return TETRIS_EVENT_LOCK;
+}
+
+/*
+ * tetris_fall
+ *
+ * returns 1 if the active tetrad moved down a row
+ *
+ */
+static int tetris_fall( struct Tetris *t )
+{
+	if( !tetris_can_fall( t ) )
+		return 0;
+
+	t->ty += TETRAD_HEIGHT;
+
+	return 1;
+}
+
+/*
+ * tetris_can_fall
+ *
+ */
+static int tetris_can_fall( struct Tetris *t )
+{
+	return ( t->ty + TETRAD_HEIGHT <= t->max_y ) &&
+		tetrad_move( &(t->board[0][0]), t->t, t->cur_pattern, t->tx, t->ty + TETRAD_HEIGHT );
+}
+
+/*
+ * tetris_set_pattern
+ *
+ * make pattern the active one and update the limits of the position
+ *
+ */
+static void tetris_set_pattern( struct Tetris *t, int pattern )
+{
+	t->cur_pattern = pattern;
+	t->max_x = TETRIS_MAX_X - ( t->t->mask[pattern].w * TETRAD_WIDTH );
+	t->max_y = TETRIS_MAX_Y - ( t->t->mask[pattern].h * TETRAD_HEIGHT );
+}
+
+/*
+ * tetris_next_tetrad
+ *
+ * make the next tetrad in line the active one, at the top of the board
+ *
+ */
+void tetris_next_tetrad( struct Tetris *t )
+{
+	int i;
+
+	t->cur_tetrad = t->next_tetrad[0];
+
+	for( i=0; i<TETRIS_NUM_NEXT-1; i++ )
+		t->next_tetrad[i] = t->next_tetrad[i+1];
+	t->next_tetrad[TETRIS_NUM_NEXT-1] = tetris_random( t ) % MAX_TETRAD;
+
+	t->game_num_pieces++;
+
+	t->t = &tetrad[t->cur_tetrad];
+
+	t->tx = START_X;
+	t->ty = 0;
+
+	tetris_set_pattern( t, 0 );
+}
+
+/*
+ * tetris_move_left
+ *
+ * returns 1 if the active tetrad moved
+ *
+ */
+int tetris_move_left( struct Tetris *t )
+{
+	int prev_tx;
+
+	if( !TETRIS_ACTIVE( t ) )
+		return 0;
+
+	prev_tx = t->tx;
+
+	t->tx -= TETRAD_WIDTH;
+
+	if( t->tx < (TETRIS_MIN_X+1) )
+		t->tx = (TETRIS_MIN_X+1);
+
+	/* make sure we can move into this position */
+	if( !tetrad_move( &(t->board[0][0]), t->t, t->cur_pattern, t->tx, t->ty ) ) {
+		/* move the tetrad back */
+		t->tx = prev_tx;
+	}
+
+	return ( t->tx != prev_tx );
+}
+
+/*
+ * tetris_move_right
+ *
+ * returns 1 if the active tetrad moved
+ *
+ */
+int tetris_move_right( struct Tetris *t )
+{
+	int prev_tx;
+
+	if( !TETRIS_ACTIVE( t ) )
+		return 0;
+
+	prev_tx = t->tx;
+
+	t->tx += TETRAD_WIDTH;
+
+	if( t->tx > t->max_x )
+		t->tx = t->max_x;
+
+	/* make sure we can move into this position */
+	if( !tetrad_move( &(t->board[0][0]), t->t, t->cur_pattern, t->tx, t->ty ) ) {
+		/* move the tetrad back */
+		t->tx = prev_tx;
+	}
+
+	return ( t->tx != prev_tx );
+}
+
+/*
+ * tetris_rotate
+ *
+ * returns 1 if the active tetrad rotated
+ *
+ */
+int tetris_rotate( struct Tetris *t )
+{
+	int prev_pattern;
+
+	if( !TETRIS_ACTIVE( t ) )
+		return 0;
+
+	prev_pattern = t->cur_pattern;
+
+	tetris_set_pattern( t, ( prev_pattern + 1 ) % t->t->num_patterns );
+
+	/* 
+	 * check the position of the new tetrad
+	 * make sure that it can be placed along
+	 * the right edge and the bottom of the game board
+	 */
+
+	if( t->tx > t->max_x || t->ty > t->max_y ||
+			!tetrad_move( &(t->board[0][0]), t->t, t->cur_pattern, t->tx, t->ty ) ) {
+		/* move the tetrad back */
+		tetris_set_pattern( t, prev_pattern );
+	}
+
+	return ( t->cur_pattern != prev_pattern );
+}
+
+/*
+ * tetris_move_down
+ *
+ * returns 1 if the active tetrad moved
+ *
+ */
+int tetris_move_down( struct Tetris *t )
+{
+	if( !TETRIS_ACTIVE( t ) )
+		return 0;
+
+	return tetris_fall( t );
+}
+
+/*
+ * tetris_drop
+ *
+ * drop the active tetrad, it falls one row per tick until it lands
+ *
+ */
+void tetris_drop( struct Tetris *t )
+{
+	if( TETRIS_ACTIVE( t ) )
+		t->state = TETRIS_STATE_DROP;
+}
+
+/*
+ * tetris_pause
+ *
+ * flip the pause switch of a game in progress, the next tick stops or
+ * resumes the game
+ *
+ * returns 1 if the game is paused now
+ *
+ */
+int tetris_pause( struct Tetris *t )
+{
+	if( TETRIS_PLAYING( t ) || t->state == TETRIS_STATE_PAUSE )
+		t->game_pause = !t->game_pause;
+
+	return t->game_pause;
+}
+
+/*
+ * tetris_update
+ *
+ * check the tetris game board for filled rows and remove them if they are found
+ * and accumulate points.
+ *
+ */
+void tetris_update( struct Tetris *t )
+{
+	Uint32 num_lines_cleared;
+	Uint32 attack;
+	int i, j;
+	int n;
+	int dst;
+
+	num_lines_cleared = 0;
+
+	/* from the bottom up, move every row that isn't filled down over
+	 * the filled rows below it, each row is copied at most once */
+	dst = TETRIS_HEIGHT - 1;
+
+	for( i=TETRIS_HEIGHT-1; i>-1; i-- ) {
+		n = 0;
+		for( j=0; j<TETRIS_WIDTH; j++ ) {
+			if( t->board[i][j] )
+				n++;
+		}
+
+		if( n == TETRIS_WIDTH ) {
+			num_lines_cleared++;
+			if( i == 0 )
+				memset( t->board[0], 0, sizeof(t->board[0]) );
+			continue;
+		}
+
+		if( dst != i )
+			memcpy( t->board[dst], t->board[i], sizeof(t->board[0]) );
+		dst--;
+	}
+
+	/* the rows left over at the top repeat the top row, as they did when
+	 * each clear shifted the board down a row, so that recorded games
+	 * still play back the same. row 0 is never written over. */
+	for( i=1; i<=dst; i++ )
+		memcpy( t->board[i], t->board[0], sizeof(t->board[0]) );
+
+	/* update game score */
+	t->game_score += tetris_score( t->game_level, num_lines_cleared );
+	t->game_total_num_lines_cleared += num_lines_cleared;
+	t->game_cur_num_lines_cleared += num_lines_cleared;
+
+	/* check for tilt, if so then reset the score */
+	if( t->game_score > 9999999 ) {
+		t->game_score = 0;
+	}
+
+	/* versus mode: an attack first cancels the garbage waiting to rise */
+	attack = tetris_attack[ ( num_lines_cleared > 4 ) ? 4 : num_lines_cleared ];
+
+	n = ( attack < t->garbage_in ) ? attack : t->garbage_in;
+	t->garbage_in -= n;
+	t->garbage_out += attack - n;
+}
+
+/*
+ * tetris_garbage
+ *
+ * push rows of garbage in under the stack, one shift of the board up
+ * rather than a row at a time. each row is filled except for column hole.
+ *
+ * returns 0, or -1 if blocks were pushed out the top of the board
+ *
+ */
+int tetris_garbage( struct Tetris *t, Uint32 rows, int hole )
+{
+	int over;
+	int i, j;
+
+	if( rows > TETRIS_HEIGHT )
+		rows = TETRIS_HEIGHT;
+
+	over = 0;
+	for( i=0; i<(int)rows; i++ ) {
+		for( j=0; j<TETRIS_WIDTH; j++ ) {
+			if( t->board[i][j] )
+				over = 1;
+		}
+	}
+
+	memmove( t->board[0], t->board[rows], ( TETRIS_HEIGHT - rows ) * sizeof(t->board[0]) );
+
+	for( i=TETRIS_HEIGHT-rows; i<TETRIS_HEIGHT; i++ ) {
+		for( j=0; j<TETRIS_WIDTH; j++ )
+			t->board[i][j] = ( j == hole ) ? 0 : TETRIS_GARBAGE_COLOR;
+	}
+
+	return over ? -1 : 0;
+}
+
+/*
+ * tetris_score
+ *
+ * calculate game score based on NES scoring algorithm
+ * see wikipedia.org entry for tetris for an explaination.
+ *
+ */
+Uint32 tetris_score( Uint32 level, Uint32 lines )
+{
+	if( lines == 0 )
+		return 0;
+	else if( lines == 1 ) {
+		return ( level + 1 ) * 40;
+	}
+	else if( lines == 2 ) {
+		return ( level + 1 ) * 100;
+	}
+	else if( lines == 3 ) {
+		return ( level + 1 ) * 300;
+	}
+	else {
+		return ( level + 1 ) * 1200;
+	}
+}
+
+/*
+ * tetris_level_up
+ *
+ * increase the game level every 10 lines cleared
+ * stop at level 20
+ *
+ * increase tetrad_drop_rate by 20ms per level
+ *
+ */
+void tetris_level_up( struct Tetris *t )
+{
+	if( ( t->game_cur_num_lines_cleared > 9 ) && ( t->game_level < 20 ) ) {
+		t->game_level++;
+		t->tetrad_drop_rate -= 20;
+		t->game_cur_num_lines_cleared -= 10;
+	}
+	else if( ( t->game_cur_num_lines_cleared >= 10 ) && ( t->game_level >= 20 ) ) {
+		t->game_level++;
+		t->game_cur_num_lines_cleared -= 10;
+	}
+}
+
+/*
+ * tetrad_move
+ *
+ */
+int tetrad_move( Uint32 *board, struct Tetrad *t, int pattern, int tx, int ty )
+{
+	Uint32 *mask;
+	Uint32 *bptr;
+	int i, j;
+	int bx;
+	int by;
+	int w, h;
+
+	bx = (tx / TETRAD_WIDTH)-1;
+	by = ty / TETRAD_HEIGHT;
+	w = t->mask[pattern].w;
+	h = t->mask[pattern].h;
+
+	mask = t->mask[pattern].mask_arr;
+
+	for( i=0; i<h; i++ ) {
+		if ( by > -1 ) {
+			bptr = board + ( by * TETRIS_WIDTH ) + bx;
+			for( j=0; j<w; j++ ) {
+				if( *mask && *bptr ) {
+					return 0;
+				}
+				mask++;
+				bptr++;
+			}
+		}
+		by++;
+	}
+	
+	return 1;
+}
+
+/*
+ * tetrad_put
+ *
+ */
+void tetrad_put( Uint32 *board, struct Tetrad *t, int pattern, int tx, int ty )
+{
+	Uint32 *mask;
+	Uint32 *bptr = board;
+	int i, j;
+	int bx;
+	int by;
+	int w, h;
+
+	/* nothing to place before the first tetrad has been spawned */
+	if ( ty < 0 || pattern < 0 )
+		return;
+
+	bx = (tx / TETRAD_WIDTH)-1;
+	by = ty / TETRAD_HEIGHT;
+	w = t->mask[pattern].w;
+	h = t->mask[pattern].h;
+
+	mask = t->mask[pattern].mask_arr;
+
+	for( i=0; i<h; i++ ) {
+		if ( by > -1 ) {
+			bptr = board + ( by * TETRIS_WIDTH ) + bx;
+			for( j=0; j<w; j++ ) {
+				if( *mask ) {
+					*bptr = t->color;
+				}
+				mask++;
+				bptr++;
+			}
+		}
+		by++;
+	}
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,199 @@
+/*
+SDLBlocks
+ 
+Description:
+Game board, tetrad types and game rules.
+ 
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef TETRIS_H
+#define TETRIS_H
+
+#include <SDL/SDL.h>
+
+#define TETRIS_WIDTH  10
+#define TETRIS_HEIGHT 20
+
+#define TETRAD_WIDTH 20
+#define TETRAD_HEIGHT 20
+
+#define MAX_TETRAD 7
+
+#define TETRIS_MIN_X (TETRAD_WIDTH-1)
+#define TETRIS_MAX_X (TETRIS_MIN_X+(TETRIS_WIDTH*TETRAD_HEIGHT)+1)
+#define TETRIS_MIN_Y 0
+#define TETRIS_MAX_Y (TETRIS_MIN_Y+(TETRAD_HEIGHT*TETRIS_HEIGHT))
+
+#define START_X (TETRIS_MIN_X+1)+(TETRAD_WIDTH*4)
+#define START_Y TETRIS_MIN_Y
+
+/* number of upcoming tetrads known in advance */
+#define TETRIS_NUM_NEXT 5
+
+/* events reported by tetris_tick */
+#define TETRIS_EVENT_MOVE  0x01	/* active tetrad fell one row */
+#define TETRIS_EVENT_LOCK  0x02	/* tetrad placed on the board, see lock_* */
+#define TETRIS_EVENT_SPAWN 0x04	/* new active tetrad */
+#define TETRIS_EVENT_CLEAR 0x08	/* rows filled, see clear_rows and last_lines */
+#define TETRIS_EVENT_LEVEL 0x10	/* level up */
+#define TETRIS_EVENT_OVER  0x20	/* game over */
+
+/* versus mode: color of the garbage rows pushed in under the stack */
+#define TETRIS_GARBAGE_COLOR 0x808080
+
+/* game states, tetris_tick() runs the handler of the current one */
+#define TETRIS_STATE_START 0	/* start screen, no tetrad yet */
+#define TETRIS_STATE_SPAWN 1	/* deal the next tetrad */
+#define TETRIS_STATE_FALL  2	/* active tetrad falls at the drop rate */
+#define TETRIS_STATE_DROP  3	/* active tetrad falls one row per tick */
+#define TETRIS_STATE_LOCK  4	/* active tetrad rests on the stack, lock delay */
+#define TETRIS_STATE_CLEAR 5	/* filled rows flash before they are removed */
+#define TETRIS_STATE_PAUSE 6	/* stopped, see resume_state */
+#define TETRIS_STATE_OVER  7
+#define TETRIS_NUM_STATES  8
+
+/* states the active tetrad can be moved in, and the states of a game
+ * in progress, which can be paused */
+#define TETRIS_ACTIVE_STATES  ( (1<<TETRIS_STATE_FALL) | (1<<TETRIS_STATE_DROP) | (1<<TETRIS_STATE_LOCK) )
+#define TETRIS_PLAYING_STATES ( TETRIS_ACTIVE_STATES | (1<<TETRIS_STATE_SPAWN) | (1<<TETRIS_STATE_CLEAR) )
+
+#define TETRIS_ACTIVE( t )  ( ( TETRIS_ACTIVE_STATES >> (t)->state ) & 1 )
+#define TETRIS_PLAYING( t ) ( ( TETRIS_PLAYING_STATES >> (t)->state ) & 1 )
+
+/* the active tetrad is drawn while it can move, at game over where it
+ * didn't fit, and in a pause of either */
+#define TETRIS_SHOWN_STATES ( TETRIS_ACTIVE_STATES | (1<<TETRIS_STATE_OVER) )
+#define TETRIS_SHOWN( t ) ( ( TETRIS_SHOWN_STATES >> \
+		( (t)->state == TETRIS_STATE_PAUSE ? (t)->resume_state : (t)->state ) ) & 1 )
+
+/* how long a landed tetrad can still be moved, and how long filled rows
+ * flash before they are removed (ms) */
+#define TETRIS_LOCK_DELAY  500
+#define TETRIS_CLEAR_DELAY 300
+
+/* tetrad patterns */
+
+struct TetradMask {
+	int w, h;
+	Uint32 mask_arr[6];
+};
+
+/* tetrad type */
+
+struct Tetrad {
+	int num_patterns;
+	Uint32 color;
+	struct TetradMask * mask; 
+};
+
+extern struct Tetrad tetrad[MAX_TETRAD];
+
+/* game super type - holds all of the game state variables, the ones
+ * every tick touches first */
+
+struct Tetris {
+
+	/* state -- TETRIS_STATE_*, state_time -- game time it was entered */
+	int state;
+	Uint32 state_time;
+
+	/* cur_tetrad, cur_pattern -- the active tetrad, t -- its type */
+	int cur_tetrad;
+	int cur_pattern;
+	struct Tetrad *t;
+
+	/* tx, ty -- upper-left position of currently active tetrad relative to the game board */
+	int tx;
+	int ty;
+
+	/* max_x,max_y -- maximum width and height of currently active tetrad relative to the game board */
+	int max_x;
+	int max_y;
+
+	/* now -- time of the last tick, next_time -- time of the last fall,
+	 * tetrad_drop_rate -- ms per row */
+	Uint32 now, next_time;
+	Uint32 tetrad_drop_rate;
+
+	/* lock_delay, clear_delay -- how long the LOCK and CLEAR states
+	 * last (ms), clear_rows -- a bit per board row being cleared */
+	Uint32 lock_delay;
+	Uint32 clear_delay;
+	Uint32 clear_rows;
+
+	/* game_pause -- pause switch, the next tick stops or resumes the
+	 * game, resume_* -- the state the pause interrupted */
+	int game_pause;
+	int resume_state;
+	Uint32 resume_time;
+
+	int game_audio;
+
+	Uint32 game_score;
+	Uint32 game_level;
+	Uint32 game_total_num_lines_cleared;
+	Uint32 game_cur_num_lines_cleared;
+	Uint32 game_num_pieces;
+
+	/* rng -- random number generator state, next_tetrad -- upcoming tetrads */
+	Uint32 rng;
+	int next_tetrad[TETRIS_NUM_NEXT];
+
+	/* lock_* -- the last tetrad placed on the board, last_lines -- rows it filled */
+	int lock_tetrad;
+	int lock_pattern;
+	int lock_tx;
+	int lock_ty;
+	Uint32 last_lines;
+
+	/* garbage_in -- rows to push in under the stack before the next
+	 * spawn, with the gap at column garbage_hole, garbage_out -- rows
+	 * sent by clears not yet collected, both only used in versus mode */
+	Uint32 garbage_in;
+	int garbage_hole;
+	Uint32 garbage_out;
+	
+	/* abstract representation of the tetris game board */
+	Uint32 board[TETRIS_HEIGHT][TETRIS_WIDTH];
+};
+
+/* function prototypes */
+
+void tetris_initialize( struct Tetris * t );
+void tetris_seed( struct Tetris *t, Uint32 seed );
+Uint32 tetris_random( struct Tetris *t );
+void tetris_start( struct Tetris *t );
+int  tetris_tick( struct Tetris *t, Uint32 now );
+void tetris_next_tetrad( struct Tetris *t );
+int  tetris_move_left( struct Tetris *t );
+int  tetris_move_right( struct Tetris *t );
+int  tetris_move_down( struct Tetris *t );
+int  tetris_rotate( struct Tetris *t );
+void tetris_drop( struct Tetris *t );
+int  tetris_pause( struct Tetris *t );
+void tetris_update( struct Tetris *t );
+int  tetris_garbage( struct Tetris *t, Uint32 rows, int hole );
+Uint32 tetris_score( Uint32 level, Uint32 lines );
+void tetris_level_up( struct Tetris *t );
+void tetrad_put( Uint32 *board, struct Tetrad *t, int pattern, int tx, int ty );
+int  tetrad_move( Uint32 *board, struct Tetrad *t, int pattern, int tx, int ty );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,251 @@
+/*
+SDLBlocks
+ 
+Description:
+Binary game event trace written through per-thread lock-free rings.
+ 
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SDL/SDL.h>
+
+#include "trace.h"
+
+/*
+ * one ring per tracing thread: the owning thread only advances head,
+ * the writer thread only advances tail
+ *
+ */
+
+struct TraceRing {
+	Uint32 head __attribute__(( aligned(64) ));
+	Uint32 dropped;
+	Uint32 tail __attribute__(( aligned(64) ));
+	struct TraceEvent ev[TRACE_RING_SIZE] __attribute__(( aligned(64) ));
+};
+
+int trace_enabled = 0;
+
+static struct TraceRing trace_rings[TRACE_MAX_THREADS];
+static int trace_num_rings = 0;
+static __thread struct TraceRing *trace_ring = NULL;
+
+/* set for a thread that found every ring taken, its events are dropped
+ * without touching trace_num_rings again */
+static __thread int trace_no_ring = 0;
+static int trace_overflow = 0;
+
+static FILE *trace_fp = NULL;
+static SDL_Thread *trace_writer = NULL;
+static int trace_quit = 0;
+
+static int trace_drain( void );
+static int trace_writer_thread( void *data );
+
+/*
+ * trace_open
+ *
+ * start tracing to a file
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int trace_open( const char *path )
+{
+	struct TraceHeader hdr;
+
+	trace_fp = fopen( path, "wb" );
+	if( trace_fp == NULL ) {
+		fprintf( stderr, "Unable to open trace file: %s\n", path );
+		return -1;
+	}
+
+	hdr.magic = TRACE_MAGIC;
+	hdr.version = TRACE_VERSION;
+	hdr.event_size = sizeof(struct TraceEvent);
+	hdr.reserved = 0;
+	fwrite( &hdr, sizeof(hdr), 1, trace_fp );
+
+	trace_quit = 0;
+	trace_writer = SDL_CreateThread( trace_writer_thread, NULL );
+
+	if( trace_writer == NULL ) {
+		fclose( trace_fp );
+		trace_fp = NULL;
+		return -1;
+	}
+
+	trace_enabled = 1;
+
+	return 0;
+}
+
+/*
+ * trace_event
+ *
+ * append an event to the calling thread's ring, the event is dropped
+ * if the writer has fallen a full ring behind
+ *
+ */
+void trace_event( int type, int tetrad, int pattern, int col, int row, int arg )
+{
+	struct TraceRing *r;
+	struct TraceEvent *e;
+	struct timespec ts;
+	Uint32 head;
+	int id;
+
+	r = trace_ring;
+
+	if( r == NULL ) {
+		if( trace_no_ring )
+			return;
+
+		/* only take a ring while there is one left, so the count never
+		 * goes past TRACE_MAX_THREADS */
+		id = __atomic_load_n( &trace_num_rings, __ATOMIC_ACQUIRE );
+		do {
+			if( id >= TRACE_MAX_THREADS ) {
+				trace_no_ring = 1;
+				__atomic_store_n( &trace_overflow, 1, __ATOMIC_RELAXED );
+				return;
+			}
+		} while( !__atomic_compare_exchange_n( &trace_num_rings, &id, id + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) );
+
+		r = trace_ring = &trace_rings[id];
+	}
+
+	head = r->head;
+
+	if( head - __atomic_load_n( &r->tail, __ATOMIC_ACQUIRE ) >= TRACE_RING_SIZE ) {
+		r->dropped++;
+		return;
+	}
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	e = &r->ev[ head & (TRACE_RING_SIZE-1) ];
+	e->time = ( (Uint64)ts.tv_sec * 1000000 ) + ( ts.tv_nsec / 1000 );
+	e->type = type;
+	e->thread = r - trace_rings;
+	e->tetrad = tetrad;
+	e->pattern = pattern;
+	e->col = col;
+	e->row = row;
+	e->arg = arg;
+
+	__atomic_store_n( &r->head, head + 1, __ATOMIC_RELEASE );
+}
+
+/*
+ * trace_close
+ *
+ * stop the writer, flush whatever is left and close the file
+ *
+ */
+void trace_close( void )
+{
+	int i;
+
+	if( !trace_enabled )
+		return;
+
+	trace_enabled = 0;
+
+	__atomic_store_n( &trace_quit, 1, __ATOMIC_RELEASE );
+	SDL_WaitThread( trace_writer, NULL );
+
+	trace_drain();
+
+	for( i=0; i<trace_num_rings; i++ ) {
+		if( trace_rings[i].dropped )
+			fprintf( stderr, "trace: thread %d dropped %u events\n", i, trace_rings[i].dropped );
+	}
+
+	if( trace_overflow )
+		fprintf( stderr, "trace: more than %d threads traced, the events of the others were dropped\n", TRACE_MAX_THREADS );
+
+	fclose( trace_fp );
+	trace_fp = NULL;
+}
+
+/*
+ * trace_drain
+ *
+ * copy every event published so far from the rings to the file
+ *
+ * returns the number of events written
+ *
+ */
+static int trace_drain( void )
+{
+	struct TraceRing *r;
+	Uint32 head, tail;
+	Uint32 start, n;
+	int num;
+	int total;
+	int i;
+
+	total = 0;
+	num = __atomic_load_n( &trace_num_rings, __ATOMIC_ACQUIRE );
+
+	for( i=0; i<num; i++ ) {
+		r = &trace_rings[i];
+
+		head = __atomic_load_n( &r->head, __ATOMIC_ACQUIRE );
+		tail = r->tail;
+
+		while( tail != head ) {
+			/* write up to the end of the ring, then wrap */
+			start = tail & (TRACE_RING_SIZE-1);
+			n = head - tail;
+			if( start + n > TRACE_RING_SIZE )
+				n = TRACE_RING_SIZE - start;
+
+			fwrite( &r->ev[start], sizeof(struct TraceEvent), n, trace_fp );
+			tail += n;
+			total += n;
+		}
+
+		__atomic_store_n( &r->tail, tail, __ATOMIC_RELEASE );
+	}
+
+	return total;
+}
+
+/*
+ * trace_writer_thread
+ *
+ */
+static int trace_writer_thread( void *data )
+{
+	while( !__atomic_load_n( &trace_quit, __ATOMIC_ACQUIRE ) ) {
+		if( trace_drain() > 0 )
+			fflush( trace_fp );
+		SDL_Delay( TRACE_DRAIN_TICKS );
+	}
+
+	return 0;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
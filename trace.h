@@ -0,0 +1,104 @@
+/*
+SDLBlocks
+ 
+Description:
+Binary game event trace written through per-thread lock-free rings.
+ 
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <SDL/SDL.h>
+
+#define TRACE_FILE "sdlblocks.trace"
+
+#define TRACE_MAGIC 0x52544253	/* "SBTR" */
+#define TRACE_VERSION 1
+
+/* events per thread ring, must be a power of two */
+#define TRACE_RING_SIZE 4096
+
+/* threads that can trace at the same time */
+#define TRACE_MAX_THREADS 16
+
+/* how often the writer drains the rings (ms) */
+#define TRACE_DRAIN_TICKS 10
+
+/* event types */
+#define TRACE_START  1	/* new game */
+#define TRACE_SPAWN  2	/* new active tetrad */
+#define TRACE_MOVE   3	/* tetrad moved, arg = 1 if moved by gravity */
+#define TRACE_ROTATE 4	/* tetrad rotated */
+#define TRACE_LOCK   5	/* tetrad placed on the board */
+#define TRACE_CLEAR  6	/* rows cleared, arg = number of rows */
+#define TRACE_LEVEL  7	/* level up, arg = new level */
+#define TRACE_OVER   8	/* game over */
+#define TRACE_REWIND 9	/* play resumed from a rewound game, arg = rewind frame */
+
+/* the rewound game follows its TRACE_REWIND, so a decoder can pick up
+ * the board again: a TRACE_ROW for every four cells of every row, then
+ * TRACE_SCORE and TRACE_LINES */
+#define TRACE_ROW    10	/* cells col..col+3 of row, arg = a nibble each from the left:
+						 * 0 empty, tetrad+1, TRACE_CELL_OTHER for garbage */
+#define TRACE_SCORE  11	/* arg = low 16 bits of the score, tetrad = the high 8 */
+#define TRACE_LINES  12	/* arg = lines cleared, tetrad = level, row = lines toward the next level */
+
+#define TRACE_CELL_OTHER 15
+
+struct TraceEvent {
+	Uint64 time;	/* microseconds */
+	Uint8 type;
+	Uint8 thread;
+	Uint8 tetrad;
+	Sint8 pattern;
+	Sint8 col;
+	Sint8 row;
+	Uint16 arg;
+};
+
+struct TraceHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 event_size;
+	Uint32 reserved;
+};
+
+/* trace_enabled -- set by trace_open, checked before every event */
+extern int trace_enabled;
+
+#define TRACE( type, tetrad, pattern, col, row, arg ) \
+	do { if( trace_enabled ) trace_event( type, tetrad, pattern, col, row, arg ); } while( 0 )
+
+/* trace the active tetrad of a struct Tetris */
+#define TRACE_TETRAD( type, t, arg ) \
+	TRACE( type, (t)->cur_tetrad, (t)->cur_pattern, ((t)->tx/TETRAD_WIDTH)-1, (t)->ty/TETRAD_HEIGHT, arg )
+
+/* trace the tetrad tetris_tick last placed on the board */
+#define TRACE_LOCKED( t ) \
+	TRACE( TRACE_LOCK, (t)->lock_tetrad, (t)->lock_pattern, ((t)->lock_tx/TETRAD_WIDTH)-1, (t)->lock_ty/TETRAD_HEIGHT, 0 )
+
+int  trace_open( const char *path );
+void trace_event( int type, int tetrad, int pattern, int col, int row, int arg );
+void trace_close( void );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */
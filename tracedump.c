@@ -0,0 +1,211 @@
+/*
+SDLBlocks
+ 
+Description:
+Trace file decoder: prints the events and the boards they produce.
+ 
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "trace.h"
+
+static const char *event_name[] = {
+	"?", "START", "SPAWN", "MOVE", "ROTATE", "LOCK", "CLEAR", "LEVEL", "OVER", "REWIND",
+	"ROW", "SCORE", "LINES"
+};
+
+static void print_board( struct Tetris *t );
+
+/*
+ * tracedump
+ *
+ * usage: tracedump [-n] [file]
+ *
+ * prints every event in a trace written with sdlblocks -trace, and the
+ * board after every tetrad placed unless -n is given. the board is
+ * rebuilt from the placements, a rewind is followed by the whole board
+ * which is printed once it is complete.
+ *
+ */
+
+int main( int argc, char *argv[] )
+{
+	static struct Tetris board[TRACE_MAX_THREADS];
+	struct TraceHeader hdr;
+	struct TraceEvent e;
+	struct Tetris *t;
+	const char *path;
+	FILE *fp;
+	Uint64 start;
+	int boards;
+	int cell;
+	int i, k;
+
+	path = TRACE_FILE;
+	boards = 1;
+
+	for( i=1; i<argc; i++ ) {
+		if( !strcmp( argv[i], "-n" ) )
+			boards = 0;
+		else if( argv[i][0] == '-' ) {
+			fprintf( stderr, "usage: %s [-n] [file]\n", argv[0] );
+			exit( 1 );
+		}
+		else
+			path = argv[i];
+	}
+
+	fp = fopen( path, "rb" );
+	if( fp == NULL ) {
+		fprintf( stderr, "Unable to open trace file: %s\n", path );
+		exit( 1 );
+	}
+
+	if( fread( &hdr, sizeof(hdr), 1, fp ) != 1 || hdr.magic != TRACE_MAGIC ) {
+		fprintf( stderr, "%s is not a trace file\n", path );
+		exit( 1 );
+	}
+
+	if( hdr.version != TRACE_VERSION || hdr.event_size != sizeof(struct TraceEvent) ) {
+		fprintf( stderr, "%s: unsupported trace version %u\n", path, hdr.version );
+		exit( 1 );
+	}
+
+	for( i=0; i<TRACE_MAX_THREADS; i++ )
+		tetris_initialize( &board[i] );
+
+	start = 0;
+
+	while( fread( &e, sizeof(e), 1, fp ) == 1 ) {
+
+		if( start == 0 )
+			start = e.time;
+
+		if( e.type > TRACE_LINES || e.thread >= TRACE_MAX_THREADS ) {
+			fprintf( stderr, "%s: bad event\n", path );
+			exit( 1 );
+		}
+
+		t = &board[e.thread];
+
+		printf( "%12.6f t%-2d %-6s tetrad %d pattern %d at (%d,%d)",
+				(double)( e.time - start ) / 1000000.0, e.thread, event_name[e.type],
+				e.tetrad, e.pattern, e.col, e.row );
+
+		if( e.type == TRACE_MOVE || e.type == TRACE_CLEAR || e.type == TRACE_LEVEL || e.type >= TRACE_REWIND )
+			printf( " arg %d", e.arg );
+
+		printf( "\n" );
+
+		switch( e.type ) {
+			case TRACE_START:
+				tetris_initialize( t );
+				break;
+
+			/* the rewound board comes next, row by row */
+			case TRACE_REWIND:
+				memset( t->board, 0, sizeof(t->board) );
+				break;
+
+			case TRACE_ROW:
+				if( e.row < 0 || e.row >= TETRIS_HEIGHT )
+					break;
+
+				for( k=0; k<4 && e.col >= 0 && e.col+k < TETRIS_WIDTH; k++ ) {
+					cell = ( e.arg >> ( 12 - (k*4) ) ) & 15;
+					if( cell == 0 )
+						t->board[e.row][e.col+k] = 0;
+					else if( cell <= MAX_TETRAD )
+						t->board[e.row][e.col+k] = tetrad[cell-1].color;
+					else
+						t->board[e.row][e.col+k] = TETRIS_GARBAGE_COLOR;
+				}
+				break;
+
+			case TRACE_SCORE:
+				t->game_score = ( (Uint32)e.tetrad << 16 ) | e.arg;
+				break;
+
+			/* the last of the rewound game */
+			case TRACE_LINES:
+				t->game_total_num_lines_cleared = e.arg;
+				t->game_cur_num_lines_cleared = e.row;
+				t->game_level = e.tetrad;
+				if( boards )
+					print_board( t );
+				break;
+
+			case TRACE_LOCK:
+				/* the game checks for filled rows as soon as a tetrad is placed */
+				if( e.tetrad < MAX_TETRAD && e.pattern >= 0 && e.pattern < tetrad[e.tetrad].num_patterns ) {
+					tetrad_put( &(t->board[0][0]), &tetrad[e.tetrad], e.pattern,
+							(e.col+1) * TETRAD_WIDTH, e.row * TETRAD_HEIGHT );
+					tetris_update( t );
+					tetris_level_up( t );
+				}
+				if( boards )
+					print_board( t );
+				break;
+		}
+	}
+
+	fclose( fp );
+
+	return 0;
+}
+
+/*
+ * print_board
+ *
+ * print the board with each cell showing the tetrad that filled it
+ *
+ */
+static void print_board( struct Tetris *t )
+{
+	Uint32 c;
+	int i, j, k;
+
+	for( i=0; i<TETRIS_HEIGHT; i++ ) {
+		printf( "    |" );
+		for( j=0; j<TETRIS_WIDTH; j++ ) {
+			c = t->board[i][j];
+			if( c == 0 ) {
+				printf( " ." );
+				continue;
+			}
+			for( k=0; k<MAX_TETRAD; k++ ) {
+				if( tetrad[k].color == c )
+					break;
+			}
+			printf( " %c", ( k < MAX_TETRAD ) ? '0'+k : '#' );
+		}
+		printf( " |\n" );
+	}
+
+	printf( "    score %u lines %u level %u\n\n", t->game_score,
+			t->game_total_num_lines_cleared, t->game_level );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
@@ -0,0 +1,670 @@
+/*
+SDLBlocks
+
+Description:
+Tunes the weights of the placement AI with the cross-entropy method,
+playing the games of every generation on all cores.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "ai.h"
+
+#define TUNE_MAX_THREADS 64
+#define TUNE_MAX_POPULATION 256
+#define TUNE_MAX_GAMES 4096
+
+/* one weight per field of struct AiWeights */
+#define TUNE_NUM_WEIGHTS 4
+
+/* what a game is worth */
+#define TUNE_FITNESS_SCORE 0
+#define TUNE_FITNESS_LINES 1
+
+struct TuneCandidate {
+	float w[TUNE_NUM_WEIGHTS];
+
+	/* racing -- still being played, sum -- fitness over the games played */
+	int racing;
+	Uint32 played;
+	double sum;
+	double mean;
+};
+
+struct Tune {
+	int depth;
+	Uint32 max_pieces;
+	int fitness;
+
+	/* game g of the generation uses seed + g for every candidate */
+	Uint32 seed;
+	Uint32 games;
+
+	int num_cands;
+	struct TuneCandidate cand[TUNE_MAX_POPULATION];
+
+	/* result[c*games + g] -- fitness of candidate c in game g */
+	float *result;
+
+	/* the round being played: games lo..hi of the candidates in jobs,
+	 * next -- the next game handed out, taken by every thread in turn */
+	int jobs[TUNE_MAX_POPULATION];
+	int num_jobs;
+	Uint32 lo;
+	Uint32 hi;
+	Uint32 next;
+};
+
+/* one thread, each with an AI of its own */
+struct TuneWorker {
+	struct Tune *tune;
+	struct Ai ai;
+	Uint32 games;
+	Uint64 pieces;
+};
+
+static void   tune_round( struct Tune *tn, struct TuneWorker *workers, int threads );
+static int    tune_thread( void *data );
+static float  tune_play( struct Tune *tn, struct Ai *ai, const float *w, Uint32 seed, Uint32 *pieces );
+static void   tune_race( struct Tune *tn, int elite, double z );
+static int    tune_compare( const void *a, const void *b );
+static void   tune_normalize( float *w );
+static void   tune_set( struct AiWeights *aw, const float *w );
+static double tune_gauss( Uint32 *rng );
+static double tune_clock( void );
+
+/*
+ * blockstune
+ *
+ * usage: blockstune [-generations n] [-population n] [-elite n]
+ *                   [-games n] [-batch n] [-pieces n] [-depth n]
+ *                   [-threads n] [-seed n] [-sigma f] [-noise f]
+ *                   [-race z] [-fitness score|lines] [-log file]
+ *
+ * cross-entropy search for the AI weights: every generation draws
+ * -population candidates around the mean, plays them and moves the
+ * mean and the spread to those of the -elite best. the first candidate
+ * is the mean itself. weights are kept at unit length, scaling them
+ * doesn't change a single placement.
+ *
+ * all the candidates of a generation play the same -games seeds, so
+ * they are compared on the same tetrads. the games are played -batch
+ * at a time, after each batch a candidate that is behind the weakest
+ * elite by more than -race standard errors of their differences over
+ * the games so far is dropped, from the second game on. -race 0 plays
+ * every game.
+ *
+ * each game ends at game over or after -pieces tetrads. results don't
+ * depend on the number of threads.
+ *
+ */
+
+int main( int argc, char *argv[] )
+{
+	static struct Tune tn;
+	struct TuneWorker *workers;
+	struct TuneCandidate *c;
+	struct TuneCandidate *order[TUNE_MAX_POPULATION];
+	FILE *log;
+	char *log_path;
+	float mean[TUNE_NUM_WEIGHTS];
+	float sigma[TUNE_NUM_WEIGHTS];
+	double m, v, noise, noise_gen;
+	double start, gen_start, seconds;
+	double race;
+	Uint32 generations, gen;
+	Uint32 seed, rng;
+	Uint64 games, pieces;
+	int population, elite, batch;
+	int threads;
+	int dropped;
+	int i, k;
+
+	generations = 20;
+	population = 50;
+	elite = 10;
+	tn.games = 100;
+	batch = 10;
+	tn.max_pieces = 1000;
+	tn.depth = 1;
+	tn.fitness = TUNE_FITNESS_SCORE;
+	threads = 0;
+	seed = 1;
+	race = 2.0;
+	noise = 0.05;
+	log_path = NULL;
+
+	sigma[0] = 0.2f;
+
+	for( i=1; i<argc; i++ ) {
+		if( !strcmp( argv[i], "-generations" ) && ( i+1 < argc ) )
+			generations = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-population" ) && ( i+1 < argc ) )
+			population = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-elite" ) && ( i+1 < argc ) )
+			elite = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-games" ) && ( i+1 < argc ) )
+			tn.games = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-batch" ) && ( i+1 < argc ) )
+			batch = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-pieces" ) && ( i+1 < argc ) )
+			tn.max_pieces = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-depth" ) && ( i+1 < argc ) )
+			tn.depth = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-threads" ) && ( i+1 < argc ) )
+			threads = atoi( argv[++i] );
+		else if( !strcmp( argv[i], "-seed" ) && ( i+1 < argc ) )
+			seed = strtoul( argv[++i], NULL, 0 );
+		else if( !strcmp( argv[i], "-sigma" ) && ( i+1 < argc ) )
+			sigma[0] = atof( argv[++i] );
+		else if( !strcmp( argv[i], "-noise" ) && ( i+1 < argc ) )
+			noise = atof( argv[++i] );
+		else if( !strcmp( argv[i], "-race" ) && ( i+1 < argc ) )
+			race = atof( argv[++i] );
+		else if( !strcmp( argv[i], "-fitness" ) && ( i+1 < argc ) && !strcmp( argv[i+1], "score" ) ) {
+			tn.fitness = TUNE_FITNESS_SCORE;
+			i++;
+		}
+		else if( !strcmp( argv[i], "-fitness" ) && ( i+1 < argc ) && !strcmp( argv[i+1], "lines" ) ) {
+			tn.fitness = TUNE_FITNESS_LINES;
+			i++;
+		}
+		else if( !strcmp( argv[i], "-log" ) && ( i+1 < argc ) )
+			log_path = argv[++i];
+		else {
+			fprintf( stderr, "usage: %s [-generations n] [-population n] [-elite n]\n"
+					"       [-games n] [-batch n] [-pieces n] [-depth 1..%d]\n"
+					"       [-threads n] [-seed n] [-sigma f] [-noise f]\n"
+					"       [-race z] [-fitness score|lines] [-log file]\n", argv[0], AI_MAX_DEPTH );
+			exit( 1 );
+		}
+	}
+
+	if( population < 2 || population > TUNE_MAX_POPULATION || elite < 1 || elite >= population ) {
+		fprintf( stderr, "Population must be between 2 and %d, elite between 1 and the population\n", TUNE_MAX_POPULATION );
+		exit( 1 );
+	}
+
+	if( tn.games < 1 || tn.games > TUNE_MAX_GAMES || batch < 1 ) {
+		fprintf( stderr, "Games must be between 1 and %d, batch at least 1\n", TUNE_MAX_GAMES );
+		exit( 1 );
+	}
+
+	if( tn.depth < 1 || tn.depth > AI_MAX_DEPTH ) {
+		fprintf( stderr, "Depth must be between 1 and %d\n", AI_MAX_DEPTH );
+		exit( 1 );
+	}
+
+	if( threads < 1 )
+		threads = sysconf( _SC_NPROCESSORS_ONLN );
+	if( threads < 1 )
+		threads = 1;
+	if( threads > TUNE_MAX_THREADS )
+		threads = TUNE_MAX_THREADS;
+
+	tn.result = malloc( (size_t)population * tn.games * sizeof(float) );
+	workers = malloc( threads * sizeof(struct TuneWorker) );
+
+	if( tn.result == NULL || workers == NULL ) {
+		fprintf( stderr, "Unable to allocate the results\n" );
+		exit( 1 );
+	}
+
+	for( i=0; i<threads; i++ ) {
+		if( ai_initialize( &workers[i].ai ) != 0 ) {
+			fprintf( stderr, "Unable to allocate the transposition table\n" );
+			exit( 1 );
+		}
+		workers[i].ai.depth = tn.depth;
+		workers[i].tune = &tn;
+		workers[i].games = 0;
+		workers[i].pieces = 0;
+	}
+
+	log = NULL;
+
+	if( log_path != NULL ) {
+		log = fopen( log_path, "w" );
+		if( log == NULL ) {
+			fprintf( stderr, "Unable to open %s: %s\n", log_path, strerror( errno ) );
+			exit( 1 );
+		}
+		fprintf( log, "# generation games dropped mean_fitness elite_fitness best_fitness"
+				" height lines holes bumpiness sigma_height sigma_lines sigma_holes sigma_bumpiness seconds\n" );
+	}
+
+	/* start from the default weights */
+	mean[0] = ai_default_weights.height;
+	mean[1] = ai_default_weights.lines;
+	mean[2] = ai_default_weights.holes;
+	mean[3] = ai_default_weights.bumpiness;
+	tune_normalize( mean );
+
+	for( k=1; k<TUNE_NUM_WEIGHTS; k++ )
+		sigma[k] = sigma[0];
+
+	rng = ( seed * 0x9e3779b9 ) | 1;
+
+	printf( "%d candidates, %d elite, %u games of up to %u pieces at depth %d, %d threads\n",
+			population, elite, tn.games, tn.max_pieces, tn.depth, threads );
+
+	start = tune_clock();
+
+	for( gen=0; gen<generations; gen++ ) {
+
+		gen_start = tune_clock();
+
+		tn.seed = seed + gen * tn.games;
+		tn.num_cands = population;
+
+		for( i=0; i<population; i++ ) {
+			c = &tn.cand[i];
+
+			for( k=0; k<TUNE_NUM_WEIGHTS; k++ )
+				c->w[k] = ( i == 0 ) ? mean[k] : mean[k] + sigma[k] * tune_gauss( &rng );
+			tune_normalize( c->w );
+
+			c->racing = 1;
+			c->played = 0;
+			c->sum = 0.0;
+			c->mean = 0.0;
+		}
+
+		/*
+		 * play the candidates still racing a batch of games at a time
+		 *
+		 */
+
+		for( tn.lo=0; tn.lo<tn.games; tn.lo=tn.hi ) {
+			tn.hi = ( tn.games - tn.lo > (Uint32)batch ) ? tn.lo + batch : tn.games;
+
+			tn.num_jobs = 0;
+			for( i=0; i<population; i++ ) {
+				if( tn.cand[i].racing )
+					tn.jobs[tn.num_jobs++] = i;
+			}
+
+			tune_round( &tn, workers, threads );
+
+			if( race > 0.0 && tn.hi < tn.games )
+				tune_race( &tn, elite, race );
+		}
+
+		/*
+		 * move the mean and the spread to the elite, the extra noise
+		 * keeps the spread from collapsing too early and fades out
+		 * over the first half of the run
+		 *
+		 */
+
+		dropped = 0;
+		for( i=0; i<population; i++ ) {
+			order[i] = &tn.cand[i];
+			if( !tn.cand[i].racing )
+				dropped++;
+		}
+
+		qsort( order, population, sizeof(order[0]), tune_compare );
+
+		noise_gen = ( generations > 1 ) ? noise * ( 1.0 - ( 2.0 * gen ) / generations ) : 0.0;
+		if( noise_gen < 0.0 )
+			noise_gen = 0.0;
+
+		for( k=0; k<TUNE_NUM_WEIGHTS; k++ ) {
+			m = 0.0;
+			for( i=0; i<elite; i++ )
+				m += order[i]->w[k];
+			m /= elite;
+
+			v = 0.0;
+			for( i=0; i<elite; i++ )
+				v += ( order[i]->w[k] - m ) * ( order[i]->w[k] - m );
+			v /= elite;
+
+			mean[k] = m;
+			sigma[k] = sqrt( v + noise_gen );
+		}
+
+		tune_normalize( mean );
+
+		m = 0.0;
+		for( i=0; i<elite; i++ )
+			m += order[i]->mean;
+		m /= elite;
+
+		printf( "generation %u: mean %.1f elite %.1f best %.1f, %d dropped, %.1f s\n", gen,
+				tn.cand[0].mean, m, order[0]->mean, dropped, tune_clock() - gen_start );
+		printf( "  weights %.6f %.6f %.6f %.6f sigma %.4f %.4f %.4f %.4f\n",
+				mean[0], mean[1], mean[2], mean[3], sigma[0], sigma[1], sigma[2], sigma[3] );
+
+		if( log != NULL ) {
+			fprintf( log, "%u %u %d %.2f %.2f %.2f %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.3f\n",
+					gen, tn.games, dropped, tn.cand[0].mean, m, order[0]->mean,
+					mean[0], mean[1], mean[2], mean[3], sigma[0], sigma[1], sigma[2], sigma[3],
+					tune_clock() - start );
+			fflush( log );
+		}
+	}
+
+	games = 0;
+	pieces = 0;
+	for( i=0; i<threads; i++ ) {
+		games += workers[i].games;
+		pieces += workers[i].pieces;
+	}
+
+	seconds = tune_clock() - start;
+
+	printf( "%llu games, %llu pieces in %.1f s, %.0f pieces/s\n", (unsigned long long)games,
+			(unsigned long long)pieces, seconds, seconds > 0 ? pieces / seconds : 0.0 );
+	printf( "weights: { %ff, %ff, %ff, %ff }\n", mean[0], mean[1], mean[2], mean[3] );
+
+	if( log != NULL )
+		fclose( log );
+
+	for( i=0; i<threads; i++ )
+		ai_free( &workers[i].ai );
+
+	free( workers );
+	free( tn.result );
+
+	return 0;
+}
+
+/*
+ * tune_round
+ *
+ * play games lo..hi of every candidate in jobs, then add them up
+ *
+ */
+static void tune_round( struct Tune *tn, struct TuneWorker *workers, int threads )
+{
+	SDL_Thread *thread[TUNE_MAX_THREADS];
+	struct TuneCandidate *c;
+	Uint32 g;
+	int i;
+
+	tn->next = 0;
+
+	/* the main thread plays too */
+	for( i=1; i<threads; i++ )
+		thread[i] = SDL_CreateThread( tune_thread, &workers[i] );
+
+	tune_thread( &workers[0] );
+
+	for( i=1; i<threads; i++ ) {
+		if( thread[i] != NULL )
+			SDL_WaitThread( thread[i], NULL );
+		else
+			tune_thread( &workers[i] );
+	}
+
+	for( i=0; i<tn->num_jobs; i++ ) {
+		c = &tn->cand[tn->jobs[i]];
+
+		for( g=tn->lo; g<tn->hi; g++ )
+			c->sum += tn->result[tn->jobs[i]*tn->games + g];
+
+		c->played = tn->hi;
+		c->mean = c->sum / c->played;
+	}
+}
+
+/*
+ * tune_thread
+ *
+ * play the games of the round until none are left
+ *
+ */
+static int tune_thread( void *data )
+{
+	struct TuneWorker *w = data;
+	struct Tune *tn = w->tune;
+	Uint32 n, j, g;
+	Uint32 pieces;
+	int c;
+
+	n = tn->hi - tn->lo;
+
+	for( ;; ) {
+		j = __atomic_fetch_add( &tn->next, 1, __ATOMIC_RELAXED );
+		if( j >= n * tn->num_jobs )
+			break;
+
+		c = tn->jobs[j / n];
+		g = tn->lo + ( j % n );
+
+		tn->result[c*tn->games + g] = tune_play( tn, &w->ai, tn->cand[c].w, tn->seed + g, &pieces );
+
+		w->games++;
+		w->pieces += pieces;
+	}
+
+	return 0;
+}
+
+/*
+ * tune_play
+ *
+ * one game with weights w, played like blocksbot
+ *
+ * returns the fitness of the game
+ *
+ */
+static float tune_play( struct Tune *tn, struct Ai *ai, const float *w, Uint32 seed, Uint32 *pieces )
+{
+	struct Tetris t;
+	struct AiMove move;
+	int events;
+
+	tune_set( &ai->weights, w );
+
+	/* the table holds scores under the last weights */
+	memset( ai->table, 0, AI_TABLE_SIZE * sizeof(struct AiEntry) );
+
+	tetris_initialize( &t );
+	tetris_seed( &t, seed );
+	tetris_start( &t );
+	t.clear_delay = 0;
+
+	while( t.state != TETRIS_STATE_OVER && t.game_num_pieces <= tn->max_pieces ) {
+
+		events = tetris_tick( &t, 0 );
+
+		if( events & TETRIS_EVENT_SPAWN ) {
+			if( ai_choose( ai, &t, &move ) != 0 )
+				break;
+
+			while( ai_step( &t, &move ) )
+				;
+		}
+	}
+
+	*pieces = t.game_num_pieces;
+
+	if( tn->fitness == TUNE_FITNESS_LINES )
+		return t.game_total_num_lines_cleared;
+
+	return t.game_score;
+}
+
+/*
+ * tune_race
+ *
+ * drop the candidates that are clearly behind the weakest elite. all of
+ * them played the same games, so each is judged on its differences to
+ * the elite game by game, which vary far less than the games do. one
+ * game has no variance to judge by, the race starts after two.
+ *
+ */
+static void tune_race( struct Tune *tn, int elite, double z )
+{
+	struct TuneCandidate *order[TUNE_MAX_POPULATION];
+	struct TuneCandidate *c;
+	const float *rc, *rt;
+	double d, m, v;
+	Uint32 g, n;
+	int num;
+	int i;
+
+	n = tn->hi;
+	if( n < 2 )
+		return;
+
+	num = 0;
+	for( i=0; i<tn->num_cands; i++ ) {
+		if( tn->cand[i].racing )
+			order[num++] = &tn->cand[i];
+	}
+
+	if( num <= elite )
+		return;
+
+	qsort( order, num, sizeof(order[0]), tune_compare );
+
+	rt = &tn->result[( order[elite-1] - tn->cand ) * tn->games];
+
+	for( i=elite; i<num; i++ ) {
+		c = order[i];
+
+		/* the mean is always played out for the log */
+		if( c == &tn->cand[0] )
+			continue;
+
+		rc = &tn->result[( c - tn->cand ) * tn->games];
+
+		m = 0.0;
+		for( g=0; g<n; g++ )
+			m += rc[g] - rt[g];
+		m /= n;
+
+		v = 0.0;
+		for( g=0; g<n; g++ ) {
+			d = rc[g] - rt[g] - m;
+			v += d * d;
+		}
+		v /= n - 1;
+
+		if( m + z * sqrt( v / n ) < 0.0 )
+			c->racing = 0;
+	}
+}
+
+/*
+ * tune_compare
+ *
+ * candidates still racing first, then by mean fitness, best first
+ *
+ */
+static int tune_compare( const void *a, const void *b )
+{
+	const struct TuneCandidate *ca = *(struct TuneCandidate * const *)a;
+	const struct TuneCandidate *cb = *(struct TuneCandidate * const *)b;
+
+	if( ca->racing != cb->racing )
+		return cb->racing - ca->racing;
+
+	if( ca->mean > cb->mean )
+		return -1;
+	if( ca->mean < cb->mean )
+		return 1;
+
+	/* the same every run, whatever qsort does with ties */
+	return ( ca < cb ) ? -1 : ( ca > cb );
+}
+
+/*
+ * tune_normalize
+ *
+ */
+static void tune_normalize( float *w )
+{
+	double len;
+	int k;
+
+	len = 0.0;
+	for( k=0; k<TUNE_NUM_WEIGHTS; k++ )
+		len += w[k] * w[k];
+
+	len = sqrt( len );
+	if( len <= 0.0 )
+		return;
+
+	for( k=0; k<TUNE_NUM_WEIGHTS; k++ )
+		w[k] /= len;
+}
+
+/*
+ * tune_set
+ *
+ */
+static void tune_set( struct AiWeights *aw, const float *w )
+{
+	aw->height = w[0];
+	aw->lines = w[1];
+	aw->holes = w[2];
+	aw->bumpiness = w[3];
+}
+
+/*
+ * tune_gauss
+ *
+ * standard normal deviate from a xorshift generator, Box-Muller
+ *
+ */
+static double tune_gauss( Uint32 *rng )
+{
+	double u[2];
+	int i;
+
+	for( i=0; i<2; i++ ) {
+		*rng ^= *rng << 13;
+		*rng ^= *rng >> 17;
+		*rng ^= *rng << 5;
+		u[i] = ( *rng + 1.0 ) / 4294967297.0;
+	}
+
+	return sqrt( -2.0 * log( u[0] ) ) * cos( 2.0 * M_PI * u[1] );
+}
+
+/*
+ * tune_clock
+ *
+ * monotonic time in seconds
+ *
+ */
+static double tune_clock( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ts.tv_sec + ( ts.tv_nsec / 1.0e9 );
+}
+
+/* vim: set ci ai ts=4 sw=4: */
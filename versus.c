@@ -0,0 +1,562 @@
+/*
+SDLBlocks
+
+Description:
+Versus mode: boards on threads of their own sending each other the
+garbage rows of their line clears through lock-free queues.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#include <string.h>
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "replay.h"
+#include "ai.h"
+#include "versus.h"
+
+static int    versus_thread( void *data );
+static int    versus_wait( struct VersusBoard *b, Uint32 now );
+static int    versus_step( struct VersusBoard *b, Uint32 now );
+static void   versus_receive( struct VersusBoard *b, Uint32 now );
+static void   versus_send( struct VersusBoard *b, Uint32 now );
+static void   versus_bot( struct VersusBoard *b, Uint32 now, int events );
+static int    versus_beaten( struct VersusBoard *b, Uint32 now );
+static Uint32 versus_random( struct VersusBoard *b );
+static void   versus_publish( struct VersusBoard *b );
+static void   versus_fill( struct VersusBoard *b, struct VersusSnapshot *s );
+
+/*
+ * versus_initialize
+ *
+ * every board deals the same tetrads from seed. ai[i] plays board i,
+ * NULL leaves it to versus_action(). a headless match stops as a draw
+ * after max_time ms of game time, 0 for no limit.
+ *
+ */
+void versus_initialize( struct Versus *v, int num_players, Uint32 seed, struct Ai **ai, int headless, Uint32 max_time )
+{
+	struct VersusBoard *b;
+	int i;
+
+	memset( v, 0, sizeof(*v) );
+
+	v->num_players = num_players;
+	v->headless = headless;
+	v->max_time = max_time;
+
+	for( i=0; i<num_players; i++ ) {
+		b = &v->board[i];
+
+		b->v = v;
+		b->id = i;
+		b->ai = ai[i];
+		b->rng = ( seed + (Uint32)i * 0x9e3779b9 ) | 1;
+		b->target = ( i + 1 ) % num_players;
+		b->result = VERSUS_PLAYING;
+
+		tetris_initialize( &b->tetris );
+		tetris_seed( &b->tetris, seed );
+		tetris_start( &b->tetris );
+
+		/* the renderer starts out with a valid snapshot */
+		b->snap_back = 0;
+		b->snap_middle = 1;
+		b->snap_front = 2;
+		versus_fill( b, &b->snap[b->snap_front] );
+	}
+}
+
+/*
+ * versus_start
+ *
+ * start a thread per board
+ *
+ * returns 0 on success, -1 on failure
+ *
+ */
+int versus_start( struct Versus *v )
+{
+	int i;
+
+	v->quit = 0;
+	v->start = SDL_GetTicks();
+
+	for( i=0; i<v->num_players; i++ ) {
+		v->board[i].thread = SDL_CreateThread( versus_thread, &v->board[i] );
+
+		if( v->board[i].thread == NULL ) {
+			versus_stop( v );
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * versus_stop
+ *
+ * stop the board threads, a match that is over is left as it was
+ *
+ */
+void versus_stop( struct Versus *v )
+{
+	int i;
+
+	__atomic_store_n( &v->quit, 1, __ATOMIC_RELEASE );
+
+	for( i=0; i<v->num_players; i++ ) {
+		if( v->board[i].thread != NULL ) {
+			SDL_WaitThread( v->board[i].thread, NULL );
+			v->board[i].thread = NULL;
+		}
+	}
+}
+
+/*
+ * versus_over
+ *
+ * once every board has stopped, settle the results: the board that
+ * lasted longest wins, boards that lasted equally long draw.
+ *
+ * returns 1 if the match is over
+ *
+ */
+int versus_over( struct Versus *v )
+{
+	struct VersusBoard *b;
+	Uint32 last;
+	int num_last;
+	int i;
+
+	for( i=0; i<v->num_players; i++ ) {
+		if( __atomic_load_n( &v->board[i].clock, __ATOMIC_ACQUIRE ) != VERSUS_STOPPED )
+			return 0;
+	}
+
+	last = 0;
+	num_last = 0;
+
+	for( i=0; i<v->num_players; i++ ) {
+		b = &v->board[i];
+
+		if( b->end_time > last ) {
+			last = b->end_time;
+			num_last = 0;
+		}
+		if( b->end_time == last )
+			num_last++;
+	}
+
+	for( i=0; i<v->num_players; i++ ) {
+		b = &v->board[i];
+
+		if( b->end_time < last )
+			b->result = VERSUS_LOST;
+		else if( num_last > 1 )
+			b->result = VERSUS_DRAW;
+		else
+			b->result = VERSUS_WON;
+	}
+
+	return 1;
+}
+
+/*
+ * versus_action
+ *
+ * queue a replay action for a board played from the event loop.
+ * actions are dropped if the board falls VERSUS_INPUT_SIZE behind.
+ *
+ * returns 0 if queued, -1 if dropped
+ *
+ */
+int versus_action( struct Versus *v, int player, int action )
+{
+	struct VersusBoard *b = &v->board[player];
+	Uint32 head;
+
+	head = b->input_head;
+
+	if( head - __atomic_load_n( &b->input_tail, __ATOMIC_ACQUIRE ) >= VERSUS_INPUT_SIZE )
+		return -1;
+
+	b->input[head & (VERSUS_INPUT_SIZE-1)] = action;
+
+	__atomic_store_n( &b->input_head, head + 1, __ATOMIC_RELEASE );
+
+	return 0;
+}
+
+/*
+ * versus_snapshot
+ *
+ * the newest snapshot of a board, called from the renderer only. the
+ * snapshot stays valid until the next call for the same board.
+ *
+ * returns 1 if it is newer than the one from the last call
+ *
+ */
+int versus_snapshot( struct Versus *v, int player, struct VersusSnapshot **snap )
+{
+	struct VersusBoard *b = &v->board[player];
+	int fresh;
+
+	fresh = 0;
+
+	if( __atomic_load_n( &b->snap_middle, __ATOMIC_ACQUIRE ) & VERSUS_SNAP_FRESH ) {
+		b->snap_front = __atomic_exchange_n( &b->snap_middle, b->snap_front, __ATOMIC_ACQ_REL ) & 3;
+		fresh = 1;
+	}
+
+	*snap = &b->snap[b->snap_front];
+
+	return fresh;
+}
+
+/*
+ * versus_thread
+ *
+ * on the clock a board steps every VERSUS_TICKS like game_thread, a
+ * headless board steps VERSUS_STEP of game time as soon as none of
+ * its opponents is more than VERSUS_DELAY behind
+ *
+ */
+static int versus_thread( void *data )
+{
+	struct VersusBoard *b = data;
+	struct Versus *v = b->v;
+	Uint32 now, next, ticks;
+
+	now = 0;
+	next = v->start;
+
+	while( !__atomic_load_n( &v->quit, __ATOMIC_ACQUIRE ) ) {
+
+		if( v->headless ) {
+			now += VERSUS_STEP;
+
+			if( !versus_wait( b, now ) )
+				break;
+		}
+		else {
+			ticks = SDL_GetTicks();
+
+			if( (Sint32)( next - ticks ) > 0 ) {
+				SDL_Delay( next - ticks );
+				continue;
+			}
+
+			now = next - v->start;
+			next += VERSUS_TICKS;
+		}
+
+		if( !versus_step( b, now ) ) {
+			b->end_time = now;
+			break;
+		}
+
+		versus_publish( b );
+		__atomic_store_n( &b->clock, now, __ATOMIC_RELEASE );
+	}
+
+	versus_publish( b );
+	__atomic_store_n( &b->clock, VERSUS_STOPPED, __ATOMIC_RELEASE );
+
+	return 0;
+}
+
+/*
+ * versus_wait
+ *
+ * hold a headless board back until every opponent has simulated up to
+ * now - VERSUS_DELAY, so every attack due by now is in its queues
+ *
+ * returns 0 if the match was stopped meanwhile
+ *
+ */
+static int versus_wait( struct VersusBoard *b, Uint32 now )
+{
+	struct Versus *v = b->v;
+	Uint32 clock;
+	int i;
+
+	if( now <= VERSUS_DELAY )
+		return 1;
+
+	for( i=0; i<v->num_players; i++ ) {
+		if( i == b->id )
+			continue;
+
+		for( ;; ) {
+			clock = __atomic_load_n( &v->board[i].clock, __ATOMIC_ACQUIRE );
+
+			if( clock == VERSUS_STOPPED || clock >= now - VERSUS_DELAY )
+				break;
+
+			if( __atomic_load_n( &v->quit, __ATOMIC_ACQUIRE ) )
+				return 0;
+
+			SDL_Delay( 0 );
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * versus_step
+ *
+ * one step of a board at game time now
+ *
+ * returns 0 once the board is done playing
+ *
+ */
+static int versus_step( struct VersusBoard *b, Uint32 now )
+{
+	struct Versus *v = b->v;
+	struct Tetris *t = &b->tetris;
+	Uint32 tail;
+	int events;
+
+	tail = b->input_tail;
+
+	while( tail != __atomic_load_n( &b->input_head, __ATOMIC_ACQUIRE ) ) {
+		replay_apply( t, b->input[tail & (VERSUS_INPUT_SIZE-1)] );
+		tail++;
+		__atomic_store_n( &b->input_tail, tail, __ATOMIC_RELEASE );
+	}
+
+	versus_receive( b, now );
+
+	events = tetris_tick( t, now );
+
+	if( b->ai != NULL )
+		versus_bot( b, now, events );
+
+	if( t->garbage_out )
+		versus_send( b, now );
+
+	if( events & TETRIS_EVENT_OVER ) {
+		b->topped_out = 1;
+		return 0;
+	}
+
+	if( versus_beaten( b, now ) )
+		return 0;
+
+	if( v->headless && v->max_time && now >= v->max_time )
+		return 0;
+
+	return 1;
+}
+
+/*
+ * versus_receive
+ *
+ * collect the attacks sent to a board and push in the garbage of those
+ * that have come due, all of it with the same gap
+ *
+ */
+static void versus_receive( struct VersusBoard *b, Uint32 now )
+{
+	struct Versus *v = b->v;
+	struct VersusQueue *q;
+	Uint32 head, tail;
+	Uint32 rows;
+	int i;
+
+	for( i=0; i<v->num_players; i++ ) {
+		if( i == b->id )
+			continue;
+
+		q = &v->queue[i][b->id];
+		head = __atomic_load_n( &q->head, __ATOMIC_ACQUIRE );
+		tail = q->tail;
+
+		while( tail != head && b->num_pending < VERSUS_MAX_PLAYERS*VERSUS_QUEUE_SIZE ) {
+			b->pending[b->num_pending++] = q->slot[tail & (VERSUS_QUEUE_SIZE-1)];
+			tail++;
+		}
+
+		__atomic_store_n( &q->tail, tail, __ATOMIC_RELEASE );
+	}
+
+	/* only attacks that are due count, those are in the queues by now
+	 * however the threads were scheduled */
+	rows = 0;
+
+	for( i=0; i<b->num_pending; ) {
+		if( (Sint32)( now - b->pending[i].time ) >= VERSUS_DELAY ) {
+			rows += b->pending[i].rows;
+			b->pending[i] = b->pending[--b->num_pending];
+		}
+		else
+			i++;
+	}
+
+	if( rows == 0 )
+		return;
+
+	b->tetris.garbage_in += rows;
+	b->tetris.garbage_hole = versus_random( b ) % TETRIS_WIDTH;
+	b->received += rows;
+}
+
+/*
+ * versus_send
+ *
+ * send the garbage of a board's clears to its opponents in turn, an
+ * attack on a full queue or on a board that has stopped is lost
+ *
+ */
+static void versus_send( struct VersusBoard *b, Uint32 now )
+{
+	struct Versus *v = b->v;
+	struct VersusQueue *q;
+	Uint32 head;
+
+	q = &v->queue[b->id][b->target];
+	head = q->head;
+
+	if( head - __atomic_load_n( &q->tail, __ATOMIC_ACQUIRE ) < VERSUS_QUEUE_SIZE ) {
+		q->slot[head & (VERSUS_QUEUE_SIZE-1)].time = now;
+		q->slot[head & (VERSUS_QUEUE_SIZE-1)].rows = b->tetris.garbage_out;
+		__atomic_store_n( &q->head, head + 1, __ATOMIC_RELEASE );
+	}
+
+	b->sent += b->tetris.garbage_out;
+	b->tetris.garbage_out = 0;
+
+	b->target = ( b->target + 1 ) % v->num_players;
+	if( b->target == b->id )
+		b->target = ( b->target + 1 ) % v->num_players;
+}
+
+/*
+ * versus_bot
+ *
+ * the AI plans each tetrad as it spawns, then plays it one action
+ * every VERSUS_BOT_TICKS on the clock or all at once headless
+ *
+ */
+static void versus_bot( struct VersusBoard *b, Uint32 now, int events )
+{
+	struct Tetris *t = &b->tetris;
+
+	if( events & TETRIS_EVENT_SPAWN ) {
+		b->moving = ( ai_choose( b->ai, t, &b->move ) == 0 );
+		b->move_time = now;
+	}
+
+	if( !b->moving || !TETRIS_ACTIVE( t ) )
+		return;
+
+	if( b->v->headless ) {
+		while( ai_step( t, &b->move ) )
+			;
+		b->moving = 0;
+	}
+	else if( now - b->move_time >= VERSUS_BOT_TICKS ) {
+		b->move_time = now;
+		b->moving = ai_step( t, &b->move );
+	}
+}
+
+/*
+ * versus_beaten
+ *
+ * a board has won once every opponent stopped at least VERSUS_DELAY
+ * ago. a headless board only ever sees opponents up to that point of
+ * their game, so asking no sooner keeps matches the same every run.
+ *
+ * returns 1 if all the opponents are done
+ *
+ */
+static int versus_beaten( struct VersusBoard *b, Uint32 now )
+{
+	struct Versus *v = b->v;
+	struct VersusBoard *o;
+	int i;
+
+	if( now < VERSUS_DELAY )
+		return 0;
+
+	for( i=0; i<v->num_players; i++ ) {
+		o = &v->board[i];
+
+		if( o == b )
+			continue;
+
+		if( __atomic_load_n( &o->clock, __ATOMIC_ACQUIRE ) != VERSUS_STOPPED )
+			return 0;
+
+		if( o->end_time > now - VERSUS_DELAY )
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * versus_random
+ *
+ * xorshift, each board has a generator of its own
+ *
+ */
+static Uint32 versus_random( struct VersusBoard *b )
+{
+	b->rng ^= b->rng << 13;
+	b->rng ^= b->rng >> 17;
+	b->rng ^= b->rng << 5;
+
+	return b->rng;
+}
+
+/*
+ * versus_publish
+ *
+ * hand the state after this step to the renderer
+ *
+ */
+static void versus_publish( struct VersusBoard *b )
+{
+	versus_fill( b, &b->snap[b->snap_back] );
+	b->snap_back = __atomic_exchange_n( &b->snap_middle, b->snap_back | VERSUS_SNAP_FRESH, __ATOMIC_ACQ_REL ) & 3;
+}
+
+/*
+ * versus_fill
+ *
+ */
+static void versus_fill( struct VersusBoard *b, struct VersusSnapshot *s )
+{
+	int i;
+
+	s->tetris = b->tetris;
+	s->sent = b->sent;
+	s->received = b->received;
+
+	s->incoming = b->tetris.garbage_in;
+	for( i=0; i<b->num_pending; i++ )
+		s->incoming += b->pending[i].rows;
+}
+
+/* vim: set ci ai ts=4 sw=4: */
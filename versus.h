@@ -0,0 +1,161 @@
+/*
+SDLBlocks
+
+Description:
+Versus mode: boards on threads of their own sending each other the
+garbage rows of their line clears through lock-free queues.
+
+Don E. Llopis 2005 (llopis.don@gmail.com)
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or (at
+your option) any later version.
+
+This program is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+USA
+*/
+
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include <SDL/SDL.h>
+
+#include "tetris.h"
+#include "ai.h"
+
+#define VERSUS_MAX_PLAYERS 4
+
+/* attacks in flight from one board to another, must be a power of two */
+#define VERSUS_QUEUE_SIZE 64
+
+/* actions queued from the event loop to a board, must be a power of two */
+#define VERSUS_INPUT_SIZE 64
+
+/* game time from a line clear until its garbage can rise (ms) */
+#define VERSUS_DELAY 500
+
+/* simulation step of a board on the clock, game time per step of a
+ * headless board, and time between AI actions on the clock (ms) */
+#define VERSUS_TICKS 4
+#define VERSUS_STEP 16
+#define VERSUS_BOT_TICKS 40
+
+/* clock of a board that has stopped, never holds anyone back */
+#define VERSUS_STOPPED 0xffffffff
+
+/* results of a board */
+#define VERSUS_PLAYING 0
+#define VERSUS_WON     1
+#define VERSUS_LOST    2
+#define VERSUS_DRAW    3
+
+/* garbage sent at game time time */
+struct VersusAttack {
+	Uint32 time;
+	Uint32 rows;
+};
+
+/*
+ * single producer single consumer ring: only the sending board
+ * advances head, only the receiving board advances tail
+ *
+ */
+struct VersusQueue {
+	struct VersusAttack slot[VERSUS_QUEUE_SIZE];
+	Uint32 head __attribute__(( aligned(64) ));
+	Uint32 tail __attribute__(( aligned(64) ));
+};
+
+/* what the renderer draws of a board, incoming -- garbage rows on their way */
+struct VersusSnapshot {
+	struct Tetris tetris;
+	Uint32 incoming;
+	Uint32 sent;
+	Uint32 received;
+};
+
+struct VersusBoard {
+
+	struct Tetris tetris;
+	struct Versus *v;
+	int id;
+
+	/* ai -- set if the AI plays this board */
+	struct Ai *ai;
+	struct AiMove move;
+	int moving;
+	Uint32 move_time;
+
+	/* pending -- attacks received that haven't come due,
+	 * rng -- picks the gap in the garbage, target -- next opponent */
+	struct VersusAttack pending[VERSUS_MAX_PLAYERS*VERSUS_QUEUE_SIZE];
+	int num_pending;
+	Uint32 rng;
+	int target;
+
+	Uint32 sent;
+	Uint32 received;
+
+	/* end_time -- game time the board stopped, topped out -- it lost its
+	 * stack, result -- VERSUS_*, settled by versus_over() */
+	Uint32 end_time;
+	int topped_out;
+	int result;
+
+	/* input -- replay actions from the event loop, a single producer
+	 * single consumer ring like the attack queues */
+	Uint8 input[VERSUS_INPUT_SIZE];
+	Uint32 input_head __attribute__(( aligned(64) ));
+	Uint32 input_tail __attribute__(( aligned(64) ));
+
+	/* snap -- triple buffer of snapshots, as in game.c */
+	struct VersusSnapshot snap[3];
+	int snap_back;
+	int snap_front;
+	int snap_middle __attribute__(( aligned(64) ));
+
+	/* clock -- game time the board has been simulated up to, attacks
+	 * sent before it are in the queues */
+	Uint32 clock __attribute__(( aligned(64) ));
+
+	SDL_Thread *thread;
+};
+
+struct Versus {
+	int num_players;
+
+	/* headless -- boards run on game time as fast as they can, each
+	 * staying less than VERSUS_DELAY ahead of the others so that every
+	 * attack arrives in time and a match always plays out the same */
+	int headless;
+	Uint32 max_time;
+
+	struct VersusBoard board[VERSUS_MAX_PLAYERS];
+
+	/* queue[from][to] */
+	struct VersusQueue queue[VERSUS_MAX_PLAYERS][VERSUS_MAX_PLAYERS];
+
+	Uint32 start;
+	int quit;
+};
+
+#define VERSUS_SNAP_FRESH 4
+
+void versus_initialize( struct Versus *v, int num_players, Uint32 seed, struct Ai **ai, int headless, Uint32 max_time );
+int  versus_start( struct Versus *v );
+void versus_stop( struct Versus *v );
+int  versus_over( struct Versus *v );
+int  versus_action( struct Versus *v, int player, int action );
+int  versus_snapshot( struct Versus *v, int player, struct VersusSnapshot **snap );
+
+#endif
+
+/* vim: set ci ai ts=4 sw=4: */